@@ -56,6 +56,7 @@ enum
     IMSCSI_CLI_ERROR_PARTITION_NOT_FOUND = 12,
     IMSCSI_CLI_ERROR_WRONG_SYNTAX = 13,
     IMSCSI_CLI_NO_FREE_DRIVE_LETTERS = 14,
+    IMSCSI_CLI_ERROR_VERIFY_FAILED = 15,
     IMSCSI_CLI_ERROR_FATAL = -1
 };
 
@@ -103,13 +104,63 @@ ImScsiSyntaxHelp()
         "aim_ll --rescan\r\n"
         "        Rescans SCSI bus on installed adapter.\r\n"
         "\n"
+        "Image verification syntax:\r\n"
+        "aim_ll --build-index imagefile [chunkshift]\r\n"
+        "        Builds a Merkle index file of SHA-256 chunk hashes for an image file\r\n"
+        "        and displays the root hash. The index file is named as the image file\r\n"
+        "        with .aimidx appended. Chunk size is 2^chunkshift bytes, default 1 MB.\r\n"
+        "        Used with -o verify.\r\n"
+        "\n"
+        "aim_ll --verify-index imagefile [chunks [roothash]]\r\n"
+        "        Checks that the Merkle index file for an image file is intact and, if\r\n"
+        "        roothash is specified, that it has that root hash. Then reads the given\r\n"
+        "        number of chunks from the image file, default 64, and checks them\r\n"
+        "        against the index. First and last chunk are always checked, others are\r\n"
+        "        selected at random. With 0 chunks, only the index file is read. Use\r\n"
+        "        -o verify to check every chunk that is read from a virtual disk.\r\n"
+        "\n"
+        "Request tracing syntax:\r\n"
+        "aim_ll --trace tracefile [seconds [records]]\r\n"
+        "        Records each stage of SCSI requests to all virtual disks, with\r\n"
+        "        timestamps, and saves them to tracefile. Runs for the given number of\r\n"
+        "        seconds, or until Ctrl+C if 0 or not specified. records is the size\r\n"
+        "        of the trace buffer in driver, default 65536. The buffer is allocated\r\n"
+        "        on first use and keeps its size until the driver is restarted.\r\n"
+        "\n"
+        "aim_ll --trace-report tracefile\r\n"
+        "        Displays latency between each recorded stage of requests in a trace\r\n"
+        "        file, and from arrival to completion for each kind of request, with\r\n"
+        "        mean, percentiles and maximum.\r\n"
+        "\n"
+        "aim_ll --replay tracefile target [-u devicenumber] [-S sectorsize]\r\n"
+        "       [-q depth] [-f] [-w]\r\n"
+        "        Issues read and write requests to one virtual disk in a trace file\r\n"
+        "        again, to target, which is an image file or a disk device such as\r\n"
+        "        \\\\.\\PhysicalDrive2. Displays throughput and latency percentiles.\r\n"
+        "        -u selects the virtual disk if the trace has more than one.\r\n"
+        "        -S is the sector size of the traced disk, default 512.\r\n"
+        "        Requests are issued at their original times unless -f is specified,\r\n"
+        "        then as fast as possible with at most depth requests in progress,\r\n"
+        "        default 32. Write requests are skipped unless -w is specified, then\r\n"
+        "        they overwrite data on target with a fixed pattern.\r\n"
+        "\n"
+        "Scale test syntax:\r\n"
+        "aim_ll --scale-test [count [size]]\r\n"
+        "        Creates count virtual disks in memory, each size bytes, default 1 MB,\r\n"
+        "        and then removes them. Displays time per create and remove request.\r\n"
+        "        Default count is the number of free device addresses on adapter,\r\n"
+        "        NumberOfBuses x MaximumTargets x MaximumLuns, DWORD values under\r\n"
+        "        HKLM\\SYSTEM\\CurrentControlSet\\Services\\phdskmnt\\Parameters\r\n"
+        "        read when the driver loads. Defaults 1 x 8 x 24 give 192 addresses,\r\n"
+        "        at most 8 x 128 x 254. For example 1 x 128 x 8 allows 1024 disks.\r\n"
+        "\n"
         "Manage virtual disks:\r\n"
-        "aim_ll -a -t type [-n] [-o opt1[,opt2 ...]] [-f|-F file] [-s size] [-b offset]\r\n"
-        "       [-S sectorsize] [-u devicenumber] [-m mountpoint]\r\n"
-        "       [-p \"format-parameters\"] [-P]\r\n"
+        "aim_ll -a -t type [-n] [-o opt1[,opt2 ...]] [-f|-F file] [-O overlayfile]\r\n"
+        "       [-s size] [-b offset] [-S sectorsize] [-u devicenumber]\r\n"
+        "       [-m mountpoint] [-p \"format-parameters\"] [-P]\r\n"
         "aim_ll -d|-D [-u devicenumber | -m mountpoint] [-P]\r\n"
         "aim_ll -R -u unit\r\n"
-        "aim_ll -l [-u devicenumber | -m mountpoint]\r\n"
+        "aim_ll -l [--stats] [-u devicenumber | -m mountpoint]\r\n"
         "aim_ll -e [-s size] [-o opt1[,opt2 ...]] [-u devicenumber | -m mountpoint]\r\n"
         "\n"
         "-a      Attach a virtual disk. This will configure and attach a virtual disk\r\n"
@@ -164,9 +215,25 @@ ImScsiSyntaxHelp()
         "        specify files on disks or communication devices that currently have no\r\n"
         "        drive letters assigned.\r\n"
         "\n"
+        "-O overlayfile\r\n"
+        "        Differencing file for a file or proxy type virtual disk. With this\r\n"
+        "        switch, the image file or proxy is never written to. Writes go to the\r\n"
+        "        differencing file instead and reads combine data from the\r\n"
+        "        differencing file and the image. The differencing file is created if\r\n"
+        "        it does not exist. An existing differencing file must have been created\r\n"
+        "        for an image of the same size. Use -e with -o commit or -o discard to\r\n"
+        "        write changes to the image or throw them away. The path is a native\r\n"
+        "        path if -F is used.\r\n"
+        "\n"
         "-l      List configured devices. If given with -u or -m, display details about\r\n"
         "        that particular device.\r\n"
         "\n"
+        "--stats\r\n"
+        "        Along with -l, also display performance counters for each device:\r\n"
+        "        requests, bytes, errors and latency histograms for reads, writes,\r\n"
+        "        UNMAP and other commands, cache hits, proxy round trips and number of\r\n"
+        "        requests currently queued in driver.\r\n"
+        "\n"
         "-n      When printing listing devices, print only the unit number without other\r\n"
         "        information.\r\n"
         "\n"
@@ -232,6 +299,23 @@ ImScsiSyntaxHelp()
         "        signature is zero and master boot record has otherwise apparently valid\r\n"
         "        data.\r\n"
         "\n"
+        "verify  Checks data read from the image file against the Merkle index file\r\n"
+        "        built with --build-index. Each chunk is checked the first time it is\r\n"
+        "        read, reads of chunks that do not match fail. This option implies ro\r\n"
+        "        and cannot be combined with a write overlay.\r\n"
+        "\n"
+        "hash    Computes MD5, SHA-1 and SHA-256 digests of the virtual disk contents\r\n"
+        "        while the disk is in use. Parts of the disk not read by Windows are\r\n"
+        "        read by the driver when the disk is idle. Progress and digests are\r\n"
+        "        displayed in the -l output for the virtual disk. This option implies\r\n"
+        "        ro and cannot be combined with a write overlay.\r\n"
+        "\n"
+        "wb      Write-back caching. Writes complete when they are in the file\r\n"
+        "        system cache of the image file or write overlay and are flushed on\r\n"
+        "        SYNCHRONIZE CACHE, FUA writes, shutdown and removal of the virtual\r\n"
+        "        disk. Not valid for memory disks, split images and proxy disks\r\n"
+        "        without write overlay.\r\n"
+        "\n"
         "sparse  Sets NTFS sparse attribute on image file. This has no effect on proxy\r\n"
         "        or vm type virtual disks.\r\n"
         "\n"
@@ -251,6 +335,15 @@ ImScsiSyntaxHelp()
         "        in the -l output for a virtual disk. The 'saved' option is only valid\r\n"
         "        with the -e parameter.\r\n"
         "\n"
+        "commit  Writes all changes in the differencing file of a virtual disk created\r\n"
+        "        with -O to the image file or proxy and empties the differencing file.\r\n"
+        "        Only valid with the -e parameter.\r\n"
+        "\n"
+        "discard Empties the differencing file of a virtual disk created with -O, so\r\n"
+        "        that the virtual disk shows the unmodified image again. Dismount\r\n"
+        "        filesystems on the virtual disk first. Only valid with the -e\r\n"
+        "        parameter.\r\n"
+        "\n"
         "        Note that virtual floppy or CD/DVD-ROM drives are always read-only and\r\n"
         "        removable devices and that cannot be changed.\r\n"
         "\n"
@@ -298,6 +391,20 @@ ImScsiSyntaxHelp()
         "\n"
         "        NOTE: This option is currently not supported by the driver.\r\n"
         "\n"
+        "comp    Can only be used with vm type virtual disks. Contents not recently\r\n"
+        "        used are compressed in memory and decompressed again when accessed.\r\n"
+        "        Blocks containing only zeros use no memory at all.\r\n"
+        "\n"
+        "dedup   Can only be used with vm type virtual disks. Identical blocks of\r\n"
+        "        contents not recently used are stored only once in memory. Can be\r\n"
+        "        combined with comp.\r\n"
+        "\n"
+        "split   Can only be used with file type virtual disks. The file specified\r\n"
+        "        with -f or -F is the first segment of an image split into several\r\n"
+        "        files with numbered extensions, such as image.001. Following segments,\r\n"
+        "        image.002, image.003 and so on, are used in that order until there is\r\n"
+        "        no file with next number. Cannot be combined with -O.\r\n"
+        "\n"
         "par     Parallel I/O. Valid for file-type virtual disks. With this flag set,\r\n"
         "        driver sends read and write requests for the virtual disk directly down\r\n"
         "        to the driver that handles the image file, within the SCSIOP dispatch\r\n"
@@ -458,6 +565,104 @@ ImScsiCliCheckDriverVersion(HANDLE Device)
     return TRUE;
 }
 
+// Finds further segment files of a split image by counting up the numeric
+// extension of the first segment file name, such as image.001, image.002
+// and so on, until no such file exists. Native paths of segment files found
+// are stored in SegmentNames, separated by null characters.
+BOOL
+ImScsiCliFindImageSegments(LPCWSTR FirstSegment,
+BOOL NativePath,
+LPWSTR SegmentNames,
+USHORT MaxLength,
+PUSHORT SegmentNamesLength)
+{
+    const WCHAR global_root[] = L"\\\\?\\GLOBALROOT";
+
+    size_t name_length = wcslen(FirstSegment);
+    size_t digits = 0;
+
+    while ((digits < name_length) &&
+        (FirstSegment[name_length - digits - 1] >= L'0') &&
+        (FirstSegment[name_length - digits - 1] <= L'9'))
+        digits++;
+
+    if (digits == 0)
+    {
+        SetLastError(ERROR_INVALID_NAME);
+        return FALSE;
+    }
+
+    // Native paths are checked for existence through GLOBALROOT.
+    WHeapMem<WCHAR> check_name(sizeof(global_root) +
+        (name_length * sizeof(WCHAR)),
+        HEAP_GENERATE_EXCEPTIONS);
+
+    LPWSTR segment_name = check_name;
+
+    if (NativePath)
+    {
+        wcscpy(check_name, global_root);
+        segment_name += wcslen(global_root);
+    }
+
+    wcscpy(segment_name, FirstSegment);
+
+    LPWSTR number = segment_name + name_length - digits;
+
+    *SegmentNamesLength = 0;
+
+    for (;;)
+    {
+        size_t i = digits;
+
+        while ((i > 0) && (number[i - 1] == L'9'))
+            number[--i] = L'0';
+
+        if (i == 0)
+            break;
+
+        number[i - 1]++;
+
+        if (GetFileAttributes(check_name) == INVALID_FILE_ATTRIBUTES)
+            break;
+
+        UNICODE_STRING native_name;
+        if (NativePath ?
+            !RtlCreateUnicodeString(&native_name, segment_name) :
+            !RtlDosPathNameToNtPathName_U(segment_name, &native_name,
+            NULL, NULL))
+        {
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            return FALSE;
+        }
+
+        USHORT separator_length = *SegmentNamesLength > 0 ? sizeof(WCHAR) : 0;
+
+        if (*SegmentNamesLength + separator_length + native_name.Length >
+            MaxLength)
+        {
+            RtlFreeUnicodeString(&native_name);
+            SetLastError(ERROR_FILENAME_EXCED_RANGE);
+            return FALSE;
+        }
+
+        if (separator_length != 0)
+        {
+            SegmentNames[*SegmentNamesLength >> 1] = 0;
+            *SegmentNamesLength += separator_length;
+        }
+
+        memcpy(SegmentNames + (*SegmentNamesLength >> 1), native_name.Buffer,
+            native_name.Length);
+
+        *SegmentNamesLength += native_name.Length;
+
+        RtlFreeUnicodeString(&native_name);
+    }
+
+    return TRUE;
+}
+
 // Creates a new virtual disk device.
 int
 ImScsiCliCreateDevice(PDEVICE_NUMBER DeviceNumber,
@@ -466,6 +671,7 @@ ULONG BytesPerSector,
 PLARGE_INTEGER ImageOffset,
 DWORD Flags,
 LPCWSTR FileName,
+LPCWSTR OverlayFileName,
 BOOL NativePath,
 BOOL NumericPrint,
 BOOL SaveSettings,
@@ -656,8 +862,52 @@ LPWSTR FormatOptions)
         }
     }
 
+    // Further segments of a split image follow first segment file name,
+    // separated by null characters.
+    WHeapMem<WCHAR> segment_names;
+    USHORT segment_names_length = 0;
+    if ((Flags & IMSCSI_MULTI_SEGMENT) && (FileName != NULL))
+    {
+        segment_names = (LPWSTR)HeapAlloc(GetProcessHeap(),
+            HEAP_GENERATE_EXCEPTIONS, UNICODE_STRING_MAX_BYTES);
+
+        if (!ImScsiCliFindImageSegments(FileName, NativePath, segment_names,
+            (USHORT)(UNICODE_STRING_MAX_BYTES - sizeof(WCHAR) - file_name.Length),
+            &segment_names_length))
+        {
+            RtlFreeUnicodeString(&file_name);
+            CloseHandle(driver);
+            PrintLastError(L"Error finding image segment files:");
+            return IMSCSI_CLI_ERROR_CREATE_DEVICE;
+        }
+    }
+
+    // Differencing file name for write overlay follows image file name,
+    // separated by a null character.
+    UNICODE_STRING overlay_file_name;
+    if (OverlayFileName == NULL)
+        RtlInitUnicodeString(&overlay_file_name, NULL);
+    else if (NativePath ?
+        !RtlCreateUnicodeString(&overlay_file_name, OverlayFileName) :
+        !RtlDosPathNameToNtPathName_U(OverlayFileName, &overlay_file_name,
+        NULL, NULL))
+    {
+        RtlFreeUnicodeString(&file_name);
+        CloseHandle(driver);
+        fputs("Memory allocation error.\r\n", stderr);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+    else
+        Flags |= IMSCSI_WRITE_OVERLAY;
+
+    USHORT file_name_length = file_name.Length;
+    if (overlay_file_name.Length != 0)
+        file_name_length += sizeof(WCHAR) + overlay_file_name.Length;
+    if (segment_names_length != 0)
+        file_name_length += sizeof(WCHAR) + segment_names_length;
+
     WHeapMem<SRB_IMSCSI_CREATE_DATA> create_data(
-        sizeof(SRB_IMSCSI_CREATE_DATA) + file_name.Length,
+        sizeof(SRB_IMSCSI_CREATE_DATA) + file_name_length,
         HEAP_GENERATE_EXCEPTIONS | HEAP_ZERO_MEMORY);
 
     puts("Creating device...");
@@ -667,12 +917,31 @@ LPWSTR FormatOptions)
     create_data->Fields.BytesPerSector = BytesPerSector;
     create_data->Fields.ImageOffset = *ImageOffset;
     create_data->Fields.Flags = Flags;
-    create_data->Fields.FileNameLength = file_name.Length;
+    create_data->Fields.FileNameLength = file_name_length;
 
     if (file_name.Length != 0)
     {
         memcpy(&create_data->Fields.FileName, file_name.Buffer,
             file_name.Length);
+    }
+
+    if (overlay_file_name.Length != 0)
+    {
+        memcpy(&create_data->Fields.FileName[(file_name.Length >> 1) + 1],
+            overlay_file_name.Buffer,
+            overlay_file_name.Length);
+        RtlFreeUnicodeString(&overlay_file_name);
+    }
+
+    if (segment_names_length != 0)
+    {
+        memcpy(&create_data->Fields.FileName[(file_name.Length >> 1) + 1],
+            segment_names,
+            segment_names_length);
+    }
+
+    if (file_name.Length != 0)
+    {
         RtlFreeUnicodeString(&file_name);
     }
 
@@ -1305,11 +1574,76 @@ BOOL RemoveSettings)
     return IMSCSI_CLI_SUCCESS;
 }
 
+// Prints performance counters of a virtual disk device.
+void
+ImScsiCliPrintStatistics(HANDLE Adapter, DEVICE_NUMBER DeviceNumber)
+{
+    static const char * const class_names[IMSCSI_STAT_CLASSES] =
+    {
+        "Read",
+        "Write",
+        "Unmap",
+        "Other"
+    };
+
+    IMSCSI_LU_STATISTICS statistics;
+
+    if (!ImScsiQueryStatistics(Adapter, DeviceNumber, &statistics))
+    {
+        PrintLastError(L"Error querying performance counters:");
+        return;
+    }
+
+    printf("Queued requests: %i\n"
+        "Cache: %I64i hits, %I64i misses\n"
+        "Proxy round trips: %I64i\n",
+        statistics.QueueDepth,
+        statistics.CacheHits,
+        statistics.CacheMisses,
+        statistics.ProxyRoundTrips);
+
+    for (int c = 0; c < IMSCSI_STAT_CLASSES; c++)
+    {
+        PIMSCSI_OPERATION_STATISTICS operation = &statistics.Operations[c];
+
+        printf("%s: %I64i requests, %I64i bytes, %I64i errors",
+            class_names[c],
+            operation->Requests,
+            operation->Bytes,
+            operation->Errors);
+
+        if (operation->Requests == 0)
+        {
+            puts("");
+            continue;
+        }
+
+        printf(", average latency %I64i us\n",
+            operation->LatencyTotal / operation->Requests);
+
+        // Bucket n counts latencies below 2^n microseconds.
+        for (int b = 0; b < IMSCSI_STAT_LATENCY_BUCKETS; b++)
+        {
+            if (operation->Latency[b] == 0)
+                continue;
+
+            if (b == IMSCSI_STAT_LATENCY_BUCKETS - 1)
+                printf("  >= %10I64u us: %I64i\n",
+                1ULL << (b - 1), operation->Latency[b]);
+            else
+                printf("  <  %10I64u us: %I64i\n",
+                1ULL << b, operation->Latency[b]);
+        }
+    }
+}
+
 // Prints information about an existing virtual disk device, identified by
-// either a device number or mount point.
+// either a device number or mount point. Performance counters are included
+// if ShowStatistics is TRUE.
 int
 ImScsiCliQueryStatusDevice(DEVICE_NUMBER DeviceNumber,
-LPWSTR MountPoint)
+LPWSTR MountPoint,
+BOOL ShowStatistics)
 {
     WHeapMem<IMSCSI_DEVICE_CONFIGURATION> config(
         UNICODE_STRING_MAX_BYTES,
@@ -1416,11 +1750,36 @@ LPWSTR MountPoint)
 
         if (config->FileNameLength != 0)
         {
+            int name_length = (int)(config->FileNameLength /
+                sizeof(*config->FileName));
+            int image_name_length = (int)wcsnlen(config->FileName,
+                name_length);
+
             ImScsiOemPrintF(stdout,
                 "Image file: %1!.*ws!",
-                (int)(config->FileNameLength /
-                sizeof(*config->FileName)),
+                image_name_length,
                 config->FileName);
+
+            if (config->Flags & IMSCSI_MULTI_SEGMENT)
+                for (int segment_name_start = image_name_length + 1;
+                    segment_name_start < name_length;)
+                {
+                    int segment_name_length = (int)wcsnlen(
+                        config->FileName + segment_name_start,
+                        name_length - segment_name_start);
+
+                    ImScsiOemPrintF(stdout,
+                        "Image file segment: %1!.*ws!",
+                        segment_name_length,
+                        config->FileName + segment_name_start);
+
+                    segment_name_start += segment_name_length + 1;
+                }
+            else if (image_name_length + 1 < name_length)
+                ImScsiOemPrintF(stdout,
+                    "Write overlay file: %1!.*ws!",
+                    name_length - image_name_length - 1,
+                    config->FileName + image_name_length + 1);
         }
         else
             puts("No image file.");
@@ -1434,7 +1793,7 @@ LPWSTR MountPoint)
             _h(config->DiskSize.QuadPart),
             _p(config->DiskSize.QuadPart));
 
-        printf("%s%s%s%s%s.\n",
+        printf("%s%s%s%s%s%s%s%s%s%s%s%s.\n",
             IMSCSI_READONLY(config->Flags) ?
             ", ReadOnly" : "",
             IMSCSI_REMOVABLE(config->Flags) ?
@@ -1454,7 +1813,55 @@ LPWSTR MountPoint)
             IMSCSI_DEVICE_TYPE_RAW ? ", RAW" :
             IMSCSI_DEVICE_TYPE(config->Flags) ==
             IMSCSI_DEVICE_TYPE_FD ? ", Floppy" : ", HDD",
-            config->Flags & IMSCSI_IMAGE_MODIFIED ? ", Modified" : "");
+            config->Flags & IMSCSI_IMAGE_MODIFIED ? ", Modified" : "",
+            config->Flags & IMSCSI_VM_COMPRESS ? ", Compressed" : "",
+            config->Flags & IMSCSI_VM_DEDUP ? ", Deduplicated" : "",
+            config->Flags & IMSCSI_WRITE_OVERLAY ? ", Write Overlay" : "",
+            config->Flags & IMSCSI_MULTI_SEGMENT ? ", Split Image" : "",
+            config->Flags & IMSCSI_HASH_IMAGE ? ", Hash" : "",
+            config->Flags & IMSCSI_VERIFY_IMAGE ? ", Verified Reads" : "",
+            config->Flags & IMSCSI_WRITE_BACK ? ", Write-Back" : "");
+
+        if (config->Flags & IMSCSI_HASH_IMAGE)
+        {
+            SRB_IMSCSI_QUERY_HASH query_hash = { 0 };
+
+            if (!ImScsiQueryDeviceHash(adapter, DeviceNumber, &query_hash))
+            {
+                PrintLastError(L"Error querying image digests:");
+            }
+            else if (!query_hash.Complete)
+            {
+                printf("Hashing: %I64i of %I64i bytes (%.4g%%).
+",
+                    query_hash.BytesHashed.QuadPart,
+                    query_hash.DiskSize.QuadPart,
+                    query_hash.DiskSize.QuadPart > 0 ?
+                    100.0 * query_hash.BytesHashed.QuadPart /
+                    query_hash.DiskSize.QuadPart : 100.0);
+            }
+            else
+            {
+                fputs("MD5: ", stdout);
+                for (size_t i = 0; i < sizeof(query_hash.MD5); i++)
+                    printf("%02x", query_hash.MD5[i]);
+
+                fputs("\nSHA1: ", stdout);
+                for (size_t i = 0; i < sizeof(query_hash.SHA1); i++)
+                    printf("%02x", query_hash.SHA1[i]);
+
+                fputs("\nSHA256: ", stdout);
+                for (size_t i = 0; i < sizeof(query_hash.SHA256); i++)
+                    printf("%02x", query_hash.SHA256[i]);
+
+                puts("");
+            }
+        }
+
+        if (ShowStatistics)
+        {
+            ImScsiCliPrintStatistics(adapter, DeviceNumber);
+        }
 
         flushall();
 
@@ -1581,9 +1988,9 @@ LPWSTR MountPoint)
 
 // Prints a list of current virtual disk devices. If NumericPrint is TRUE a
 // simple number list is printed, otherwise each device object name with path
-// is printed.
+// is printed, with performance counters if ShowStatistics is TRUE.
 int
-ImScsiCliQueryStatusDriver(BOOL NumericPrint)
+ImScsiCliQueryStatusDriver(BOOL NumericPrint, BOOL ShowStatistics)
 {
     HANDLE adapter = ImScsiOpenScsiAdapter();
 
@@ -1653,7 +2060,7 @@ ImScsiCliQueryStatusDriver(BOOL NumericPrint)
         printf("Device number %.6X\n",
             device_list[counter].LongNumber);
 
-        ImScsiCliQueryStatusDevice(device_list[counter], NULL);
+        ImScsiCliQueryStatusDevice(device_list[counter], NULL, ShowStatistics);
 
         puts("");
     }
@@ -1736,127 +2143,1413 @@ PLARGE_INTEGER ExtendSize)
     return 0;
 }
 
-// Entry function. Translates command line switches and parameters and calls
-// corresponding functions to carry out actual tasks.
+// Builds Merkle index file for an image file and displays root hash.
 int
-__cdecl
-wmain(int argc, LPWSTR argv[])
+ImScsiCliBuildMerkleIndex(LPCWSTR ImageFile,
+ULONG ChunkShift)
 {
-    // Catch debug messages from API
-    ImScsiSetDebugMessageCallback(NULL, DebugMessageCallback);
+    UCHAR root[IMSCSI_MERKLE_HASH_SIZE];
 
-    if ((argc == 2) && (_wcsicmp(argv[1], L"--version") == 0))
+    if (!ImScsiBuildMerkleIndex(NULL, ImageFile, ChunkShift, root))
     {
-        puts(
-            "Low-level command line interface to Arsenal Image Mounter virtual\r\n"
-            "SCSI miniport driver.\r\n"
-            "\n"
-            "Version " PHDSKMNT_RC_VERSION_STR " - (Compiled " __DATE__ ")\r\n"
-            "\n"
-            "Copyright (C) 2012-2015 Arsenal Recon.\r\n"
-            "\n"
-            "\n"
-            "http://www.ArsenalRecon.com\r\n"
-            "\n"
-            "Arsenal Image Mounter including its kernel driver, API library,\r\n"
-            "command line and graphical user applications (\"the Software\")\r\n"
-            "are provided \"AS IS\" and \"WITH ALL FAULTS,\" without warranty\r\n"
-            "of any kind, including without limitation the warranties of\r\n"
-            "merchantability, fitness for a particular purpose and\r\n"
-            "non - infringement.Arsenal makes no warranty that the Software\r\n"
-            "is free of defects or is suitable for any particular purpose.\r\n"
-            "In no event shall Arsenal be responsible for loss or damages\r\n"
-            "arising from the installation or use of the Software, including\r\n"
-            "but not limited to any indirect, punitive, special, incidental\r\n"
-            "or consequential damages of any character including, without\r\n"
-            "limitation, damages for loss of goodwill, work stoppage,\r\n"
-            "computer failure or malfunction, or any and all other\r\n"
-            "commercial damages or losses.The entire risk as to the\r\n"
-            "quality and performance of the Software is borne by you.Should\r\n"
-            "the Software prove defective, you and not Arsenal assume the\r\n"
-            "entire cost of any service and repair.\r\n"
-            "\n"
-            "Arsenal Consulting, Inc. (d/b/a Arsenal Recon) retains the copyright to the\r\n"
-            "Arsenal Image Mounter source code being made available under terms of the\r\n"
-            "Affero General Public License v3.\r\n"
-            "(http://www.fsf.org/licensing/licenses/agpl-3.0.html). This source code may\r\n"
-            "be used in projects that are licensed so as to be compatible with AGPL v3.\r\n"
-            "\n"
-            "Contributors to Arsenal Image Mounter must sign the Arsenal Contributor\r\n"
-            "Agreement(\"ACA\").The ACA gives Arsenal and the contributor joint\r\n"
-            "copyright interests in the code.\r\n"
-            "\n"
-            "If your project is not licensed under an AGPL v3 compatible license,\r\n"
-            "contact us directly regarding alternative licensing.");
-
-        DWORD library_version;
-        DWORD driver_version;
+        PrintLastError(L"Error building Merkle index:");
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
 
-        auto rc = ImScsiGetVersion(&library_version, &driver_version);
+    fputs("Merkle root: ", stdout);
+    for (size_t i = 0; i < sizeof(root); i++)
+        printf("%02x", root[i]);
+    puts("");
 
-        printf("\nCurrently installed Arsenal Image Mounter:\n"
-            "Library version: %u.%u.%u.%u\n",
-            library_version >> 24,
-            (library_version >> 16) & 0xff,
-            (library_version >> 8) & 0xff,
-            library_version & 0xff);
+    return IMSCSI_CLI_SUCCESS;
+}
 
-        if (rc)
-        {
-            printf("Driver version: %u.%u.%u.%u\n",
-                driver_version >> 24,
-                (driver_version >> 16) & 0xff,
-                (driver_version >> 8) & 0xff,
-                driver_version & 0xff);
-        }
-        else
-        {
-            PrintLastError(L"Error checking driver version:");
-        }
+// Checks Merkle index file for an image file, optionally against a root
+// hash displayed when index was built, and a sample of image chunks against
+// the index.
+int
+ImScsiCliVerifyMerkleIndex(LPCWSTR ImageFile,
+LPCWSTR SampleText,
+LPCWSTR RootText)
+{
+    UCHAR expected_root[IMSCSI_MERKLE_HASH_SIZE];
+    UCHAR root[IMSCSI_MERKLE_HASH_SIZE];
+    ULONG sample_chunks = IMSCSI_MERKLE_DEFAULT_SAMPLE_CHUNKS;
 
-        rc = ImDiskGetVersion(&library_version, NULL);
+    if (SampleText != NULL)
+    {
+        LPWSTR end;
 
-        printf("Using library functions from ImDisk Virtual Disk Driver version: %u.%u.%u\n",
-            library_version >> 8,
-            (library_version >> 4) & 0xf,
-            library_version & 0xf);
+        sample_chunks = wcstoul(SampleText, &end, 0);
 
-        return 0;
+        if ((end == SampleText) || (*end != 0))
+            ImScsiSyntaxHelp();
     }
 
-    if ((argc >= 2) &&
-        ((_wcsicmp(argv[1], L"--install") == 0) ||
-        (_wcsicmp(argv[1], L"--uninstall") == 0) ||
-        (_wcsicmp(argv[1], L"--rescan") == 0)))
+    if (RootText != NULL)
     {
-        return wmainSetup(argc - 1, argv + 1);
+        if (wcslen(RootText) != sizeof(expected_root) * 2)
+            ImScsiSyntaxHelp();
+
+        for (size_t i = 0; i < sizeof(expected_root); i++)
+        {
+            WCHAR hex_byte[] = { RootText[i * 2], RootText[i * 2 + 1], 0 };
+            LPWSTR end;
+
+            expected_root[i] = (UCHAR)wcstoul(hex_byte, &end, 16);
+
+            if (*end != 0)
+                ImScsiSyntaxHelp();
+        }
     }
 
-    enum
+    if (!ImScsiVerifyMerkleIndex(ImageFile,
+        RootText != NULL ? expected_root : NULL, sample_chunks, root))
     {
-        OP_MODE_NONE,
-        OP_MODE_CREATE,
-        OP_MODE_REMOVE,
-        OP_MODE_QUERY,
-        OP_MODE_EDIT
-    } op_mode = OP_MODE_NONE;
-    DWORD flags = 0;
-    BOOL native_path = FALSE;
-    BOOL numeric_print = FALSE;
-    BOOL force_dismount = FALSE;
-    BOOL emergency_remove = FALSE;
-    LPWSTR file_name = NULL;
-    LPWSTR format_options = NULL;
-    BOOL save_settings = FALSE;
-    DEVICE_NUMBER device_number;
-    device_number.LongNumber = IMSCSI_AUTO_DEVICE_NUMBER;
-    LPWSTR mount_point = NULL;
-    LARGE_INTEGER disk_geometry = { 0 };
-    ULONG bytes_per_sector = 0;
-    LARGE_INTEGER image_offset = { 0 };
-    BOOL auto_find_offset = FALSE;
-    DWORD flags_to_change = 0;
-    int ret = 0;
+        PrintLastError(L"Merkle index verification failed:");
+        return IMSCSI_CLI_ERROR_VERIFY_FAILED;
+    }
+
+    fputs("Merkle root: ", stdout);
+    for (size_t i = 0; i < sizeof(root); i++)
+        printf("%02x", root[i]);
+    puts("");
+
+    if (sample_chunks > 0)
+        puts("Merkle index is intact and matches sampled image chunks.");
+    else
+        puts("Merkle index is intact. Image file was not read.");
+
+    return IMSCSI_CLI_SUCCESS;
+}
+
+static volatile BOOL ImScsiCliStopTrace = FALSE;
+
+static
+BOOL
+WINAPI
+ImScsiCliTraceCtrlHandler(DWORD CtrlType)
+{
+    UNREFERENCED_PARAMETER(CtrlType);
+
+    ImScsiCliStopTrace = TRUE;
+
+    return TRUE;
+}
+
+// Reads everything currently in trace buffer of driver and appends it to
+// trace file.
+static
+BOOL
+ImScsiCliDrainTrace(HANDLE Adapter,
+HANDLE TraceFile,
+PULONGLONG Sequence,
+PIMSCSI_TRACE_RECORD Records,
+ULONG MaxRecords,
+PULONGLONG Written,
+PULONGLONG Lost)
+{
+    for (;;)
+    {
+        ULONG count;
+        ULONGLONG lost;
+        DWORD dw;
+
+        if (!ImScsiReadSrbTrace(Adapter, Sequence, Records, MaxRecords,
+            &count, &lost))
+        {
+            PrintLastError(L"Error reading trace:");
+            return FALSE;
+        }
+
+        *Lost += lost;
+
+        if (count == 0)
+            return TRUE;
+
+        if (!WriteFile(TraceFile, Records, count * sizeof(*Records), &dw,
+            NULL))
+        {
+            PrintLastError(L"Error writing trace file:");
+            return FALSE;
+        }
+
+        *Written += count;
+    }
+}
+
+// Records SCSI request stages in driver and saves them to a trace file,
+// for Seconds seconds or until Ctrl+C if Seconds is 0.
+int
+ImScsiCliCaptureTrace(LPCWSTR TraceFile,
+ULONG Seconds,
+ULONG Capacity)
+{
+    const ULONG chunk_records = 1024;
+
+    HANDLE adapter = ImScsiOpenScsiAdapter();
+
+    if (adapter == INVALID_HANDLE_VALUE)
+    {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        {
+            fprintf(stderr, "Arsenal Image Mounter not installed.\r\n");
+            return IMSCSI_CLI_ERROR_DRIVER_NOT_INSTALLED;
+        }
+        else
+        {
+            PrintLastError(L"Cannot control the Arsenal Image Mounter:");
+            return IMSCSI_CLI_ERROR_DRIVER_INACCESSIBLE;
+        }
+    }
+
+    HANDLE file = CreateFile(TraceFile, GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        PrintLastError(TraceFile);
+        NtClose(adapter);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    IMSCSI_TRACE_FILE_HEADER header = { 0 };
+    memcpy(header.Signature, IMSCSI_TRACE_FILE_SIGNATURE,
+        sizeof(header.Signature));
+    header.Version = IMSCSI_TRACE_FILE_VERSION;
+    header.RecordSize = sizeof(IMSCSI_TRACE_RECORD);
+
+    WHeapMem<IMSCSI_TRACE_RECORD> records(
+        chunk_records * sizeof(IMSCSI_TRACE_RECORD),
+        HEAP_GENERATE_EXCEPTIONS);
+
+    // Start after events already in buffer from earlier captures.
+    ULONGLONG sequence = MAXULONGLONG;
+    ULONGLONG written = 0;
+    ULONGLONG lost = 0;
+    DWORD dw;
+    BOOL ok = FALSE;
+
+    if (!WriteFile(file, &header, sizeof(header), &dw, NULL))
+    {
+        PrintLastError(L"Error writing trace file:");
+    }
+    else if (!ImScsiSetSrbTrace(adapter, TRUE, &Capacity, &header.Frequency))
+    {
+        PrintLastError(L"Error starting trace:");
+    }
+    else
+    {
+        ok = ImScsiCliDrainTrace(adapter, file, &sequence, records,
+            chunk_records, &written, &lost);
+
+        written = 0;
+        lost = 0;
+
+        printf("Tracing with %u records buffer. Press Ctrl+C to stop.\n",
+            Capacity);
+
+        SetConsoleCtrlHandler(ImScsiCliTraceCtrlHandler, TRUE);
+
+        DWORD start_time = GetTickCount();
+
+        while (ok && !ImScsiCliStopTrace &&
+            ((Seconds == 0) || ((GetTickCount() - start_time) / 1000 < Seconds)))
+        {
+            Sleep(50);
+
+            ok = ImScsiCliDrainTrace(adapter, file, &sequence, records,
+                chunk_records, &written, &lost);
+        }
+
+        SetConsoleCtrlHandler(ImScsiCliTraceCtrlHandler, FALSE);
+
+        ImScsiSetSrbTrace(adapter, FALSE, NULL, NULL);
+
+        if (ok)
+        {
+            ok = ImScsiCliDrainTrace(adapter, file, &sequence, records,
+                chunk_records, &written, &lost);
+        }
+    }
+
+    NtClose(adapter);
+
+    header.Lost = lost;
+
+    if (ok &&
+        ((SetFilePointer(file, 0, NULL, FILE_BEGIN) != 0) ||
+        !WriteFile(file, &header, sizeof(header), &dw, NULL)))
+    {
+        PrintLastError(L"Error writing trace file:");
+        ok = FALSE;
+    }
+
+    CloseHandle(file);
+
+    if (!ok)
+        return IMSCSI_CLI_ERROR_FATAL;
+
+    printf("%I64u records saved, %I64u lost.\n", written, lost);
+
+    if (lost != 0)
+        puts("Use a larger trace buffer to avoid lost records.");
+
+    return IMSCSI_CLI_SUCCESS;
+}
+
+static
+int
+__cdecl
+ImScsiCliCompareTraceRecords(const void *Record1, const void *Record2)
+{
+    PIMSCSI_TRACE_RECORD record1 = (PIMSCSI_TRACE_RECORD)Record1;
+    PIMSCSI_TRACE_RECORD record2 = (PIMSCSI_TRACE_RECORD)Record2;
+
+    if (record1->Request != record2->Request)
+        return record1->Request < record2->Request ? -1 : 1;
+
+    if (record1->Sequence != record2->Sequence)
+        return record1->Sequence < record2->Sequence ? -1 : 1;
+
+    return 0;
+}
+
+static
+int
+__cdecl
+ImScsiCliCompareTicks(const void *Ticks1, const void *Ticks2)
+{
+    LONGLONG ticks1 = *(const LONGLONG*)Ticks1;
+    LONGLONG ticks2 = *(const LONGLONG*)Ticks2;
+
+    return ticks1 < ticks2 ? -1 : ticks1 > ticks2 ? 1 : 0;
+}
+
+static
+void
+ImScsiCliPrintLatencies(LPCSTR Name,
+LONGLONG *Ticks,
+ULONG Count,
+LONGLONG Frequency)
+{
+    if (Count == 0)
+        return;
+
+    qsort(Ticks, Count, sizeof(*Ticks), ImScsiCliCompareTicks);
+
+    LONGLONG total = 0;
+
+    for (ULONG i = 0; i < Count; i++)
+        total += Ticks[i];
+
+    double us = 1000000.0 / Frequency;
+
+    printf("%-26s %9u %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        Name,
+        Count,
+        total * us / Count,
+        Ticks[(Count - 1) * 50ULL / 100] * us,
+        Ticks[(Count - 1) * 90ULL / 100] * us,
+        Ticks[(Count - 1) * 99ULL / 100] * us,
+        Ticks[Count - 1] * us);
+}
+
+static
+int
+ImScsiCliGetOperationClass(UCHAR Operation)
+{
+    switch (Operation)
+    {
+    case SCSIOP_READ6:
+    case SCSIOP_READ:
+    case SCSIOP_READ12:
+    case SCSIOP_READ16:
+        return IMSCSI_STAT_READ;
+
+    case SCSIOP_WRITE6:
+    case SCSIOP_WRITE:
+    case SCSIOP_WRITE12:
+    case SCSIOP_WRITE16:
+    case SCSIOP_WRITE_SAME:
+    case SCSIOP_WRITE_SAME16:
+        return IMSCSI_STAT_WRITE;
+
+    case SCSIOP_UNMAP:
+        return IMSCSI_STAT_UNMAP;
+
+    default:
+        return IMSCSI_STAT_OTHER;
+    }
+}
+
+// Reads header and all records of a trace file saved by --trace.
+static
+int
+ImScsiCliLoadTrace(LPCWSTR TraceFile,
+PIMSCSI_TRACE_FILE_HEADER Header,
+WHeapMem<IMSCSI_TRACE_RECORD> &Records,
+PULONG Count)
+{
+    HANDLE file = CreateFile(TraceFile, GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        PrintLastError(TraceFile);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    LARGE_INTEGER file_size;
+    DWORD dw;
+
+    if (!ReadFile(file, Header, sizeof(*Header), &dw, NULL) ||
+        (dw != sizeof(*Header)) ||
+        !GetFileSizeEx(file, &file_size))
+    {
+        PrintLastError(L"Error reading trace file:");
+        CloseHandle(file);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    if ((memcmp(Header->Signature, IMSCSI_TRACE_FILE_SIGNATURE,
+        sizeof(Header->Signature)) != 0) ||
+        (Header->Version != IMSCSI_TRACE_FILE_VERSION) ||
+        (Header->RecordSize != sizeof(IMSCSI_TRACE_RECORD)) ||
+        (Header->Frequency <= 0) ||
+        ((ULONGLONG)file_size.QuadPart - sizeof(*Header) >
+        MAXDWORD / sizeof(IMSCSI_TRACE_RECORD)))
+    {
+        fprintf(stderr, "Not a supported trace file.\r\n");
+        CloseHandle(file);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    ULONG count = (ULONG)((file_size.QuadPart - sizeof(*Header)) /
+        sizeof(IMSCSI_TRACE_RECORD));
+
+    *Count = count;
+
+    if (count == 0)
+    {
+        CloseHandle(file);
+        return IMSCSI_CLI_SUCCESS;
+    }
+
+    Records = (PIMSCSI_TRACE_RECORD)HeapAlloc(GetProcessHeap(), 0,
+        count * sizeof(IMSCSI_TRACE_RECORD));
+
+    if (!Records)
+    {
+        fprintf(stderr, "Not enough memory for %u trace records.\r\n", count);
+        CloseHandle(file);
+        return IMSCSI_CLI_ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (!ReadFile(file, Records, count * sizeof(IMSCSI_TRACE_RECORD), &dw,
+        NULL) ||
+        (dw != count * sizeof(IMSCSI_TRACE_RECORD)))
+    {
+        PrintLastError(L"Error reading trace file:");
+        CloseHandle(file);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    CloseHandle(file);
+
+    return IMSCSI_CLI_SUCCESS;
+}
+
+// Reads a trace file saved by --trace and prints latencies between each
+// recorded stage of requests, and from StartIo to completion for each kind
+// of request.
+int
+ImScsiCliTraceReport(LPCWSTR TraceFile)
+{
+    static const char * const stage_names[IMSCSI_TRACE_STAGES] =
+    {
+        "StartIo",
+        "Queued",
+        "Dequeued",
+        "Submit",
+        "BackendDone",
+        "Complete"
+    };
+
+    static const char * const class_names[IMSCSI_STAT_CLASSES] =
+    {
+        "Read",
+        "Write",
+        "Unmap",
+        "Other"
+    };
+
+    IMSCSI_TRACE_FILE_HEADER header;
+    WHeapMem<IMSCSI_TRACE_RECORD> records;
+    ULONG count;
+
+    int ret = ImScsiCliLoadTrace(TraceFile, &header, records, &count);
+
+    if (ret != IMSCSI_CLI_SUCCESS)
+    {
+        return ret;
+    }
+
+    if (count == 0)
+    {
+        puts("Trace file is empty.");
+        return IMSCSI_CLI_SUCCESS;
+    }
+
+    LONGLONG first_timestamp = records[0].Timestamp;
+    LONGLONG last_timestamp = records[0].Timestamp;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        first_timestamp = min(first_timestamp, records[i].Timestamp);
+        last_timestamp = max(last_timestamp, records[i].Timestamp);
+    }
+
+    // Events of each SRB address in order. An address is reused by later
+    // requests, each starting with a StartIo event.
+    qsort(records, count, sizeof(IMSCSI_TRACE_RECORD),
+        ImScsiCliCompareTraceRecords);
+
+    // Latencies between stages, [from][to], and StartIo to completion by
+    // kind of request. Each list can hold one entry per record.
+    WHeapMem<LONGLONG> stage_ticks[IMSCSI_TRACE_STAGES][IMSCSI_TRACE_STAGES];
+    ULONG stage_count[IMSCSI_TRACE_STAGES][IMSCSI_TRACE_STAGES] = { 0 };
+    WHeapMem<LONGLONG> total_ticks[IMSCSI_STAT_CLASSES];
+    ULONG total_count[IMSCSI_STAT_CLASSES] = { 0 };
+    ULONG requests = 0;
+
+    PIMSCSI_TRACE_RECORD start = NULL;
+    PIMSCSI_TRACE_RECORD previous = NULL;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        PIMSCSI_TRACE_RECORD record = &records[i];
+
+        if ((previous != NULL) &&
+            (previous->Request != record->Request))
+        {
+            start = NULL;
+            previous = NULL;
+        }
+
+        if (record->Stage == IMSCSI_TRACE_START_IO)
+        {
+            start = record;
+            previous = record;
+            continue;
+        }
+
+        // Started before trace was captured, or record lost.
+        if ((start == NULL) || (record->Stage >= IMSCSI_TRACE_STAGES))
+        {
+            continue;
+        }
+
+        UCHAR from = previous->Stage;
+        UCHAR to = record->Stage;
+
+        if (!stage_ticks[from][to])
+        {
+            stage_ticks[from][to] =
+                (LONGLONG*)HeapAlloc(GetProcessHeap(),
+                HEAP_GENERATE_EXCEPTIONS, count * sizeof(LONGLONG));
+        }
+
+        stage_ticks[from][to][stage_count[from][to]++] =
+            record->Timestamp - previous->Timestamp;
+
+        previous = record;
+
+        if (to != IMSCSI_TRACE_COMPLETE)
+        {
+            continue;
+        }
+
+        int operation_class = ImScsiCliGetOperationClass(start->Operation);
+
+        if (!total_ticks[operation_class])
+        {
+            total_ticks[operation_class] =
+                (LONGLONG*)HeapAlloc(GetProcessHeap(),
+                HEAP_GENERATE_EXCEPTIONS, count * sizeof(LONGLONG));
+        }
+
+        total_ticks[operation_class][total_count[operation_class]++] =
+            record->Timestamp - start->Timestamp;
+
+        ++requests;
+
+        start = NULL;
+        previous = NULL;
+    }
+
+    printf("%u records, %I64u lost while capturing, %u complete requests in %.3f s.\n\n",
+        count,
+        header.Lost,
+        requests,
+        (double)(last_timestamp - first_timestamp) / header.Frequency);
+
+    printf("%-26s %9s %10s %10s %10s %10s %10s\n",
+        "Latency (us)", "Count", "Mean", "50%", "90%", "99%", "Max");
+
+    for (int from = 0; from < IMSCSI_TRACE_STAGES; from++)
+    {
+        for (int to = 0; to < IMSCSI_TRACE_STAGES; to++)
+        {
+            char name[40];
+
+            _snprintf_s(name, _TRUNCATE, "%s -> %s",
+                stage_names[from], stage_names[to]);
+
+            ImScsiCliPrintLatencies(name, stage_ticks[from][to],
+                stage_count[from][to], header.Frequency);
+        }
+    }
+
+    puts("");
+
+    for (int c = 0; c < IMSCSI_STAT_CLASSES; c++)
+    {
+        char name[40];
+
+        _snprintf_s(name, _TRUNCATE, "%s total", class_names[c]);
+
+        ImScsiCliPrintLatencies(name, total_ticks[c], total_count[c],
+            header.Frequency);
+    }
+
+    return IMSCSI_CLI_SUCCESS;
+}
+
+typedef struct _IMSCSI_CLI_REPLAY_SLOT
+{
+    // First member, completion packets point here.
+    OVERLAPPED Overlapped;
+    LARGE_INTEGER Issued;
+    int OperationClass;
+    PUCHAR Buffer;
+} IMSCSI_CLI_REPLAY_SLOT, *PIMSCSI_CLI_REPLAY_SLOT;
+
+// Issues read and write requests of one virtual disk in a trace file saved
+// by --trace to Target, which can be an image file or a disk device, and
+// displays throughput and latencies. Requests are issued at the same time
+// offsets as they arrived in driver, or if AsFastAsPossible is set, as soon
+// as one of QueueDepth requests is done. Write requests are skipped unless
+// Writes is set, and then write a fixed pattern.
+int
+ImScsiCliReplayTrace(LPCWSTR TraceFile,
+LPCWSTR Target,
+DEVICE_NUMBER DeviceNumber,
+DWORD BytesPerSector,
+ULONG QueueDepth,
+BOOL AsFastAsPossible,
+BOOL Writes)
+{
+    IMSCSI_TRACE_FILE_HEADER header;
+    WHeapMem<IMSCSI_TRACE_RECORD> records;
+    ULONG count;
+
+    int ret = ImScsiCliLoadTrace(TraceFile, &header, records, &count);
+
+    if (ret != IMSCSI_CLI_SUCCESS)
+    {
+        return ret;
+    }
+
+    if (BytesPerSector == 0)
+    {
+        BytesPerSector = 512;
+    }
+
+    if (QueueDepth == 0)
+    {
+        QueueDepth = 32;
+    }
+
+    // Keep arrival of each read and write request, in order of arrival.
+    ULONG requests = 0;
+    ULONG skipped_writes = 0;
+    ULONG max_length = 0;
+    BOOL device_selected =
+        (DeviceNumber.LongNumber != IMSCSI_AUTO_DEVICE_NUMBER);
+    BOOL device_found = device_selected;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        PIMSCSI_TRACE_RECORD record = &records[i];
+
+        if ((record->Stage != IMSCSI_TRACE_START_IO) ||
+            (record->DataTransferLength == 0) ||
+            (record->Operation == SCSIOP_WRITE_SAME) ||
+            (record->Operation == SCSIOP_WRITE_SAME16))
+        {
+            continue;
+        }
+
+        int operation_class = ImScsiCliGetOperationClass(record->Operation);
+
+        if ((operation_class != IMSCSI_STAT_READ) &&
+            (operation_class != IMSCSI_STAT_WRITE))
+        {
+            continue;
+        }
+
+        if (!device_found)
+        {
+            DeviceNumber = record->DeviceNumber;
+            device_found = TRUE;
+        }
+        else if (record->DeviceNumber.LongNumber != DeviceNumber.LongNumber)
+        {
+            if (device_selected)
+            {
+                continue;
+            }
+
+            fprintf(stderr, "Trace has requests to more than one virtual disk. Select one with -u.\r\n");
+            return IMSCSI_CLI_ERROR_BAD_SYNTAX;
+        }
+
+        if ((operation_class == IMSCSI_STAT_WRITE) && !Writes)
+        {
+            ++skipped_writes;
+            continue;
+        }
+
+        max_length = max(max_length, record->DataTransferLength);
+
+        records[requests++] = *record;
+    }
+
+    if (requests == 0)
+    {
+        puts("No read or write requests to replay.");
+        return IMSCSI_CLI_SUCCESS;
+    }
+
+    printf("Replaying %u requests to device %.6X on %ws.\n",
+        requests, DeviceNumber.LongNumber, Target);
+
+    HANDLE target = CreateFile(Target,
+        GENERIC_READ | (Writes ? GENERIC_WRITE : 0),
+        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, NULL);
+
+    if (target == INVALID_HANDLE_VALUE)
+    {
+        PrintLastError(Target);
+        return IMSCSI_CLI_ERROR_DEVICE_INACCESSIBLE;
+    }
+
+    HANDLE completion_port = CreateIoCompletionPort(target, NULL, 0, 1);
+
+    if (completion_port == NULL)
+    {
+        PrintLastError(L"Error creating I/O completion port:");
+        CloseHandle(target);
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    // Page aligned buffers, as required for unbuffered I/O.
+    SIZE_T buffer_size = (max_length + 4095) & ~4095;
+
+    PUCHAR buffers = (PUCHAR)VirtualAlloc(NULL, buffer_size * QueueDepth,
+        MEM_COMMIT, PAGE_READWRITE);
+
+    if (buffers == NULL)
+    {
+        PrintLastError(L"Error allocating I/O buffers:");
+        CloseHandle(completion_port);
+        CloseHandle(target);
+        return IMSCSI_CLI_ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Same data on every run, and not zeros that a back-end could treat
+    // specially.
+    ULONG pattern = 0x41494D21;
+
+    for (SIZE_T i = 0; i < buffer_size * QueueDepth / sizeof(ULONG); i++)
+    {
+        pattern = pattern * 1103515245 + 12345;
+        ((PULONG)buffers)[i] = pattern;
+    }
+
+    WHeapMem<IMSCSI_CLI_REPLAY_SLOT> slots(
+        QueueDepth * sizeof(IMSCSI_CLI_REPLAY_SLOT),
+        HEAP_GENERATE_EXCEPTIONS | HEAP_ZERO_MEMORY);
+
+    WHeapMem<ULONG> free_slots(QueueDepth * sizeof(ULONG),
+        HEAP_GENERATE_EXCEPTIONS);
+
+    for (ULONG i = 0; i < QueueDepth; i++)
+    {
+        slots[i].Buffer = buffers + i * buffer_size;
+        free_slots[i] = i;
+    }
+
+    ULONG free_count = QueueDepth;
+
+    WHeapMem<LONGLONG> latencies[IMSCSI_STAT_WRITE + 1];
+    ULONG latency_count[IMSCSI_STAT_WRITE + 1] = { 0 };
+    ULONGLONG bytes[IMSCSI_STAT_WRITE + 1] = { 0 };
+
+    for (int c = 0; c <= IMSCSI_STAT_WRITE; c++)
+    {
+        latencies[c] = (LONGLONG*)HeapAlloc(GetProcessHeap(),
+            HEAP_GENERATE_EXCEPTIONS, requests * sizeof(LONGLONG));
+    }
+
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start_time;
+    LARGE_INTEGER now;
+
+    QueryPerformanceFrequency(&frequency);
+
+    double trace_to_local =
+        (double)frequency.QuadPart / (double)header.Frequency;
+
+    LONGLONG trace_start = records[0].Timestamp;
+    LONGLONG issue_delay = 0;
+    ULONG next = 0;
+    ULONG outstanding = 0;
+    ULONG errors = 0;
+    BOOL ok = TRUE;
+
+    SetConsoleCtrlHandler(ImScsiCliTraceCtrlHandler, TRUE);
+
+    QueryPerformanceCounter(&start_time);
+    now = start_time;
+
+    while (ok && ((next < requests) || (outstanding > 0)))
+    {
+        DWORD wait = INFINITE;
+
+        if (ImScsiCliStopTrace)
+        {
+            requests = next;
+        }
+
+        while ((next < requests) && (free_count > 0))
+        {
+            PIMSCSI_TRACE_RECORD request = &records[next];
+            LONGLONG due = 0;
+
+            QueryPerformanceCounter(&now);
+
+            if (!AsFastAsPossible)
+            {
+                due = (LONGLONG)((request->Timestamp - trace_start) *
+                    trace_to_local);
+
+                if (now.QuadPart - start_time.QuadPart < due)
+                {
+                    wait = (DWORD)((due - (now.QuadPart - start_time.QuadPart)) *
+                        1000 / frequency.QuadPart);
+                    break;
+                }
+
+                issue_delay += now.QuadPart - start_time.QuadPart - due;
+            }
+
+            PIMSCSI_CLI_REPLAY_SLOT slot = &slots[free_slots[--free_count]];
+            ULARGE_INTEGER offset;
+
+            offset.QuadPart = (ULONGLONG)request->LogicalBlock *
+                BytesPerSector;
+
+            RtlZeroMemory(&slot->Overlapped, sizeof(slot->Overlapped));
+            slot->Overlapped.Offset = offset.LowPart;
+            slot->Overlapped.OffsetHigh = offset.HighPart;
+            slot->OperationClass =
+                ImScsiCliGetOperationClass(request->Operation);
+            slot->Issued = now;
+
+            BOOL result;
+
+            if (slot->OperationClass == IMSCSI_STAT_WRITE)
+            {
+                result = WriteFile(target, slot->Buffer,
+                    request->DataTransferLength, NULL, &slot->Overlapped);
+            }
+            else
+            {
+                result = ReadFile(target, slot->Buffer,
+                    request->DataTransferLength, NULL, &slot->Overlapped);
+            }
+
+            ++next;
+
+            // Requests done at once also queue a completion packet.
+            if (!result && (GetLastError() != ERROR_IO_PENDING))
+            {
+                ++errors;
+                free_slots[free_count++] = (ULONG)(slot - (PIMSCSI_CLI_REPLAY_SLOT)slots);
+                continue;
+            }
+
+            ++outstanding;
+        }
+
+        if ((outstanding == 0) && (wait == INFINITE))
+        {
+            continue;
+        }
+
+        DWORD transferred;
+        ULONG_PTR key;
+        LPOVERLAPPED overlapped = NULL;
+
+        BOOL result = GetQueuedCompletionStatus(completion_port,
+            &transferred, &key, &overlapped, wait);
+
+        if (overlapped == NULL)
+        {
+            if (GetLastError() != WAIT_TIMEOUT)
+            {
+                PrintLastError(L"Error waiting for I/O completion:");
+                ok = FALSE;
+            }
+
+            continue;
+        }
+
+        QueryPerformanceCounter(&now);
+
+        PIMSCSI_CLI_REPLAY_SLOT slot =
+            CONTAINING_RECORD(overlapped, IMSCSI_CLI_REPLAY_SLOT, Overlapped);
+
+        if (result)
+        {
+            bytes[slot->OperationClass] += transferred;
+        }
+        else
+        {
+            ++errors;
+        }
+
+        latencies[slot->OperationClass][latency_count[slot->OperationClass]++] =
+            now.QuadPart - slot->Issued.QuadPart;
+
+        free_slots[free_count++] = (ULONG)(slot - (PIMSCSI_CLI_REPLAY_SLOT)slots);
+        --outstanding;
+    }
+
+    SetConsoleCtrlHandler(ImScsiCliTraceCtrlHandler, FALSE);
+
+    // Requests still in progress after a failure must finish before their
+    // buffers are freed.
+    if (outstanding > 0)
+    {
+        CancelIo(target);
+
+        while (outstanding > 0)
+        {
+            DWORD transferred;
+            ULONG_PTR key;
+            LPOVERLAPPED overlapped = NULL;
+
+            GetQueuedCompletionStatus(completion_port, &transferred, &key,
+                &overlapped, INFINITE);
+
+            if (overlapped == NULL)
+                break;
+
+            --outstanding;
+        }
+    }
+
+    CloseHandle(completion_port);
+    CloseHandle(target);
+
+    if (outstanding == 0)
+    {
+        VirtualFree(buffers, 0, MEM_RELEASE);
+    }
+
+    if (!ok)
+    {
+        return IMSCSI_CLI_ERROR_FATAL;
+    }
+
+    double seconds = (double)(now.QuadPart - start_time.QuadPart) /
+        frequency.QuadPart;
+
+    if (seconds <= 0)
+    {
+        seconds = 1.0 / frequency.QuadPart;
+    }
+
+    printf("%u requests in %.3f s, %u failed, %u writes skipped.\n",
+        next, seconds, errors, skipped_writes);
+
+    printf("%.0f requests/s, %.1f MB/s read, %.1f MB/s written.\n",
+        next / seconds,
+        bytes[IMSCSI_STAT_READ] / seconds / (1 << 20),
+        bytes[IMSCSI_STAT_WRITE] / seconds / (1 << 20));
+
+    if (!AsFastAsPossible && (next > 0))
+    {
+        printf("Requests issued on average %.1f us after original time.\n",
+            issue_delay * 1000000.0 / frequency.QuadPart / next);
+    }
+
+    puts("");
+
+    printf("%-26s %9s %10s %10s %10s %10s %10s\n",
+        "Latency (us)", "Count", "Mean", "50%", "90%", "99%", "Max");
+
+    ImScsiCliPrintLatencies("Read", latencies[IMSCSI_STAT_READ],
+        latency_count[IMSCSI_STAT_READ], frequency.QuadPart);
+
+    ImScsiCliPrintLatencies("Write", latencies[IMSCSI_STAT_WRITE],
+        latency_count[IMSCSI_STAT_WRITE], frequency.QuadPart);
+
+    return IMSCSI_CLI_SUCCESS;
+}
+
+// Reads a DWORD driver parameter, Default if not set.
+DWORD
+ImScsiCliQueryParameter(HKEY Key, LPCWSTR ValueName, DWORD Default,
+DWORD Maximum)
+{
+    DWORD value = Default;
+    DWORD value_size = sizeof(value);
+
+    if ((Key == NULL) ||
+        (RegQueryValueEx(Key, ValueName, NULL, NULL, (LPBYTE)&value,
+            &value_size) != ERROR_SUCCESS) ||
+        (value_size != sizeof(value)))
+    {
+        value = Default;
+    }
+
+    // Same limits as MpQueryRegParameters in driver.
+    if (value == 0)
+    {
+        value = 1;
+    }
+    else if (value > Maximum)
+    {
+        value = Maximum;
+    }
+
+    return value;
+}
+
+// Number of device addresses of adapter, from the NumberOfBuses,
+// MaximumTargets and MaximumLuns driver parameters read when the driver
+// was loaded. Default is 1 bus, 8 targets and 24 LUNs.
+ULONG
+ImScsiCliGetAdapterCapacity()
+{
+    HKEY key = NULL;
+
+    if (RegOpenKeyEx(HKEY_LOCAL_MACHINE,
+        L"SYSTEM\\CurrentControlSet\\Services\\phdskmnt"
+        IMSCSI_CFG_PARAMETER_KEY,
+        0, KEY_QUERY_VALUE, &key) != ERROR_SUCCESS)
+    {
+        key = NULL;
+    }
+
+    ULONG capacity =
+        ImScsiCliQueryParameter(key, L"NumberOfBuses", 1, 8) *
+        ImScsiCliQueryParameter(key, L"MaximumTargets", 8, 128) *
+        ImScsiCliQueryParameter(key, L"MaximumLuns", 24, 254);
+
+    if (key != NULL)
+    {
+        RegCloseKey(key);
+    }
+
+    return capacity;
+}
+
+// Creates Count virtual disks in memory, each DiskSize bytes, and then
+// removes them again. Displays time taken by driver for each create and
+// remove request. Disks are removed also if creation fails part way.
+// Default count is the number of free device addresses on adapter.
+int
+ImScsiCliScaleTest(ULONG Count, LONGLONG DiskSize)
+{
+    HANDLE adapter = ImScsiOpenScsiAdapter();
+
+    if (adapter == INVALID_HANDLE_VALUE)
+    {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        {
+            fprintf(stderr, "Arsenal Image Mounter not installed.\r\n");
+            return IMSCSI_CLI_ERROR_DRIVER_NOT_INSTALLED;
+        }
+        else
+        {
+            PrintLastError(L"Cannot control the Arsenal Image Mounter:");
+            return IMSCSI_CLI_ERROR_DRIVER_INACCESSIBLE;
+        }
+    }
+
+    ULONG capacity = ImScsiCliGetAdapterCapacity();
+    ULONG existing = 0;
+
+    if ((!ImScsiGetDeviceList(0, adapter, NULL, &existing)) &&
+        (GetLastError() != ERROR_MORE_DATA))
+    {
+        PrintLastError(L"Cannot control the Arsenal Image Mounter:");
+        NtClose(adapter);
+        return IMSCSI_CLI_ERROR_DRIVER_INACCESSIBLE;
+    }
+
+    ULONG available = capacity > existing ? capacity - existing : 0;
+
+    if (Count == 0)
+    {
+        Count = available;
+    }
+    else if (Count > available)
+    {
+        fprintf(stderr,
+            "Adapter has %u free device addresses of %u. Raise NumberOfBuses,\n"
+            "MaximumTargets or MaximumLuns driver parameters and restart the driver\n"
+            "to create %u virtual disks, see aim_ll --help.\n",
+            available, capacity, Count);
+    }
+
+    if (Count == 0)
+    {
+        fprintf(stderr, "No free device addresses on adapter.\n");
+        NtClose(adapter);
+        return IMSCSI_CLI_ERROR_CREATE_DEVICE;
+    }
+
+    if (DiskSize == 0)
+    {
+        DiskSize = 1 << 20;
+    }
+
+    WHeapMem<DEVICE_NUMBER> devices(Count * sizeof(DEVICE_NUMBER),
+        HEAP_GENERATE_EXCEPTIONS);
+    WHeapMem<LONGLONG> create_ticks(Count * sizeof(LONGLONG),
+        HEAP_GENERATE_EXCEPTIONS);
+    WHeapMem<LONGLONG> remove_ticks(Count * sizeof(LONGLONG),
+        HEAP_GENERATE_EXCEPTIONS);
+
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start_time;
+    LARGE_INTEGER end_time;
+
+    QueryPerformanceFrequency(&frequency);
+
+    printf("Creating %u virtual disks of %I64i bytes...\n", Count, DiskSize);
+
+    ULONG created = 0;
+    int ret = IMSCSI_CLI_SUCCESS;
+
+    for (; created < Count; created++)
+    {
+        SRB_IMSCSI_CREATE_DATA create_data = { 0 };
+        DWORD dw;
+
+        create_data.Fields.DeviceNumber.LongNumber = IMSCSI_AUTO_DEVICE_NUMBER;
+        create_data.Fields.DiskSize.QuadPart = DiskSize;
+        create_data.Fields.Flags = IMSCSI_TYPE_VM;
+
+        QueryPerformanceCounter(&start_time);
+
+        if (!ImScsiDeviceIoControl(adapter,
+            SMP_IMSCSI_CREATE_DEVICE,
+            &create_data.SrbIoControl,
+            sizeof(create_data),
+            0, &dw))
+        {
+            PrintLastError(L"Error creating virtual disk:");
+            ret = IMSCSI_CLI_ERROR_CREATE_DEVICE;
+            break;
+        }
+
+        QueryPerformanceCounter(&end_time);
+
+        create_ticks[created] = end_time.QuadPart - start_time.QuadPart;
+        devices[created] = create_data.Fields.DeviceNumber;
+    }
+
+    printf("Removing %u virtual disks...\n", created);
+
+    ULONG removed = 0;
+
+    for (ULONG i = 0; i < created; i++)
+    {
+        QueryPerformanceCounter(&start_time);
+
+        if (!ImScsiRemoveDeviceByNumber(NULL, adapter, devices[i]))
+        {
+            PrintLastError(L"Error removing virtual disk:");
+            ret = IMSCSI_CLI_ERROR_DEVICE_INACCESSIBLE;
+            continue;
+        }
+
+        QueryPerformanceCounter(&end_time);
+
+        remove_ticks[removed++] = end_time.QuadPart - start_time.QuadPart;
+    }
+
+    NtClose(adapter);
+
+    printf("%-26s %9s %10s %10s %10s %10s %10s\n",
+        "Latency (us)", "Count", "Mean", "50%", "90%", "99%", "Max");
+
+    ImScsiCliPrintLatencies("Create", create_ticks, created,
+        frequency.QuadPart);
+
+    ImScsiCliPrintLatencies("Remove", remove_ticks, removed,
+        frequency.QuadPart);
+
+    return ret;
+}
+
+// Commits or discards write overlay of an existing virtual disk.
+int
+ImScsiCliWriteOverlay(DEVICE_NUMBER DeviceNumber,
+BOOL Commit)
+{
+    HANDLE adapter = ImScsiOpenScsiAdapter();
+
+    if (adapter == INVALID_HANDLE_VALUE)
+    {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        {
+            fprintf(stderr, "Arsenal Image Mounter not installed.\r\n");
+            return IMSCSI_CLI_ERROR_DRIVER_NOT_INSTALLED;
+        }
+        else
+        {
+            fprintf(stderr, "Arsenal Image Mounter not installed.\r\n");
+            return IMSCSI_CLI_ERROR_DRIVER_INACCESSIBLE;
+        }
+    }
+
+    if (Commit ?
+        !ImScsiCommitOverlay(NULL, adapter, DeviceNumber) :
+        !ImScsiDiscardOverlay(NULL, adapter, DeviceNumber))
+    {
+        NtClose(adapter);
+        PrintLastError();
+        return IMSCSI_CLI_ERROR_DEVICE_INACCESSIBLE;
+    }
+
+    NtClose(adapter);
+
+    return 0;
+}
+
+// Entry function. Translates command line switches and parameters and calls
+// corresponding functions to carry out actual tasks.
+int
+__cdecl
+wmain(int argc, LPWSTR argv[])
+{
+    // Catch debug messages from API
+    ImScsiSetDebugMessageCallback(NULL, DebugMessageCallback);
+
+    if ((argc == 2) && (_wcsicmp(argv[1], L"--version") == 0))
+    {
+        puts(
+            "Low-level command line interface to Arsenal Image Mounter virtual\r\n"
+            "SCSI miniport driver.\r\n"
+            "\n"
+            "Version " PHDSKMNT_RC_VERSION_STR " - (Compiled " __DATE__ ")\r\n"
+            "\n"
+            "Copyright (C) 2012-2015 Arsenal Recon.\r\n"
+            "\n"
+            "\n"
+            "http://www.ArsenalRecon.com\r\n"
+            "\n"
+            "Arsenal Image Mounter including its kernel driver, API library,\r\n"
+            "command line and graphical user applications (\"the Software\")\r\n"
+            "are provided \"AS IS\" and \"WITH ALL FAULTS,\" without warranty\r\n"
+            "of any kind, including without limitation the warranties of\r\n"
+            "merchantability, fitness for a particular purpose and\r\n"
+            "non - infringement.Arsenal makes no warranty that the Software\r\n"
+            "is free of defects or is suitable for any particular purpose.\r\n"
+            "In no event shall Arsenal be responsible for loss or damages\r\n"
+            "arising from the installation or use of the Software, including\r\n"
+            "but not limited to any indirect, punitive, special, incidental\r\n"
+            "or consequential damages of any character including, without\r\n"
+            "limitation, damages for loss of goodwill, work stoppage,\r\n"
+            "computer failure or malfunction, or any and all other\r\n"
+            "commercial damages or losses.The entire risk as to the\r\n"
+            "quality and performance of the Software is borne by you.Should\r\n"
+            "the Software prove defective, you and not Arsenal assume the\r\n"
+            "entire cost of any service and repair.\r\n"
+            "\n"
+            "Arsenal Consulting, Inc. (d/b/a Arsenal Recon) retains the copyright to the\r\n"
+            "Arsenal Image Mounter source code being made available under terms of the\r\n"
+            "Affero General Public License v3.\r\n"
+            "(http://www.fsf.org/licensing/licenses/agpl-3.0.html). This source code may\r\n"
+            "be used in projects that are licensed so as to be compatible with AGPL v3.\r\n"
+            "\n"
+            "Contributors to Arsenal Image Mounter must sign the Arsenal Contributor\r\n"
+            "Agreement(\"ACA\").The ACA gives Arsenal and the contributor joint\r\n"
+            "copyright interests in the code.\r\n"
+            "\n"
+            "If your project is not licensed under an AGPL v3 compatible license,\r\n"
+            "contact us directly regarding alternative licensing.");
+
+        DWORD library_version;
+        DWORD driver_version;
+
+        auto rc = ImScsiGetVersion(&library_version, &driver_version);
+
+        printf("\nCurrently installed Arsenal Image Mounter:\n"
+            "Library version: %u.%u.%u.%u\n",
+            library_version >> 24,
+            (library_version >> 16) & 0xff,
+            (library_version >> 8) & 0xff,
+            library_version & 0xff);
+
+        if (rc)
+        {
+            printf("Driver version: %u.%u.%u.%u\n",
+                driver_version >> 24,
+                (driver_version >> 16) & 0xff,
+                (driver_version >> 8) & 0xff,
+                driver_version & 0xff);
+        }
+        else
+        {
+            PrintLastError(L"Error checking driver version:");
+        }
+
+        rc = ImDiskGetVersion(&library_version, NULL);
+
+        printf("Using library functions from ImDisk Virtual Disk Driver version: %u.%u.%u\n",
+            library_version >> 8,
+            (library_version >> 4) & 0xf,
+            library_version & 0xf);
+
+        return 0;
+    }
+
+    if ((argc >= 2) &&
+        ((_wcsicmp(argv[1], L"--install") == 0) ||
+        (_wcsicmp(argv[1], L"--uninstall") == 0) ||
+        (_wcsicmp(argv[1], L"--rescan") == 0)))
+    {
+        return wmainSetup(argc - 1, argv + 1);
+    }
+
+    if ((argc >= 3) && (argc <= 4) &&
+        (_wcsicmp(argv[1], L"--build-index") == 0))
+    {
+        return ImScsiCliBuildMerkleIndex(argv[2],
+            argc == 4 ? wcstoul(argv[3], NULL, 0) : 0);
+    }
+
+    if ((argc >= 3) && (argc <= 5) &&
+        (_wcsicmp(argv[1], L"--verify-index") == 0))
+    {
+        return ImScsiCliVerifyMerkleIndex(argv[2],
+            argc >= 4 ? argv[3] : NULL,
+            argc >= 5 ? argv[4] : NULL);
+    }
+
+    if ((argc >= 3) && (argc <= 5) &&
+        (_wcsicmp(argv[1], L"--trace") == 0))
+    {
+        return ImScsiCliCaptureTrace(argv[2],
+            argc >= 4 ? wcstoul(argv[3], NULL, 0) : 0,
+            argc >= 5 ? wcstoul(argv[4], NULL, 0) : 0);
+    }
+
+    if ((argc == 3) &&
+        (_wcsicmp(argv[1], L"--trace-report") == 0))
+    {
+        return ImScsiCliTraceReport(argv[2]);
+    }
+
+    if ((argc >= 2) && (argc <= 4) &&
+        (_wcsicmp(argv[1], L"--scale-test") == 0))
+    {
+        return ImScsiCliScaleTest(
+            argc >= 3 ? wcstoul(argv[2], NULL, 0) : 0,
+            argc >= 4 ? _wcstoi64(argv[3], NULL, 0) : 0);
+    }
+
+    if ((argc >= 4) &&
+        (_wcsicmp(argv[1], L"--replay") == 0))
+    {
+        DEVICE_NUMBER device_number;
+        DWORD bytes_per_sector = 0;
+        ULONG queue_depth = 0;
+        BOOL as_fast_as_possible = FALSE;
+        BOOL writes = FALSE;
+
+        device_number.LongNumber = IMSCSI_AUTO_DEVICE_NUMBER;
+
+        for (int i = 4; i < argc; i++)
+        {
+            if ((wcscmp(argv[i], L"-u") == 0) && (i + 1 < argc))
+            {
+                device_number.LongNumber = wcstoul(argv[++i], NULL, 16);
+            }
+            else if ((wcscmp(argv[i], L"-S") == 0) && (i + 1 < argc))
+            {
+                bytes_per_sector = wcstoul(argv[++i], NULL, 0);
+            }
+            else if ((wcscmp(argv[i], L"-q") == 0) && (i + 1 < argc))
+            {
+                queue_depth = wcstoul(argv[++i], NULL, 0);
+            }
+            else if (wcscmp(argv[i], L"-f") == 0)
+            {
+                as_fast_as_possible = TRUE;
+            }
+            else if (wcscmp(argv[i], L"-w") == 0)
+            {
+                writes = TRUE;
+            }
+            else
+            {
+                ImScsiSyntaxHelp();
+            }
+        }
+
+        return ImScsiCliReplayTrace(argv[2], argv[3], device_number,
+            bytes_per_sector, queue_depth, as_fast_as_possible, writes);
+    }
+
+    enum
+    {
+        OP_MODE_NONE,
+        OP_MODE_CREATE,
+        OP_MODE_REMOVE,
+        OP_MODE_QUERY,
+        OP_MODE_EDIT
+    } op_mode = OP_MODE_NONE;
+    DWORD flags = 0;
+    BOOL native_path = FALSE;
+    BOOL numeric_print = FALSE;
+    BOOL show_statistics = FALSE;
+    BOOL force_dismount = FALSE;
+    BOOL emergency_remove = FALSE;
+    LPWSTR file_name = NULL;
+    LPWSTR overlay_file_name = NULL;
+    LPWSTR format_options = NULL;
+    BOOL save_settings = FALSE;
+    DEVICE_NUMBER device_number;
+    device_number.LongNumber = IMSCSI_AUTO_DEVICE_NUMBER;
+    LPWSTR mount_point = NULL;
+    LARGE_INTEGER disk_geometry = { 0 };
+    ULONG bytes_per_sector = 0;
+    LARGE_INTEGER image_offset = { 0 };
+    BOOL auto_find_offset = FALSE;
+    DWORD flags_to_change = 0;
+    ULONG overlay_operation = 0;
+    int ret = 0;
 
     // Argument parse loop
     while (argc-- > 1)
@@ -1962,6 +3655,30 @@ wmain(int argc, LPWSTR argv[])
                             flags_to_change |= IMSCSI_FAKE_DISK_SIG_IF_ZERO;
                             flags |= IMSCSI_FAKE_DISK_SIG_IF_ZERO;
                         }
+                        else if (wcscmp(opt, L"verify") == 0)
+                        {
+                            if (op_mode != OP_MODE_CREATE)
+                                ImScsiSyntaxHelp();
+
+                            flags_to_change |= IMSCSI_VERIFY_IMAGE | IMSCSI_OPTION_RO;
+                            flags |= IMSCSI_VERIFY_IMAGE | IMSCSI_OPTION_RO;
+                        }
+                        else if (wcscmp(opt, L"hash") == 0)
+                        {
+                            if (op_mode != OP_MODE_CREATE)
+                                ImScsiSyntaxHelp();
+
+                            flags_to_change |= IMSCSI_HASH_IMAGE | IMSCSI_OPTION_RO;
+                            flags |= IMSCSI_HASH_IMAGE | IMSCSI_OPTION_RO;
+                        }
+                        else if (wcscmp(opt, L"wb") == 0)
+                        {
+                            if (op_mode != OP_MODE_CREATE)
+                                ImScsiSyntaxHelp();
+
+                            flags_to_change |= IMSCSI_WRITE_BACK;
+                            flags |= IMSCSI_WRITE_BACK;
+                        }
                         else if (wcscmp(opt, L"sparse") == 0)
                         {
                             flags_to_change |= IMSCSI_OPTION_SPARSE_FILE;
@@ -1991,6 +3708,17 @@ wmain(int argc, LPWSTR argv[])
                             flags_to_change |= IMSCSI_IMAGE_MODIFIED;
                             flags &= ~IMSCSI_IMAGE_MODIFIED;
                         }
+                        else if ((wcscmp(opt, L"commit") == 0) ||
+                            (wcscmp(opt, L"discard") == 0))
+                        {
+                            if ((op_mode != OP_MODE_EDIT) |
+                                (overlay_operation != 0))
+                                ImScsiSyntaxHelp();
+
+                            overlay_operation = wcscmp(opt, L"commit") == 0 ?
+                                SMP_IMSCSI_COMMIT_OVERLAY :
+                                SMP_IMSCSI_DISCARD_OVERLAY;
+                        }
                         // None of the other options are valid with the -e parameter.
                         else if (op_mode != OP_MODE_CREATE)
                             ImScsiSyntaxHelp();
@@ -2042,6 +3770,31 @@ wmain(int argc, LPWSTR argv[])
                         {
                             flags |= IMSCSI_OPTION_BYTE_SWAP;
                         }
+                        else if (wcscmp(opt, L"comp") == 0)
+                        {
+                            if ((IMSCSI_TYPE(flags) != IMSCSI_TYPE_VM) &
+                                (IMSCSI_TYPE(flags) != 0))
+                                ImScsiSyntaxHelp();
+
+                            flags |= IMSCSI_TYPE_VM | IMSCSI_VM_COMPRESS;
+                        }
+                        else if (wcscmp(opt, L"dedup") == 0)
+                        {
+                            if ((IMSCSI_TYPE(flags) != IMSCSI_TYPE_VM) &
+                                (IMSCSI_TYPE(flags) != 0))
+                                ImScsiSyntaxHelp();
+
+                            flags |= IMSCSI_TYPE_VM | IMSCSI_VM_DEDUP;
+                        }
+                        else if (wcscmp(opt, L"split") == 0)
+                        {
+                            if (((IMSCSI_TYPE(flags) != IMSCSI_TYPE_FILE) &
+                                (IMSCSI_TYPE(flags) != 0)) |
+                                (IMSCSI_FILE_TYPE(flags) == IMSCSI_FILE_TYPE_AWEALLOC))
+                                ImScsiSyntaxHelp();
+
+                            flags |= IMSCSI_TYPE_FILE | IMSCSI_MULTI_SEGMENT;
+                        }
                         else if (IMSCSI_DEVICE_TYPE(flags) != 0)
                             ImScsiSyntaxHelp();
                         else if (wcscmp(opt, L"hd") == 0)
@@ -2076,6 +3829,18 @@ wmain(int argc, LPWSTR argv[])
                 argv++;
                 break;
 
+            case L'O':
+                if ((op_mode != OP_MODE_CREATE) |
+                    (argc < 2) |
+                    (overlay_file_name != NULL))
+                    ImScsiSyntaxHelp();
+
+                overlay_file_name = argv[1];
+
+                argc--;
+                argv++;
+                break;
+
             case L's':
                 if (((op_mode != OP_MODE_CREATE) & (op_mode != OP_MODE_EDIT)) |
                     (argc < 2) |
@@ -2276,12 +4041,19 @@ wmain(int argc, LPWSTR argv[])
                 ImScsiSyntaxHelp();
             }
         }
+        else if (_wcsicmp(argv[0], L"--stats") == 0)
+        {
+            show_statistics = TRUE;
+        }
         else
         {
             ImScsiSyntaxHelp();
         }
     }
 
+    if (show_statistics && (op_mode != OP_MODE_QUERY))
+        ImScsiSyntaxHelp();
+
     // Switch block for operation switch found on command line.
     switch (op_mode)
     {
@@ -2299,6 +4071,7 @@ wmain(int argc, LPWSTR argv[])
             &image_offset,
             flags,
             file_name,
+            overlay_file_name,
             native_path,
             numeric_print,
             save_settings,
@@ -2320,9 +4093,10 @@ wmain(int argc, LPWSTR argv[])
     case OP_MODE_QUERY:
         if ((device_number.LongNumber == IMSCSI_AUTO_DEVICE_NUMBER) &
             (mount_point == NULL))
-            return !ImScsiCliQueryStatusDriver(numeric_print);
+            return !ImScsiCliQueryStatusDriver(numeric_print, show_statistics);
 
-        return ImScsiCliQueryStatusDevice(device_number, mount_point);
+        return ImScsiCliQueryStatusDevice(device_number, mount_point,
+            show_statistics);
 
     case OP_MODE_EDIT:
         if ((device_number.LongNumber == IMSCSI_AUTO_DEVICE_NUMBER) &
@@ -2342,6 +4116,15 @@ wmain(int argc, LPWSTR argv[])
                 &disk_geometry);
         }
 
+        if (overlay_operation != 0)
+        {
+            if (mount_point != NULL)
+                ImScsiSyntaxHelp();
+
+            ret = ImScsiCliWriteOverlay(device_number,
+                overlay_operation == SMP_IMSCSI_COMMIT_OVERLAY);
+        }
+
         return ret;
     }
 
@@ -1865,6 +1865,184 @@ ImScsiExtendDevice(HWND hWnd,
     return TRUE;
 }
 
+AIMAPI_API BOOL
+WINAPI
+ImScsiCommitOverlay(HWND hWnd,
+    HANDLE Adapter,
+    DEVICE_NUMBER DeviceNumber)
+{
+    DWORD dw;
+
+
+    ImScsiSetStatusMsg(hWnd, L"Writing changes to image...");
+
+    SRB_IMSCSI_WRITE_OVERLAY overlay_data;
+
+    overlay_data.DeviceNumber = DeviceNumber;
+
+    if (!ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_COMMIT_OVERLAY,
+        &overlay_data.SrbIoControl,
+        sizeof(overlay_data),
+        0, &dw))
+    {
+
+        ImScsiMsgBoxLastError(hWnd, L"Error committing write overlay:");
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiDiscardOverlay(HWND hWnd,
+    HANDLE Adapter,
+    DEVICE_NUMBER DeviceNumber)
+{
+    DWORD dw;
+
+
+    ImScsiSetStatusMsg(hWnd, L"Discarding changes...");
+
+    SRB_IMSCSI_WRITE_OVERLAY overlay_data;
+
+    overlay_data.DeviceNumber = DeviceNumber;
+
+    if (!ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_DISCARD_OVERLAY,
+        &overlay_data.SrbIoControl,
+        sizeof(overlay_data),
+        0, &dw))
+    {
+
+        ImScsiMsgBoxLastError(hWnd, L"Error discarding write overlay:");
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiQueryDeviceHash(HANDLE Adapter,
+    DEVICE_NUMBER DeviceNumber,
+    PSRB_IMSCSI_QUERY_HASH QueryHash)
+{
+    DWORD dw;
+
+    QueryHash->DeviceNumber = DeviceNumber;
+
+    return ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_QUERY_HASH,
+        &QueryHash->SrbIoControl,
+        sizeof(*QueryHash),
+        0, &dw);
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiQueryStatistics(HANDLE Adapter,
+    DEVICE_NUMBER DeviceNumber,
+    PIMSCSI_LU_STATISTICS Statistics)
+{
+    DWORD dw;
+    SRB_IMSCSI_QUERY_STATISTICS query_statistics = { 0 };
+
+    query_statistics.DeviceNumber = DeviceNumber;
+
+    if (!ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_QUERY_STATISTICS,
+        &query_statistics.SrbIoControl,
+        sizeof(query_statistics),
+        0, &dw))
+    {
+        return FALSE;
+    }
+
+    *Statistics = query_statistics.Statistics;
+
+    return TRUE;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiSetSrbTrace(HANDLE Adapter,
+    BOOL Enable,
+    PULONG Capacity,
+    PLONGLONG Frequency)
+{
+    DWORD dw;
+    SRB_IMSCSI_SET_TRACE set_trace = { 0 };
+
+    set_trace.Enable = Enable ? TRUE : FALSE;
+
+    if (Capacity != NULL)
+        set_trace.Capacity = *Capacity;
+
+    if (!ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_SET_TRACE,
+        &set_trace.SrbIoControl,
+        sizeof(set_trace),
+        0, &dw))
+    {
+        return FALSE;
+    }
+
+    if (Capacity != NULL)
+        *Capacity = set_trace.Capacity;
+
+    if (Frequency != NULL)
+        *Frequency = set_trace.Frequency;
+
+    return TRUE;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiReadSrbTrace(HANDLE Adapter,
+    PULONGLONG Sequence,
+    PIMSCSI_TRACE_RECORD Records,
+    ULONG MaxRecords,
+    PULONG NumberOfRecords,
+    PULONGLONG Lost)
+{
+    WHeapMem<SRB_IMSCSI_READ_TRACE> buffer(
+        FIELD_OFFSET(SRB_IMSCSI_READ_TRACE, Records) +
+        MaxRecords * sizeof(*Records), HEAP_GENERATE_EXCEPTIONS);
+
+    DWORD dw;
+
+    buffer->Sequence = *Sequence;
+
+    if (!ImScsiDeviceIoControl(Adapter,
+        SMP_IMSCSI_READ_TRACE,
+        &buffer->SrbIoControl, (DWORD)buffer.GetSize(),
+        0, &dw))
+    {
+        return FALSE;
+    }
+
+    if (buffer->NumberOfRecords > MaxRecords)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    *Sequence = buffer->Sequence;
+    *NumberOfRecords = buffer->NumberOfRecords;
+
+    if (Lost != NULL)
+        *Lost = buffer->Lost;
+
+    RtlCopyMemory(Records, buffer->Records,
+        buffer->NumberOfRecords * sizeof(*Records));
+
+    return TRUE;
+}
+
 AIMAPI_API BOOL
 WINAPI
 ImScsiSaveRegistrySettings(PIMSCSI_DEVICE_CONFIGURATION Config)
@@ -280,6 +280,185 @@ extern "C" {
         IN DEVICE_NUMBER DeviceNumber,
         IN CONST PLARGE_INTEGER ExtendSize);
 
+    /**
+    This function writes all changes in the differencing file of a virtual
+    disk created with IMSCSI_WRITE_OVERLAY to the image file or proxy, and
+    then empties the differencing file.
+
+    hWndStatusText  A handle to a window that can display status message text.
+    The function will send WM_SETTEXT messages to this window.
+    If this parameter is NULL no WM_SETTEXT messages are sent
+    and the function acts non-interactive.
+
+    DeviceNumber    Number of the device.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiCommitOverlay(IN HWND hWndStatusText OPTIONAL,
+        IN HANDLE Adapter,
+        IN DEVICE_NUMBER DeviceNumber);
+
+    /**
+    This function empties the differencing file of a virtual disk created
+    with IMSCSI_WRITE_OVERLAY, so that the virtual disk again shows the
+    unmodified contents of the image file or proxy. Filesystems on the
+    virtual disk should be dismounted first.
+
+    hWndStatusText  A handle to a window that can display status message text.
+    The function will send WM_SETTEXT messages to this window.
+    If this parameter is NULL no WM_SETTEXT messages are sent
+    and the function acts non-interactive.
+
+    DeviceNumber    Number of the device.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiDiscardOverlay(IN HWND hWndStatusText OPTIONAL,
+        IN HANDLE Adapter,
+        IN DEVICE_NUMBER DeviceNumber);
+
+    /**
+    This function queries digests of virtual disk contents for a virtual disk
+    created with IMSCSI_HASH_IMAGE. Digests are valid when the Complete
+    member of the returned structure is set, otherwise BytesHashed tells how
+    far hashing has come.
+
+    Adapter         Handle to SCSI adapter.
+
+    DeviceNumber    Number of the device.
+
+    QueryHash       Pointer to structure that receives digests and progress.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiQueryDeviceHash(IN HANDLE Adapter,
+        IN DEVICE_NUMBER DeviceNumber,
+        OUT PSRB_IMSCSI_QUERY_HASH QueryHash);
+
+    /**
+    This function queries performance counters of a virtual disk. Counters
+    include requests, bytes, errors and latency histograms for reads,
+    writes, UNMAP and other commands, cache hits and misses, proxy round
+    trips and number of requests currently queued in driver.
+
+    Adapter         Handle to SCSI adapter.
+
+    DeviceNumber    Number of the device.
+
+    Statistics      Pointer to structure that receives counters.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiQueryStatistics(IN HANDLE Adapter,
+        IN DEVICE_NUMBER DeviceNumber,
+        OUT PIMSCSI_LU_STATISTICS Statistics);
+
+    /**
+    This function starts or stops recording of SCSI request stages in the
+    trace buffer of the driver. The buffer is allocated the first time
+    tracing is started and kept until the driver unloads.
+
+    Adapter         Handle to SCSI adapter.
+
+    Enable          TRUE to start tracing, FALSE to stop.
+
+    Capacity        Optional. On input, number of records in trace buffer,
+                    or 0 for default. Receives actual number of records.
+
+    Frequency       Optional pointer to variable that receives frequency of
+                    record timestamps, in ticks per second.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiSetSrbTrace(IN HANDLE Adapter,
+        IN BOOL Enable,
+        IN OUT PULONG Capacity OPTIONAL,
+        OUT PLONGLONG Frequency OPTIONAL);
+
+    /**
+    This function reads records from the trace buffer of the driver.
+
+    Adapter         Handle to SCSI adapter.
+
+    Sequence        On input, sequence number of first record to read, 0
+                    for the first call. Receives sequence number to pass in
+                    next call.
+
+    Records         Pointer to array that receives records.
+
+    MaxRecords      Number of elements in Records.
+
+    NumberOfRecords Receives number of records read.
+
+    Lost            Optional pointer to variable that receives number of
+                    records overwritten before they could be read.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiReadSrbTrace(IN HANDLE Adapter,
+        IN OUT PULONGLONG Sequence,
+        OUT PIMSCSI_TRACE_RECORD Records,
+        IN ULONG MaxRecords,
+        OUT PULONG NumberOfRecords,
+        OUT PULONGLONG Lost OPTIONAL);
+
+    /**
+    This function builds a Merkle index file with SHA-256 hashes of each
+    chunk of an image file, using one thread per processor. The index file
+    is named as the image file with IMSCSI_MERKLE_INDEX_SUFFIX appended.
+    Virtual disks created with IMSCSI_VERIFY_IMAGE check data read from the
+    image against this file.
+
+    hWndStatusText  A handle to a window that can display status message text.
+    The function will send WM_SETTEXT messages to this window.
+    If this parameter is NULL no WM_SETTEXT messages are sent
+    and the function acts non-interactive.
+
+    ImageFile       Path to image file.
+
+    ChunkShift      Chunk size is 1 << ChunkShift bytes. Zero selects
+    IMSCSI_MERKLE_DEFAULT_CHUNK_SHIFT.
+
+    Root            Optional pointer to IMSCSI_MERKLE_HASH_SIZE bytes that
+    receive root hash. Store this value to verify index file later.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiBuildMerkleIndex(IN HWND hWndStatusText OPTIONAL,
+        IN LPCWSTR ImageFile,
+        IN ULONG ChunkShift,
+        OUT PUCHAR Root OPTIONAL);
+
+    /**
+    This function checks that chunk hashes in Merkle index file for an image
+    file match root hash in index file and, optionally, a root hash stored
+    when the index was built. Then a sample of chunks is read from the image
+    file and hashed, and compared to leaf hashes in index file. First and
+    last chunk are always in the sample, other chunks are selected at random.
+
+    This function returns FALSE with ERROR_FILE_CORRUPT if index file is
+    damaged and with ERROR_CRC if root does not match ExpectedRoot or if
+    image size or data of a sampled chunk does not match index file.
+
+    ImageFile       Path to image file.
+
+    ExpectedRoot    Optional pointer to IMSCSI_MERKLE_HASH_SIZE bytes with
+    expected root hash.
+
+    SampleChunks    Number of image chunks to check. Zero checks index file
+    only, without reading the image. A number equal to or
+    larger than number of chunks checks every chunk.
+
+    Root            Optional pointer to IMSCSI_MERKLE_HASH_SIZE bytes that
+    receive root hash.
+    */
+    AIMAPI_API BOOL
+        WINAPI
+        ImScsiVerifyMerkleIndex(IN LPCWSTR ImageFile,
+        IN CONST UCHAR *ExpectedRoot OPTIONAL,
+        IN ULONG SampleChunks,
+        OUT PUCHAR Root OPTIONAL);
+
     /**
     Adds registry settings for creating a virtual disk at system startup (or
     when driver is loaded).
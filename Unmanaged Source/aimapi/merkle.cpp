@@ -0,0 +1,718 @@
+/// merkle.cpp
+/// Builds and checks Merkle index files of chunk hashes for image files.
+/// Driver checks reads against these for virtual disks created with
+/// IMSCSI_VERIFY_IMAGE.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+
+#include "stdafx.h"
+
+#include <wincrypt.h>
+#include <stdio.h>
+
+#include "aimapi.h"
+
+#include "winstrct.hpp"
+
+#pragma comment(lib, "advapi32.lib")
+
+// Not defined by older SDK headers.
+#ifndef PROV_RSA_AES
+#define PROV_RSA_AES 24
+#endif
+#ifndef CALG_SHA_256
+#define CALG_SHA_256 0x0000800c
+#endif
+
+// Index file format is described with IMSCSI_MERKLE_HEADER in common.h.
+// Chunks are hashed by one thread per processor, each thread reads and
+// hashes next chunk not yet taken by another thread.
+
+typedef struct _IMSCSI_MERKLE_BUILD
+{
+    LPCWSTR ImageFile;
+    HCRYPTPROV Provider;
+    ULONG ChunkShift;
+    LONGLONG ImageSize;
+    LONG ChunkCount;
+    volatile LONG NextChunk;
+    volatile LONG ChunksDone;
+    volatile LONG Error;
+    PUCHAR Leaves;
+} IMSCSI_MERKLE_BUILD, *PIMSCSI_MERKLE_BUILD;
+
+// Enough for any number of chunks that fits in a ULONG.
+#define IMSCSI_MERKLE_MAX_LEVELS    33
+
+static BOOL
+ImScsiMerkleHash(HCRYPTPROV Provider,
+    UCHAR Prefix,
+    LPCVOID Data1,
+    DWORD Length1,
+    LPCVOID Data2,
+    DWORD Length2,
+    PUCHAR Hash)
+{
+    HCRYPTHASH hash;
+    DWORD hash_size = IMSCSI_MERKLE_HASH_SIZE;
+
+    if (!CryptCreateHash(Provider, CALG_SHA_256, 0, 0, &hash))
+    {
+        return FALSE;
+    }
+
+    BOOL result = CryptHashData(hash, &Prefix, sizeof(Prefix), 0) &&
+        CryptHashData(hash, (const BYTE*)Data1, Length1, 0) &&
+        ((Length2 == 0) ||
+        CryptHashData(hash, (const BYTE*)Data2, Length2, 0)) &&
+        CryptGetHashParam(hash, HP_HASHVAL, Hash, &hash_size, 0);
+
+    WPreserveLastError ple;
+
+    CryptDestroyHash(hash);
+
+    return result;
+}
+
+// Same calculation as in driver, see ImScsiCheckMerkleRoot in
+// phdskmnt\merkle.cpp.
+static BOOL
+ImScsiMerkleRoot(HCRYPTPROV Provider,
+    const UCHAR *Leaves,
+    LONG ChunkCount,
+    PUCHAR Root)
+{
+    struct
+    {
+        ULONG Level;
+        UCHAR Hash[IMSCSI_MERKLE_HASH_SIZE];
+    } stack[IMSCSI_MERKLE_MAX_LEVELS];
+    ULONG depth = 0;
+
+    for (LONG i = 0; i < ChunkCount; i++)
+    {
+        memcpy(stack[depth].Hash, Leaves + (SIZE_T)i * IMSCSI_MERKLE_HASH_SIZE,
+            IMSCSI_MERKLE_HASH_SIZE);
+        stack[depth].Level = 0;
+        depth++;
+
+        while ((depth >= 2) &&
+            (stack[depth - 2].Level == stack[depth - 1].Level))
+        {
+            if (!ImScsiMerkleHash(Provider, 1,
+                stack[depth - 2].Hash, IMSCSI_MERKLE_HASH_SIZE,
+                stack[depth - 1].Hash, IMSCSI_MERKLE_HASH_SIZE,
+                stack[depth - 2].Hash))
+            {
+                return FALSE;
+            }
+
+            stack[depth - 2].Level++;
+            depth--;
+        }
+    }
+
+    while (depth >= 2)
+    {
+        if (!ImScsiMerkleHash(Provider, 1,
+            stack[depth - 2].Hash, IMSCSI_MERKLE_HASH_SIZE,
+            stack[depth - 1].Hash, IMSCSI_MERKLE_HASH_SIZE,
+            stack[depth - 2].Hash))
+        {
+            return FALSE;
+        }
+
+        depth--;
+    }
+
+    if (depth != 1)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    memcpy(Root, stack[0].Hash, IMSCSI_MERKLE_HASH_SIZE);
+
+    return TRUE;
+}
+
+static DWORD
+WINAPI
+ImScsiMerkleBuildThread(LPVOID Context)
+{
+    PIMSCSI_MERKLE_BUILD build = (PIMSCSI_MERKLE_BUILD)Context;
+    DWORD chunk_size = 1UL << build->ChunkShift;
+
+    HANDLE image = CreateFile(build->ImageFile,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+
+    if (image == INVALID_HANDLE_VALUE)
+    {
+        InterlockedCompareExchange(&build->Error, (LONG)GetLastError(), NO_ERROR);
+        return 0;
+    }
+
+    PUCHAR buffer = (PUCHAR)VirtualAlloc(NULL, chunk_size, MEM_COMMIT,
+        PAGE_READWRITE);
+
+    if (buffer == NULL)
+    {
+        InterlockedCompareExchange(&build->Error, (LONG)GetLastError(), NO_ERROR);
+        CloseHandle(image);
+        return 0;
+    }
+
+    while (build->Error == NO_ERROR)
+    {
+        LONG chunk = InterlockedIncrement(&build->NextChunk) - 1;
+
+        if (chunk >= build->ChunkCount)
+        {
+            break;
+        }
+
+        LARGE_INTEGER offset;
+        offset.QuadPart = (LONGLONG)chunk << build->ChunkShift;
+
+        DWORD length = (DWORD)min(build->ImageSize - offset.QuadPart,
+            (LONGLONG)chunk_size);
+
+        OVERLAPPED overlapped = { 0 };
+        overlapped.Offset = offset.LowPart;
+        overlapped.OffsetHigh = offset.HighPart;
+
+        DWORD read_length;
+
+        if (!ReadFile(image, buffer, length, &read_length, &overlapped))
+        {
+            InterlockedCompareExchange(&build->Error, (LONG)GetLastError(), NO_ERROR);
+            break;
+        }
+
+        if (read_length != length)
+        {
+            InterlockedCompareExchange(&build->Error, (LONG)ERROR_HANDLE_EOF, NO_ERROR);
+            break;
+        }
+
+        if (!ImScsiMerkleHash(build->Provider, 0, buffer, length, NULL, 0,
+            build->Leaves + (SIZE_T)chunk * IMSCSI_MERKLE_HASH_SIZE))
+        {
+            InterlockedCompareExchange(&build->Error, (LONG)GetLastError(), NO_ERROR);
+            break;
+        }
+
+        InterlockedIncrement(&build->ChunksDone);
+    }
+
+    VirtualFree(buffer, 0, MEM_RELEASE);
+    CloseHandle(image);
+
+    return 0;
+}
+
+static LPWSTR
+ImScsiMerkleIndexName(LPCWSTR ImageFile)
+{
+    size_t length = wcslen(ImageFile) + _countof(IMSCSI_MERKLE_INDEX_SUFFIX);
+
+    LPWSTR index_file = (LPWSTR)HeapAlloc(GetProcessHeap(), 0,
+        length * sizeof(WCHAR));
+
+    if (index_file == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    wcscpy(index_file, ImageFile);
+    wcscat(index_file, IMSCSI_MERKLE_INDEX_SUFFIX);
+
+    return index_file;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiBuildMerkleIndex(HWND hWnd,
+    LPCWSTR ImageFile,
+    ULONG ChunkShift,
+    PUCHAR Root)
+{
+    IMSCSI_MERKLE_BUILD build = { 0 };
+    IMSCSI_MERKLE_HEADER header = { 0 };
+    HANDLE threads[MAXIMUM_WAIT_OBJECTS];
+    DWORD thread_count = 0;
+    SYSTEM_INFO system_info;
+    WCHAR status_text[80];
+    BOOL result = FALSE;
+
+    if (ChunkShift == 0)
+    {
+        ChunkShift = IMSCSI_MERKLE_DEFAULT_CHUNK_SHIFT;
+    }
+
+    if ((ChunkShift < IMSCSI_MERKLE_MIN_CHUNK_SHIFT) ||
+        (ChunkShift > IMSCSI_MERKLE_MAX_CHUNK_SHIFT))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    LPWSTR index_file = ImScsiMerkleIndexName(ImageFile);
+
+    if (index_file == NULL)
+    {
+        return FALSE;
+    }
+
+    build.ImageFile = ImageFile;
+    build.ChunkShift = ChunkShift;
+
+    HANDLE image = CreateFile(ImageFile,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        0,
+        NULL);
+
+    LARGE_INTEGER image_size;
+
+    if ((image == INVALID_HANDLE_VALUE) ||
+        !GetFileSizeEx(image, &image_size))
+    {
+        ImScsiMsgBoxLastError(hWnd, L"Error opening image file:");
+
+        if (image != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(image);
+        }
+
+        HeapFree(GetProcessHeap(), 0, index_file);
+        return FALSE;
+    }
+
+    CloseHandle(image);
+
+    LONGLONG chunk_count = (image_size.QuadPart + (1LL << ChunkShift) - 1) >>
+        ChunkShift;
+
+    // Leaf hashes are read and written in one piece.
+    if ((chunk_count == 0) ||
+        (chunk_count > MAXLONG / IMSCSI_MERKLE_HASH_SIZE))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        HeapFree(GetProcessHeap(), 0, index_file);
+        return FALSE;
+    }
+
+    build.ImageSize = image_size.QuadPart;
+    build.ChunkCount = (LONG)chunk_count;
+
+    build.Leaves = (PUCHAR)VirtualAlloc(NULL,
+        (SIZE_T)chunk_count * IMSCSI_MERKLE_HASH_SIZE, MEM_COMMIT,
+        PAGE_READWRITE);
+
+    if (build.Leaves == NULL)
+    {
+        ImScsiMsgBoxLastError(hWnd, L"Memory allocation error:");
+        HeapFree(GetProcessHeap(), 0, index_file);
+        return FALSE;
+    }
+
+    if (!CryptAcquireContext(&build.Provider, NULL, NULL, PROV_RSA_AES,
+        CRYPT_VERIFYCONTEXT))
+    {
+        ImScsiMsgBoxLastError(hWnd, L"Error initializing SHA-256:");
+        VirtualFree(build.Leaves, 0, MEM_RELEASE);
+        HeapFree(GetProcessHeap(), 0, index_file);
+        return FALSE;
+    }
+
+    GetSystemInfo(&system_info);
+
+    DWORD max_threads = min(system_info.dwNumberOfProcessors,
+        MAXIMUM_WAIT_OBJECTS);
+
+    if ((LONGLONG)max_threads > chunk_count)
+    {
+        max_threads = (DWORD)chunk_count;
+    }
+
+    ImScsiSetStatusMsg(hWnd, L"Building Merkle index...");
+
+    while (thread_count < max_threads)
+    {
+        threads[thread_count] = CreateThread(NULL, 0,
+            ImScsiMerkleBuildThread, &build, 0, NULL);
+
+        if (threads[thread_count] == NULL)
+        {
+            break;
+        }
+
+        thread_count++;
+    }
+
+    if (thread_count == 0)
+    {
+        build.Error = (LONG)GetLastError();
+    }
+
+    // Show progress until all threads are done.
+    while ((thread_count > 0) &&
+        (WaitForMultipleObjects(thread_count, threads, TRUE, 1000) ==
+        WAIT_TIMEOUT))
+    {
+        _snwprintf(status_text, _countof(status_text),
+            L"Building Merkle index, %i%% done...",
+            (int)((LONGLONG)build.ChunksDone * 100 / chunk_count));
+        status_text[_countof(status_text) - 1] = 0;
+
+        ImScsiSetStatusMsg(hWnd, status_text);
+    }
+
+    for (DWORD i = 0; i < thread_count; i++)
+    {
+        CloseHandle(threads[i]);
+    }
+
+    if (build.Error != NO_ERROR)
+    {
+        SetLastError((DWORD)build.Error);
+        ImScsiMsgBoxLastError(hWnd, L"Error reading image file:");
+    }
+    else if (!ImScsiMerkleRoot(build.Provider, build.Leaves,
+        build.ChunkCount, header.Root))
+    {
+        ImScsiMsgBoxLastError(hWnd, L"Error hashing image file:");
+    }
+    else
+    {
+        memcpy(header.Signature, IMSCSI_MERKLE_SIGNATURE,
+            sizeof(header.Signature));
+        header.Version = IMSCSI_MERKLE_VERSION;
+        header.ChunkShift = ChunkShift;
+        header.ImageSize.QuadPart = build.ImageSize;
+
+        HANDLE index = CreateFile(index_file,
+            GENERIC_WRITE,
+            0,
+            NULL,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+
+        // Header is padded with zeros to IMSCSI_MERKLE_HEADER_SIZE.
+        UCHAR header_block[IMSCSI_MERKLE_HEADER_SIZE] = { 0 };
+        memcpy(header_block, &header, sizeof(header));
+
+        DWORD dw;
+
+        if ((index == INVALID_HANDLE_VALUE) ||
+            !WriteFile(index, header_block, sizeof(header_block), &dw, NULL) ||
+            !WriteFile(index, build.Leaves,
+            (DWORD)chunk_count * IMSCSI_MERKLE_HASH_SIZE, &dw, NULL))
+        {
+            ImScsiMsgBoxLastError(hWnd, L"Error writing Merkle index file:");
+
+            if (index != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(index);
+                DeleteFile(index_file);
+            }
+        }
+        else
+        {
+            CloseHandle(index);
+
+            if (Root != NULL)
+            {
+                memcpy(Root, header.Root, IMSCSI_MERKLE_HASH_SIZE);
+            }
+
+            ImScsiSetStatusMsg(hWnd, L"Merkle index created.");
+
+            result = TRUE;
+        }
+    }
+
+    WPreserveLastError ple;
+
+    CryptReleaseContext(build.Provider, 0);
+    VirtualFree(build.Leaves, 0, MEM_RELEASE);
+    HeapFree(GetProcessHeap(), 0, index_file);
+
+    return result;
+}
+
+// Reads chunks of image file and compares their hashes to leaf hashes. First
+// and last chunk are always checked, last chunk may be shorter than others.
+// Other chunks are selected at random, so that changed data cannot be placed
+// where it is known not to be read.
+static BOOL
+ImScsiMerkleCheckSamples(HCRYPTPROV Provider,
+    LPCWSTR ImageFile,
+    const IMSCSI_MERKLE_HEADER *Header,
+    const UCHAR *Leaves,
+    LONG ChunkCount,
+    ULONG SampleChunks)
+{
+    DWORD chunk_size = 1UL << Header->ChunkShift;
+    LARGE_INTEGER image_size;
+    BOOL result = TRUE;
+
+    HANDLE image = CreateFile(ImageFile,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_RANDOM_ACCESS,
+        NULL);
+
+    if (image == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if (!GetFileSizeEx(image, &image_size))
+    {
+        WPreserveLastError ple;
+        CloseHandle(image);
+        return FALSE;
+    }
+
+    // Index describes image of another size.
+    if (image_size.QuadPart != Header->ImageSize.QuadPart)
+    {
+        CloseHandle(image);
+        SetLastError(ERROR_CRC);
+        return FALSE;
+    }
+
+    PUCHAR buffer = (PUCHAR)VirtualAlloc(NULL, chunk_size, MEM_COMMIT,
+        PAGE_READWRITE);
+
+    if (buffer == NULL)
+    {
+        WPreserveLastError ple;
+        CloseHandle(image);
+        return FALSE;
+    }
+
+    if ((LONGLONG)SampleChunks > ChunkCount)
+    {
+        SampleChunks = (ULONG)ChunkCount;
+    }
+
+    for (ULONG i = 0; result && (i < SampleChunks); i++)
+    {
+        LONG chunk;
+
+        if (SampleChunks == (ULONG)ChunkCount)
+        {
+            chunk = (LONG)i;
+        }
+        else if (i == 0)
+        {
+            chunk = 0;
+        }
+        else if (i == 1)
+        {
+            chunk = ChunkCount - 1;
+        }
+        else
+        {
+            ULONG random;
+
+            if (!CryptGenRandom(Provider, sizeof(random), (PBYTE)&random))
+            {
+                result = FALSE;
+                break;
+            }
+
+            chunk = (LONG)(random % (ULONG)ChunkCount);
+        }
+
+        LARGE_INTEGER offset;
+        offset.QuadPart = (LONGLONG)chunk << Header->ChunkShift;
+
+        DWORD length = (DWORD)min(Header->ImageSize.QuadPart - offset.QuadPart,
+            (LONGLONG)chunk_size);
+
+        OVERLAPPED overlapped = { 0 };
+        overlapped.Offset = offset.LowPart;
+        overlapped.OffsetHigh = offset.HighPart;
+
+        DWORD read_length;
+        UCHAR leaf[IMSCSI_MERKLE_HASH_SIZE];
+
+        if (!ReadFile(image, buffer, length, &read_length, &overlapped) ||
+            !ImScsiMerkleHash(Provider, 0, buffer, read_length, NULL, 0, leaf))
+        {
+            result = FALSE;
+        }
+        else if ((read_length != length) ||
+            (memcmp(leaf, Leaves + (SIZE_T)chunk * IMSCSI_MERKLE_HASH_SIZE,
+            sizeof(leaf)) != 0))
+        {
+            // Image data was changed after index was built.
+            SetLastError(ERROR_CRC);
+            result = FALSE;
+        }
+    }
+
+    WPreserveLastError ple;
+
+    VirtualFree(buffer, 0, MEM_RELEASE);
+    CloseHandle(image);
+
+    return result;
+}
+
+AIMAPI_API BOOL
+WINAPI
+ImScsiVerifyMerkleIndex(LPCWSTR ImageFile,
+    const UCHAR *ExpectedRoot,
+    ULONG SampleChunks,
+    PUCHAR Root)
+{
+    IMSCSI_MERKLE_HEADER header;
+    HCRYPTPROV provider;
+    UCHAR root[IMSCSI_MERKLE_HASH_SIZE];
+    DWORD dw;
+    BOOL result = FALSE;
+
+    LPWSTR index_file = ImScsiMerkleIndexName(ImageFile);
+
+    if (index_file == NULL)
+    {
+        return FALSE;
+    }
+
+    HANDLE index = CreateFile(index_file,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+
+    HeapFree(GetProcessHeap(), 0, index_file);
+
+    if (index == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if (!ReadFile(index, &header, sizeof(header), &dw, NULL))
+    {
+        WPreserveLastError ple;
+        CloseHandle(index);
+        return FALSE;
+    }
+
+    LONGLONG chunk_count = 0;
+
+    if ((dw == sizeof(header)) &&
+        (memcmp(header.Signature, IMSCSI_MERKLE_SIGNATURE,
+        sizeof(header.Signature)) == 0) &&
+        (header.Version == IMSCSI_MERKLE_VERSION) &&
+        (header.ChunkShift >= IMSCSI_MERKLE_MIN_CHUNK_SHIFT) &&
+        (header.ChunkShift <= IMSCSI_MERKLE_MAX_CHUNK_SHIFT))
+    {
+        chunk_count = (header.ImageSize.QuadPart +
+            (1LL << header.ChunkShift) - 1) >> header.ChunkShift;
+    }
+
+    if ((chunk_count <= 0) ||
+        (chunk_count > MAXLONG / IMSCSI_MERKLE_HASH_SIZE))
+    {
+        CloseHandle(index);
+        SetLastError(ERROR_FILE_CORRUPT);
+        return FALSE;
+    }
+
+    PUCHAR leaves = (PUCHAR)VirtualAlloc(NULL,
+        (SIZE_T)chunk_count * IMSCSI_MERKLE_HASH_SIZE, MEM_COMMIT,
+        PAGE_READWRITE);
+
+    if (leaves == NULL)
+    {
+        WPreserveLastError ple;
+        CloseHandle(index);
+        return FALSE;
+    }
+
+    LARGE_INTEGER leaf_offset;
+    leaf_offset.QuadPart = IMSCSI_MERKLE_HEADER_SIZE;
+
+    BOOL leaves_read = SetFilePointerEx(index, leaf_offset, NULL, FILE_BEGIN) &&
+        ReadFile(index, leaves, (DWORD)chunk_count * IMSCSI_MERKLE_HASH_SIZE,
+        &dw, NULL);
+
+    if (leaves_read && (dw != (DWORD)chunk_count * IMSCSI_MERKLE_HASH_SIZE))
+    {
+        SetLastError(ERROR_FILE_CORRUPT);
+        leaves_read = FALSE;
+    }
+
+    if (leaves_read &&
+        CryptAcquireContext(&provider, NULL, NULL, PROV_RSA_AES,
+        CRYPT_VERIFYCONTEXT))
+    {
+        if (ImScsiMerkleRoot(provider, leaves, (LONG)chunk_count, root))
+        {
+            if (memcmp(root, header.Root, sizeof(root)) != 0)
+            {
+                // Leaf hashes were changed or damaged.
+                SetLastError(ERROR_FILE_CORRUPT);
+            }
+            else if ((ExpectedRoot != NULL) &&
+                (memcmp(root, ExpectedRoot, sizeof(root)) != 0))
+            {
+                // Index is intact but describes other image contents.
+                SetLastError(ERROR_CRC);
+            }
+            else if ((SampleChunks > 0) &&
+                !ImScsiMerkleCheckSamples(provider, ImageFile, &header,
+                leaves, (LONG)chunk_count, SampleChunks))
+            {
+                // Error code set by ImScsiMerkleCheckSamples.
+            }
+            else
+            {
+                if (Root != NULL)
+                {
+                    memcpy(Root, root, sizeof(root));
+                }
+
+                result = TRUE;
+            }
+        }
+
+        WPreserveLastError ple;
+
+        CryptReleaseContext(provider, 0);
+    }
+
+    WPreserveLastError ple;
+
+    VirtualFree(leaves, 0, MEM_RELEASE);
+    CloseHandle(index);
+
+    return result;
+}
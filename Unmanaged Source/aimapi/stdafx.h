@@ -33,3 +33,8 @@ int
 CDECL
 ImScsiMsgBoxPrintF(HWND hWnd, UINT uStyle, LPCWSTR lpTitle,
 LPCWSTR lpMessage, ...);
+
+void
+WINAPI
+ImScsiSetStatusMsg(IN HWND hWnd,
+LPCWSTR Text);
@@ -0,0 +1,573 @@
+/// backends.cpp
+/// Image file and memory back ends for the user mode build of the request
+/// path.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+
+#include "iobench.h"
+
+typedef struct _IMSCSI_BENCH_FILE
+{
+    int                 Fd;
+} IMSCSI_BENCH_FILE, *PIMSCSI_BENCH_FILE;
+
+typedef struct _IMSCSI_BENCH_RAM
+{
+    PUCHAR              Data;
+    LONGLONG            Size;
+    UCHAR               Identity[16];       // Random, memory disks are new each time.
+    ULONGLONG           Generation;         // Number of writes.
+} IMSCSI_BENCH_RAM, *PIMSCSI_BENCH_RAM;
+
+typedef struct _IMSCSI_BENCH_CACHE
+{
+    IMSCSI_CACHE_CORE   Core;
+    IMSCSI_BENCH_BACKEND CacheFile;
+    IMSCSI_BENCH_BACKEND Image;
+} IMSCSI_BENCH_CACHE, *PIMSCSI_BENCH_CACHE;
+
+static
+NTSTATUS
+ImScsiBenchFileRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+    ULONG done = 0;
+
+    while (done < *Length)
+    {
+        ssize_t result = pread(file->Fd, (PUCHAR)Buffer + done,
+            *Length - done, Offset + done);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            *Length = 0;
+            return STATUS_IO_DEVICE_ERROR;
+        }
+
+        // Same as STATUS_END_OF_FILE in ImScsiReadDevice, rest is zeroed.
+        if (result == 0)
+        {
+            memset((PUCHAR)Buffer + done, 0, *Length - done);
+            break;
+        }
+
+        done += (ULONG)result;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+ImScsiBenchFileWrite(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+    ULONG done = 0;
+
+    while (done < *Length)
+    {
+        ssize_t result = pwrite(file->Fd, (PUCHAR)Buffer + done,
+            *Length - done, Offset + done);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            *Length = done;
+            return STATUS_IO_DEVICE_ERROR;
+        }
+
+        done += (ULONG)result;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+ImScsiBenchFileFlush(PVOID Context)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+
+    if (fdatasync(file->Fd) != 0)
+    {
+        return STATUS_IO_DEVICE_ERROR;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+ImScsiBenchFileClose(PVOID Context)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+
+    close(file->Fd);
+    free(file);
+}
+
+// Identity is file system file id, generation is modification time.
+static
+NTSTATUS
+ImScsiBenchFileQueryIdentity(PVOID Context, PIMDPROXY_IDENTITY_RESP Identity)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+    struct stat st;
+    ULONGLONG device;
+    ULONGLONG inode;
+
+    if (fstat(file->Fd, &st) != 0)
+    {
+        return STATUS_IO_DEVICE_ERROR;
+    }
+
+    device = (ULONGLONG)st.st_dev;
+    inode = (ULONGLONG)st.st_ino;
+
+    Identity->errorno = 0;
+    memcpy(Identity->identity, &device, sizeof(device));
+    memcpy(Identity->identity + sizeof(device), &inode, sizeof(inode));
+    Identity->generation = (ULONGLONG)st.st_mtim.tv_sec * 1000000000ULL +
+        (ULONGLONG)st.st_mtim.tv_nsec;
+
+    return STATUS_SUCCESS;
+}
+
+// File system block size, writes of partial blocks are read-modify-write.
+static
+NTSTATUS
+ImScsiBenchFileQueryLimits(PVOID Context, PIMDPROXY_LIMITS_RESP Limits)
+{
+    PIMSCSI_BENCH_FILE file = (PIMSCSI_BENCH_FILE)Context;
+    struct stat st;
+
+    if (fstat(file->Fd, &st) != 0)
+    {
+        return STATUS_IO_DEVICE_ERROR;
+    }
+
+    memset(Limits, 0, sizeof(*Limits));
+    Limits->optimal_granularity = (ULONGLONG)st.st_blksize;
+    Limits->unmap_granularity = (ULONGLONG)st.st_blksize;
+
+    return STATUS_SUCCESS;
+}
+
+static const IMSCSI_CORE_BACKEND ImScsiBenchFileOps = {
+    ImScsiBenchFileRead,
+    ImScsiBenchFileWrite,
+    ImScsiBenchFileFlush
+};
+
+static
+NTSTATUS
+ImScsiBenchRamRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_RAM ram = (PIMSCSI_BENCH_RAM)Context;
+
+    if ((Offset < 0) || (Offset + *Length > ram->Size))
+    {
+        *Length = 0;
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    memcpy(Buffer, ram->Data + Offset, *Length);
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+ImScsiBenchRamWrite(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_RAM ram = (PIMSCSI_BENCH_RAM)Context;
+
+    if ((Offset < 0) || (Offset + *Length > ram->Size))
+    {
+        *Length = 0;
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    memcpy(ram->Data + Offset, Buffer, *Length);
+
+    __atomic_fetch_add(&ram->Generation, 1, __ATOMIC_RELAXED);
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+ImScsiBenchRamQueryIdentity(PVOID Context, PIMDPROXY_IDENTITY_RESP Identity)
+{
+    PIMSCSI_BENCH_RAM ram = (PIMSCSI_BENCH_RAM)Context;
+
+    Identity->errorno = 0;
+    memcpy(Identity->identity, ram->Identity, sizeof(Identity->identity));
+    Identity->generation = __atomic_load_n(&ram->Generation, __ATOMIC_RELAXED);
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+ImScsiBenchRamClose(PVOID Context)
+{
+    PIMSCSI_BENCH_RAM ram = (PIMSCSI_BENCH_RAM)Context;
+
+    free(ram->Data);
+    free(ram);
+}
+
+static const IMSCSI_CORE_BACKEND ImScsiBenchRamOps = {
+    ImScsiBenchRamRead,
+    ImScsiBenchRamWrite,
+    NULL
+};
+
+BOOLEAN
+ImScsiBenchOpenFile(
+    const char                 *Path,
+    LONGLONG                    Size,
+    BOOLEAN                     Direct,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PIMSCSI_BENCH_FILE file;
+    struct stat st;
+    int flags = O_RDWR | O_CREAT;
+
+    if (Direct)
+    {
+        flags |= O_DIRECT;
+    }
+
+    file = (PIMSCSI_BENCH_FILE)malloc(sizeof(IMSCSI_BENCH_FILE));
+
+    if (file == NULL)
+    {
+        return FALSE;
+    }
+
+    file->Fd = open(Path, flags, 0644);
+
+    if (file->Fd < 0)
+    {
+        perror(Path);
+        free(file);
+        return FALSE;
+    }
+
+    if (fstat(file->Fd, &st) != 0)
+    {
+        perror(Path);
+        close(file->Fd);
+        free(file);
+        return FALSE;
+    }
+
+    if (Size == 0)
+    {
+        Size = st.st_size;
+    }
+    else if ((st.st_size < Size) && (ftruncate(file->Fd, Size) != 0))
+    {
+        perror(Path);
+        close(file->Fd);
+        free(file);
+        return FALSE;
+    }
+
+    Backend->Ops = &ImScsiBenchFileOps;
+    Backend->Context = file;
+    Backend->Close = ImScsiBenchFileClose;
+    Backend->QueryIdentity = ImScsiBenchFileQueryIdentity;
+    Backend->QueryLimits = ImScsiBenchFileQueryLimits;
+    Backend->Size = Size;
+    Backend->ReadOnly = FALSE;
+
+    return TRUE;
+}
+
+BOOLEAN
+ImScsiBenchOpenRam(
+    LONGLONG                    Size,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PIMSCSI_BENCH_RAM ram;
+
+    ram = (PIMSCSI_BENCH_RAM)malloc(sizeof(IMSCSI_BENCH_RAM));
+
+    if (ram == NULL)
+    {
+        return FALSE;
+    }
+
+    ram->Data = (PUCHAR)calloc(1, (size_t)Size);
+    ram->Size = Size;
+    ram->Generation = 0;
+
+    if (ram->Data == NULL)
+    {
+        fprintf(stderr, "Cannot allocate %lld bytes of memory.\n",
+            (long long)Size);
+        free(ram);
+        return FALSE;
+    }
+
+    if (getrandom(ram->Identity, sizeof(ram->Identity), 0) !=
+        (ssize_t)sizeof(ram->Identity))
+    {
+        perror("getrandom");
+        free(ram->Data);
+        free(ram);
+        return FALSE;
+    }
+
+    Backend->Ops = &ImScsiBenchRamOps;
+    Backend->Context = ram;
+    Backend->Close = ImScsiBenchRamClose;
+    Backend->QueryIdentity = ImScsiBenchRamQueryIdentity;
+    Backend->QueryLimits = NULL;
+    Backend->Size = Size;
+    Backend->ReadOnly = FALSE;
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+ImScsiBenchCacheRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+    ULONG hits;
+    ULONG misses;
+
+    return ImScsiCacheCoreRead(&cache->Core, Buffer, Offset, Length, &hits,
+        &misses);
+}
+
+// Write-around, same as proxy writes in driver.
+static
+NTSTATUS
+ImScsiBenchCacheWrite(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+    ULONG length = *Length;
+    NTSTATUS status;
+
+    status = cache->Image.Ops->Write(cache->Image.Context, Buffer, Offset,
+        Length);
+
+    ImScsiCacheCoreInvalidate(&cache->Core, Offset, length);
+
+    return status;
+}
+
+static
+NTSTATUS
+ImScsiBenchCacheFlush(PVOID Context)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+
+    if (cache->Image.Ops->Flush == NULL)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    return cache->Image.Ops->Flush(cache->Image.Context);
+}
+
+static
+NTSTATUS
+ImScsiBenchCacheQueryIdentity(PVOID Context, PIMDPROXY_IDENTITY_RESP Identity)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+
+    return cache->Image.QueryIdentity(cache->Image.Context, Identity);
+}
+
+// Blocks missing in cache are read from image in runs, same as in
+// ImScsiQueryBackendLimits for proxy LUs with cache files.
+static
+NTSTATUS
+ImScsiBenchCacheQueryLimits(PVOID Context, PIMDPROXY_LIMITS_RESP Limits)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+
+    memset(Limits, 0, sizeof(*Limits));
+
+    if ((cache->Image.QueryLimits != NULL) &&
+        !NT_SUCCESS(cache->Image.QueryLimits(cache->Image.Context, Limits)))
+    {
+        memset(Limits, 0, sizeof(*Limits));
+    }
+
+    Limits->errorno = 0;
+
+    if (Limits->optimal_granularity < IMSCSI_CACHE_CORE_BLOCK_SIZE)
+    {
+        Limits->optimal_granularity = IMSCSI_CACHE_CORE_BLOCK_SIZE;
+    }
+
+    if (Limits->optimal_transfer_length <
+        IMSCSI_CACHE_CORE_BLOCK_SIZE * IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS)
+    {
+        Limits->optimal_transfer_length =
+            IMSCSI_CACHE_CORE_BLOCK_SIZE * IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+ImScsiBenchCacheClose(PVOID Context)
+{
+    PIMSCSI_BENCH_CACHE cache = (PIMSCSI_BENCH_CACHE)Context;
+    IMDPROXY_IDENTITY_RESP identity;
+    NTSTATUS status;
+
+    printf("Cache file: %llu block hits, %llu block misses.\n",
+        (unsigned long long)cache->Core.Hits,
+        (unsigned long long)cache->Core.Misses);
+
+    // Generation after own writes is saved with index.
+    status = cache->Image.QueryIdentity(cache->Image.Context, &identity);
+
+    if (NT_SUCCESS(status))
+    {
+        status = ImScsiCacheCoreClose(&cache->Core, identity.generation);
+    }
+    else
+    {
+        ImScsiCacheCoreFree(&cache->Core);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        fprintf(stderr, "Cache index not saved (%#x). Cache is discarded on next open.\n",
+            (unsigned)status);
+    }
+
+    ImScsiBenchCloseBackend(&cache->CacheFile);
+    ImScsiBenchCloseBackend(&cache->Image);
+    free(cache);
+}
+
+static const IMSCSI_CORE_BACKEND ImScsiBenchCacheOps = {
+    ImScsiBenchCacheRead,
+    ImScsiBenchCacheWrite,
+    ImScsiBenchCacheFlush
+};
+
+BOOLEAN
+ImScsiBenchOpenCache(
+    const char                 *Path,
+    LONGLONG                    CacheSize,
+    ULONG                       Policy,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PIMSCSI_BENCH_CACHE cache;
+    IMDPROXY_IDENTITY_RESP identity;
+    NTSTATUS status;
+
+    if (Backend->QueryIdentity == NULL)
+    {
+        fprintf(stderr, "Back end does not report image identity, cache disabled.\n");
+        return FALSE;
+    }
+
+    status = Backend->QueryIdentity(Backend->Context, &identity);
+
+    if (!NT_SUCCESS(status))
+    {
+        fprintf(stderr, "Image identity query failed (%#x).\n", (unsigned)status);
+        return FALSE;
+    }
+
+    cache = (PIMSCSI_BENCH_CACHE)calloc(1, sizeof(IMSCSI_BENCH_CACHE));
+
+    if (cache == NULL)
+    {
+        return FALSE;
+    }
+
+    if (!ImScsiBenchOpenFile(Path, 0, FALSE, &cache->CacheFile))
+    {
+        free(cache);
+        return FALSE;
+    }
+
+    cache->Image = *Backend;
+
+    status = ImScsiCacheCoreOpen(&cache->Core,
+        cache->CacheFile.Ops,
+        cache->CacheFile.Context,
+        cache->Image.Ops,
+        cache->Image.Context,
+        cache->Image.Size,
+        (ULONGLONG)CacheSize >> IMSCSI_CACHE_CORE_BLOCK_SHIFT,
+        Policy,
+        identity.identity,
+        identity.generation);
+
+    if (!NT_SUCCESS(status))
+    {
+        fprintf(stderr, "%s: Cannot initialize cache file (%#x).\n", Path,
+            (unsigned)status);
+
+        ImScsiBenchCloseBackend(&cache->CacheFile);
+        free(cache);
+        return FALSE;
+    }
+
+    Backend->Ops = &ImScsiBenchCacheOps;
+    Backend->Context = cache;
+    Backend->Close = ImScsiBenchCacheClose;
+    Backend->QueryIdentity = ImScsiBenchCacheQueryIdentity;
+    Backend->QueryLimits = ImScsiBenchCacheQueryLimits;
+
+    return TRUE;
+}
+
+VOID
+ImScsiBenchCloseBackend(
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    if (Backend->Close != NULL)
+    {
+        Backend->Close(Backend->Context);
+    }
+
+    Backend->Ops = NULL;
+    Backend->Context = NULL;
+    Backend->Close = NULL;
+    Backend->QueryIdentity = NULL;
+    Backend->QueryLimits = NULL;
+}
@@ -0,0 +1,1395 @@
+/// iobench.cpp
+/// Feeds synthetic read and write SRBs, or SRBs replayed from a trace file,
+/// through the request path of the driver, built in user mode from
+/// phdskmnt/iocore.cpp, and reports IOPS, throughput and latency. Can also
+/// serve a back end as a proxy provider.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "iobench.h"
+
+enum
+{
+    IMSCSI_BENCH_SUCCESS = 0,
+    IMSCSI_BENCH_ERROR_IO = 1,
+    IMSCSI_BENCH_ERROR_VERIFY_FAILED = 2,
+    IMSCSI_BENCH_ERROR_BAD_SYNTAX = 10,
+    IMSCSI_BENCH_ERROR_FATAL = -1
+};
+
+// Same block size as default for virtual disks in driver.
+#define IMSCSI_BENCH_BLOCK_POWER            9
+#define IMSCSI_BENCH_BLOCK_SIZE             (1UL << IMSCSI_BENCH_BLOCK_POWER)
+
+#define IMSCSI_BENCH_DEFAULT_SIZE           (64LL << 20)
+
+// Same as aim_ll --replay.
+#define IMSCSI_BENCH_DEFAULT_REPLAY_DEPTH   32
+
+// Force unit access bit in byte 1 of WRITE (10) and (16).
+#define IMSCSI_BENCH_CDB_FUA                0x08
+
+enum
+{
+    IMSCSI_BENCH_READ,
+    IMSCSI_BENCH_WRITE,
+    IMSCSI_BENCH_CLASSES
+};
+
+///
+/// Synthetic SRB. RequestListEntry links it into queue of LU, same as
+/// RequestListEntry of MP_WorkRtnParms in driver.
+///
+typedef struct _IMSCSI_BENCH_SRB
+{
+    LIST_ENTRY          RequestListEntry;
+    UCHAR               Cdb[16];
+    ULONG               DataTransferLength;
+    PVOID               DataBuffer;
+    UCHAR               SrbStatus;
+    IMSCSI_CORE_SENSE   Sense;
+    IMSCSI_CORE_EVENT   Completed;
+} IMSCSI_BENCH_SRB, *PIMSCSI_BENCH_SRB;
+
+typedef struct _IMSCSI_BENCH_PARAMS
+{
+    BOOLEAN             Sequential;
+    ULONG               TransferLength;
+    ULONG               Depth;
+    ULONG               ReadPercent;
+    ULONGLONG           Count;
+    ULONG               Seconds;
+    BOOLEAN             Verify;
+    BOOLEAN             ForceUnitAccess;
+    PIMSCSI_BENCH_TRACE Replay;             // Requests issued instead of synthetic ones, or NULL.
+    BOOLEAN             AsFastAsPossible;   // Replay without waiting for original times.
+    const char         *RecordPath;         // Trace file to save requests to, or NULL.
+} IMSCSI_BENCH_PARAMS, *PIMSCSI_BENCH_PARAMS;
+
+typedef struct _IMSCSI_BENCH
+{
+    IMSCSI_BENCH_PARAMS Params;
+    IMSCSI_CORE_LU      Lu;
+    LONGLONG            DiskSize;
+    BOOLEAN             ReadOnly;
+    LONGLONG            Started;            // CLOCK_MONOTONIC ns.
+    LONGLONG            Deadline;           // CLOCK_MONOTONIC ns, zero if Count is used.
+    ULONGLONG           Issued;             // Next request number, shared by initiators.
+    BOOLEAN             StopWorker;
+} IMSCSI_BENCH, *PIMSCSI_BENCH;
+
+///
+/// Per initiator state and results. Latencies are in nanoseconds.
+///
+typedef struct _IMSCSI_BENCH_INITIATOR
+{
+    PIMSCSI_BENCH       Bench;
+    ULONGLONG           Random;
+    IMSCSI_BENCH_SRB    Srb;
+    LONGLONG           *Latencies[IMSCSI_BENCH_CLASSES];
+    ULONGLONG           Count[IMSCSI_BENCH_CLASSES];
+    ULONGLONG           Allocated[IMSCSI_BENCH_CLASSES];
+    ULONGLONG           Bytes[IMSCSI_BENCH_CLASSES];
+    ULONGLONG           Errors;
+    ULONGLONG           VerifyFailures;
+    ULONGLONG           CacheHits;
+    ULONGLONG           SkippedWrites;      // Replayed writes to read-only back end.
+    LONGLONG            IssueDelay;         // Sum of replay delays after original times.
+    IMSCSI_BENCH_TRACE  Recorded;           // Requests issued, if RecordPath is set.
+    ULONGLONG           RecordedAllocated;
+    pthread_t           Thread;
+} IMSCSI_BENCH_INITIATOR, *PIMSCSI_BENCH_INITIATOR;
+
+static
+LONGLONG
+ImScsiBenchNow()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (LONGLONG)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static
+VOID
+ImScsiBenchSleepUntil(LONGLONG Time)
+{
+    struct timespec due;
+
+    due.tv_sec = (time_t)(Time / 1000000000LL);
+    due.tv_nsec = (long)(Time % 1000000000LL);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+    {
+    }
+}
+
+static
+ULONGLONG
+ImScsiBenchNextRandom(PULONGLONG State)
+{
+    ULONGLONG x = *State;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return *State = x;
+}
+
+///
+/// Parses a number with optional K, M, G or T suffix. Returns -1 if
+/// String is not a valid size.
+///
+static
+LONGLONG
+ImScsiBenchParseSize(const char *String)
+{
+    char *suffix;
+    unsigned long long value;
+
+    errno = 0;
+    value = strtoull(String, &suffix, 0);
+
+    if ((errno != 0) || (suffix == String))
+    {
+        return -1;
+    }
+
+    switch (*suffix)
+    {
+    case 'T': case 't':
+        value <<= 10;
+        // fall through
+    case 'G': case 'g':
+        value <<= 10;
+        // fall through
+    case 'M': case 'm':
+        value <<= 10;
+        // fall through
+    case 'K': case 'k':
+        value <<= 10;
+        suffix++;
+    }
+
+    if ((*suffix != 0) || (value > (unsigned long long)MAXLONGLONG))
+    {
+        return -1;
+    }
+
+    return (LONGLONG)value;
+}
+
+///
+/// Data written to each block depends on block number only, so that
+/// concurrent writes to the same block from several initiators leave
+/// predictable contents. Blocks never written read as zeroes.
+///
+static
+VOID
+ImScsiBenchFillPattern(PUCHAR Buffer, LONGLONG StartSector, ULONG Length)
+{
+    for (ULONG offset = 0; offset < Length; offset += sizeof(ULONGLONG))
+    {
+        ULONGLONG sector = StartSector + (offset >> IMSCSI_BENCH_BLOCK_POWER);
+        ULONGLONG value = (sector * 0x9E3779B97F4A7C15ULL) ^
+            (offset & (IMSCSI_BENCH_BLOCK_SIZE - 1));
+
+        memcpy(Buffer + offset, &value, sizeof(value));
+    }
+}
+
+static
+BOOLEAN
+ImScsiBenchCheckPattern(PUCHAR Buffer, LONGLONG StartSector, ULONG Length)
+{
+    static const UCHAR zero_block[IMSCSI_BENCH_BLOCK_SIZE] = { 0 };
+    UCHAR expected[IMSCSI_BENCH_BLOCK_SIZE];
+
+    for (ULONG offset = 0; offset < Length; offset += IMSCSI_BENCH_BLOCK_SIZE)
+    {
+        LONGLONG sector = StartSector + (offset >> IMSCSI_BENCH_BLOCK_POWER);
+
+        if (memcmp(Buffer + offset, zero_block, IMSCSI_BENCH_BLOCK_SIZE) == 0)
+        {
+            continue;
+        }
+
+        ImScsiBenchFillPattern(expected, sector, IMSCSI_BENCH_BLOCK_SIZE);
+
+        if (memcmp(Buffer + offset, expected, IMSCSI_BENCH_BLOCK_SIZE) != 0)
+        {
+            fprintf(stderr, "Verify failed at block %lld.\n", (long long)sector);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+ImScsiBenchBuildCdb(PUCHAR Cdb, BOOLEAN Write, LONGLONG StartSector,
+    ULONG NumBlocks, BOOLEAN ForceUnitAccess)
+{
+    memset(Cdb, 0, 16);
+
+    if ((StartSector <= 0xFFFFFFFFLL) && (NumBlocks <= 0xFFFF))
+    {
+        Cdb[0] = Write ? SCSIOP_WRITE : SCSIOP_READ;
+
+        for (int i = 0; i < 4; i++)
+        {
+            Cdb[5 - i] = (UCHAR)(StartSector >> (i * 8));
+        }
+
+        Cdb[7] = (UCHAR)(NumBlocks >> 8);
+        Cdb[8] = (UCHAR)NumBlocks;
+    }
+    else
+    {
+        Cdb[0] = Write ? SCSIOP_WRITE16 : SCSIOP_READ16;
+
+        for (int i = 0; i < 8; i++)
+        {
+            Cdb[9 - i] = (UCHAR)(StartSector >> (i * 8));
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            Cdb[13 - i] = (UCHAR)(NumBlocks >> (i * 8));
+        }
+    }
+
+    if (Write && ForceUnitAccess)
+    {
+        Cdb[1] |= IMSCSI_BENCH_CDB_FUA;
+    }
+}
+
+///
+/// Completes Srb with sense data for Status, as ScsiSetCheckCondition and
+/// ScsiSetError do in driver.
+///
+static
+VOID
+ImScsiBenchCompleteSrb(PIMSCSI_BENCH_SRB Srb, NTSTATUS Status)
+{
+    if (NT_SUCCESS(Status))
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        memset(&Srb->Sense, 0, sizeof(Srb->Sense));
+    }
+    else
+    {
+        ImScsiCoreGetSense(Status, &Srb->Sense);
+        Srb->SrbStatus = Srb->Sense.SrbStatus;
+    }
+
+    ImScsiCoreSetEvent(&Srb->Completed);
+}
+
+///
+/// Worker thread of LU, counterpart of ImScsiWorkerThread and
+/// ImScsiDispatchReadWrite in driver.
+///
+static
+void *
+ImScsiBenchWorkerThread(void *Context)
+{
+    PIMSCSI_BENCH bench = (PIMSCSI_BENCH)Context;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    for (;;)
+    {
+        PLIST_ENTRY request;
+        PIMSCSI_BENCH_SRB srb;
+        IMSCSI_RW_REQUEST rw_request;
+        NTSTATUS status;
+
+        request = ImScsiCoreQueueRemove(&bench->Lu.Queue, &lowest_assumed_irql);
+
+        if (request == NULL)
+        {
+            if (__atomic_load_n(&bench->StopWorker, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+
+            ImScsiCoreWaitEvent(&bench->Lu.Queue.Event);
+            continue;
+        }
+
+        srb = CONTAINING_RECORD(request, IMSCSI_BENCH_SRB, RequestListEntry);
+
+        if (!ImScsiDecodeReadWrite(srb->Cdb, srb->DataTransferLength,
+            IMSCSI_BENCH_BLOCK_POWER, &rw_request))
+        {
+            ImScsiBenchCompleteSrb(srb, STATUS_INVALID_PARAMETER);
+            continue;
+        }
+
+        status = ImScsiCoreDispatchReadWrite(&bench->Lu, &rw_request,
+            srb->DataBuffer, &srb->DataTransferLength,
+            (srb->Cdb[1] & IMSCSI_BENCH_CDB_FUA) != 0, &lowest_assumed_irql);
+
+        ImScsiBenchCompleteSrb(srb, status);
+    }
+
+    return NULL;
+}
+
+///
+/// Starts Srb the way ScsiOpReadWrite does in driver: decodes and checks
+/// it, serves it from last I/O buffer if possible or else queues it for
+/// worker thread. Returns TRUE if served from last I/O buffer.
+///
+static
+BOOLEAN
+ImScsiBenchStartSrb(PIMSCSI_BENCH Bench, PIMSCSI_BENCH_SRB Srb)
+{
+    IMSCSI_RW_REQUEST rw_request;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if (!ImScsiDecodeReadWrite(Srb->Cdb, Srb->DataTransferLength,
+        IMSCSI_BENCH_BLOCK_POWER, &rw_request))
+    {
+        ImScsiBenchCompleteSrb(Srb, STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    switch (ImScsiCheckReadWrite(&rw_request, Bench->DiskSize,
+        IMSCSI_BENCH_BLOCK_POWER, Bench->ReadOnly))
+    {
+    case IMSCSI_RW_OK:
+        break;
+
+    default:
+        ImScsiBenchCompleteSrb(Srb, STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    if (ImScsiCoreReadLastIo(&Bench->Lu.LastIo, &rw_request,
+        Srb->DataTransferLength, IMSCSI_BENCH_BLOCK_POWER, Srb->DataBuffer,
+        &lowest_assumed_irql))
+    {
+        ImScsiBenchCompleteSrb(Srb, STATUS_SUCCESS);
+        return TRUE;
+    }
+
+    ImScsiCoreQueueInsert(&Bench->Lu.Queue, &Srb->RequestListEntry,
+        &lowest_assumed_irql);
+
+    return FALSE;
+}
+
+static
+BOOLEAN
+ImScsiBenchRecordLatency(PIMSCSI_BENCH_INITIATOR Initiator,
+    int OperationClass, LONGLONG Latency)
+{
+    if (Initiator->Count[OperationClass] == Initiator->Allocated[OperationClass])
+    {
+        ULONGLONG allocated = Initiator->Allocated[OperationClass] * 2 + 1024;
+        LONGLONG *latencies = (LONGLONG*)realloc(
+            Initiator->Latencies[OperationClass],
+            allocated * sizeof(LONGLONG));
+
+        if (latencies == NULL)
+        {
+            return FALSE;
+        }
+
+        Initiator->Latencies[OperationClass] = latencies;
+        Initiator->Allocated[OperationClass] = allocated;
+    }
+
+    Initiator->Latencies[OperationClass][Initiator->Count[OperationClass]++] =
+        Latency;
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+ImScsiBenchRecordRequest(PIMSCSI_BENCH_INITIATOR Initiator,
+    LONGLONG Started, LONGLONG Latency, LONGLONG StartSector)
+{
+    PIMSCSI_BENCH_TRACE recorded = &Initiator->Recorded;
+    PIMSCSI_BENCH_TRACE_REQUEST request;
+
+    if (recorded->Count == Initiator->RecordedAllocated)
+    {
+        ULONGLONG allocated = Initiator->RecordedAllocated * 2 + 1024;
+        PIMSCSI_BENCH_TRACE_REQUEST requests = (PIMSCSI_BENCH_TRACE_REQUEST)
+            realloc(recorded->Requests,
+                allocated * sizeof(IMSCSI_BENCH_TRACE_REQUEST));
+
+        if (requests == NULL)
+        {
+            return FALSE;
+        }
+
+        recorded->Requests = requests;
+        Initiator->RecordedAllocated = allocated;
+    }
+
+    request = &recorded->Requests[recorded->Count++];
+
+    request->Time = Started - Initiator->Bench->Started;
+    request->Latency = Latency;
+    request->StartSector = StartSector;
+    request->Request = (ULONGLONG)(uintptr_t)&Initiator->Srb;
+    request->DataTransferLength = Initiator->Srb.DataTransferLength;
+    request->Operation = Initiator->Srb.Cdb[0];
+    request->SrbStatus = Initiator->Srb.SrbStatus;
+
+    return TRUE;
+}
+
+static
+void *
+ImScsiBenchInitiatorThread(void *Context)
+{
+    PIMSCSI_BENCH_INITIATOR initiator = (PIMSCSI_BENCH_INITIATOR)Context;
+    PIMSCSI_BENCH bench = initiator->Bench;
+    PIMSCSI_BENCH_PARAMS params = &bench->Params;
+    PIMSCSI_BENCH_SRB srb = &initiator->Srb;
+    ULONGLONG transfers = (ULONGLONG)bench->DiskSize / params->TransferLength;
+    ULONG num_blocks = params->TransferLength >> IMSCSI_BENCH_BLOCK_POWER;
+
+    for (;;)
+    {
+        ULONGLONG number;
+        LONGLONG start_sector;
+        ULONG transfer_length = params->TransferLength;
+        BOOLEAN write;
+        LONGLONG started;
+        LONGLONG latency;
+
+        number = __atomic_fetch_add(&bench->Issued, 1, __ATOMIC_RELAXED);
+
+        if (bench->Deadline != 0)
+        {
+            if (ImScsiBenchNow() >= bench->Deadline)
+            {
+                break;
+            }
+        }
+        else if ((params->Replay == NULL) && (number >= params->Count))
+        {
+            break;
+        }
+
+        if (params->Replay != NULL)
+        {
+            PIMSCSI_BENCH_TRACE_REQUEST request;
+
+            if (number >= params->Replay->Count)
+            {
+                break;
+            }
+
+            request = &params->Replay->Requests[number];
+
+            start_sector = request->StartSector;
+            transfer_length = request->DataTransferLength;
+            num_blocks = transfer_length >> IMSCSI_BENCH_BLOCK_POWER;
+            write = ImScsiBenchIsWriteOperation(request->Operation);
+
+            if (write && bench->ReadOnly)
+            {
+                initiator->SkippedWrites++;
+                continue;
+            }
+
+            if (!params->AsFastAsPossible)
+            {
+                LONGLONG due = bench->Started + request->Time;
+
+                ImScsiBenchSleepUntil(due);
+
+                initiator->IssueDelay += ImScsiBenchNow() - due;
+            }
+        }
+        else
+        {
+            if (params->Sequential)
+            {
+                start_sector = (LONGLONG)(number % transfers) * num_blocks;
+            }
+            else
+            {
+                start_sector = (LONGLONG)(ImScsiBenchNextRandom(&initiator->Random) %
+                    transfers) * num_blocks;
+            }
+
+            write = (ImScsiBenchNextRandom(&initiator->Random) % 100) >=
+                params->ReadPercent;
+        }
+
+        ImScsiBenchBuildCdb(srb->Cdb, write, start_sector, num_blocks,
+            params->ForceUnitAccess);
+
+        srb->DataTransferLength = transfer_length;
+
+        if (write)
+        {
+            ImScsiBenchFillPattern((PUCHAR)srb->DataBuffer, start_sector,
+                transfer_length);
+        }
+
+        started = ImScsiBenchNow();
+
+        if (ImScsiBenchStartSrb(bench, srb))
+        {
+            initiator->CacheHits++;
+        }
+
+        ImScsiCoreWaitEvent(&srb->Completed);
+
+        latency = ImScsiBenchNow() - started;
+
+        if ((params->RecordPath != NULL) &&
+            !ImScsiBenchRecordRequest(initiator, started, latency, start_sector))
+        {
+            initiator->Errors++;
+        }
+
+        if ((srb->SrbStatus != SRB_STATUS_SUCCESS) ||
+            (srb->DataTransferLength != transfer_length))
+        {
+            initiator->Errors++;
+            continue;
+        }
+
+        if (params->Verify && !write &&
+            !ImScsiBenchCheckPattern((PUCHAR)srb->DataBuffer, start_sector,
+            transfer_length))
+        {
+            initiator->VerifyFailures++;
+        }
+
+        initiator->Bytes[write ? IMSCSI_BENCH_WRITE : IMSCSI_BENCH_READ] +=
+            transfer_length;
+
+        if (!ImScsiBenchRecordLatency(initiator,
+            write ? IMSCSI_BENCH_WRITE : IMSCSI_BENCH_READ, latency))
+        {
+            initiator->Errors++;
+        }
+    }
+
+    return NULL;
+}
+
+static
+int
+ImScsiBenchCompareLatencies(const void *First, const void *Second)
+{
+    LONGLONG first = *(const LONGLONG*)First;
+    LONGLONG second = *(const LONGLONG*)Second;
+
+    return (first > second) - (first < second);
+}
+
+static
+VOID
+ImScsiBenchPrintLatencies(const char *Name, LONGLONG *Latencies,
+    ULONGLONG Count, ULONGLONG Bytes, double Seconds)
+{
+    if (Count == 0)
+    {
+        return;
+    }
+
+    qsort(Latencies, Count, sizeof(*Latencies), ImScsiBenchCompareLatencies);
+
+    LONGLONG total = 0;
+
+    for (ULONGLONG i = 0; i < Count; i++)
+    {
+        total += Latencies[i];
+    }
+
+    printf("%-8s %10llu %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        Name,
+        (unsigned long long)Count,
+        Count / Seconds,
+        Bytes / Seconds / (1 << 20),
+        total / 1000.0 / Count,
+        Latencies[(Count - 1) * 50ULL / 100] / 1000.0,
+        Latencies[(Count - 1) * 90ULL / 100] / 1000.0,
+        Latencies[(Count - 1) * 99ULL / 100] / 1000.0,
+        Latencies[Count - 1] / 1000.0);
+}
+
+///
+/// Opens a back end from a specification on command line, see usage.
+///
+static
+BOOLEAN
+ImScsiBenchOpenBackendSpec(const char *Spec, LONGLONG Size, BOOLEAN Direct,
+    PIMSCSI_BENCH_BACKEND Backend)
+{
+    IMSCSI_BENCH_BACKEND served;
+    BOOLEAN proxy = FALSE;
+
+    if (strncmp(Spec, "proxy:", 6) == 0)
+    {
+        char host[256];
+        const char *port = strrchr(Spec + 6, ':');
+
+        if ((port == NULL) || ((size_t)(port - (Spec + 6)) >= sizeof(host)))
+        {
+            fprintf(stderr, "Expected proxy:HOST:PORT, got '%s'.\n", Spec);
+            return FALSE;
+        }
+
+        memcpy(host, Spec + 6, port - (Spec + 6));
+        host[port - (Spec + 6)] = 0;
+
+        return ImScsiBenchConnectProxy(host, port + 1, Backend);
+    }
+
+    if (strncmp(Spec, "proxy-", 6) == 0)
+    {
+        proxy = TRUE;
+        Spec += 6;
+    }
+
+    if (strcmp(Spec, "ram") == 0)
+    {
+        if (!ImScsiBenchOpenRam(Size != 0 ? Size : IMSCSI_BENCH_DEFAULT_SIZE,
+            &served))
+        {
+            return FALSE;
+        }
+    }
+    else if (strncmp(Spec, "file:", 5) == 0)
+    {
+        if (!ImScsiBenchOpenFile(Spec + 5, Size, Direct, &served))
+        {
+            return FALSE;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Unknown back end '%s'.\n", Spec);
+        return FALSE;
+    }
+
+    if (!proxy)
+    {
+        *Backend = served;
+        return TRUE;
+    }
+
+    return ImScsiBenchOpenLoopbackProxy(&served, Backend);
+}
+
+static
+int
+ImScsiBenchRun(PIMSCSI_BENCH_PARAMS Params, PIMSCSI_BENCH_BACKEND Backend,
+    LONGLONG WriteBackLimit)
+{
+    IMSCSI_BENCH bench;
+    PIMSCSI_BENCH_INITIATOR initiators;
+    pthread_t worker;
+    LONGLONG started;
+    double seconds;
+    ULONGLONG errors = 0;
+    ULONGLONG verify_failures = 0;
+    ULONGLONG cache_hits = 0;
+    ULONGLONG skipped_writes = 0;
+    LONGLONG issue_delay = 0;
+    LONGLONG *latencies[IMSCSI_BENCH_CLASSES + 1] = { NULL };
+    ULONGLONG count[IMSCSI_BENCH_CLASSES + 1] = { 0 };
+    ULONGLONG bytes[IMSCSI_BENCH_CLASSES + 1] = { 0 };
+    ULONG max_transfer_length = Params->TransferLength;
+    IMSCSI_BENCH_TRACE recorded = { 0 };
+    NTSTATUS status;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if (Params->Replay != NULL)
+    {
+        max_transfer_length = Params->Replay->MaxTransferLength;
+
+        if (Params->Replay->EndOffset > Backend->Size)
+        {
+            fprintf(stderr, "Trace has requests beyond disk size %lld, "
+                "select a larger disk with -s.\n", (long long)Backend->Size);
+            return IMSCSI_BENCH_ERROR_BAD_SYNTAX;
+        }
+    }
+    else if (Backend->Size < (LONGLONG)Params->TransferLength)
+    {
+        fprintf(stderr, "Disk size %lld is smaller than transfer length.\n",
+            (long long)Backend->Size);
+        return IMSCSI_BENCH_ERROR_BAD_SYNTAX;
+    }
+
+    // Same limits as reported in Block Limits VPD page by driver.
+    if (Backend->QueryLimits != NULL)
+    {
+        IMDPROXY_LIMITS_RESP limits;
+
+        status = Backend->QueryLimits(Backend->Context, &limits);
+
+        if (!NT_SUCCESS(status))
+        {
+            fprintf(stderr, "Back end limits query failed (%#x).\n",
+                (unsigned)status);
+            return IMSCSI_BENCH_ERROR_IO;
+        }
+
+        printf("Granularity %llu, optimal transfer length %llu, maximum "
+            "transfer length %llu bytes\n",
+            (unsigned long long)limits.optimal_granularity,
+            (unsigned long long)limits.optimal_transfer_length,
+            (unsigned long long)limits.max_transfer_length);
+
+        if ((limits.max_transfer_length != 0) &&
+            (max_transfer_length > limits.max_transfer_length))
+        {
+            fprintf(stderr, "Transfer length is larger than maximum transfer "
+                "length of back end.\n");
+            return IMSCSI_BENCH_ERROR_BAD_SYNTAX;
+        }
+    }
+
+    memset(&bench, 0, sizeof(bench));
+
+    bench.Params = *Params;
+    bench.DiskSize = Backend->Size;
+    bench.ReadOnly = Backend->ReadOnly;
+
+    ImScsiCoreInitializeLU(&bench.Lu, Backend->Ops, Backend->Context);
+
+    if (WriteBackLimit != 0)
+    {
+        bench.Lu.WriteBack = TRUE;
+        bench.Lu.WriteBackLimit = WriteBackLimit;
+    }
+
+    initiators = (PIMSCSI_BENCH_INITIATOR)calloc(Params->Depth,
+        sizeof(IMSCSI_BENCH_INITIATOR));
+
+    if (initiators == NULL)
+    {
+        return IMSCSI_BENCH_ERROR_FATAL;
+    }
+
+    for (ULONG i = 0; i < Params->Depth; i++)
+    {
+        initiators[i].Bench = &bench;
+        initiators[i].Random = 0x2545F4914F6CDD1DULL * (i + 1);
+        initiators[i].Srb.DataBuffer =
+            ImScsiCoreAllocate(max_transfer_length);
+
+        if (initiators[i].Srb.DataBuffer == NULL)
+        {
+            fprintf(stderr, "Cannot allocate transfer buffers.\n");
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+
+        ImScsiCoreInitializeEvent(&initiators[i].Srb.Completed);
+    }
+
+    if (pthread_create(&worker, NULL, ImScsiBenchWorkerThread, &bench) != 0)
+    {
+        perror("pthread_create");
+        return IMSCSI_BENCH_ERROR_FATAL;
+    }
+
+    started = ImScsiBenchNow();
+
+    bench.Started = started;
+
+    if (Params->Seconds != 0)
+    {
+        bench.Deadline = started + Params->Seconds * 1000000000LL;
+    }
+
+    for (ULONG i = 0; i < Params->Depth; i++)
+    {
+        if (pthread_create(&initiators[i].Thread, NULL,
+            ImScsiBenchInitiatorThread, &initiators[i]) != 0)
+        {
+            perror("pthread_create");
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+    }
+
+    for (ULONG i = 0; i < Params->Depth; i++)
+    {
+        pthread_join(initiators[i].Thread, NULL);
+    }
+
+    seconds = (ImScsiBenchNow() - started) / 1e9;
+
+    __atomic_store_n(&bench.StopWorker, TRUE, __ATOMIC_RELEASE);
+    ImScsiCoreSetEvent(&bench.Lu.Queue.Event);
+    pthread_join(worker, NULL);
+
+    status = ImScsiCoreFlush(&bench.Lu);
+
+    if (!NT_SUCCESS(status))
+    {
+        fprintf(stderr, "Flush failed: %#x\n", (unsigned)status);
+        errors++;
+    }
+
+    ImScsiCoreDropLastIo(&bench.Lu.LastIo, &lowest_assumed_irql);
+
+    // Merge per initiator results, last class is total.
+    for (ULONG i = 0; i < Params->Depth; i++)
+    {
+        errors += initiators[i].Errors;
+        verify_failures += initiators[i].VerifyFailures;
+        cache_hits += initiators[i].CacheHits;
+        skipped_writes += initiators[i].SkippedWrites;
+        issue_delay += initiators[i].IssueDelay;
+        recorded.Count += initiators[i].Recorded.Count;
+
+        for (int c = 0; c < IMSCSI_BENCH_CLASSES; c++)
+        {
+            count[c] += initiators[i].Count[c];
+            bytes[c] += initiators[i].Bytes[c];
+        }
+    }
+
+    count[IMSCSI_BENCH_CLASSES] =
+        count[IMSCSI_BENCH_READ] + count[IMSCSI_BENCH_WRITE];
+    bytes[IMSCSI_BENCH_CLASSES] =
+        bytes[IMSCSI_BENCH_READ] + bytes[IMSCSI_BENCH_WRITE];
+
+    if (Params->RecordPath != NULL)
+    {
+        recorded.Requests = (PIMSCSI_BENCH_TRACE_REQUEST)malloc(
+            (recorded.Count + 1) * sizeof(IMSCSI_BENCH_TRACE_REQUEST));
+
+        if (recorded.Requests == NULL)
+        {
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+
+        recorded.Count = 0;
+
+        for (ULONG i = 0; i < Params->Depth; i++)
+        {
+            memcpy(recorded.Requests + recorded.Count,
+                initiators[i].Recorded.Requests,
+                initiators[i].Recorded.Count * sizeof(IMSCSI_BENCH_TRACE_REQUEST));
+            recorded.Count += initiators[i].Recorded.Count;
+
+            ImScsiBenchFreeTrace(&initiators[i].Recorded);
+        }
+
+        if (!ImScsiBenchSaveTrace(Params->RecordPath, &recorded))
+        {
+            errors++;
+        }
+
+        ImScsiBenchFreeTrace(&recorded);
+    }
+
+    for (int c = 0; c <= IMSCSI_BENCH_CLASSES; c++)
+    {
+        latencies[c] = (LONGLONG*)malloc((count[c] + 1) * sizeof(LONGLONG));
+
+        if (latencies[c] == NULL)
+        {
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+
+        count[c] = 0;
+    }
+
+    for (ULONG i = 0; i < Params->Depth; i++)
+    {
+        for (int c = 0; c < IMSCSI_BENCH_CLASSES; c++)
+        {
+            ULONGLONG n = initiators[i].Count[c];
+
+            memcpy(latencies[c] + count[c], initiators[i].Latencies[c],
+                n * sizeof(LONGLONG));
+            count[c] += n;
+
+            memcpy(latencies[IMSCSI_BENCH_CLASSES] +
+                count[IMSCSI_BENCH_CLASSES], initiators[i].Latencies[c],
+                n * sizeof(LONGLONG));
+            count[IMSCSI_BENCH_CLASSES] += n;
+
+            free(initiators[i].Latencies[c]);
+        }
+
+        ImScsiCoreFree(initiators[i].Srb.DataBuffer);
+    }
+
+    free(initiators);
+
+    if (Params->Replay != NULL)
+    {
+        printf("Disk size %lld bytes, replay of %llu requests, %s, depth "
+            "%u%s%s\n",
+            (long long)Backend->Size,
+            (unsigned long long)Params->Replay->Count,
+            Params->AsFastAsPossible ? "as fast as possible" : "original timing",
+            Params->Depth,
+            WriteBackLimit != 0 ? ", write-back" : "",
+            Params->ForceUnitAccess ? ", FUA" : "");
+    }
+    else
+    {
+        printf("Disk size %lld bytes, %s, transfer length %u, depth %u, "
+            "%u%% reads%s%s\n",
+            (long long)Backend->Size,
+            Params->Sequential ? "sequential" : "random",
+            Params->TransferLength, Params->Depth, Params->ReadPercent,
+            WriteBackLimit != 0 ? ", write-back" : "",
+            Params->ForceUnitAccess ? ", FUA" : "");
+    }
+
+    printf("%.3f s, %llu errors, %llu verify failures, %llu last I/O cache "
+        "hits\n",
+        seconds,
+        (unsigned long long)errors,
+        (unsigned long long)verify_failures,
+        (unsigned long long)cache_hits);
+
+    if (Params->Replay != NULL)
+    {
+        if (skipped_writes != 0)
+        {
+            printf("%llu writes skipped on read-only disk.\n",
+                (unsigned long long)skipped_writes);
+        }
+
+        if (!Params->AsFastAsPossible && (count[IMSCSI_BENCH_CLASSES] > 0))
+        {
+            printf("Requests issued on average %.1f us after original time.\n",
+                issue_delay / 1000.0 / count[IMSCSI_BENCH_CLASSES]);
+        }
+    }
+
+    puts("");
+
+    printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+        "", "Requests", "IOPS", "MB/s", "Mean us", "50% us", "90% us",
+        "99% us", "Max us");
+
+    ImScsiBenchPrintLatencies("Read", latencies[IMSCSI_BENCH_READ],
+        count[IMSCSI_BENCH_READ], bytes[IMSCSI_BENCH_READ], seconds);
+    ImScsiBenchPrintLatencies("Write", latencies[IMSCSI_BENCH_WRITE],
+        count[IMSCSI_BENCH_WRITE], bytes[IMSCSI_BENCH_WRITE], seconds);
+    ImScsiBenchPrintLatencies("Total", latencies[IMSCSI_BENCH_CLASSES],
+        count[IMSCSI_BENCH_CLASSES], bytes[IMSCSI_BENCH_CLASSES], seconds);
+
+    for (int c = 0; c <= IMSCSI_BENCH_CLASSES; c++)
+    {
+        free(latencies[c]);
+    }
+
+    if (verify_failures != 0)
+    {
+        return IMSCSI_BENCH_ERROR_VERIFY_FAILED;
+    }
+
+    if (errors != 0)
+    {
+        return IMSCSI_BENCH_ERROR_IO;
+    }
+
+    return IMSCSI_BENCH_SUCCESS;
+}
+
+///
+/// Serves Backend to proxy clients on a TCP port, one connection at a
+/// time, for example to a virtual disk created with proxy type TCP/IP.
+///
+static
+int
+ImScsiBenchServe(const char *Port, PIMSCSI_BENCH_BACKEND Backend)
+{
+    struct sockaddr_in6 address;
+    int listener;
+    int on = 1;
+    int off = 0;
+
+    listener = socket(AF_INET6, SOCK_STREAM, 0);
+
+    if (listener < 0)
+    {
+        perror("socket");
+        return IMSCSI_BENCH_ERROR_FATAL;
+    }
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons((unsigned short)atoi(Port));
+
+    if ((bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) ||
+        (listen(listener, 1) != 0))
+    {
+        perror(Port);
+        close(listener);
+        return IMSCSI_BENCH_ERROR_FATAL;
+    }
+
+    for (;;)
+    {
+        int connection = accept(listener, NULL, NULL);
+
+        if (connection < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("accept");
+            close(listener);
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        if (!ImScsiBenchServeProxy(connection, Backend))
+        {
+            fprintf(stderr, "Proxy connection closed after error.\n");
+        }
+
+        close(connection);
+    }
+}
+
+static
+int
+ImScsiBenchSyntaxHelp()
+{
+    fputs(
+        "Syntax:\n"
+        "iobench [options] BACKEND\n"
+        "    Sends synthetic read and write requests through the request path\n"
+        "    of the driver and reports IOPS, throughput and latency.\n"
+        "\n"
+        "iobench --replay TRACEFILE [-u DEVICE] [--sector-size SIZE] [-F]\n"
+        "        [options] BACKEND\n"
+        "    Sends read and write requests to one virtual disk in a trace file\n"
+        "    saved by aim_ll --trace or by --record, at their original times\n"
+        "    unless -F is specified. Writes store the same data as synthetic\n"
+        "    writes and are skipped if BACKEND is read-only. -u selects the\n"
+        "    virtual disk, in hex, if the trace has more than one.\n"
+        "    --sector-size is block size of traced disk, default 512. Default\n"
+        "    depth is 32.\n"
+        "\n"
+        "iobench --serve PORT [-s SIZE] [-D] BACKEND\n"
+        "    Serves BACKEND as a proxy provider on TCP port PORT.\n"
+        "\n"
+        "BACKEND is one of:\n"
+        "ram                    Zero filled memory.\n"
+        "file:PATH              Image file, created or extended to -s SIZE.\n"
+        "proxy-ram              Memory back end through a proxy connection to\n"
+        "proxy-file:PATH        or image file back end through a proxy\n"
+        "                       connection to a provider thread in process.\n"
+        "proxy:HOST:PORT        Proxy service over TCP/IP.\n"
+        "\n"
+        "Options:\n"
+        "-p random|sequential   Access pattern. Default random.\n"
+        "-b LENGTH              Transfer length in bytes, a multiple of 512.\n"
+        "                       Default 4K.\n"
+        "-q DEPTH               Number of requests in flight. Default 1.\n"
+        "-r PERCENT             Percentage of reads. Default 70.\n"
+        "-n COUNT               Number of requests. Default 10000.\n"
+        "-t SECONDS             Run for a time instead of a number of requests.\n"
+        "-s SIZE                Disk size for ram and file back ends.\n"
+        "                       Default 64M for ram, file size for files.\n"
+        "-w LIMIT               Write-back, flush each LIMIT bytes written.\n"
+        "-f                     Set FUA on writes.\n"
+        "-D                     Open image files with O_DIRECT.\n"
+        "-c PATH                Persistent cache file in front of BACKEND, which\n"
+        "                       must report image identity.\n"
+        "-C SIZE                Cache file data size. Default 64M.\n"
+        "-P clock|fifo          Cache slot reuse policy. Default clock.\n"
+        "-V                     Verify data read. Expects a disk that is only\n"
+        "                       written by iobench -V.\n"
+        "-F                     Replay as fast as possible, with at most DEPTH\n"
+        "                       requests in flight.\n"
+        "--record TRACEFILE     Save requests sent in a trace file, for\n"
+        "                       --replay and aim_ll --trace-report.\n"
+        "\n"
+        "SIZE and LENGTH accept K, M, G and T suffixes.\n",
+        stderr);
+
+    return IMSCSI_BENCH_ERROR_BAD_SYNTAX;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        { "serve", required_argument, NULL, 'S' },
+        { "replay", required_argument, NULL, 'R' },
+        { "record", required_argument, NULL, 'T' },
+        { "sector-size", required_argument, NULL, 'Z' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    IMSCSI_BENCH_PARAMS params;
+    IMSCSI_BENCH_BACKEND backend;
+    IMSCSI_BENCH_TRACE replay = { 0 };
+    const char *serve_port = NULL;
+    const char *replay_path = NULL;
+    ULONG device_number = IMSCSI_BENCH_ANY_DEVICE;
+    ULONG bytes_per_sector = IMSCSI_BENCH_BLOCK_SIZE;
+    BOOLEAN depth_set = FALSE;
+    const char *cache_path = NULL;
+    LONGLONG cache_size = 64LL << 20;
+    ULONG cache_policy = IMSCSI_CACHE_CORE_POLICY_CLOCK;
+    LONGLONG size = 0;
+    LONGLONG write_back_limit = 0;
+    LONGLONG value;
+    BOOLEAN direct = FALSE;
+    int option;
+    int result;
+
+    memset(&params, 0, sizeof(params));
+
+    params.TransferLength = 4096;
+    params.Depth = 1;
+    params.ReadPercent = 70;
+    params.Count = 10000;
+
+    while ((option = getopt_long(argc, argv, "p:b:q:r:n:t:s:w:fDVFu:c:C:P:h",
+        long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'p':
+            if (strcmp(optarg, "random") == 0)
+            {
+                params.Sequential = FALSE;
+            }
+            else if (strcmp(optarg, "sequential") == 0)
+            {
+                params.Sequential = TRUE;
+            }
+            else
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'b':
+            value = ImScsiBenchParseSize(optarg);
+            if ((value <= 0) || (value > 0x7FFFFFFF) ||
+                ((value & (IMSCSI_BENCH_BLOCK_SIZE - 1)) != 0))
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            params.TransferLength = (ULONG)value;
+            break;
+
+        case 'q':
+            params.Depth = (ULONG)strtoul(optarg, NULL, 0);
+            if ((params.Depth == 0) || (params.Depth > 1024))
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            depth_set = TRUE;
+            break;
+
+        case 'r':
+            params.ReadPercent = (ULONG)strtoul(optarg, NULL, 0);
+            if (params.ReadPercent > 100)
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'n':
+            params.Count = strtoull(optarg, NULL, 0);
+            break;
+
+        case 't':
+            params.Seconds = (ULONG)strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            size = ImScsiBenchParseSize(optarg);
+            if (size <= 0)
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'w':
+            write_back_limit = ImScsiBenchParseSize(optarg);
+            if (write_back_limit <= 0)
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'f':
+            params.ForceUnitAccess = TRUE;
+            break;
+
+        case 'D':
+            direct = TRUE;
+            break;
+
+        case 'V':
+            params.Verify = TRUE;
+            break;
+
+        case 'F':
+            params.AsFastAsPossible = TRUE;
+            break;
+
+        case 'u':
+            device_number = (ULONG)strtoul(optarg, NULL, 16);
+            if (device_number >= IMSCSI_BENCH_ANY_DEVICE)
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'Z':
+            bytes_per_sector = (ULONG)strtoul(optarg, NULL, 0);
+            if ((bytes_per_sector == 0) ||
+                ((bytes_per_sector & (bytes_per_sector - 1)) != 0))
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'R':
+            replay_path = optarg;
+            break;
+
+        case 'T':
+            params.RecordPath = optarg;
+            break;
+
+        case 'c':
+            cache_path = optarg;
+            break;
+
+        case 'C':
+            cache_size = ImScsiBenchParseSize(optarg);
+            if (cache_size <= 0)
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'P':
+            if (strcmp(optarg, "clock") == 0)
+            {
+                cache_policy = IMSCSI_CACHE_CORE_POLICY_CLOCK;
+            }
+            else if (strcmp(optarg, "fifo") == 0)
+            {
+                cache_policy = IMSCSI_CACHE_CORE_POLICY_FIFO;
+            }
+            else
+            {
+                return ImScsiBenchSyntaxHelp();
+            }
+            break;
+
+        case 'S':
+            serve_port = optarg;
+            break;
+
+        default:
+            return ImScsiBenchSyntaxHelp();
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        return ImScsiBenchSyntaxHelp();
+    }
+
+    if (replay_path != NULL)
+    {
+        if (!ImScsiBenchLoadTrace(replay_path, device_number,
+            bytes_per_sector, &replay))
+        {
+            return IMSCSI_BENCH_ERROR_FATAL;
+        }
+
+        if (replay.Count == 0)
+        {
+            puts("No read or write requests to replay.");
+            ImScsiBenchFreeTrace(&replay);
+            return IMSCSI_BENCH_SUCCESS;
+        }
+
+        if (replay.Skipped != 0)
+        {
+            fprintf(stderr, "%llu requests not aligned to 512 byte blocks "
+                "skipped.\n", (unsigned long long)replay.Skipped);
+        }
+
+        params.Replay = &replay;
+
+        if (!depth_set)
+        {
+            params.Depth = IMSCSI_BENCH_DEFAULT_REPLAY_DEPTH;
+        }
+    }
+
+    if (!ImScsiBenchOpenBackendSpec(argv[optind], size, direct, &backend))
+    {
+        ImScsiBenchFreeTrace(&replay);
+        return IMSCSI_BENCH_ERROR_FATAL;
+    }
+
+    // Same as in driver, disk is used without cache if cache cannot be
+    // opened.
+    if ((cache_path != NULL) &&
+        !ImScsiBenchOpenCache(cache_path, cache_size, cache_policy, &backend))
+    {
+        fprintf(stderr, "Continuing without cache file.\n");
+    }
+
+    if (serve_port != NULL)
+    {
+        result = ImScsiBenchServe(serve_port, &backend);
+    }
+    else
+    {
+        result = ImScsiBenchRun(&params, &backend, write_back_limit);
+    }
+
+    ImScsiBenchCloseBackend(&backend);
+    ImScsiBenchFreeTrace(&replay);
+
+    return result;
+}
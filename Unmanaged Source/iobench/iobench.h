@@ -0,0 +1,187 @@
+/// iobench.h
+/// Back ends and proxy provider for the user mode build of the request path
+/// in phdskmnt/iocore.cpp.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _IOBENCH_H_
+#define _IOBENCH_H_
+
+#include "iocore.h"
+#include "cachecore.h"
+#include "proxyext.h"
+
+///
+/// Opened back end. Size is virtual disk size in bytes. Close frees
+/// Context. QueryIdentity is NULL if back end cannot identify its image,
+/// same as a proxy service without IMDPROXY_FLAG_SUPPORTS_IDENTITY.
+/// QueryLimits is NULL if back end has no transfer size preferences.
+///
+typedef struct _IMSCSI_BENCH_BACKEND
+{
+    const IMSCSI_CORE_BACKEND  *Ops;
+    PVOID                       Context;
+    VOID                      (*Close)(PVOID Context);
+    NTSTATUS                  (*QueryIdentity)(PVOID Context, PIMDPROXY_IDENTITY_RESP Identity);
+    NTSTATUS                  (*QueryLimits)(PVOID Context, PIMDPROXY_LIMITS_RESP Limits);
+    LONGLONG                    Size;
+    BOOLEAN                     ReadOnly;
+} IMSCSI_BENCH_BACKEND, *PIMSCSI_BENCH_BACKEND;
+
+///
+/// Image file. File is extended to Size if it is smaller. If Size is zero,
+/// current size of file is used. Direct selects O_DIRECT.
+///
+BOOLEAN
+ImScsiBenchOpenFile(
+    const char                 *Path,
+    LONGLONG                    Size,
+    BOOLEAN                     Direct,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Zero filled memory, same as a VM disk in driver.
+///
+BOOLEAN
+ImScsiBenchOpenRam(
+    LONGLONG                    Size,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Proxy client on a connected stream socket. Takes ownership of Socket.
+///
+BOOLEAN
+ImScsiBenchOpenProxy(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Proxy client connected over TCP to a proxy service, such as another
+/// instance of iobench started with --serve, or devio.
+///
+BOOLEAN
+ImScsiBenchConnectProxy(
+    const char                 *Host,
+    const char                 *Port,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Persistent cache file at Path in front of Backend, same as proxy cache
+/// files in driver. CacheSize is maximum size of cached data in bytes.
+/// Backend must report image identity. Backend is closed with cache, or
+/// left open on failure.
+///
+BOOLEAN
+ImScsiBenchOpenCache(
+    const char                 *Path,
+    LONGLONG                    CacheSize,
+    ULONG                       Policy,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+VOID
+ImScsiBenchCloseBackend(
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Serves proxy requests on Socket from Backend until client closes
+/// connection or sends IMDPROXY_REQ_CLOSE. Returns FALSE on protocol or
+/// socket errors.
+///
+BOOLEAN
+ImScsiBenchServeProxy(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Starts a thread that serves Backend on one end of a socket pair and
+/// opens a proxy client on the other end, so that proxy back ends can be
+/// measured without a separate provider process. Served is closed with
+/// Backend, or on failure.
+///
+BOOLEAN
+ImScsiBenchOpenLoopbackProxy(
+    PIMSCSI_BENCH_BACKEND       Served,
+    PIMSCSI_BENCH_BACKEND       Backend);
+
+///
+/// Read or write request in an SRB trace file. Time and Latency are in
+/// nanoseconds, Time from first request in trace. Latency and SrbStatus
+/// are only saved, loaded requests have zero there.
+///
+typedef struct _IMSCSI_BENCH_TRACE_REQUEST
+{
+    LONGLONG                    Time;
+    LONGLONG                    Latency;
+    LONGLONG                    StartSector;        // 512 byte blocks.
+    ULONGLONG                   Request;            // SRB address, same for all records of a request.
+    ULONG                       DataTransferLength;
+    UCHAR                       Operation;          // Operation code from CDB.
+    UCHAR                       SrbStatus;
+} IMSCSI_BENCH_TRACE_REQUEST, *PIMSCSI_BENCH_TRACE_REQUEST;
+
+typedef struct _IMSCSI_BENCH_TRACE
+{
+    PIMSCSI_BENCH_TRACE_REQUEST Requests;
+    ULONGLONG                   Count;
+    ULONGLONG                   Skipped;            // Not aligned to 512 byte blocks.
+    ULONG                       MaxTransferLength;
+    LONGLONG                    EndOffset;          // End of highest block addressed.
+    ULONG                       DeviceNumber;
+} IMSCSI_BENCH_TRACE, *PIMSCSI_BENCH_TRACE;
+
+/// Same value as IMSCSI_AUTO_DEVICE_NUMBER.
+#define IMSCSI_BENCH_ANY_DEVICE     0x00FFFFFFUL
+
+///
+/// Loads read and write requests to one virtual disk from a trace file
+/// saved by aim_ll --trace or by iobench --record, in order of arrival.
+/// DeviceNumber is IMSCSI_BENCH_ANY_DEVICE to accept traces with one
+/// virtual disk only. BytesPerSector is block size of traced disk.
+///
+BOOLEAN
+ImScsiBenchLoadTrace(
+    const char                 *Path,
+    ULONG                       DeviceNumber,
+    ULONG                       BytesPerSector,
+    PIMSCSI_BENCH_TRACE         Trace);
+
+///
+/// Saves requests in Trace, which need not be sorted, as start and
+/// completion records of a trace file.
+///
+BOOLEAN
+ImScsiBenchSaveTrace(
+    const char                 *Path,
+    PIMSCSI_BENCH_TRACE         Trace);
+
+VOID
+ImScsiBenchFreeTrace(
+    PIMSCSI_BENCH_TRACE         Trace);
+
+BOOLEAN
+ImScsiBenchIsWriteOperation(
+    UCHAR                       Operation);
+
+///
+/// Exact send and receive on stream sockets.
+///
+BOOLEAN
+ImScsiBenchSend(
+    int                         Socket,
+    const void                 *Buffer,
+    size_t                      Length);
+
+BOOLEAN
+ImScsiBenchReceive(
+    int                         Socket,
+    void                       *Buffer,
+    size_t                      Length);
+
+#endif // _IOBENCH_H_
@@ -0,0 +1,430 @@
+/// proxyclient.cpp
+/// Proxy back end for the user mode build of the request path. Speaks the
+/// same stream protocol as the TCP/IP connection type in proxy.cpp.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "iobench.h"
+
+typedef struct _IMSCSI_BENCH_PROXY
+{
+    int                 Socket;
+    pthread_mutex_t     Lock;               // One request at a time on connection.
+    ULONGLONG           Flags;              // From IMDPROXY_INFO_RESP.
+    pthread_t           ServerThread;       // Loopback provider, see ImScsiBenchOpenLoopbackProxy.
+    BOOLEAN             HasServerThread;
+} IMSCSI_BENCH_PROXY, *PIMSCSI_BENCH_PROXY;
+
+typedef struct _IMSCSI_BENCH_LOOPBACK
+{
+    int                 Socket;
+    IMSCSI_BENCH_BACKEND Served;
+} IMSCSI_BENCH_LOOPBACK, *PIMSCSI_BENCH_LOOPBACK;
+
+BOOLEAN
+ImScsiBenchSend(
+    int                         Socket,
+    const void                 *Buffer,
+    size_t                      Length)
+{
+    const char *ptr = (const char*)Buffer;
+
+    while (Length > 0)
+    {
+        ssize_t result = send(Socket, ptr, Length, MSG_NOSIGNAL);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        ptr += result;
+        Length -= (size_t)result;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+ImScsiBenchReceive(
+    int                         Socket,
+    void                       *Buffer,
+    size_t                      Length)
+{
+    char *ptr = (char*)Buffer;
+
+    while (Length > 0)
+    {
+        ssize_t result = recv(Socket, ptr, Length, MSG_WAITALL);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return FALSE;
+        }
+
+        if (result == 0)
+        {
+            return FALSE;
+        }
+
+        ptr += result;
+        Length -= (size_t)result;
+    }
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+ImScsiBenchProxyRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_PROXY proxy = (PIMSCSI_BENCH_PROXY)Context;
+    IMDPROXY_READ_REQ read_req;
+    IMDPROXY_READ_RESP read_resp;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    read_req.request_code = IMDPROXY_REQ_READ;
+    read_req.offset = (ULONGLONG)Offset;
+    read_req.length = *Length;
+
+    pthread_mutex_lock(&proxy->Lock);
+
+    if (!ImScsiBenchSend(proxy->Socket, &read_req, sizeof(read_req)) ||
+        !ImScsiBenchReceive(proxy->Socket, &read_resp, sizeof(read_resp)))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+    else if (read_resp.errorno != 0)
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+    else if (read_resp.length > *Length)
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+    else if (!ImScsiBenchReceive(proxy->Socket, Buffer,
+        (size_t)read_resp.length))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    pthread_mutex_unlock(&proxy->Lock);
+
+    if (!NT_SUCCESS(status))
+    {
+        *Length = 0;
+        return status;
+    }
+
+    // Same as STATUS_END_OF_FILE in ImScsiReadDevice, rest is zeroed.
+    if (read_resp.length < *Length)
+    {
+        memset((PUCHAR)Buffer + read_resp.length, 0,
+            *Length - (size_t)read_resp.length);
+    }
+
+    return status;
+}
+
+static
+NTSTATUS
+ImScsiBenchProxyWrite(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_BENCH_PROXY proxy = (PIMSCSI_BENCH_PROXY)Context;
+    IMDPROXY_WRITE_REQ write_req;
+    IMDPROXY_WRITE_RESP write_resp;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    write_req.request_code = IMDPROXY_REQ_WRITE;
+    write_req.offset = (ULONGLONG)Offset;
+    write_req.length = *Length;
+
+    pthread_mutex_lock(&proxy->Lock);
+
+    if (!ImScsiBenchSend(proxy->Socket, &write_req, sizeof(write_req)) ||
+        !ImScsiBenchSend(proxy->Socket, Buffer, *Length) ||
+        !ImScsiBenchReceive(proxy->Socket, &write_resp, sizeof(write_resp)))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+    else if ((write_resp.errorno != 0) || (write_resp.length != *Length))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    pthread_mutex_unlock(&proxy->Lock);
+
+    if (!NT_SUCCESS(status))
+    {
+        *Length = 0;
+    }
+
+    return status;
+}
+
+static
+VOID
+ImScsiBenchProxyClose(PVOID Context)
+{
+    PIMSCSI_BENCH_PROXY proxy = (PIMSCSI_BENCH_PROXY)Context;
+    ULONGLONG close_req = IMDPROXY_REQ_CLOSE;
+
+    ImScsiBenchSend(proxy->Socket, &close_req, sizeof(close_req));
+
+    shutdown(proxy->Socket, SHUT_RDWR);
+
+    if (proxy->HasServerThread)
+    {
+        pthread_join(proxy->ServerThread, NULL);
+    }
+
+    close(proxy->Socket);
+    pthread_mutex_destroy(&proxy->Lock);
+    free(proxy);
+}
+
+static
+NTSTATUS
+ImScsiBenchProxyQueryIdentity(PVOID Context, PIMDPROXY_IDENTITY_RESP Identity)
+{
+    PIMSCSI_BENCH_PROXY proxy = (PIMSCSI_BENCH_PROXY)Context;
+    ULONGLONG identity_req = IMDPROXY_REQ_IDENTITY;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    pthread_mutex_lock(&proxy->Lock);
+
+    if (!ImScsiBenchSend(proxy->Socket, &identity_req, sizeof(identity_req)) ||
+        !ImScsiBenchReceive(proxy->Socket, Identity, sizeof(*Identity)) ||
+        (Identity->errorno != 0))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    pthread_mutex_unlock(&proxy->Lock);
+
+    return status;
+}
+
+static
+NTSTATUS
+ImScsiBenchProxyQueryLimits(PVOID Context, PIMDPROXY_LIMITS_RESP Limits)
+{
+    PIMSCSI_BENCH_PROXY proxy = (PIMSCSI_BENCH_PROXY)Context;
+    ULONGLONG limits_req = IMDPROXY_REQ_LIMITS;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    pthread_mutex_lock(&proxy->Lock);
+
+    if (!ImScsiBenchSend(proxy->Socket, &limits_req, sizeof(limits_req)) ||
+        !ImScsiBenchReceive(proxy->Socket, Limits, sizeof(*Limits)) ||
+        (Limits->errorno != 0))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    pthread_mutex_unlock(&proxy->Lock);
+
+    return status;
+}
+
+static const IMSCSI_CORE_BACKEND ImScsiBenchProxyOps = {
+    ImScsiBenchProxyRead,
+    ImScsiBenchProxyWrite,
+    NULL
+};
+
+BOOLEAN
+ImScsiBenchOpenProxy(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PIMSCSI_BENCH_PROXY proxy;
+    ULONGLONG info_req = IMDPROXY_REQ_INFO;
+    IMDPROXY_INFO_RESP info_resp;
+
+    if (!ImScsiBenchSend(Socket, &info_req, sizeof(info_req)) ||
+        !ImScsiBenchReceive(Socket, &info_resp, sizeof(info_resp)))
+    {
+        fprintf(stderr, "Proxy information request failed.\n");
+        close(Socket);
+        return FALSE;
+    }
+
+    proxy = (PIMSCSI_BENCH_PROXY)calloc(1, sizeof(IMSCSI_BENCH_PROXY));
+
+    if (proxy == NULL)
+    {
+        close(Socket);
+        return FALSE;
+    }
+
+    proxy->Socket = Socket;
+    proxy->Flags = info_resp.flags;
+    pthread_mutex_init(&proxy->Lock, NULL);
+
+    Backend->Ops = &ImScsiBenchProxyOps;
+    Backend->Context = proxy;
+    Backend->Close = ImScsiBenchProxyClose;
+    Backend->QueryIdentity =
+        (info_resp.flags & IMDPROXY_FLAG_SUPPORTS_IDENTITY) ?
+        ImScsiBenchProxyQueryIdentity : NULL;
+    Backend->QueryLimits =
+        (info_resp.flags & IMDPROXY_FLAG_SUPPORTS_LIMITS) ?
+        ImScsiBenchProxyQueryLimits : NULL;
+    Backend->Size = (LONGLONG)info_resp.file_size;
+    Backend->ReadOnly = (info_resp.flags & IMDPROXY_FLAG_RO) != 0;
+
+    return TRUE;
+}
+
+BOOLEAN
+ImScsiBenchConnectProxy(
+    const char                 *Host,
+    const char                 *Port,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    struct addrinfo hints;
+    struct addrinfo *addresses;
+    struct addrinfo *address;
+    int sock = -1;
+    int result;
+    int nodelay = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    result = getaddrinfo(Host, Port, &hints, &addresses);
+
+    if (result != 0)
+    {
+        fprintf(stderr, "%s:%s: %s\n", Host, Port, gai_strerror(result));
+        return FALSE;
+    }
+
+    for (address = addresses; address != NULL; address = address->ai_next)
+    {
+        sock = socket(address->ai_family, address->ai_socktype,
+            address->ai_protocol);
+
+        if (sock < 0)
+        {
+            continue;
+        }
+
+        if (connect(sock, address->ai_addr, address->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(addresses);
+
+    if (sock < 0)
+    {
+        perror(Host);
+        return FALSE;
+    }
+
+    // Request headers and data are sent separately.
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    return ImScsiBenchOpenProxy(sock, Backend);
+}
+
+static
+void *
+ImScsiBenchLoopbackThread(void *Context)
+{
+    PIMSCSI_BENCH_LOOPBACK loopback = (PIMSCSI_BENCH_LOOPBACK)Context;
+
+    ImScsiBenchServeProxy(loopback->Socket, &loopback->Served);
+
+    close(loopback->Socket);
+    ImScsiBenchCloseBackend(&loopback->Served);
+    free(loopback);
+
+    return NULL;
+}
+
+BOOLEAN
+ImScsiBenchOpenLoopbackProxy(
+    PIMSCSI_BENCH_BACKEND       Served,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PIMSCSI_BENCH_LOOPBACK loopback;
+    PIMSCSI_BENCH_PROXY proxy;
+    pthread_t thread;
+    int sockets[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+    {
+        perror("socketpair");
+        ImScsiBenchCloseBackend(Served);
+        return FALSE;
+    }
+
+    loopback = (PIMSCSI_BENCH_LOOPBACK)malloc(sizeof(IMSCSI_BENCH_LOOPBACK));
+
+    if (loopback == NULL)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        ImScsiBenchCloseBackend(Served);
+        return FALSE;
+    }
+
+    // Served back end is owned and closed by provider thread from here.
+    loopback->Socket = sockets[1];
+    loopback->Served = *Served;
+
+    if (pthread_create(&thread, NULL, ImScsiBenchLoopbackThread,
+        loopback) != 0)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        ImScsiBenchCloseBackend(&loopback->Served);
+        free(loopback);
+        return FALSE;
+    }
+
+    if (!ImScsiBenchOpenProxy(sockets[0], Backend))
+    {
+        pthread_join(thread, NULL);
+        return FALSE;
+    }
+
+    proxy = (PIMSCSI_BENCH_PROXY)Backend->Context;
+    proxy->ServerThread = thread;
+    proxy->HasServerThread = TRUE;
+
+    return TRUE;
+}
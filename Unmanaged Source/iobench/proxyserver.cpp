@@ -0,0 +1,365 @@
+/// proxyserver.cpp
+/// Proxy provider serving a back end over a stream socket, counterpart of
+/// proxyclient.cpp and of the TCP/IP connection type in proxy.cpp.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include <stdio.h>
+#include <errno.h>
+
+#include "iobench.h"
+
+//
+// Largest read or write request accepted. Driver never sends more than
+// maximum transfer length of adapter in one request.
+//
+#define IMSCSI_BENCH_MAX_PROXY_TRANSFER     (64UL << 20)
+
+static
+BOOLEAN
+ImScsiBenchServeInfo(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    IMDPROXY_INFO_RESP info_resp;
+
+    info_resp.file_size = (ULONGLONG)Backend->Size;
+    info_resp.req_alignment = 1;
+    info_resp.flags = Backend->ReadOnly ? IMDPROXY_FLAG_RO : 0;
+
+    // Maximum transfer length is always known, see ImScsiBenchServeLimits.
+    info_resp.flags |= IMDPROXY_FLAG_SUPPORTS_LIMITS;
+
+    if (Backend->QueryIdentity != NULL)
+    {
+        info_resp.flags |= IMDPROXY_FLAG_SUPPORTS_IDENTITY |
+            IMDPROXY_FLAG_SUPPORTS_COPY;
+    }
+
+    return ImScsiBenchSend(Socket, &info_resp, sizeof(info_resp));
+}
+
+static
+BOOLEAN
+ImScsiBenchServeIdentity(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    IMDPROXY_IDENTITY_RESP identity_resp;
+
+    memset(&identity_resp, 0, sizeof(identity_resp));
+
+    if ((Backend->QueryIdentity == NULL) ||
+        !NT_SUCCESS(Backend->QueryIdentity(Backend->Context, &identity_resp)))
+    {
+        memset(&identity_resp, 0, sizeof(identity_resp));
+        identity_resp.errorno = ENOTSUP;
+    }
+
+    return ImScsiBenchSend(Socket, &identity_resp, sizeof(identity_resp));
+}
+
+static
+BOOLEAN
+ImScsiBenchServeLimits(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    IMDPROXY_LIMITS_RESP limits_resp;
+
+    memset(&limits_resp, 0, sizeof(limits_resp));
+
+    if ((Backend->QueryLimits != NULL) &&
+        !NT_SUCCESS(Backend->QueryLimits(Backend->Context, &limits_resp)))
+    {
+        memset(&limits_resp, 0, sizeof(limits_resp));
+    }
+
+    limits_resp.errorno = 0;
+
+    if ((limits_resp.max_transfer_length == 0) ||
+        (limits_resp.max_transfer_length > IMSCSI_BENCH_MAX_PROXY_TRANSFER))
+    {
+        limits_resp.max_transfer_length = IMSCSI_BENCH_MAX_PROXY_TRANSFER;
+    }
+
+    return ImScsiBenchSend(Socket, &limits_resp, sizeof(limits_resp));
+}
+
+static
+BOOLEAN
+ImScsiBenchServeRead(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend,
+    PUCHAR                      Buffer)
+{
+    IMDPROXY_READ_REQ read_req;
+    IMDPROXY_READ_RESP read_resp;
+    ULONG length;
+    NTSTATUS status;
+
+    if (!ImScsiBenchReceive(Socket, &read_req.offset,
+        sizeof(read_req) - sizeof(read_req.request_code)))
+    {
+        return FALSE;
+    }
+
+    if ((read_req.length > IMSCSI_BENCH_MAX_PROXY_TRANSFER) ||
+        (read_req.offset > (ULONGLONG)Backend->Size))
+    {
+        read_resp.errorno = EINVAL;
+        read_resp.length = 0;
+
+        return ImScsiBenchSend(Socket, &read_resp, sizeof(read_resp));
+    }
+
+    length = (ULONG)read_req.length;
+
+    if (read_req.offset + length > (ULONGLONG)Backend->Size)
+    {
+        length = (ULONG)(Backend->Size - read_req.offset);
+    }
+
+    status = Backend->Ops->Read(Backend->Context, Buffer,
+        (LONGLONG)read_req.offset, &length);
+
+    if (!NT_SUCCESS(status))
+    {
+        read_resp.errorno = EIO;
+        read_resp.length = 0;
+
+        return ImScsiBenchSend(Socket, &read_resp, sizeof(read_resp));
+    }
+
+    read_resp.errorno = 0;
+    read_resp.length = length;
+
+    return ImScsiBenchSend(Socket, &read_resp, sizeof(read_resp)) &&
+        ImScsiBenchSend(Socket, Buffer, length);
+}
+
+static
+BOOLEAN
+ImScsiBenchServeWrite(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend,
+    PUCHAR                      Buffer)
+{
+    IMDPROXY_WRITE_REQ write_req;
+    IMDPROXY_WRITE_RESP write_resp;
+    ULONG length;
+    NTSTATUS status;
+
+    if (!ImScsiBenchReceive(Socket, &write_req.offset,
+        sizeof(write_req) - sizeof(write_req.request_code)))
+    {
+        return FALSE;
+    }
+
+    // Data that follows cannot be skipped, connection is dropped.
+    if (write_req.length > IMSCSI_BENCH_MAX_PROXY_TRANSFER)
+    {
+        fprintf(stderr, "Proxy write request too large: %llu bytes.\n",
+            (unsigned long long)write_req.length);
+
+        return FALSE;
+    }
+
+    length = (ULONG)write_req.length;
+
+    if (!ImScsiBenchReceive(Socket, Buffer, length))
+    {
+        return FALSE;
+    }
+
+    if (Backend->ReadOnly ||
+        (write_req.offset + length > (ULONGLONG)Backend->Size))
+    {
+        write_resp.errorno = Backend->ReadOnly ? EBADF : EINVAL;
+        write_resp.length = 0;
+
+        return ImScsiBenchSend(Socket, &write_resp, sizeof(write_resp));
+    }
+
+    status = Backend->Ops->Write(Backend->Context, Buffer,
+        (LONGLONG)write_req.offset, &length);
+
+    write_resp.errorno = NT_SUCCESS(status) ? 0 : EIO;
+    write_resp.length = length;
+
+    return ImScsiBenchSend(Socket, &write_resp, sizeof(write_resp));
+}
+
+//
+// Only one image is served, so source identity must be the identity of
+// that image. Overlapping ranges are copied from the end when data moves
+// towards higher offsets.
+//
+static
+BOOLEAN
+ImScsiBenchServeCopy(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend,
+    PUCHAR                      Buffer)
+{
+    IMDPROXY_COPY_REQ copy_req;
+    IMDPROXY_COPY_RESP copy_resp;
+    IMDPROXY_IDENTITY_RESP identity_resp;
+    ULONGLONG done = 0;
+    BOOLEAN backwards;
+
+    if (!ImScsiBenchReceive(Socket, copy_req.source_identity,
+        sizeof(copy_req) - sizeof(copy_req.request_code)))
+    {
+        return FALSE;
+    }
+
+    copy_resp.errorno = 0;
+    copy_resp.length = 0;
+
+    if ((Backend->QueryIdentity == NULL) ||
+        !NT_SUCCESS(Backend->QueryIdentity(Backend->Context, &identity_resp)) ||
+        (memcmp(identity_resp.identity, copy_req.source_identity,
+            sizeof(identity_resp.identity)) != 0))
+    {
+        copy_resp.errorno = EXDEV;
+    }
+    else if (Backend->ReadOnly)
+    {
+        copy_resp.errorno = EBADF;
+    }
+    else if ((copy_req.source_offset > (ULONGLONG)Backend->Size) ||
+        (copy_req.offset > (ULONGLONG)Backend->Size) ||
+        (copy_req.length > (ULONGLONG)Backend->Size - copy_req.source_offset) ||
+        (copy_req.length > (ULONGLONG)Backend->Size - copy_req.offset))
+    {
+        copy_resp.errorno = EINVAL;
+    }
+
+    if (copy_resp.errorno != 0)
+    {
+        return ImScsiBenchSend(Socket, &copy_resp, sizeof(copy_resp));
+    }
+
+    backwards = copy_req.source_offset < copy_req.offset;
+
+    while (done < copy_req.length)
+    {
+        ULONG chunk = IMSCSI_BENCH_MAX_PROXY_TRANSFER;
+        ULONG length;
+        ULONGLONG position;
+        NTSTATUS status;
+
+        if (copy_req.length - done < chunk)
+        {
+            chunk = (ULONG)(copy_req.length - done);
+        }
+
+        position = backwards ? copy_req.length - done - chunk : done;
+
+        length = chunk;
+
+        status = Backend->Ops->Read(Backend->Context, Buffer,
+            (LONGLONG)(copy_req.source_offset + position), &length);
+
+        if (NT_SUCCESS(status) && (length == chunk))
+        {
+            status = Backend->Ops->Write(Backend->Context, Buffer,
+                (LONGLONG)(copy_req.offset + position), &length);
+        }
+
+        if (!NT_SUCCESS(status) || (length != chunk))
+        {
+            copy_resp.errorno = EIO;
+            break;
+        }
+
+        done += chunk;
+    }
+
+    copy_resp.length = copy_resp.errorno == 0 ? done : 0;
+
+    return ImScsiBenchSend(Socket, &copy_resp, sizeof(copy_resp));
+}
+
+BOOLEAN
+ImScsiBenchServeProxy(
+    int                         Socket,
+    PIMSCSI_BENCH_BACKEND       Backend)
+{
+    PUCHAR buffer;
+    BOOLEAN result = TRUE;
+
+    buffer = (PUCHAR)ImScsiCoreAllocate(IMSCSI_BENCH_MAX_PROXY_TRANSFER);
+
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Cannot allocate proxy transfer buffer.\n");
+        return FALSE;
+    }
+
+    for (;;)
+    {
+        ULONGLONG request_code;
+
+        if (!ImScsiBenchReceive(Socket, &request_code, sizeof(request_code)))
+        {
+            // Client closed connection.
+            break;
+        }
+
+        switch (request_code)
+        {
+        case IMDPROXY_REQ_INFO:
+            result = ImScsiBenchServeInfo(Socket, Backend);
+            break;
+
+        case IMDPROXY_REQ_READ:
+            result = ImScsiBenchServeRead(Socket, Backend, buffer);
+            break;
+
+        case IMDPROXY_REQ_WRITE:
+            result = ImScsiBenchServeWrite(Socket, Backend, buffer);
+            break;
+
+        case IMDPROXY_REQ_IDENTITY:
+            result = ImScsiBenchServeIdentity(Socket, Backend);
+            break;
+
+        case IMDPROXY_REQ_LIMITS:
+            result = ImScsiBenchServeLimits(Socket, Backend);
+            break;
+
+        case IMDPROXY_REQ_COPY:
+            result = ImScsiBenchServeCopy(Socket, Backend, buffer);
+            break;
+
+        case IMDPROXY_REQ_CLOSE:
+            ImScsiCoreFree(buffer);
+            return TRUE;
+
+        default:
+            // Length of unknown requests is not known, so the rest of
+            // the stream cannot be interpreted.
+            fprintf(stderr, "Unsupported proxy request: %#llx\n",
+                (unsigned long long)request_code);
+            result = FALSE;
+        }
+
+        if (!result)
+        {
+            break;
+        }
+    }
+
+    ImScsiCoreFree(buffer);
+
+    return result;
+}
@@ -0,0 +1,347 @@
+/// replay.cpp
+/// Reads and writes SRB trace files in the format saved by aim_ll --trace,
+/// so that traces captured from the driver can be replayed through the
+/// user mode build of the request path, and runs of iobench can be
+/// recorded for aim_ll --trace-report and --replay.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include <stdio.h>
+#include <errno.h>
+
+#include "iobench.h"
+
+//
+// Same layout as IMSCSI_TRACE_FILE_HEADER and IMSCSI_TRACE_RECORD in
+// phdskmnt/inc/common.h, which cannot be included without Windows headers.
+//
+#define IMSCSI_BENCH_TRACE_FILE_SIGNATURE   "AIMTRACE"
+#define IMSCSI_BENCH_TRACE_FILE_VERSION     1
+
+#define IMSCSI_BENCH_TRACE_START_IO         0
+#define IMSCSI_BENCH_TRACE_COMPLETE         5
+
+#define IMSCSI_BENCH_SCSISTAT_CHECK_CONDITION   0x02
+
+typedef struct _IMSCSI_BENCH_TRACE_FILE_HEADER
+{
+    char                Signature[8];
+    ULONG               Version;
+    ULONG               RecordSize;
+    LONGLONG            Frequency;
+    ULONGLONG           Lost;
+} IMSCSI_BENCH_TRACE_FILE_HEADER, *PIMSCSI_BENCH_TRACE_FILE_HEADER;
+
+typedef struct _IMSCSI_BENCH_TRACE_RECORD
+{
+    ULONGLONG           Sequence;
+    LONGLONG            Timestamp;
+    ULONGLONG           Request;
+    LONGLONG            LogicalBlock;
+    ULONG               DataTransferLength;
+    ULONG               DeviceNumber;       // PathId, TargetId and Lun in low bytes.
+    UCHAR               Stage;
+    UCHAR               Operation;
+    UCHAR               SrbStatus;
+    UCHAR               ScsiStatus;
+    ULONG               Processor;
+} IMSCSI_BENCH_TRACE_RECORD, *PIMSCSI_BENCH_TRACE_RECORD;
+
+static_assert(sizeof(IMSCSI_BENCH_TRACE_FILE_HEADER) == 32,
+    "Trace file header layout differs from driver");
+static_assert(sizeof(IMSCSI_BENCH_TRACE_RECORD) == 48,
+    "Trace record layout differs from driver");
+
+// Timestamps of recorded traces are CLOCK_MONOTONIC nanoseconds.
+#define IMSCSI_BENCH_TRACE_FREQUENCY        1000000000LL
+
+static
+int
+ImScsiBenchCompareTraceRecords(const void *First, const void *Second)
+{
+    const IMSCSI_BENCH_TRACE_RECORD *first =
+        (const IMSCSI_BENCH_TRACE_RECORD *)First;
+    const IMSCSI_BENCH_TRACE_RECORD *second =
+        (const IMSCSI_BENCH_TRACE_RECORD *)Second;
+
+    if (first->Timestamp != second->Timestamp)
+    {
+        return first->Timestamp < second->Timestamp ? -1 : 1;
+    }
+
+    // Completion of a request cannot come before its start.
+    return (first->Stage > second->Stage) - (first->Stage < second->Stage);
+}
+
+BOOLEAN
+ImScsiBenchIsWriteOperation(
+    UCHAR                       Operation)
+{
+    switch (Operation)
+    {
+    case SCSIOP_WRITE6:
+    case SCSIOP_WRITE:
+    case SCSIOP_WRITE12:
+    case SCSIOP_WRITE16:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+static
+BOOLEAN
+ImScsiBenchIsReadWriteOperation(
+    UCHAR                       Operation)
+{
+    switch (Operation)
+    {
+    case SCSIOP_READ6:
+    case SCSIOP_READ:
+    case SCSIOP_READ12:
+    case SCSIOP_READ16:
+        return TRUE;
+
+    default:
+        return ImScsiBenchIsWriteOperation(Operation);
+    }
+}
+
+BOOLEAN
+ImScsiBenchLoadTrace(
+    const char                 *Path,
+    ULONG                       DeviceNumber,
+    ULONG                       BytesPerSector,
+    PIMSCSI_BENCH_TRACE         Trace)
+{
+    IMSCSI_BENCH_TRACE_FILE_HEADER header;
+    IMSCSI_BENCH_TRACE_RECORD record;
+    ULONGLONG allocated = 0;
+    LONGLONG first_timestamp = 0;
+    BOOLEAN device_selected = DeviceNumber != IMSCSI_BENCH_ANY_DEVICE;
+    FILE *file;
+
+    memset(Trace, 0, sizeof(*Trace));
+
+    file = fopen(Path, "rb");
+
+    if (file == NULL)
+    {
+        perror(Path);
+        return FALSE;
+    }
+
+    if ((fread(&header, sizeof(header), 1, file) != 1) ||
+        (memcmp(header.Signature, IMSCSI_BENCH_TRACE_FILE_SIGNATURE,
+            sizeof(header.Signature)) != 0) ||
+        (header.Version != IMSCSI_BENCH_TRACE_FILE_VERSION) ||
+        (header.RecordSize != sizeof(IMSCSI_BENCH_TRACE_RECORD)) ||
+        (header.Frequency <= 0))
+    {
+        fprintf(stderr, "%s: Not a supported trace file.\n", Path);
+        fclose(file);
+        return FALSE;
+    }
+
+    // Keep read and write requests of one virtual disk, in order of
+    // arrival, same selection as aim_ll --replay.
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        PIMSCSI_BENCH_TRACE_REQUEST request;
+        LONGLONG offset;
+
+        if ((record.Stage != IMSCSI_BENCH_TRACE_START_IO) ||
+            (record.DataTransferLength == 0) ||
+            !ImScsiBenchIsReadWriteOperation(record.Operation))
+        {
+            continue;
+        }
+
+        // Device number is three bytes, fourth byte is padding.
+        record.DeviceNumber &= IMSCSI_BENCH_ANY_DEVICE;
+
+        if (DeviceNumber == IMSCSI_BENCH_ANY_DEVICE)
+        {
+            DeviceNumber = record.DeviceNumber;
+        }
+        else if (record.DeviceNumber != DeviceNumber)
+        {
+            if (device_selected)
+            {
+                continue;
+            }
+
+            fprintf(stderr, "Trace has requests to more than one virtual "
+                "disk. Select one with -u.\n");
+            ImScsiBenchFreeTrace(Trace);
+            fclose(file);
+            return FALSE;
+        }
+
+        offset = record.LogicalBlock * (LONGLONG)BytesPerSector;
+
+        // Request path here uses 512 byte blocks.
+        if ((record.LogicalBlock < 0) ||
+            ((offset & 511) != 0) ||
+            ((record.DataTransferLength & 511) != 0))
+        {
+            Trace->Skipped++;
+            continue;
+        }
+
+        if (Trace->Count == allocated)
+        {
+            ULONGLONG new_allocated = allocated * 2 + 1024;
+            PIMSCSI_BENCH_TRACE_REQUEST requests =
+                (PIMSCSI_BENCH_TRACE_REQUEST)realloc(Trace->Requests,
+                    new_allocated * sizeof(IMSCSI_BENCH_TRACE_REQUEST));
+
+            if (requests == NULL)
+            {
+                fprintf(stderr, "Not enough memory for trace records.\n");
+                ImScsiBenchFreeTrace(Trace);
+                fclose(file);
+                return FALSE;
+            }
+
+            Trace->Requests = requests;
+            allocated = new_allocated;
+        }
+
+        if (Trace->Count == 0)
+        {
+            first_timestamp = record.Timestamp;
+        }
+
+        request = &Trace->Requests[Trace->Count++];
+
+        memset(request, 0, sizeof(*request));
+        request->Time = (LONGLONG)((double)(record.Timestamp - first_timestamp) *
+            IMSCSI_BENCH_TRACE_FREQUENCY / header.Frequency);
+        request->StartSector = offset >> 9;
+        request->DataTransferLength = record.DataTransferLength;
+        request->Operation = record.Operation;
+        request->Request = record.Request;
+
+        if (request->DataTransferLength > Trace->MaxTransferLength)
+        {
+            Trace->MaxTransferLength = request->DataTransferLength;
+        }
+
+        if (offset + record.DataTransferLength > Trace->EndOffset)
+        {
+            Trace->EndOffset = offset + record.DataTransferLength;
+        }
+    }
+
+    if (ferror(file))
+    {
+        perror(Path);
+        ImScsiBenchFreeTrace(Trace);
+        fclose(file);
+        return FALSE;
+    }
+
+    fclose(file);
+
+    Trace->DeviceNumber = DeviceNumber;
+
+    return TRUE;
+}
+
+BOOLEAN
+ImScsiBenchSaveTrace(
+    const char                 *Path,
+    PIMSCSI_BENCH_TRACE         Trace)
+{
+    IMSCSI_BENCH_TRACE_FILE_HEADER header;
+    PIMSCSI_BENCH_TRACE_RECORD records;
+    ULONGLONG count = Trace->Count * 2;
+    FILE *file;
+    BOOLEAN result;
+
+    records = (PIMSCSI_BENCH_TRACE_RECORD)calloc(count + 1,
+        sizeof(IMSCSI_BENCH_TRACE_RECORD));
+
+    if (records == NULL)
+    {
+        fprintf(stderr, "Not enough memory for trace records.\n");
+        return FALSE;
+    }
+
+    // Start and completion of each request, in order of time.
+    for (ULONGLONG i = 0; i < Trace->Count; i++)
+    {
+        PIMSCSI_BENCH_TRACE_REQUEST request = &Trace->Requests[i];
+        PIMSCSI_BENCH_TRACE_RECORD start = &records[i * 2];
+        PIMSCSI_BENCH_TRACE_RECORD complete = &records[i * 2 + 1];
+
+        start->Timestamp = request->Time;
+        start->Request = request->Request;
+        start->LogicalBlock = request->StartSector;
+        start->DataTransferLength = request->DataTransferLength;
+        start->DeviceNumber = Trace->DeviceNumber;
+        start->Stage = IMSCSI_BENCH_TRACE_START_IO;
+        start->Operation = request->Operation;
+
+        *complete = *start;
+        complete->Timestamp = request->Time + request->Latency;
+        complete->Stage = IMSCSI_BENCH_TRACE_COMPLETE;
+        complete->SrbStatus = request->SrbStatus;
+        complete->ScsiStatus = request->SrbStatus == SRB_STATUS_SUCCESS ?
+            0 : IMSCSI_BENCH_SCSISTAT_CHECK_CONDITION;
+    }
+
+    qsort(records, count, sizeof(IMSCSI_BENCH_TRACE_RECORD),
+        ImScsiBenchCompareTraceRecords);
+
+    for (ULONGLONG i = 0; i < count; i++)
+    {
+        records[i].Sequence = i;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Signature, IMSCSI_BENCH_TRACE_FILE_SIGNATURE,
+        sizeof(header.Signature));
+    header.Version = IMSCSI_BENCH_TRACE_FILE_VERSION;
+    header.RecordSize = sizeof(IMSCSI_BENCH_TRACE_RECORD);
+    header.Frequency = IMSCSI_BENCH_TRACE_FREQUENCY;
+
+    file = fopen(Path, "wb");
+
+    if (file == NULL)
+    {
+        perror(Path);
+        free(records);
+        return FALSE;
+    }
+
+    result = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(records, sizeof(IMSCSI_BENCH_TRACE_RECORD), count, file) == count);
+
+    if ((fclose(file) != 0) || !result)
+    {
+        perror(Path);
+        result = FALSE;
+    }
+
+    free(records);
+
+    return result;
+}
+
+VOID
+ImScsiBenchFreeTrace(
+    PIMSCSI_BENCH_TRACE         Trace)
+{
+    free(Trace->Requests);
+    memset(Trace, 0, sizeof(*Trace));
+}
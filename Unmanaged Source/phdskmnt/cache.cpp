@@ -0,0 +1,694 @@
+/// cache.cpp
+/// Block cache for image files, shared by all virtual disks. Several virtual
+/// disks that use the same image file, for example with different image
+/// offsets, share cached blocks.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Cached blocks are IMSCSI_CACHE_BLOCK_SIZE bytes at aligned offsets in an
+// image file. Blocks are found through a hash table keyed by image file
+// identity and file offset. Image file identity, volume serial number and
+// file id, is kept in an IMSCSI_CACHE_FILE object that is shared by all LUs
+// using the same image file.
+//
+// Block headers and hash table are in non-paged pool and protected by a
+// spin lock. Block data is in paged pool and only accessed outside the lock.
+// A block is referenced while data is copied from it. Blocks not referenced
+// are evicted in least recently used order when the number of blocks
+// exceeds the budget set by the BlockCacheSize registry value. Blocks that
+// are invalidated while referenced are freed when last reference is
+// released.
+//
+// Only queued I/O image files are cached. Writes, zeroing and unmapping
+// through any LU invalidate the blocks involved. Blocks are invalidated
+// after an image file has been modified and each invalidation increments a
+// generation counter for the file, so that a block read from the image file
+// before the modification completed is never added to the cache.
+//
+
+typedef struct _IMSCSI_CACHE_FILE
+{
+    LIST_ENTRY ListEntry;
+    ULONG VolumeSerialNumber;
+    LARGE_INTEGER FileId;
+    ULONG RefCount;
+    ULONG Generation;
+} IMSCSI_CACHE_FILE, *PIMSCSI_CACHE_FILE;
+
+typedef struct _IMSCSI_CACHE_BLOCK
+{
+    LIST_ENTRY HashListEntry;
+    LIST_ENTRY LruListEntry;
+    PIMSCSI_CACHE_FILE File;
+    LONGLONG Offset;
+    ULONG RefCount;
+    BOOLEAN Removed;
+    PUCHAR Data;
+} IMSCSI_CACHE_BLOCK, *PIMSCSI_CACHE_BLOCK;
+
+FORCEINLINE
+PLIST_ENTRY
+ImScsiCacheBucket(__in PIMSCSI_CACHE_FILE File,
+__in LONGLONG Offset)
+{
+    ULONG hash = (ULONG)(((ULONG_PTR)File >> 4) ^
+        ((ULONG)(Offset >> IMSCSI_CACHE_BLOCK_SHIFT) * 2654435761UL));
+
+    return &pMPDrvInfoGlobal->BlockCache.Hash[hash & (IMSCSI_CACHE_HASH_BUCKETS - 1)];
+}
+
+//
+// Must be called with cache lock held.
+//
+PIMSCSI_CACHE_BLOCK
+ImScsiFindCacheBlock(__in PIMSCSI_CACHE_FILE File,
+__in LONGLONG Offset)
+{
+    PLIST_ENTRY bucket = ImScsiCacheBucket(File, Offset);
+
+    for (PLIST_ENTRY entry = bucket->Flink;
+        entry != bucket;
+        entry = entry->Flink)
+    {
+        PIMSCSI_CACHE_BLOCK block =
+            CONTAINING_RECORD(entry, IMSCSI_CACHE_BLOCK, HashListEntry);
+
+        if ((block->File == File) &&
+            (block->Offset == Offset))
+        {
+            return block;
+        }
+    }
+
+    return NULL;
+}
+
+//
+// Unlinks a block from hash table and LRU list. Must be called with cache
+// lock held. Returns TRUE if block is no longer referenced and should be
+// freed by caller.
+//
+BOOLEAN
+ImScsiRemoveCacheBlock(__in PIMSCSI_CACHE_BLOCK Block)
+{
+    RemoveEntryList(&Block->HashListEntry);
+    RemoveEntryList(&Block->LruListEntry);
+
+    pMPDrvInfoGlobal->BlockCache.Blocks--;
+
+    if (Block->RefCount > 0)
+    {
+        Block->Removed = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+ImScsiFreeCacheBlock(__in PIMSCSI_CACHE_BLOCK Block)
+{
+    if (Block->Data != NULL)
+    {
+        ExFreePoolWithTag(Block->Data, MP_TAG_GENERAL);
+    }
+
+    ExFreePoolWithTag(Block, MP_TAG_GENERAL);
+}
+
+//
+// Frees blocks linked through HashListEntry after removal. Must be called
+// without cache lock held, block data is in paged pool.
+//
+VOID
+ImScsiFreeCacheBlockList(__in PLIST_ENTRY List)
+{
+    while (!IsListEmpty(List))
+    {
+        PLIST_ENTRY entry = RemoveHeadList(List);
+
+        ImScsiFreeCacheBlock(
+            CONTAINING_RECORD(entry, IMSCSI_CACHE_BLOCK, HashListEntry));
+    }
+}
+
+VOID
+ImScsiReleaseCacheBlock(__in PIMSCSI_CACHE_BLOCK Block)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+    BOOLEAN free_block;
+
+    ImScsiAcquireLock(&pMPDrvInfoGlobal->BlockCache.Lock, &LockHandle,
+        lowest_assumed_irql);
+
+    Block->RefCount--;
+
+    free_block = (BOOLEAN)(Block->Removed && (Block->RefCount == 0));
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    if (free_block)
+    {
+        ImScsiFreeCacheBlock(Block);
+    }
+}
+
+VOID
+ImScsiInitializeBlockCache(__in ULONG SizeInMegabytes)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+
+    KeInitializeSpinLock(&cache->Lock);
+    InitializeListHead(&cache->FileList);
+    InitializeListHead(&cache->LruList);
+
+    cache->Blocks = 0;
+    cache->MaxBlocks = SizeInMegabytes << (20 - IMSCSI_CACHE_BLOCK_SHIFT);
+
+    if (cache->MaxBlocks == 0)
+    {
+        KdPrint(("PhDskMnt::ImScsiInitializeBlockCache: Block cache disabled.\n"));
+        return;
+    }
+
+    cache->Hash = (PLIST_ENTRY)ExAllocatePoolWithTag(NonPagedPool,
+        IMSCSI_CACHE_HASH_BUCKETS * sizeof(LIST_ENTRY), MP_TAG_GENERAL);
+
+    if (cache->Hash == NULL)
+    {
+        DbgPrint("PhDskMnt::ImScsiInitializeBlockCache: Memory allocation failed. Block cache disabled.\n");
+        return;
+    }
+
+    for (ULONG i = 0; i < IMSCSI_CACHE_HASH_BUCKETS; i++)
+    {
+        InitializeListHead(&cache->Hash[i]);
+    }
+
+    KdPrint(("PhDskMnt::ImScsiInitializeBlockCache: Block cache of %u MB.\n",
+        SizeInMegabytes));
+}
+
+VOID
+ImScsiFreeBlockCache()
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+
+    if (cache->Hash == NULL)
+    {
+        return;
+    }
+
+    // All LUs are gone by now, so no blocks are referenced.
+    while (!IsListEmpty(&cache->LruList))
+    {
+        PIMSCSI_CACHE_BLOCK block = CONTAINING_RECORD(
+            RemoveHeadList(&cache->LruList), IMSCSI_CACHE_BLOCK, LruListEntry);
+
+        ImScsiFreeCacheBlock(block);
+    }
+
+    while (!IsListEmpty(&cache->FileList))
+    {
+        ExFreePoolWithTag(CONTAINING_RECORD(RemoveHeadList(&cache->FileList),
+            IMSCSI_CACHE_FILE, ListEntry), MP_TAG_GENERAL);
+    }
+
+    ExFreePoolWithTag(cache->Hash, MP_TAG_GENERAL);
+    cache->Hash = NULL;
+    cache->Blocks = 0;
+}
+
+NTSTATUS
+ImScsiOpenCacheFile(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+    NTSTATUS status;
+    IO_STATUS_BLOCK io_status;
+    FILE_INTERNAL_INFORMATION internal_info;
+    UCHAR volume_info_buffer[sizeof(FILE_FS_VOLUME_INFORMATION) + 64];
+    PFILE_FS_VOLUME_INFORMATION volume_info =
+        (PFILE_FS_VOLUME_INFORMATION)volume_info_buffer;
+    PIMSCSI_CACHE_FILE new_file;
+    PIMSCSI_CACHE_FILE file = NULL;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if (cache->Hash == NULL)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    status = ZwQueryInformationFile(pLUExt->ImageFile,
+        &io_status,
+        &internal_info,
+        sizeof(internal_info),
+        FileInternalInformation);
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiOpenCacheFile: Cannot get file id (%#x).\n",
+            status));
+
+        return status;
+    }
+
+    // Volume label does not fit in all cases, serial number is in fixed
+    // part of structure.
+    status = ZwQueryVolumeInformationFile(pLUExt->ImageFile,
+        &io_status,
+        volume_info,
+        sizeof(volume_info_buffer),
+        FileFsVolumeInformation);
+
+    if (status == STATUS_BUFFER_OVERFLOW)
+    {
+        status = STATUS_SUCCESS;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiOpenCacheFile: Cannot get volume serial number (%#x).\n",
+            status));
+
+        return status;
+    }
+
+    new_file = (PIMSCSI_CACHE_FILE)ExAllocatePoolWithTag(NonPagedPool,
+        sizeof(IMSCSI_CACHE_FILE), MP_TAG_GENERAL);
+
+    if (new_file == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(new_file, sizeof(IMSCSI_CACHE_FILE));
+    new_file->VolumeSerialNumber = volume_info->VolumeSerialNumber;
+    new_file->FileId = internal_info.IndexNumber;
+    new_file->RefCount = 1;
+
+    ImScsiAcquireLock(&cache->Lock, &LockHandle, lowest_assumed_irql);
+
+    for (PLIST_ENTRY entry = cache->FileList.Flink;
+        entry != &cache->FileList;
+        entry = entry->Flink)
+    {
+        PIMSCSI_CACHE_FILE existing =
+            CONTAINING_RECORD(entry, IMSCSI_CACHE_FILE, ListEntry);
+
+        if ((existing->VolumeSerialNumber == new_file->VolumeSerialNumber) &&
+            (existing->FileId.QuadPart == new_file->FileId.QuadPart))
+        {
+            existing->RefCount++;
+            file = existing;
+            break;
+        }
+    }
+
+    if (file == NULL)
+    {
+        InsertTailList(&cache->FileList, &new_file->ListEntry);
+        file = new_file;
+        new_file = NULL;
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    if (new_file != NULL)
+    {
+        ExFreePoolWithTag(new_file, MP_TAG_GENERAL);
+    }
+
+    KdPrint(("PhDskMnt::ImScsiOpenCacheFile: pLUExt=%p uses cache file %p, %u LUs.\n",
+        pLUExt, file, file->RefCount));
+
+    pLUExt->CacheFile = file;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiCloseCacheFile(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+    PIMSCSI_CACHE_FILE file = (PIMSCSI_CACHE_FILE)pLUExt->CacheFile;
+    LIST_ENTRY free_list;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+    BOOLEAN free_file = FALSE;
+
+    if (file == NULL)
+    {
+        return;
+    }
+
+    pLUExt->CacheFile = NULL;
+
+    InitializeListHead(&free_list);
+
+    ImScsiAcquireLock(&cache->Lock, &LockHandle, lowest_assumed_irql);
+
+    if (--file->RefCount == 0)
+    {
+        PLIST_ENTRY entry = cache->LruList.Flink;
+
+        while (entry != &cache->LruList)
+        {
+            PIMSCSI_CACHE_BLOCK block =
+                CONTAINING_RECORD(entry, IMSCSI_CACHE_BLOCK, LruListEntry);
+
+            entry = entry->Flink;
+
+            if ((block->File == file) &&
+                ImScsiRemoveCacheBlock(block))
+            {
+                InsertTailList(&free_list, &block->HashListEntry);
+            }
+        }
+
+        RemoveEntryList(&file->ListEntry);
+        free_file = TRUE;
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    ImScsiFreeCacheBlockList(&free_list);
+
+    if (free_file)
+    {
+        ExFreePoolWithTag(file, MP_TAG_GENERAL);
+    }
+}
+
+VOID
+ImScsiInvalidateCache(__in pHW_LU_EXTENSION pLUExt,
+__in LONGLONG ByteOffset,
+__in LONGLONG Length)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+    PIMSCSI_CACHE_FILE file = (PIMSCSI_CACHE_FILE)pLUExt->CacheFile;
+    LONGLONG first_block;
+    LONGLONG end_block;
+    LIST_ENTRY free_list;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if ((file == NULL) || (Length <= 0))
+    {
+        return;
+    }
+
+    first_block = ByteOffset & ~(LONGLONG)(IMSCSI_CACHE_BLOCK_SIZE - 1);
+    end_block = (ByteOffset + Length + IMSCSI_CACHE_BLOCK_SIZE - 1) &
+        ~(LONGLONG)(IMSCSI_CACHE_BLOCK_SIZE - 1);
+
+    InitializeListHead(&free_list);
+
+    ImScsiAcquireLock(&cache->Lock, &LockHandle, lowest_assumed_irql);
+
+    file->Generation++;
+
+    // Look up each block in range, or scan all cached blocks if that is
+    // fewer, as for large unmapped ranges.
+    if (((end_block - first_block) >> IMSCSI_CACHE_BLOCK_SHIFT) <= cache->Blocks)
+    {
+        for (LONGLONG offset = first_block;
+            offset < end_block;
+            offset += IMSCSI_CACHE_BLOCK_SIZE)
+        {
+            PIMSCSI_CACHE_BLOCK block = ImScsiFindCacheBlock(file, offset);
+
+            if ((block != NULL) &&
+                ImScsiRemoveCacheBlock(block))
+            {
+                InsertTailList(&free_list, &block->HashListEntry);
+            }
+        }
+    }
+    else
+    {
+        PLIST_ENTRY entry = cache->LruList.Flink;
+
+        while (entry != &cache->LruList)
+        {
+            PIMSCSI_CACHE_BLOCK block =
+                CONTAINING_RECORD(entry, IMSCSI_CACHE_BLOCK, LruListEntry);
+
+            entry = entry->Flink;
+
+            if ((block->File == file) &&
+                (block->Offset >= first_block) &&
+                (block->Offset < end_block) &&
+                ImScsiRemoveCacheBlock(block))
+            {
+                InsertTailList(&free_list, &block->HashListEntry);
+            }
+        }
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    ImScsiFreeCacheBlockList(&free_list);
+}
+
+//
+// Adds blocks read from image file to cache, unless blocks were
+// invalidated since Generation was sampled or other LUs added the same
+// blocks meanwhile. Least recently used blocks are evicted if cache is over
+// budget.
+//
+VOID
+ImScsiInsertCacheBlocks(__in PIMSCSI_CACHE_FILE File,
+__in ULONG Generation,
+__in LONGLONG Offset,
+__in PUCHAR Data,
+__in ULONG Blocks)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+    LIST_ENTRY new_list;
+    LIST_ENTRY free_list;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    InitializeListHead(&new_list);
+    InitializeListHead(&free_list);
+
+    for (ULONG i = 0; i < Blocks; i++)
+    {
+        PIMSCSI_CACHE_BLOCK block = (PIMSCSI_CACHE_BLOCK)
+            ExAllocatePoolWithTag(NonPagedPool, sizeof(IMSCSI_CACHE_BLOCK),
+            MP_TAG_GENERAL);
+
+        if (block == NULL)
+        {
+            break;
+        }
+
+        RtlZeroMemory(block, sizeof(IMSCSI_CACHE_BLOCK));
+
+        block->Data = (PUCHAR)ExAllocatePoolWithTag(PagedPool,
+            IMSCSI_CACHE_BLOCK_SIZE, MP_TAG_GENERAL);
+
+        if (block->Data == NULL)
+        {
+            ExFreePoolWithTag(block, MP_TAG_GENERAL);
+            break;
+        }
+
+        RtlCopyMemory(block->Data,
+            Data + ((SIZE_T)i << IMSCSI_CACHE_BLOCK_SHIFT),
+            IMSCSI_CACHE_BLOCK_SIZE);
+
+        block->File = File;
+        block->Offset = Offset + ((LONGLONG)i << IMSCSI_CACHE_BLOCK_SHIFT);
+
+        InsertTailList(&new_list, &block->HashListEntry);
+    }
+
+    ImScsiAcquireLock(&cache->Lock, &LockHandle, lowest_assumed_irql);
+
+    while (!IsListEmpty(&new_list))
+    {
+        PIMSCSI_CACHE_BLOCK block = CONTAINING_RECORD(RemoveHeadList(&new_list),
+            IMSCSI_CACHE_BLOCK, HashListEntry);
+
+        if ((File->Generation != Generation) ||
+            (ImScsiFindCacheBlock(File, block->Offset) != NULL))
+        {
+            InsertTailList(&free_list, &block->HashListEntry);
+            continue;
+        }
+
+        InsertTailList(ImScsiCacheBucket(File, block->Offset),
+            &block->HashListEntry);
+        InsertTailList(&cache->LruList, &block->LruListEntry);
+        cache->Blocks++;
+    }
+
+    for (PLIST_ENTRY entry = cache->LruList.Flink;
+        (cache->Blocks > cache->MaxBlocks) && (entry != &cache->LruList);)
+    {
+        PIMSCSI_CACHE_BLOCK block =
+            CONTAINING_RECORD(entry, IMSCSI_CACHE_BLOCK, LruListEntry);
+
+        entry = entry->Flink;
+
+        if (block->RefCount > 0)
+        {
+            continue;
+        }
+
+        ImScsiRemoveCacheBlock(block);
+        InsertTailList(&free_list, &block->HashListEntry);
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    ImScsiFreeCacheBlockList(&free_list);
+}
+
+NTSTATUS
+ImScsiReadCachedFile(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in PLARGE_INTEGER ByteOffset,
+__in ULONG Length,
+__out PIO_STATUS_BLOCK IoStatus)
+{
+    PIMSCSI_BLOCK_CACHE cache = &pMPDrvInfoGlobal->BlockCache;
+    PIMSCSI_CACHE_FILE file = (PIMSCSI_CACHE_FILE)pLUExt->CacheFile;
+    NTSTATUS status = STATUS_SUCCESS;
+    PUCHAR buffer = (PUCHAR)Buffer;
+    LONGLONG position = ByteOffset->QuadPart;
+    LONGLONG end_position = ByteOffset->QuadPart + Length;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    while (position < end_position)
+    {
+        LONGLONG block_offset = position & ~(LONGLONG)(IMSCSI_CACHE_BLOCK_SIZE - 1);
+        PIMSCSI_CACHE_BLOCK block;
+        ULONG run_blocks = 0;
+        ULONG generation;
+
+        ImScsiAcquireLock(&cache->Lock, &LockHandle, lowest_assumed_irql);
+
+        block = ImScsiFindCacheBlock(file, block_offset);
+
+        if (block != NULL)
+        {
+            block->RefCount++;
+
+            RemoveEntryList(&block->LruListEntry);
+            InsertTailList(&cache->LruList, &block->LruListEntry);
+        }
+        else
+        {
+            // Read as many missing blocks as possible in one request.
+            do
+            {
+                run_blocks++;
+            } while ((run_blocks < IMSCSI_CACHE_MAX_RUN_BLOCKS) &&
+                (block_offset + ((LONGLONG)run_blocks << IMSCSI_CACHE_BLOCK_SHIFT) <
+                end_position) &&
+                (ImScsiFindCacheBlock(file, block_offset +
+                ((LONGLONG)run_blocks << IMSCSI_CACHE_BLOCK_SHIFT)) == NULL));
+        }
+
+        generation = file->Generation;
+
+        ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+        if (block != NULL)
+        {
+            ULONG length = (ULONG)min(end_position - position,
+                block_offset + IMSCSI_CACHE_BLOCK_SIZE - position);
+
+            RtlCopyMemory(buffer, block->Data + (position - block_offset), length);
+
+            ImScsiReleaseCacheBlock(block);
+
+            ImScsiCountCacheAccess(pLUExt, 1, 0);
+
+            buffer += length;
+            position += length;
+
+            continue;
+        }
+
+        ULONG run_length = run_blocks << IMSCSI_CACHE_BLOCK_SHIFT;
+        LARGE_INTEGER run_offset;
+        IO_STATUS_BLOCK io_status;
+        ULONG length;
+
+        WPoolMem<UCHAR, PagedPool> run_buffer(run_length);
+
+        if (!run_buffer)
+        {
+            status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        run_offset.QuadPart = block_offset;
+
+        status = NtReadFile(pLUExt->ImageFile,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            run_buffer,
+            run_length,
+            &run_offset,
+            NULL);
+
+        // Data beyond end of image file reads as zeros, same as without
+        // cache.
+        if (status == STATUS_END_OF_FILE)
+        {
+            io_status.Information = 0;
+            status = STATUS_SUCCESS;
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        if (io_status.Information < run_length)
+        {
+            RtlZeroMemory(run_buffer + io_status.Information,
+                run_length - io_status.Information);
+        }
+
+        length = (ULONG)min(end_position - position,
+            block_offset + run_length - position);
+
+        RtlCopyMemory(buffer, run_buffer + (position - block_offset), length);
+
+        ImScsiInsertCacheBlocks(file, generation, block_offset, run_buffer,
+            run_blocks);
+
+        ImScsiCountCacheAccess(pLUExt, 0, run_blocks);
+
+        buffer += length;
+        position += length;
+    }
+
+    IoStatus->Status = status;
+    IoStatus->Information = NT_SUCCESS(status) ? Length : 0;
+
+    return status;
+}
@@ -0,0 +1,697 @@
+/// cachecore.cpp
+/// Persistent cache file for slow back ends. Same source is built into the
+/// driver and into the user mode benchmark harness, see cachecore.h.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifdef IMSCSI_CORE_USER_MODE
+
+#include "cachecore.h"
+
+#define RtlMoveMemory                       memmove
+#define RtlZeroMemory(Destination, Length)  memset((Destination), 0, (Length))
+#define RtlEqualMemory(First, Second, Length) (memcmp((First), (Second), (Length)) == 0)
+#define KdPrint(Args)
+
+#define ImScsiCacheCoreAllocate(Size)       ImScsiCoreAllocate(Size)
+#define ImScsiCacheCoreRelease(Block)       ImScsiCoreFree(Block)
+
+#else
+
+#include "phdskmnt.h"
+
+// Index and hash tables are only accessed by LU worker thread.
+#define ImScsiCacheCoreAllocate(Size)       ExAllocatePoolWithTag(PagedPool, (Size), MP_TAG_GENERAL)
+#define ImScsiCacheCoreRelease(Block)       ExFreePoolWithTag((Block), MP_TAG_GENERAL)
+
+#endif
+
+//
+// A cache file has a header page, an index with one entry per cache slot
+// and then the slots themselves, each holding one
+// IMSCSI_CACHE_CORE_BLOCK_SIZE block of the image.
+//
+// The cache is read-through and write-around. Blocks missing in the cache
+// are read from the image and stored in a slot, writes, zeroing and
+// unmapping go to the image and remove affected blocks from the cache.
+// When all slots are in use, a slot is reused in order selected by the
+// policy. Clock policy gives recently read blocks a second chance, an
+// approximation of least recently used, FIFO policy reuses slots in the
+// order they were filled.
+//
+// Index is kept in memory and written to the cache file at close. Header
+// is marked as not clean while the cache file is in use, a cache file that
+// was not closed properly is discarded on next open. A cache file is also
+// discarded if image size, identity or generation reported by the back end
+// does not match the values stored in the header.
+//
+
+#define IMSCSI_CACHE_CORE_SIGNATURE         "AIMPXCCH"
+#define IMSCSI_CACHE_CORE_VERSION           2
+#define IMSCSI_CACHE_CORE_HEADER_SIZE       4096
+
+#define IMSCSI_CACHE_CORE_NO_SLOT           0xFFFFFFFFUL
+
+typedef struct _IMSCSI_CACHE_CORE_HEADER
+{
+    UCHAR Signature[8];
+    ULONG Version;
+    ULONG BlockShift;
+    ULONG Slots;
+    ULONG Clean;
+    ULONGLONG ImageSize;
+    UCHAR Identity[IMSCSI_CACHE_CORE_IDENTITY_SIZE];
+    ULONGLONG Generation;
+    ULONG Hand;
+} IMSCSI_CACHE_CORE_HEADER, *PIMSCSI_CACHE_CORE_HEADER;
+
+FORCEINLINE
+BOOLEAN
+ImScsiCacheCoreTestReferenced(PIMSCSI_CACHE_CORE Cache, ULONG Slot)
+{
+    return (Cache->Referenced[Slot >> 5] & (1UL << (Slot & 31))) != 0;
+}
+
+FORCEINLINE
+VOID
+ImScsiCacheCoreSetReferenced(PIMSCSI_CACHE_CORE Cache, ULONG Slot)
+{
+    Cache->Referenced[Slot >> 5] |= 1UL << (Slot & 31);
+}
+
+FORCEINLINE
+VOID
+ImScsiCacheCoreClearReferenced(PIMSCSI_CACHE_CORE Cache, ULONG Slot)
+{
+    Cache->Referenced[Slot >> 5] &= ~(1UL << (Slot & 31));
+}
+
+FORCEINLINE
+PULONG
+ImScsiCacheCoreBucket(PIMSCSI_CACHE_CORE Cache, ULONGLONG Block)
+{
+    ULONG hash = (ULONG)(Block ^ (Block >> 32)) * 2654435761UL;
+
+    return &Cache->HashHeads[hash & Cache->HashMask];
+}
+
+static
+ULONG
+ImScsiCacheCoreFindSlot(PIMSCSI_CACHE_CORE Cache, ULONGLONG Block)
+{
+    for (ULONG slot = *ImScsiCacheCoreBucket(Cache, Block);
+        slot != 0;
+        slot = Cache->HashNext[slot - 1])
+    {
+        if (Cache->Index[slot - 1] == Block + 1)
+        {
+            return slot - 1;
+        }
+    }
+
+    return IMSCSI_CACHE_CORE_NO_SLOT;
+}
+
+static
+VOID
+ImScsiCacheCoreInsertSlot(PIMSCSI_CACHE_CORE Cache, ULONG Slot,
+    ULONGLONG Block)
+{
+    PULONG bucket = ImScsiCacheCoreBucket(Cache, Block);
+
+    Cache->Index[Slot] = Block + 1;
+    Cache->HashNext[Slot] = *bucket;
+    *bucket = Slot + 1;
+}
+
+static
+VOID
+ImScsiCacheCoreRemoveSlot(PIMSCSI_CACHE_CORE Cache, ULONG Slot)
+{
+    PULONG link;
+
+    if (Cache->Index[Slot] == 0)
+    {
+        return;
+    }
+
+    for (link = ImScsiCacheCoreBucket(Cache, Cache->Index[Slot] - 1);
+        *link != 0;
+        link = &Cache->HashNext[*link - 1])
+    {
+        if (*link == Slot + 1)
+        {
+            *link = Cache->HashNext[Slot];
+            break;
+        }
+    }
+
+    Cache->Index[Slot] = 0;
+    Cache->HashNext[Slot] = 0;
+    ImScsiCacheCoreClearReferenced(Cache, Slot);
+}
+
+static
+ULONG
+ImScsiCacheCoreSelectSlot(PIMSCSI_CACHE_CORE Cache)
+{
+    ULONG slot;
+
+    // With clock policy, a slot read since last pass of the hand is
+    // skipped once. Loop ends within two rounds.
+    while ((Cache->Policy == IMSCSI_CACHE_CORE_POLICY_CLOCK) &&
+        (Cache->Index[Cache->Hand] != 0) &&
+        ImScsiCacheCoreTestReferenced(Cache, Cache->Hand))
+    {
+        ImScsiCacheCoreClearReferenced(Cache, Cache->Hand);
+
+        if (++Cache->Hand >= Cache->Slots)
+        {
+            Cache->Hand = 0;
+        }
+    }
+
+    slot = Cache->Hand;
+
+    if (++Cache->Hand >= Cache->Slots)
+    {
+        Cache->Hand = 0;
+    }
+
+    ImScsiCacheCoreRemoveSlot(Cache, slot);
+
+    return slot;
+}
+
+VOID
+ImScsiCacheCoreFree(
+    PIMSCSI_CACHE_CORE          Cache)
+{
+    if (Cache->Index != NULL)
+    {
+        ImScsiCacheCoreRelease(Cache->Index);
+        Cache->Index = NULL;
+    }
+
+    if (Cache->HashHeads != NULL)
+    {
+        ImScsiCacheCoreRelease(Cache->HashHeads);
+        Cache->HashHeads = NULL;
+    }
+
+    if (Cache->HashNext != NULL)
+    {
+        ImScsiCacheCoreRelease(Cache->HashNext);
+        Cache->HashNext = NULL;
+    }
+
+    if (Cache->Referenced != NULL)
+    {
+        ImScsiCacheCoreRelease(Cache->Referenced);
+        Cache->Referenced = NULL;
+    }
+
+    if (Cache->RunBuffer != NULL)
+    {
+        ImScsiCacheCoreRelease(Cache->RunBuffer);
+        Cache->RunBuffer = NULL;
+    }
+}
+
+static
+NTSTATUS
+ImScsiCacheCoreWriteHeader(PIMSCSI_CACHE_CORE Cache, BOOLEAN Clean)
+{
+    PIMSCSI_CACHE_CORE_HEADER header;
+    ULONG length = IMSCSI_CACHE_CORE_HEADER_SIZE;
+    NTSTATUS status;
+
+    header = (PIMSCSI_CACHE_CORE_HEADER)
+        ImScsiCacheCoreAllocate(IMSCSI_CACHE_CORE_HEADER_SIZE);
+
+    if (header == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(header, IMSCSI_CACHE_CORE_HEADER_SIZE);
+    RtlMoveMemory(header->Signature, IMSCSI_CACHE_CORE_SIGNATURE,
+        sizeof(header->Signature));
+    header->Version = IMSCSI_CACHE_CORE_VERSION;
+    header->BlockShift = IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+    header->Slots = Cache->Slots;
+    header->Clean = Clean;
+    header->ImageSize = Cache->ImageSize;
+    RtlMoveMemory(header->Identity, Cache->Identity, sizeof(header->Identity));
+    header->Generation = Cache->Generation;
+    header->Hand = Cache->Hand;
+
+    status = Cache->CacheFile->Write(Cache->CacheFileContext, header, 0,
+        &length);
+
+    if (NT_SUCCESS(status) && (length != IMSCSI_CACHE_CORE_HEADER_SIZE))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    ImScsiCacheCoreRelease(header);
+
+    return status;
+}
+
+static
+NTSTATUS
+ImScsiCacheCoreLoadIndex(PIMSCSI_CACHE_CORE Cache)
+{
+    PIMSCSI_CACHE_CORE_HEADER header;
+    ULONG length = IMSCSI_CACHE_CORE_HEADER_SIZE;
+    NTSTATUS status;
+
+    header = (PIMSCSI_CACHE_CORE_HEADER)
+        ImScsiCacheCoreAllocate(IMSCSI_CACHE_CORE_HEADER_SIZE);
+
+    if (header == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    status = Cache->CacheFile->Read(Cache->CacheFileContext, header, 0,
+        &length);
+
+    if ((!NT_SUCCESS(status)) ||
+        (length != IMSCSI_CACHE_CORE_HEADER_SIZE) ||
+        (!RtlEqualMemory(header->Signature, IMSCSI_CACHE_CORE_SIGNATURE,
+        sizeof(header->Signature))) ||
+        (header->Version != IMSCSI_CACHE_CORE_VERSION) ||
+        (header->BlockShift != IMSCSI_CACHE_CORE_BLOCK_SHIFT) ||
+        (header->Slots != Cache->Slots) ||
+        (header->Hand >= Cache->Slots) ||
+        (header->ImageSize != (ULONGLONG)Cache->ImageSize) ||
+        (!RtlEqualMemory(header->Identity, Cache->Identity,
+        sizeof(header->Identity))) ||
+        (header->Generation != Cache->Generation))
+    {
+        KdPrint(("PhDskMnt::ImScsiCacheCoreLoadIndex: New cache file or different image.\n"));
+
+        ImScsiCacheCoreRelease(header);
+        return STATUS_OBJECT_TYPE_MISMATCH;
+    }
+
+    if (!header->Clean)
+    {
+        KdPrint(("PhDskMnt::ImScsiCacheCoreLoadIndex: Cache file was not properly closed.\n"));
+
+        ImScsiCacheCoreRelease(header);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    Cache->Hand = header->Hand;
+
+    ImScsiCacheCoreRelease(header);
+
+    length = Cache->Slots * (ULONG)sizeof(*Cache->Index);
+
+    status = Cache->CacheFile->Read(Cache->CacheFileContext, Cache->Index,
+        IMSCSI_CACHE_CORE_HEADER_SIZE, &length);
+
+    if ((!NT_SUCCESS(status)) ||
+        (length != Cache->Slots * sizeof(*Cache->Index)))
+    {
+        Cache->Hand = 0;
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+ImScsiCacheCoreOpen(
+    PIMSCSI_CACHE_CORE          Cache,
+    const IMSCSI_CORE_BACKEND  *CacheFile,
+    PVOID                       CacheFileContext,
+    const IMSCSI_CORE_BACKEND  *Image,
+    PVOID                       ImageContext,
+    LONGLONG                    ImageSize,
+    ULONGLONG                   MaxSlots,
+    ULONG                       Policy,
+    const UCHAR                *Identity,
+    ULONGLONG                   Generation)
+{
+    ULONGLONG image_blocks = ((ULONGLONG)ImageSize +
+        IMSCSI_CACHE_CORE_BLOCK_SIZE - 1) >> IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+    ULONGLONG slots = MaxSlots;
+    ULONG buckets;
+    NTSTATUS status;
+
+    if ((MaxSlots == 0) || (ImageSize <= 0))
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (slots > image_blocks)
+    {
+        slots = image_blocks;
+    }
+
+    if (slots > 0xFFFFFFFFUL / sizeof(*Cache->Index))
+    {
+        slots = 0xFFFFFFFFUL / sizeof(*Cache->Index);
+    }
+
+    Cache->CacheFile = CacheFile;
+    Cache->CacheFileContext = CacheFileContext;
+    Cache->Image = Image;
+    Cache->ImageContext = ImageContext;
+    Cache->Slots = (ULONG)slots;
+    Cache->Policy = Policy;
+    Cache->ImageSize = ImageSize;
+    Cache->Generation = Generation;
+    RtlMoveMemory(Cache->Identity, Identity, sizeof(Cache->Identity));
+    Cache->DataOffset = (IMSCSI_CACHE_CORE_HEADER_SIZE +
+        ((LONGLONG)Cache->Slots * sizeof(*Cache->Index)) +
+        IMSCSI_CACHE_CORE_BLOCK_SIZE - 1) &
+        ~(LONGLONG)(IMSCSI_CACHE_CORE_BLOCK_SIZE - 1);
+
+    for (buckets = 1; (buckets < Cache->Slots) && (buckets < 0x80000000UL); buckets <<= 1);
+
+    Cache->HashMask = buckets - 1;
+
+    Cache->Index = (PULONGLONG)ImScsiCacheCoreAllocate(
+        Cache->Slots * sizeof(*Cache->Index));
+    Cache->HashHeads = (PULONG)ImScsiCacheCoreAllocate(
+        buckets * sizeof(*Cache->HashHeads));
+    Cache->HashNext = (PULONG)ImScsiCacheCoreAllocate(
+        Cache->Slots * sizeof(*Cache->HashNext));
+    Cache->Referenced = (PULONG)ImScsiCacheCoreAllocate(
+        ((Cache->Slots + 31) >> 5) * sizeof(ULONG));
+    Cache->RunBuffer = (PUCHAR)ImScsiCacheCoreAllocate(
+        IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS << IMSCSI_CACHE_CORE_BLOCK_SHIFT);
+
+    if ((Cache->Index == NULL) || (Cache->HashHeads == NULL) ||
+        (Cache->HashNext == NULL) || (Cache->Referenced == NULL) ||
+        (Cache->RunBuffer == NULL))
+    {
+        KdPrint(("PhDskMnt::ImScsiCacheCoreOpen: Memory allocation failed for %u slots.\n",
+            Cache->Slots));
+
+        ImScsiCacheCoreFree(Cache);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Cache->Referenced, ((Cache->Slots + 31) >> 5) * sizeof(ULONG));
+    RtlZeroMemory(Cache->HashHeads, buckets * sizeof(*Cache->HashHeads));
+    RtlZeroMemory(Cache->HashNext, Cache->Slots * sizeof(*Cache->HashNext));
+
+    status = ImScsiCacheCoreLoadIndex(Cache);
+
+    if (NT_SUCCESS(status))
+    {
+        for (ULONG slot = 0; slot < Cache->Slots; slot++)
+        {
+            if ((Cache->Index[slot] == 0) ||
+                (Cache->Index[slot] > image_blocks) ||
+                (ImScsiCacheCoreFindSlot(Cache, Cache->Index[slot] - 1) !=
+                IMSCSI_CACHE_CORE_NO_SLOT))
+            {
+                Cache->Index[slot] = 0;
+                continue;
+            }
+
+            ImScsiCacheCoreInsertSlot(Cache, slot, Cache->Index[slot] - 1);
+        }
+    }
+    else
+    {
+        RtlZeroMemory(Cache->Index, Cache->Slots * sizeof(*Cache->Index));
+        Cache->Hand = 0;
+    }
+
+    // Index on disk is not valid until written back at close.
+    status = ImScsiCacheCoreWriteHeader(Cache, FALSE);
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiCacheCoreOpen: Cannot write cache file header (%#x).\n",
+            status));
+
+        ImScsiCacheCoreFree(Cache);
+        return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+ImScsiCacheCoreClose(
+    PIMSCSI_CACHE_CORE          Cache,
+    ULONGLONG                   Generation)
+{
+    ULONG length = Cache->Slots * (ULONG)sizeof(*Cache->Index);
+    NTSTATUS status;
+
+    // Writes through this cache have removed affected blocks, so cache
+    // is valid for image as it is now. Otherwise a new generation means
+    // that image was modified elsewhere and header stays not clean.
+    if ((!Cache->Modified) && (Generation != Cache->Generation))
+    {
+        KdPrint(("PhDskMnt::ImScsiCacheCoreClose: Image modified elsewhere, cache is discarded.\n"));
+
+        ImScsiCacheCoreFree(Cache);
+        return STATUS_OBJECT_TYPE_MISMATCH;
+    }
+
+    Cache->Generation = Generation;
+
+    status = Cache->CacheFile->Write(Cache->CacheFileContext, Cache->Index,
+        IMSCSI_CACHE_CORE_HEADER_SIZE, &length);
+
+    if (NT_SUCCESS(status) && (length != Cache->Slots * sizeof(*Cache->Index)))
+    {
+        status = STATUS_IO_DEVICE_ERROR;
+    }
+
+    // Index is flushed to disk before header is marked clean.
+    if (NT_SUCCESS(status) && (Cache->CacheFile->Flush != NULL))
+    {
+        status = Cache->CacheFile->Flush(Cache->CacheFileContext);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = ImScsiCacheCoreWriteHeader(Cache, TRUE);
+    }
+
+    ImScsiCacheCoreFree(Cache);
+
+    return status;
+}
+
+VOID
+ImScsiCacheCoreInvalidate(
+    PIMSCSI_CACHE_CORE          Cache,
+    LONGLONG                    Offset,
+    LONGLONG                    Length)
+{
+    ULONGLONG block;
+    ULONGLONG end_block;
+
+    if ((Length <= 0) || (Offset < 0))
+    {
+        return;
+    }
+
+    Cache->Modified = TRUE;
+
+    block = (ULONGLONG)Offset >> IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+    end_block = ((ULONGLONG)(Offset + Length) + IMSCSI_CACHE_CORE_BLOCK_SIZE - 1) >>
+        IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+
+    for (; block < end_block; block++)
+    {
+        ULONG slot = ImScsiCacheCoreFindSlot(Cache, block);
+
+        if (slot != IMSCSI_CACHE_CORE_NO_SLOT)
+        {
+            ImScsiCacheCoreRemoveSlot(Cache, slot);
+        }
+    }
+}
+
+NTSTATUS
+ImScsiCacheCoreRead(
+    PIMSCSI_CACHE_CORE          Cache,
+    PVOID                       Buffer,
+    LONGLONG                    Offset,
+    PULONG                      Length,
+    PULONG                      Hits,
+    PULONG                      Misses)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PUCHAR buffer = (PUCHAR)Buffer;
+    LONGLONG position = Offset;
+    LONGLONG end_position = Offset + *Length;
+
+    *Hits = 0;
+    *Misses = 0;
+
+    while (position < end_position)
+    {
+        ULONGLONG block = (ULONGLONG)position >> IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+        LONGLONG block_offset = (LONGLONG)block << IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+        ULONG slot = ImScsiCacheCoreFindSlot(Cache, block);
+        ULONG length;
+        ULONG done;
+
+        if (slot != IMSCSI_CACHE_CORE_NO_SLOT)
+        {
+            length = (ULONG)(end_position - position);
+
+            if (length > block_offset + IMSCSI_CACHE_CORE_BLOCK_SIZE - position)
+            {
+                length = (ULONG)(block_offset + IMSCSI_CACHE_CORE_BLOCK_SIZE - position);
+            }
+
+            done = length;
+
+            status = Cache->CacheFile->Read(Cache->CacheFileContext, buffer,
+                Cache->DataOffset +
+                ((LONGLONG)slot << IMSCSI_CACHE_CORE_BLOCK_SHIFT) +
+                (position - block_offset),
+                &done);
+
+            if (NT_SUCCESS(status) && (done == length))
+            {
+                ImScsiCacheCoreSetReferenced(Cache, slot);
+                Cache->Hits++;
+                (*Hits)++;
+
+                buffer += length;
+                position += length;
+
+                continue;
+            }
+
+            // Read from image instead if cache file fails.
+            KdPrint(("PhDskMnt::ImScsiCacheCoreRead: Cache file read failed (%#x).\n",
+                status));
+
+            status = STATUS_SUCCESS;
+
+            ImScsiCacheCoreRemoveSlot(Cache, slot);
+        }
+
+        // Read as many missing blocks as possible in one request.
+        ULONG run_blocks = 0;
+
+        do
+        {
+            run_blocks++;
+        } while ((run_blocks < IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS) &&
+            (block_offset + ((LONGLONG)run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT) <
+            end_position) &&
+            (ImScsiCacheCoreFindSlot(Cache, block + run_blocks) ==
+            IMSCSI_CACHE_CORE_NO_SLOT));
+
+        ULONG run_length = run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+
+        // Image is not asked for data beyond its end.
+        if (Cache->ImageSize - block_offset < (LONGLONG)run_length)
+        {
+            run_length = Cache->ImageSize > block_offset ?
+                (ULONG)(Cache->ImageSize - block_offset) : 0;
+        }
+
+        done = 0;
+
+        if (run_length > 0)
+        {
+            done = run_length;
+
+            status = Cache->Image->Read(Cache->ImageContext, Cache->RunBuffer,
+                block_offset, &done);
+
+            if (!NT_SUCCESS(status))
+            {
+                break;
+            }
+        }
+
+        if (done < (run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT))
+        {
+            RtlZeroMemory(Cache->RunBuffer + done,
+                (run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT) - done);
+        }
+
+        length = (ULONG)(end_position - position);
+
+        if (length > block_offset +
+            ((LONGLONG)run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT) - position)
+        {
+            length = (ULONG)(block_offset +
+                ((LONGLONG)run_blocks << IMSCSI_CACHE_CORE_BLOCK_SHIFT) - position);
+        }
+
+        RtlMoveMemory(buffer, Cache->RunBuffer + (position - block_offset), length);
+
+        Cache->Misses += run_blocks;
+        *Misses += run_blocks;
+
+        // Only blocks completely returned by image are stored, last block
+        // of image may be short.
+        ULONG store_blocks;
+
+        if (done == run_length)
+        {
+            ULONGLONG remaining_blocks = (ULONGLONG)((Cache->ImageSize - block_offset) +
+                IMSCSI_CACHE_CORE_BLOCK_SIZE - 1) >> IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+
+            store_blocks = remaining_blocks < run_blocks ?
+                (ULONG)remaining_blocks : run_blocks;
+        }
+        else
+        {
+            store_blocks = done >> IMSCSI_CACHE_CORE_BLOCK_SHIFT;
+        }
+
+        for (ULONG i = 0; i < store_blocks; i++)
+        {
+            ULONG block_length = IMSCSI_CACHE_CORE_BLOCK_SIZE;
+            NTSTATUS write_status;
+
+            slot = ImScsiCacheCoreSelectSlot(Cache);
+
+            write_status = Cache->CacheFile->Write(Cache->CacheFileContext,
+                Cache->RunBuffer + ((size_t)i << IMSCSI_CACHE_CORE_BLOCK_SHIFT),
+                Cache->DataOffset + ((LONGLONG)slot << IMSCSI_CACHE_CORE_BLOCK_SHIFT),
+                &block_length);
+
+            if (!NT_SUCCESS(write_status) ||
+                (block_length != IMSCSI_CACHE_CORE_BLOCK_SIZE))
+            {
+                KdPrint(("PhDskMnt::ImScsiCacheCoreRead: Cache file write failed (%#x).\n",
+                    write_status));
+
+                break;
+            }
+
+            ImScsiCacheCoreInsertSlot(Cache, slot, block + i);
+        }
+
+        buffer += length;
+        position += length;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        *Length = 0;
+    }
+
+    return status;
+}
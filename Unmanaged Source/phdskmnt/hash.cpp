@@ -0,0 +1,709 @@
+/// hash.cpp
+/// Computes MD5, SHA-1 and SHA-256 digests of virtual disk contents while
+/// reads are served, so that evidence can be verified without a separate
+/// full read of the image.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#if _NT_TARGET_VERSION >= 0x600
+#include <bcrypt.h>
+#endif
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Digests are computed over virtual disk contents in order. Data before
+// ImageHash->NextOffset has been queued for hashing. When a read request
+// served by the LU worker thread covers NextOffset, the part of the read
+// data from NextOffset onwards is copied to a hash buffer and queued.
+// When the LU worker thread is idle, it reads data at NextOffset itself to
+// fill gaps left by non-sequential reads, see ImScsiHashIdle.
+//
+// Each algorithm runs in its own system thread with its own queue. A hash
+// buffer is linked into all queues and freed when all threads are done
+// with it. At most IMSCSI_HASH_QUEUE_DEPTH buffers are outstanding, reads
+// are never delayed waiting for hash threads. Data that does not fit in
+// the queue is read again later by ImScsiHashIdle. Hash threads wake the
+// LU worker thread when buffers are freed so that it can continue reading.
+//
+// Hash algorithms are provided by kernel mode CNG, which uses CPU
+// instruction set extensions where available.
+//
+
+#if _NT_TARGET_VERSION >= 0x600
+
+#define IMSCSI_HASH_ALGORITHMS      3
+
+typedef struct _IMSCSI_HASH_BUFFER
+{
+    LIST_ENTRY ListEntry[IMSCSI_HASH_ALGORITHMS];
+    LONG RefCount;
+    ULONG Length;
+    UCHAR Data[1];
+} IMSCSI_HASH_BUFFER, *PIMSCSI_HASH_BUFFER;
+
+typedef struct _IMSCSI_IMAGE_HASH IMSCSI_IMAGE_HASH, *PIMSCSI_IMAGE_HASH;
+
+typedef struct _IMSCSI_HASH_WORKER
+{
+    PIMSCSI_IMAGE_HASH ImageHash;
+    ULONG Algorithm;
+    LIST_ENTRY Queue;
+    KEVENT QueueEvent;
+    PKTHREAD Thread;
+    BCRYPT_ALG_HANDLE AlgHandle;
+    BCRYPT_HASH_HANDLE HashHandle;
+    PUCHAR HashObject;
+    PUCHAR Digest;
+    ULONG DigestLength;
+    LONGLONG BytesHashed;
+} IMSCSI_HASH_WORKER, *PIMSCSI_HASH_WORKER;
+
+struct _IMSCSI_IMAGE_HASH
+{
+    pHW_LU_EXTENSION pLUExt;
+    KSPIN_LOCK Lock;                // Protects queues and fields below.
+    ULONG Outstanding;              // Buffers not yet released by all hash threads.
+    ULONG Finished;                 // Hash threads that have final digests.
+    NTSTATUS Status;
+    BOOLEAN Complete;
+    LONGLONG NextOffset;            // Only used by LU worker thread.
+    LONGLONG DiskSize;
+    KEVENT Stop;
+    UCHAR MD5[16];
+    UCHAR SHA1[20];
+    UCHAR SHA256[32];
+    IMSCSI_HASH_WORKER Workers[IMSCSI_HASH_ALGORITHMS];
+};
+
+VOID
+ImScsiReleaseHashBuffer(__in PIMSCSI_IMAGE_HASH ImageHash,
+__in PIMSCSI_HASH_BUFFER Buffer)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if (InterlockedDecrement(&Buffer->RefCount) != 0)
+    {
+        return;
+    }
+
+    ExFreePoolWithTag(Buffer, MP_TAG_GENERAL);
+
+    ImScsiAcquireLock(&ImageHash->Lock, &LockHandle, lowest_assumed_irql);
+
+    ImageHash->Outstanding--;
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    // Room in queue, LU worker thread may read more when idle.
+    KeSetEvent(&ImageHash->pLUExt->Core.Queue.Event, (KPRIORITY)0, FALSE);
+}
+
+VOID
+ImScsiHashWorkerThread(__in PVOID Context)
+{
+    PIMSCSI_HASH_WORKER worker = (PIMSCSI_HASH_WORKER)Context;
+    PIMSCSI_IMAGE_HASH image_hash = worker->ImageHash;
+    PKEVENT wait_objects[] = {
+        &worker->QueueEvent,
+        &image_hash->Stop
+    };
+    NTSTATUS status = STATUS_SUCCESS;
+
+    KdPrint(("PhDskMnt::ImScsiHashWorkerThread: Start, algorithm %u.\n",
+        worker->Algorithm));
+
+    for (;;)
+    {
+        PLIST_ENTRY entry;
+        PIMSCSI_HASH_BUFFER buffer;
+        KLOCK_QUEUE_HANDLE LockHandle;
+        KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+        ImScsiAcquireLock(&image_hash->Lock, &LockHandle, lowest_assumed_irql);
+
+        entry = RemoveHeadList(&worker->Queue);
+
+        ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+        if (entry == &worker->Queue)
+        {
+            if (KeReadStateEvent(&image_hash->Stop))
+            {
+                break;
+            }
+
+            KeWaitForMultipleObjects(2, (PVOID*)wait_objects, WaitAny,
+                Executive, KernelMode, FALSE, NULL, NULL);
+
+            continue;
+        }
+
+        buffer = CONTAINING_RECORD(entry - worker->Algorithm,
+            IMSCSI_HASH_BUFFER, ListEntry);
+
+        if (NT_SUCCESS(status))
+        {
+            status = BCryptHashData(worker->HashHandle, buffer->Data,
+                buffer->Length, 0);
+
+            worker->BytesHashed += buffer->Length;
+        }
+
+        ImScsiReleaseHashBuffer(image_hash, buffer);
+
+        if (NT_SUCCESS(status) &&
+            (worker->BytesHashed >= image_hash->DiskSize))
+        {
+            status = BCryptFinishHash(worker->HashHandle, worker->Digest,
+                worker->DigestLength, 0);
+
+            if (NT_SUCCESS(status))
+            {
+                ImScsiAcquireLock(&image_hash->Lock, &LockHandle, lowest_assumed_irql);
+
+                if (++image_hash->Finished == IMSCSI_HASH_ALGORITHMS)
+                {
+                    image_hash->Complete = TRUE;
+                }
+
+                ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+                KdPrint(("PhDskMnt::ImScsiHashWorkerThread: Algorithm %u done, %I64i bytes.\n",
+                    worker->Algorithm, worker->BytesHashed));
+
+                // Nothing more is queued for this thread.
+                break;
+            }
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiHashWorkerThread: Hashing failed: %#x\n",
+                status);
+
+            ImScsiAcquireLock(&image_hash->Lock, &LockHandle, lowest_assumed_irql);
+
+            if (NT_SUCCESS(image_hash->Status))
+            {
+                image_hash->Status = status;
+            }
+
+            ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+        }
+    }
+
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+//
+// Stops hash threads and releases their resources. The digest state itself
+// stays in pLUExt->ImageHash, because ImScsiQueryHashDevice can still find
+// the LU in lookup table until ImScsiWaitForLULookups has returned. It is
+// freed by ImScsiFreeImageHash at the same point as LUExt.
+//
+VOID
+ImScsiStopImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_IMAGE_HASH image_hash = (PIMSCSI_IMAGE_HASH)pLUExt->ImageHash;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    if (image_hash == NULL)
+    {
+        return;
+    }
+
+    // No more buffers are queued, see ImScsiAllocateHashBuffer.
+    ImScsiAcquireLock(&image_hash->Lock, &LockHandle, lowest_assumed_irql);
+
+    if (NT_SUCCESS(image_hash->Status) && !image_hash->Complete)
+    {
+        image_hash->Status = STATUS_CANCELLED;
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    KeSetEvent(&image_hash->Stop, (KPRIORITY)0, FALSE);
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        PIMSCSI_HASH_WORKER worker = &image_hash->Workers[i];
+
+        if (worker->Thread != NULL)
+        {
+            KeWaitForSingleObject(worker->Thread, Executive, KernelMode,
+                FALSE, NULL);
+
+            ObDereferenceObject(worker->Thread);
+            worker->Thread = NULL;
+        }
+
+        // Buffers not hashed before thread exited.
+        while (!IsListEmpty(&worker->Queue))
+        {
+            PLIST_ENTRY entry = RemoveHeadList(&worker->Queue);
+
+            PIMSCSI_HASH_BUFFER buffer = CONTAINING_RECORD(entry - i,
+                IMSCSI_HASH_BUFFER, ListEntry);
+
+            if (InterlockedDecrement(&buffer->RefCount) == 0)
+            {
+                ExFreePoolWithTag(buffer, MP_TAG_GENERAL);
+            }
+        }
+
+        if (worker->HashHandle != NULL)
+        {
+            BCryptDestroyHash(worker->HashHandle);
+            worker->HashHandle = NULL;
+        }
+
+        if (worker->HashObject != NULL)
+        {
+            ExFreePoolWithTag(worker->HashObject, MP_TAG_GENERAL);
+            worker->HashObject = NULL;
+        }
+
+        if (worker->AlgHandle != NULL)
+        {
+            BCryptCloseAlgorithmProvider(worker->AlgHandle, 0);
+            worker->AlgHandle = NULL;
+        }
+    }
+}
+
+VOID
+ImScsiFreeImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_IMAGE_HASH image_hash = (PIMSCSI_IMAGE_HASH)pLUExt->ImageHash;
+
+    if (image_hash == NULL)
+    {
+        return;
+    }
+
+    ImScsiStopImageHash(pLUExt);
+
+    pLUExt->ImageHash = NULL;
+
+    ExFreePoolWithTag(image_hash, MP_TAG_GENERAL);
+}
+
+NTSTATUS
+ImScsiStartImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    LPCWSTR algorithm_names[IMSCSI_HASH_ALGORITHMS] = {
+        BCRYPT_MD5_ALGORITHM,
+        BCRYPT_SHA1_ALGORITHM,
+        BCRYPT_SHA256_ALGORITHM
+    };
+    PIMSCSI_IMAGE_HASH image_hash;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    image_hash = (PIMSCSI_IMAGE_HASH)ExAllocatePoolWithTag(NonPagedPool,
+        sizeof(IMSCSI_IMAGE_HASH), MP_TAG_GENERAL);
+
+    if (image_hash == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(image_hash, sizeof(IMSCSI_IMAGE_HASH));
+
+    image_hash->pLUExt = pLUExt;
+    image_hash->DiskSize = pLUExt->DiskSize.QuadPart;
+    KeInitializeSpinLock(&image_hash->Lock);
+    KeInitializeEvent(&image_hash->Stop, NotificationEvent, FALSE);
+
+    image_hash->Workers[0].Digest = image_hash->MD5;
+    image_hash->Workers[1].Digest = image_hash->SHA1;
+    image_hash->Workers[2].Digest = image_hash->SHA256;
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        PIMSCSI_HASH_WORKER worker = &image_hash->Workers[i];
+
+        worker->ImageHash = image_hash;
+        worker->Algorithm = i;
+        InitializeListHead(&worker->Queue);
+        KeInitializeEvent(&worker->QueueEvent, SynchronizationEvent, FALSE);
+    }
+
+    pLUExt->ImageHash = image_hash;
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        PIMSCSI_HASH_WORKER worker = &image_hash->Workers[i];
+        ULONG object_length;
+        ULONG digest_length;
+        ULONG result_length;
+        HANDLE thread_handle;
+
+        status = BCryptOpenAlgorithmProvider(&worker->AlgHandle,
+            algorithm_names[i], NULL, 0);
+
+        if (NT_SUCCESS(status))
+        {
+            status = BCryptGetProperty(worker->AlgHandle,
+                BCRYPT_OBJECT_LENGTH, (PUCHAR)&object_length,
+                sizeof(object_length), &result_length, 0);
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            status = BCryptGetProperty(worker->AlgHandle,
+                BCRYPT_HASH_LENGTH, (PUCHAR)&digest_length,
+                sizeof(digest_length), &result_length, 0);
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            worker->DigestLength = digest_length;
+
+            worker->HashObject = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+                object_length, MP_TAG_GENERAL);
+
+            if (worker->HashObject == NULL)
+            {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+            }
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            status = BCryptCreateHash(worker->AlgHandle, &worker->HashHandle,
+                worker->HashObject, object_length, NULL, 0, 0);
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            status = PsCreateSystemThread(
+                &thread_handle,
+                (ACCESS_MASK)0L,
+                NULL,
+                NULL,
+                NULL,
+                ImScsiHashWorkerThread,
+                worker);
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            status = ObReferenceObjectByHandle(
+                thread_handle,
+                FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                *PsThreadType,
+                KernelMode,
+                (PVOID*)&worker->Thread,
+                NULL);
+
+            ZwClose(thread_handle);
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiStartImageHash: Cannot initialize algorithm %u: %#x\n",
+                i, status);
+
+            worker->Thread = NULL;
+
+            ImScsiStopImageHash(pLUExt);
+
+            return status;
+        }
+    }
+
+    KdPrint(("PhDskMnt::ImScsiStartImageHash: Hashing %I64i bytes.\n",
+        image_hash->DiskSize));
+
+    return STATUS_SUCCESS;
+}
+
+PIMSCSI_HASH_BUFFER
+ImScsiAllocateHashBuffer(__in PIMSCSI_IMAGE_HASH ImageHash,
+__in ULONG Length)
+{
+    PIMSCSI_HASH_BUFFER buffer;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+    BOOLEAN queue_full;
+
+    ImScsiAcquireLock(&ImageHash->Lock, &LockHandle, lowest_assumed_irql);
+
+    queue_full = (ImageHash->Outstanding >= IMSCSI_HASH_QUEUE_DEPTH) ||
+        !NT_SUCCESS(ImageHash->Status);
+
+    if (!queue_full)
+    {
+        ImageHash->Outstanding++;
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    if (queue_full)
+    {
+        return NULL;
+    }
+
+    buffer = (PIMSCSI_HASH_BUFFER)ExAllocatePoolWithTag(PagedPool,
+        FIELD_OFFSET(IMSCSI_HASH_BUFFER, Data) + Length, MP_TAG_GENERAL);
+
+    if (buffer == NULL)
+    {
+        ImScsiAcquireLock(&ImageHash->Lock, &LockHandle, lowest_assumed_irql);
+
+        ImageHash->Outstanding--;
+
+        ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+        return NULL;
+    }
+
+    buffer->RefCount = IMSCSI_HASH_ALGORITHMS;
+    buffer->Length = Length;
+
+    return buffer;
+}
+
+VOID
+ImScsiQueueHashBuffer(__in PIMSCSI_IMAGE_HASH ImageHash,
+__in PIMSCSI_HASH_BUFFER Buffer)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    ImageHash->NextOffset += Buffer->Length;
+
+    ImScsiAcquireLock(&ImageHash->Lock, &LockHandle, lowest_assumed_irql);
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        InsertTailList(&ImageHash->Workers[i].Queue, &Buffer->ListEntry[i]);
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        KeSetEvent(&ImageHash->Workers[i].QueueEvent, (KPRIORITY)0, FALSE);
+    }
+}
+
+VOID
+ImScsiHashReadData(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in LONGLONG Offset,
+__in ULONG Length)
+{
+    PIMSCSI_IMAGE_HASH image_hash = (PIMSCSI_IMAGE_HASH)pLUExt->ImageHash;
+    PIMSCSI_HASH_BUFFER hash_buffer;
+    ULONG skip;
+
+    if ((image_hash == NULL) ||
+        (Offset > image_hash->NextOffset) ||
+        (Offset + Length <= image_hash->NextOffset))
+    {
+        return;
+    }
+
+    skip = (ULONG)(image_hash->NextOffset - Offset);
+
+    hash_buffer = ImScsiAllocateHashBuffer(image_hash, Length - skip);
+
+    if (hash_buffer == NULL)
+    {
+        return;
+    }
+
+    RtlCopyMemory(hash_buffer->Data, (PUCHAR)Buffer + skip, Length - skip);
+
+    ImScsiQueueHashBuffer(image_hash, hash_buffer);
+}
+
+BOOLEAN
+ImScsiHashIdle(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_IMAGE_HASH image_hash = (PIMSCSI_IMAGE_HASH)pLUExt->ImageHash;
+    PIMSCSI_HASH_BUFFER hash_buffer;
+    LARGE_INTEGER offset;
+    ULONG length;
+    NTSTATUS status;
+
+    if ((image_hash == NULL) ||
+        (image_hash->NextOffset >= image_hash->DiskSize))
+    {
+        return FALSE;
+    }
+
+    length = (ULONG)min(image_hash->DiskSize - image_hash->NextOffset,
+        IMSCSI_HASH_READ_SIZE);
+
+    hash_buffer = ImScsiAllocateHashBuffer(image_hash, length);
+
+    if (hash_buffer == NULL)
+    {
+        return FALSE;
+    }
+
+    offset.QuadPart = image_hash->NextOffset;
+
+    status = ImScsiReadDevice(pLUExt, hash_buffer->Data, &offset, &length);
+
+    if (!NT_SUCCESS(status) || (length != hash_buffer->Length))
+    {
+        KLOCK_QUEUE_HANDLE LockHandle;
+        KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+        DbgPrint("PhDskMnt::ImScsiHashIdle: Read failed at %I64i: %#x\n",
+            offset.QuadPart, status);
+
+        ImScsiAcquireLock(&image_hash->Lock, &LockHandle, lowest_assumed_irql);
+
+        image_hash->Status = NT_SUCCESS(status) ? STATUS_END_OF_FILE : status;
+        image_hash->Outstanding--;
+
+        ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+        ExFreePoolWithTag(hash_buffer, MP_TAG_GENERAL);
+
+        return FALSE;
+    }
+
+    ImScsiQueueHashBuffer(image_hash, hash_buffer);
+
+    return TRUE;
+}
+
+NTSTATUS
+ImScsiQueryHashDevice(
+__in            pHW_HBA_EXT             pHBAExt,
+__inout __deref PSRB_IMSCSI_QUERY_HASH  query_hash,
+__inout __deref PKIRQL                  LowestAssumedIrql
+)
+{
+    pHW_LU_EXTENSION device_extension;
+    PIMSCSI_IMAGE_HASH image_hash;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    NTSTATUS status;
+    UCHAR srb_status;
+
+    srb_status = ScsiGetLUExtension(
+        pHBAExt,
+        &device_extension,
+        query_hash->DeviceNumber.PathId,
+        query_hash->DeviceNumber.TargetId,
+        query_hash->DeviceNumber.Lun,
+        LowestAssumedIrql
+        );
+
+    if (srb_status != SRB_STATUS_SUCCESS)
+    {
+        KdPrint(("PhDskMnt::ImScsiQueryHashDevice: Device not found.\n"));
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    image_hash = (PIMSCSI_IMAGE_HASH)device_extension->ImageHash;
+
+    if (image_hash == NULL)
+    {
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    ImScsiAcquireLock(&image_hash->Lock, &LockHandle, *LowestAssumedIrql);
+
+    // Bytes hashed by all algorithms.
+    query_hash->BytesHashed.QuadPart = image_hash->DiskSize;
+
+    for (ULONG i = 0; i < IMSCSI_HASH_ALGORITHMS; i++)
+    {
+        query_hash->BytesHashed.QuadPart = min(query_hash->BytesHashed.QuadPart,
+            image_hash->Workers[i].BytesHashed);
+    }
+
+    query_hash->DiskSize.QuadPart = image_hash->DiskSize;
+    query_hash->Complete = image_hash->Complete;
+    status = image_hash->Status;
+
+    if (image_hash->Complete)
+    {
+        RtlCopyMemory(query_hash->MD5, image_hash->MD5, sizeof(query_hash->MD5));
+        RtlCopyMemory(query_hash->SHA1, image_hash->SHA1, sizeof(query_hash->SHA1));
+        RtlCopyMemory(query_hash->SHA256, image_hash->SHA256, sizeof(query_hash->SHA256));
+    }
+
+    ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
+
+    return status;
+}
+
+#else
+
+// Kernel mode CNG is not available before Windows Vista.
+
+NTSTATUS
+ImScsiStartImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+VOID
+ImScsiStopImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+}
+
+VOID
+ImScsiFreeImageHash(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+}
+
+VOID
+ImScsiHashReadData(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in LONGLONG Offset,
+__in ULONG Length)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(Offset);
+    UNREFERENCED_PARAMETER(Length);
+}
+
+BOOLEAN
+ImScsiHashIdle(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+
+    return FALSE;
+}
+
+NTSTATUS
+ImScsiQueryHashDevice(
+__in            pHW_HBA_EXT             pHBAExt,
+__inout __deref PSRB_IMSCSI_QUERY_HASH  query_hash,
+__inout __deref PKIRQL                  LowestAssumedIrql
+)
+{
+    UNREFERENCED_PARAMETER(pHBAExt);
+    UNREFERENCED_PARAMETER(query_hash);
+    UNREFERENCED_PARAMETER(LowestAssumedIrql);
+
+    return STATUS_INVALID_DEVICE_REQUEST;
+}
+
+#endif
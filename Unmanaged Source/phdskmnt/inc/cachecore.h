@@ -0,0 +1,129 @@
+/// cachecore.h
+/// Persistent cache file for slow back ends, such as proxy services for
+/// images on network shares. Cache file and image are accessed through
+/// IMSCSI_CORE_BACKEND routines, so the same code is used by the driver,
+/// see proxycache.cpp, and by the user mode harness in iobench.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _CACHECORE_H_
+#define _CACHECORE_H_
+
+#include "iocore.h"
+
+#define IMSCSI_CACHE_CORE_BLOCK_SHIFT       16       // Cache files store 64 KB blocks of images
+#define IMSCSI_CACHE_CORE_BLOCK_SIZE        (1UL << IMSCSI_CACHE_CORE_BLOCK_SHIFT)
+#define IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS    16       // Missing blocks read from image in one request
+
+#define IMSCSI_CACHE_CORE_IDENTITY_SIZE     16
+
+#define IMSCSI_CACHE_CORE_POLICY_CLOCK      0
+#define IMSCSI_CACHE_CORE_POLICY_FIFO       1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Open cache file. Only accessed from one thread at a time, in driver the
+/// worker thread of the LU.
+///
+typedef struct _IMSCSI_CACHE_CORE
+{
+    const IMSCSI_CORE_BACKEND  *CacheFile;
+    PVOID                       CacheFileContext;
+    const IMSCSI_CORE_BACKEND  *Image;
+    PVOID                       ImageContext;
+    ULONG                       Slots;
+    ULONG                       Policy;
+    ULONG                       Hand;
+    UCHAR                       Identity[IMSCSI_CACHE_CORE_IDENTITY_SIZE];
+    ULONGLONG                   Generation;
+    BOOLEAN                     Modified;       // Image written since cache was opened.
+    LONGLONG                    ImageSize;
+    LONGLONG                    DataOffset;
+    PULONGLONG                  Index;          // Image block number + 1 for each slot, 0 if slot is free.
+    PULONG                      HashHeads;      // First slot + 1 for each bucket, 0 if bucket is empty.
+    PULONG                      HashNext;       // Next slot + 1 in same bucket for each slot.
+    ULONG                       HashMask;
+    PULONG                      Referenced;     // Bit for each slot read since clock hand passed it.
+    PUCHAR                      RunBuffer;      // IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS blocks read from image.
+    ULONGLONG                   Hits;
+    ULONGLONG                   Misses;
+} IMSCSI_CACHE_CORE, *PIMSCSI_CACHE_CORE;
+
+///
+/// Opens cache for an image with up to MaxSlots blocks in cache file.
+/// Index in cache file is used if it was saved for an image with same
+/// Identity, Generation and ImageSize, otherwise cache starts empty.
+/// Cache is zeroed by caller. Returns an error if cache file cannot be
+/// written.
+///
+NTSTATUS
+ImScsiCacheCoreOpen(
+    PIMSCSI_CACHE_CORE          Cache,
+    const IMSCSI_CORE_BACKEND  *CacheFile,
+    PVOID                       CacheFileContext,
+    const IMSCSI_CORE_BACKEND  *Image,
+    PVOID                       ImageContext,
+    LONGLONG                    ImageSize,
+    ULONGLONG                   MaxSlots,
+    ULONG                       Policy,
+    const UCHAR                *Identity,
+    ULONGLONG                   Generation);
+
+///
+/// Saves index to cache file and frees memory used by Cache. Generation
+/// is generation of image at close, after writes made through this
+/// cache. If image was not written through this cache and Generation
+/// differs from generation at open, image was modified elsewhere and
+/// cache file is left to be discarded on next open.
+///
+NTSTATUS
+ImScsiCacheCoreClose(
+    PIMSCSI_CACHE_CORE          Cache,
+    ULONGLONG                   Generation);
+
+///
+/// Frees memory used by Cache without saving index.
+///
+VOID
+ImScsiCacheCoreFree(
+    PIMSCSI_CACHE_CORE          Cache);
+
+///
+/// Reads from image through cache. Blocks missing in cache are read from
+/// image and stored in cache file. Hits and Misses receive number of
+/// blocks found and not found in cache.
+///
+NTSTATUS
+ImScsiCacheCoreRead(
+    PIMSCSI_CACHE_CORE          Cache,
+    PVOID                       Buffer,
+    LONGLONG                    Offset,
+    PULONG                      Length,
+    PULONG                      Hits,
+    PULONG                      Misses);
+
+///
+/// Removes blocks in a range from cache. Called for each write, zero and
+/// unmap request to image.
+///
+VOID
+ImScsiCacheCoreInvalidate(
+    PIMSCSI_CACHE_CORE          Cache,
+    LONGLONG                    Offset,
+    LONGLONG                    Length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CACHECORE_H_
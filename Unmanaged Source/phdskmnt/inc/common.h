@@ -109,6 +109,45 @@
 /// Report a fake disk signature if zero
 #define IMSCSI_FAKE_DISK_SIG_IF_ZERO    0x00020000
 
+/// Load image file into VM disk on demand and in background instead of
+/// reading the whole image before the device is brought online
+#define IMSCSI_VM_LAZY_LOAD             0x00040000
+
+/// Compress VM disk contents that have not been used recently
+#define IMSCSI_VM_COMPRESS              0x00080000
+
+/// Store identical blocks of VM disk contents only once
+#define IMSCSI_VM_DEDUP                 0x00100000
+
+/// Never write to image file or proxy. Writes go to a differencing file and
+/// reads are merged from differencing file and image. FileName holds image
+/// file name followed by a null character and differencing file name.
+#define IMSCSI_WRITE_OVERLAY            0x00200000
+
+/// Image is split into several segment files, such as image.001, image.002
+/// and so on. FileName holds segment file names in image order, separated
+/// by null characters. Only valid for file type virtual disks.
+#define IMSCSI_MULTI_SEGMENT            0x00400000
+
+/// Compute MD5, SHA-1 and SHA-256 digests of virtual disk contents while
+/// reads are served, reading parts not yet read when idle. Digests are
+/// queried with SMP_IMSCSI_QUERY_HASH. Only valid for read-only virtual
+/// disks without write overlay.
+#define IMSCSI_HASH_IMAGE               0x00800000
+
+/// Check data read from image against chunk hashes in a Merkle index file,
+/// named as the image file with IMSCSI_MERKLE_INDEX_SUFFIX appended. Each
+/// chunk is checked once, the first time it is read. Only valid for
+/// read-only virtual disks without write overlay.
+#define IMSCSI_VERIFY_IMAGE             0x01000000
+
+/// Complete writes when they are in system file cache instead of on disk.
+/// Cached data is flushed on SYNCHRONIZE CACHE, writes with FUA bit set,
+/// shutdown, removal of virtual disk and when WriteBackLimit MB has been
+/// written since last flush. Parallel I/O image files are written without
+/// write-through instead. Only valid for image files and write overlays.
+#define IMSCSI_WRITE_BACK               0x02000000
+
 /// Specify as device number to remove all devices.
 #define IMSCSI_ALL_DEVICES              (0x00FFFFFFUL)
 
@@ -310,6 +349,257 @@ typedef struct {
 
 } SRB_IMSCSI_EXTEND_DEVICE, *PSRB_IMSCSI_EXTEND_DEVICE;
 
+///
+/// Structure used with SMP_IMSCSI_DISCARD_OVERLAY and
+/// SMP_IMSCSI_COMMIT_OVERLAY calls.
+///
+typedef struct {
+    /// SRB_IO_CONTROL header
+    SRB_IO_CONTROL  SrbIoControl;
+
+    DEVICE_NUMBER   DeviceNumber;
+
+} SRB_IMSCSI_WRITE_OVERLAY, *PSRB_IMSCSI_WRITE_OVERLAY;
+
+///
+/// Structure used with SMP_IMSCSI_QUERY_HASH calls, for virtual disks
+/// created with IMSCSI_HASH_IMAGE.
+///
+typedef struct {
+    /// SRB_IO_CONTROL header
+    SRB_IO_CONTROL  SrbIoControl;
+
+    DEVICE_NUMBER   DeviceNumber;
+
+    /// Number of bytes from start of virtual disk included in digests.
+    LARGE_INTEGER   BytesHashed;
+
+    LARGE_INTEGER   DiskSize;
+
+    /// Digests below are valid when set.
+    BOOLEAN         Complete;
+
+    UCHAR           MD5[16];
+
+    UCHAR           SHA1[20];
+
+    UCHAR           SHA256[32];
+
+} SRB_IMSCSI_QUERY_HASH, *PSRB_IMSCSI_QUERY_HASH;
+
+///
+/// Operation classes in IMSCSI_LU_STATISTICS. WRITE SAME is counted as
+/// write, commands other than read, write and UNMAP as other.
+///
+#define IMSCSI_STAT_READ                0
+#define IMSCSI_STAT_WRITE               1
+#define IMSCSI_STAT_UNMAP               2
+#define IMSCSI_STAT_OTHER               3
+#define IMSCSI_STAT_CLASSES             4
+
+///
+/// Latency histogram bucket n counts requests that took less than
+/// 2^n microseconds, but not less than 2^(n-1). Last bucket also counts
+/// everything slower.
+///
+#define IMSCSI_STAT_LATENCY_BUCKETS     32
+
+typedef struct {
+    LONGLONG        Requests;
+
+    /// Bytes in data phase of completed requests.
+    LONGLONG        Bytes;
+
+    /// Requests completed with other status than SRB_STATUS_SUCCESS.
+    LONGLONG        Errors;
+
+    /// Sum of latencies, in microseconds, from request queued in driver
+    /// to done.
+    LONGLONG        LatencyTotal;
+
+    LONGLONG        Latency[IMSCSI_STAT_LATENCY_BUCKETS];
+
+} IMSCSI_OPERATION_STATISTICS, *PIMSCSI_OPERATION_STATISTICS;
+
+typedef struct {
+    IMSCSI_OPERATION_STATISTICS Operations[IMSCSI_STAT_CLASSES];
+
+    /// Blocks found in block cache or proxy cache, and reads served
+    /// from last I/O buffer.
+    LONGLONG        CacheHits;
+
+    /// Blocks read from image file or proxy into cache.
+    LONGLONG        CacheMisses;
+
+    /// Requests sent to proxy service.
+    LONGLONG        ProxyRoundTrips;
+
+    /// Requests queued in driver but not yet done.
+    LONG            QueueDepth;
+
+} IMSCSI_LU_STATISTICS, *PIMSCSI_LU_STATISTICS;
+
+///
+/// Structure used with SMP_IMSCSI_QUERY_STATISTICS calls. Counters are
+/// collected from creation of virtual disk.
+///
+typedef struct {
+    /// SRB_IO_CONTROL header
+    SRB_IO_CONTROL  SrbIoControl;
+
+    DEVICE_NUMBER   DeviceNumber;
+
+    IMSCSI_LU_STATISTICS Statistics;
+
+} SRB_IMSCSI_QUERY_STATISTICS, *PSRB_IMSCSI_QUERY_STATISTICS;
+
+///
+/// Stages of SCSI requests recorded in SRB trace. Requests completed
+/// directly by miniport only have IMSCSI_TRACE_START_IO and
+/// IMSCSI_TRACE_COMPLETE records. Requests sent to lower driver of a
+/// parallel I/O image file have no IMSCSI_TRACE_DEQUEUED record.
+///
+#define IMSCSI_TRACE_START_IO           0   // Received from port driver.
+#define IMSCSI_TRACE_QUEUED             1   // Queued for worker thread.
+#define IMSCSI_TRACE_DEQUEUED           2   // Picked up by worker thread.
+#define IMSCSI_TRACE_BACKEND_SUBMIT     3   // Sent to image file, proxy or memory.
+#define IMSCSI_TRACE_BACKEND_DONE       4
+#define IMSCSI_TRACE_COMPLETE           5   // Completion sent to port driver.
+#define IMSCSI_TRACE_STAGES             6
+
+#define IMSCSI_TRACE_DEFAULT_CAPACITY   65536
+#define IMSCSI_TRACE_MAX_CAPACITY       262144
+
+typedef struct {
+    /// Counts events since tracing was first started.
+    ULONGLONG       Sequence;
+
+    /// Performance counter value when event was recorded.
+    LONGLONG        Timestamp;
+
+    /// Address of SRB, same for all events of a request.
+    ULONGLONG       Request;
+
+    /// First block of read, write and WRITE SAME requests.
+    LONGLONG        LogicalBlock;
+
+    ULONG           DataTransferLength;
+
+    DEVICE_NUMBER   DeviceNumber;
+
+    UCHAR           Stage;
+
+    /// Operation code from CDB.
+    UCHAR           Operation;
+
+    /// Status of request, meaningful in IMSCSI_TRACE_COMPLETE records.
+    UCHAR           SrbStatus;
+
+    UCHAR           ScsiStatus;
+
+    ULONG           Processor;
+
+} IMSCSI_TRACE_RECORD, *PIMSCSI_TRACE_RECORD;
+
+///
+/// Structure used with SMP_IMSCSI_SET_TRACE calls. Only SCSI requests
+/// are traced. Trace buffer is allocated first time tracing is started
+/// and kept until driver unloads, stopping and starting again continues
+/// sequence numbers in the same buffer.
+///
+typedef struct {
+    /// SRB_IO_CONTROL header
+    SRB_IO_CONTROL  SrbIoControl;
+
+    /// TRUE to start tracing, FALSE to stop.
+    BOOLEAN         Enable;
+
+    /// Number of records in trace buffer, or 0 for default. Upon return,
+    /// actual size of buffer, which could have been allocated earlier
+    /// with another size.
+    ULONG           Capacity;
+
+    /// Upon return, performance counter frequency of timestamps.
+    LONGLONG        Frequency;
+
+} SRB_IMSCSI_SET_TRACE, *PSRB_IMSCSI_SET_TRACE;
+
+///
+/// Structure used with SMP_IMSCSI_READ_TRACE calls.
+///
+typedef struct {
+    /// SRB_IO_CONTROL header
+    SRB_IO_CONTROL  SrbIoControl;
+
+    /// Sequence number of first record to read. Upon return, sequence
+    /// number to read from next time.
+    ULONGLONG       Sequence;
+
+    /// Upon return, number of records from Sequence that were
+    /// overwritten before they could be read.
+    ULONGLONG       Lost;
+
+    /// Upon return, number of records in Records.
+    ULONG           NumberOfRecords;
+
+    IMSCSI_TRACE_RECORD Records[];
+
+} SRB_IMSCSI_READ_TRACE, *PSRB_IMSCSI_READ_TRACE;
+
+///
+/// SRB trace file, written by aim_ll --trace. Header is followed by
+/// IMSCSI_TRACE_RECORD structures in sequence order.
+///
+#define IMSCSI_TRACE_FILE_SIGNATURE     "AIMTRACE"
+#define IMSCSI_TRACE_FILE_VERSION       1
+
+typedef struct {
+    CHAR            Signature[8];
+
+    ULONG           Version;
+
+    ULONG           RecordSize;
+
+    /// Performance counter frequency of timestamps.
+    LONGLONG        Frequency;
+
+    /// Records lost while trace was captured.
+    ULONGLONG       Lost;
+
+} IMSCSI_TRACE_FILE_HEADER, *PIMSCSI_TRACE_FILE_HEADER;
+
+///
+/// Merkle index file for an image. Header is followed, at offset
+/// IMSCSI_MERKLE_HEADER_SIZE, by a SHA-256 leaf hash for each chunk of the
+/// image in order. Leaf hashes are computed over a zero byte followed by
+/// chunk data, the last chunk may be shorter than others. Nodes are hashed
+/// over a one byte followed by left and right child hashes. A node without
+/// a right sibling moves up unchanged to next level.
+///
+#define IMSCSI_MERKLE_INDEX_SUFFIX      L".aimidx"
+#define IMSCSI_MERKLE_SIGNATURE         "AIMMRKL"
+#define IMSCSI_MERKLE_VERSION           1
+#define IMSCSI_MERKLE_HEADER_SIZE       4096
+#define IMSCSI_MERKLE_HASH_SIZE         32
+#define IMSCSI_MERKLE_MIN_CHUNK_SHIFT   12
+#define IMSCSI_MERKLE_MAX_CHUNK_SHIFT   24
+#define IMSCSI_MERKLE_DEFAULT_CHUNK_SHIFT 20
+#define IMSCSI_MERKLE_DEFAULT_SAMPLE_CHUNKS 64
+
+typedef struct {
+    CHAR            Signature[8];
+
+    ULONG           Version;
+
+    /// Chunk size is 1 << ChunkShift bytes.
+    ULONG           ChunkShift;
+
+    LARGE_INTEGER   ImageSize;
+
+    UCHAR           Root[IMSCSI_MERKLE_HASH_SIZE];
+
+} IMSCSI_MERKLE_HEADER, *PIMSCSI_MERKLE_HEADER;
+
 typedef struct {
     /// SRB_IO_CONTROL header
     SRB_IO_CONTROL  SrbIoControl;
@@ -363,6 +653,12 @@ ULONG Timeout)
 #define SMP_IMSCSI_SET_DEVICE_FLAGS     ((ULONG) (SMP_IMSCSI | 0x805))
 #define SMP_IMSCSI_REMOVE_DEVICE        ((ULONG) (SMP_IMSCSI | 0x806))
 #define SMP_IMSCSI_EXTEND_DEVICE        ((ULONG) (SMP_IMSCSI | 0x807))
+#define SMP_IMSCSI_DISCARD_OVERLAY      ((ULONG) (SMP_IMSCSI | 0x808))
+#define SMP_IMSCSI_COMMIT_OVERLAY       ((ULONG) (SMP_IMSCSI | 0x809))
+#define SMP_IMSCSI_QUERY_HASH           ((ULONG) (SMP_IMSCSI | 0x80A))
+#define SMP_IMSCSI_QUERY_STATISTICS     ((ULONG) (SMP_IMSCSI | 0x80B))
+#define SMP_IMSCSI_SET_TRACE            ((ULONG) (SMP_IMSCSI | 0x80C))
+#define SMP_IMSCSI_READ_TRACE           ((ULONG) (SMP_IMSCSI | 0x80D))
 
 #define IMSCSI_API_NO_BROADCAST_NOTIFY  0x00000001
 #define IMSCSI_API_FORCE_DISMOUNT       0x00000002
@@ -0,0 +1,371 @@
+/// iocore.h
+/// Request queue, last I/O cache and back-end dispatch of read and write
+/// requests. Built into the driver, where phdskmnt.h supplies the kernel
+/// primitives, and into the user mode benchmark harness in iobench, where
+/// IMSCSI_CORE_USER_MODE selects the pthread based primitives below.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _IOCORE_H_
+#define _IOCORE_H_
+
+#include "rwcore.h"
+
+#ifdef IMSCSI_CORE_USER_MODE
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef void VOID, *PVOID;
+typedef UCHAR *PUCHAR;
+typedef ULONG *PULONG;
+typedef LONGLONG *PLONGLONG;
+typedef ULONGLONG *PULONGLONG;
+typedef int32_t LONG;
+typedef LONG NTSTATUS;
+typedef UCHAR KIRQL, *PKIRQL;
+
+#define NT_SUCCESS(Status)                  (((NTSTATUS)(Status)) >= 0)
+
+#define STATUS_SUCCESS                      ((NTSTATUS)0x00000000L)
+#define STATUS_DEVICE_BUSY                  ((NTSTATUS)0x80000011L)
+#define STATUS_NOT_IMPLEMENTED              ((NTSTATUS)0xC0000002L)
+#define STATUS_INVALID_PARAMETER            ((NTSTATUS)0xC000000DL)
+#define STATUS_END_OF_FILE                  ((NTSTATUS)0xC0000011L)
+#define STATUS_OBJECT_TYPE_MISMATCH         ((NTSTATUS)0xC0000024L)
+#define STATUS_DATA_ERROR                   ((NTSTATUS)0xC000003EL)
+#define STATUS_INSUFFICIENT_RESOURCES       ((NTSTATUS)0xC000009AL)
+#define STATUS_NOT_SUPPORTED                ((NTSTATUS)0xC00000BBL)
+#define STATUS_FILE_CORRUPT_ERROR           ((NTSTATUS)0xC0000102L)
+#define STATUS_IO_DEVICE_ERROR              ((NTSTATUS)0xC0000185L)
+#define STATUS_INVALID_BUFFER_SIZE          ((NTSTATUS)0xC0000206L)
+
+#define PASSIVE_LEVEL                       0
+
+#define SRB_STATUS_SUCCESS                  0x01
+#define SRB_STATUS_BUSY                     0x05
+#define SRB_STATUS_ERROR                    0x04
+#define SRB_STATUS_PARITY_ERROR             0x0F
+
+#define SCSI_SENSE_NO_SENSE                 0x00
+#define SCSI_SENSE_NOT_READY                0x02
+#define SCSI_SENSE_MEDIUM_ERROR             0x03
+#define SCSI_SENSE_HARDWARE_ERROR           0x04
+#define SCSI_SENSE_ILLEGAL_REQUEST          0x05
+#define SCSI_SENSE_DATA_PROTECT             0x07
+
+#define SCSI_ADSENSE_NO_SENSE               0x00
+#define SCSI_ADSENSE_LUN_NOT_READY          0x04
+#define SCSI_ADSENSE_UNRECOVERED_ERROR      0x11
+#define SCSI_ADSENSE_ILLEGAL_BLOCK          0x21
+#define SCSI_ADSENSE_INVALID_CDB            0x24
+#define SCSI_ADSENSE_WRITE_PROTECT          0x27
+#define SCSI_SENSEQ_BECOMING_READY          0x01
+
+typedef struct _LIST_ENTRY {
+    struct _LIST_ENTRY *Flink;
+    struct _LIST_ENTRY *Blink;
+} LIST_ENTRY, *PLIST_ENTRY;
+
+#define CONTAINING_RECORD(address, type, field) \
+    ((type *)((char *)(address) - offsetof(type, field)))
+
+FORCEINLINE
+VOID
+InitializeListHead(PLIST_ENTRY ListHead)
+{
+    ListHead->Flink = ListHead->Blink = ListHead;
+}
+
+FORCEINLINE
+VOID
+InsertTailList(PLIST_ENTRY ListHead, PLIST_ENTRY Entry)
+{
+    Entry->Flink = ListHead;
+    Entry->Blink = ListHead->Blink;
+    ListHead->Blink->Flink = Entry;
+    ListHead->Blink = Entry;
+}
+
+FORCEINLINE
+PLIST_ENTRY
+RemoveHeadList(PLIST_ENTRY ListHead)
+{
+    PLIST_ENTRY entry = ListHead->Flink;
+
+    entry->Flink->Blink = ListHead;
+    ListHead->Flink = entry->Flink;
+
+    return entry;
+}
+
+typedef pthread_mutex_t IMSCSI_CORE_LOCK, *PIMSCSI_CORE_LOCK;
+
+typedef struct _IMSCSI_CORE_LOCK_HANDLE {
+    PIMSCSI_CORE_LOCK   Lock;
+} IMSCSI_CORE_LOCK_HANDLE, *PIMSCSI_CORE_LOCK_HANDLE;
+
+///
+/// Auto-reset event, same semantics as a kernel SynchronizationEvent.
+///
+typedef struct _IMSCSI_CORE_EVENT {
+    pthread_mutex_t     Mutex;
+    pthread_cond_t      Cond;
+    BOOLEAN             Signalled;
+} IMSCSI_CORE_EVENT, *PIMSCSI_CORE_EVENT;
+
+FORCEINLINE
+VOID
+ImScsiCoreInitializeLock(PIMSCSI_CORE_LOCK Lock)
+{
+    pthread_mutex_init(Lock, NULL);
+}
+
+FORCEINLINE
+VOID
+ImScsiCoreAcquireLock(PIMSCSI_CORE_LOCK Lock,
+    PIMSCSI_CORE_LOCK_HANDLE LockHandle, KIRQL LowestAssumedIrql)
+{
+    (void)LowestAssumedIrql;
+    pthread_mutex_lock(Lock);
+    LockHandle->Lock = Lock;
+}
+
+FORCEINLINE
+VOID
+ImScsiCoreReleaseLock(PIMSCSI_CORE_LOCK_HANDLE LockHandle,
+    PKIRQL LowestAssumedIrql)
+{
+    (void)LowestAssumedIrql;
+    pthread_mutex_unlock(LockHandle->Lock);
+}
+
+FORCEINLINE
+VOID
+ImScsiCoreInitializeEvent(PIMSCSI_CORE_EVENT Event)
+{
+    pthread_mutex_init(&Event->Mutex, NULL);
+    pthread_cond_init(&Event->Cond, NULL);
+    Event->Signalled = FALSE;
+}
+
+FORCEINLINE
+VOID
+ImScsiCoreSetEvent(PIMSCSI_CORE_EVENT Event)
+{
+    pthread_mutex_lock(&Event->Mutex);
+    Event->Signalled = TRUE;
+    pthread_cond_signal(&Event->Cond);
+    pthread_mutex_unlock(&Event->Mutex);
+}
+
+FORCEINLINE
+VOID
+ImScsiCoreWaitEvent(PIMSCSI_CORE_EVENT Event)
+{
+    pthread_mutex_lock(&Event->Mutex);
+    while (!Event->Signalled)
+    {
+        pthread_cond_wait(&Event->Cond, &Event->Mutex);
+    }
+    Event->Signalled = FALSE;
+    pthread_mutex_unlock(&Event->Mutex);
+}
+
+///
+/// Page aligned, as non-paged pool allocations of a page or more, so that
+/// image files opened with O_DIRECT can be read into it.
+///
+FORCEINLINE
+PVOID
+ImScsiCoreAllocate(size_t Size)
+{
+    PVOID block;
+
+    if (posix_memalign(&block, 4096, Size) != 0)
+    {
+        return NULL;
+    }
+
+    return block;
+}
+
+#define ImScsiCoreFree(Block)               free(Block)
+
+#else
+
+typedef KSPIN_LOCK IMSCSI_CORE_LOCK, *PIMSCSI_CORE_LOCK;
+typedef KLOCK_QUEUE_HANDLE IMSCSI_CORE_LOCK_HANDLE, *PIMSCSI_CORE_LOCK_HANDLE;
+typedef KEVENT IMSCSI_CORE_EVENT, *PIMSCSI_CORE_EVENT;
+
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Back end of a virtual disk. Offsets are relative to start of virtual
+/// disk. Read and Write update Length with number of bytes transferred.
+/// Flush is NULL if back end has nothing to write back.
+///
+typedef struct _IMSCSI_CORE_BACKEND
+{
+    NTSTATUS (*Read)(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length);
+
+    NTSTATUS (*Write)(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length);
+
+    NTSTATUS (*Flush)(PVOID Context);
+} IMSCSI_CORE_BACKEND, *PIMSCSI_CORE_BACKEND;
+
+///
+/// Requests waiting for worker thread of an LU, linked through a
+/// LIST_ENTRY in each request. Event is set each time a request is added.
+///
+typedef struct _IMSCSI_CORE_QUEUE
+{
+    LIST_ENTRY          List;
+    IMSCSI_CORE_LOCK    Lock;
+    IMSCSI_CORE_EVENT   Event;
+} IMSCSI_CORE_QUEUE, *PIMSCSI_CORE_QUEUE;
+
+///
+/// Data of last read or write request, so that small reads within the
+/// same range can be served without queueing. Buffer is NULL when empty.
+///
+typedef struct _IMSCSI_CORE_LAST_IO
+{
+    PVOID               Buffer;
+    LONGLONG            StartSector;
+    ULONG               Length;
+    IMSCSI_CORE_LOCK    Lock;
+} IMSCSI_CORE_LAST_IO, *PIMSCSI_CORE_LAST_IO;
+
+///
+/// Per LU state of request path.
+///
+typedef struct _IMSCSI_CORE_LU
+{
+    const IMSCSI_CORE_BACKEND  *Backend;
+    PVOID                       Context;        // Passed to Backend routines.
+    IMSCSI_CORE_QUEUE           Queue;
+    IMSCSI_CORE_LAST_IO         LastIo;
+    BOOLEAN                     WriteBack;      // Writes complete before flushed to back end.
+    LONGLONG                    WriteBackDirty; // Bytes written since last flush.
+    LONGLONG                    WriteBackLimit; // Flush when WriteBackDirty reaches this.
+} IMSCSI_CORE_LU, *PIMSCSI_CORE_LU;
+
+///
+/// How to complete an SRB that failed with an NTSTATUS. SenseKey is
+/// SCSI_SENSE_NO_SENSE if only SrbStatus is to be set.
+///
+typedef struct _IMSCSI_CORE_SENSE
+{
+    UCHAR               SrbStatus;
+    UCHAR               SenseKey;
+    UCHAR               AdditionalSenseCode;
+    UCHAR               AdditionalSenseCodeQualifier;
+} IMSCSI_CORE_SENSE, *PIMSCSI_CORE_SENSE;
+
+VOID
+ImScsiCoreInitializeQueue(
+    PIMSCSI_CORE_QUEUE          Queue);
+
+///
+/// Adds Entry last in Queue and sets queue event.
+///
+VOID
+ImScsiCoreQueueInsert(
+    PIMSCSI_CORE_QUEUE          Queue,
+    PLIST_ENTRY                 Entry,
+    PKIRQL                      LowestAssumedIrql);
+
+///
+/// Removes first entry in Queue. Returns NULL if Queue is empty.
+///
+PLIST_ENTRY
+ImScsiCoreQueueRemove(
+    PIMSCSI_CORE_QUEUE          Queue,
+    PKIRQL                      LowestAssumedIrql);
+
+VOID
+ImScsiCoreInitializeLU(
+    PIMSCSI_CORE_LU             Lu,
+    const IMSCSI_CORE_BACKEND  *Backend,
+    PVOID                       Context);
+
+///
+/// Copies data for a read request from last I/O buffer to Destination.
+/// Returns FALSE without copying anything if data is not entirely within
+/// last I/O buffer.
+///
+BOOLEAN
+ImScsiCoreReadLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    const IMSCSI_RW_REQUEST    *Request,
+    ULONG                       DataTransferLength,
+    UCHAR                       BlockPower,
+    PVOID                       Destination,
+    PKIRQL                      LowestAssumedIrql);
+
+///
+/// Replaces last I/O buffer with Buffer, allocated with ImScsiCoreAllocate.
+/// Buffer is owned and later freed by LastIo.
+///
+VOID
+ImScsiCoreStoreLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    LONGLONG                    StartSector,
+    ULONG                       Length,
+    PVOID                       Buffer,
+    PKIRQL                      LowestAssumedIrql);
+
+VOID
+ImScsiCoreDropLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    PKIRQL                      LowestAssumedIrql);
+
+///
+/// Serves a decoded read or write request through back end of Lu, using
+/// an intermediate buffer that is kept as last I/O buffer afterwards.
+/// Length is data transfer length of request on entry and bytes
+/// transferred on return.
+///
+NTSTATUS
+ImScsiCoreDispatchReadWrite(
+    PIMSCSI_CORE_LU             Lu,
+    const IMSCSI_RW_REQUEST    *Request,
+    PVOID                       SystemBuffer,
+    PULONG                      Length,
+    BOOLEAN                     ForceUnitAccess,
+    PKIRQL                      LowestAssumedIrql);
+
+///
+/// Flushes back end and resets write-back accounting of Lu.
+///
+NTSTATUS
+ImScsiCoreFlush(
+    PIMSCSI_CORE_LU             Lu);
+
+///
+/// SRB status and sense data for a request that failed with Status.
+///
+VOID
+ImScsiCoreGetSense(
+    NTSTATUS                    Status,
+    PIMSCSI_CORE_SENSE          Sense);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _IOCORE_H_
@@ -156,4 +156,14 @@ ImScsiUnmapOrZeroProxy(
     __in ULONG Items,
     __in __deref PDEVICE_DATA_SET_RANGE Ranges);
 
+NTSTATUS
+ImScsiQueryAllocatedRangesProxy(
+    __in __deref PPROXY_CONNECTION Proxy,
+    __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+    __in __deref PKEVENT CancelEvent,
+    __in LONGLONG Offset,
+    __in LONGLONG Length,
+    __out_ecount(MaxItems) PDEVICE_DATA_SET_RANGE Ranges,
+    __in ULONG MaxItems);
+
 #pragma warning(pop)
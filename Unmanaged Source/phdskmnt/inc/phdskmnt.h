@@ -79,7 +79,9 @@ extern "C" {
 #pragma warning(disable: 4201)
 
 #include "common.h"
+#include "rwcore.h"
 #include "imdproxy.h"
+#include "proxyext.h"
 #include "phdskmntver.h"
 
 #if !defined(_MP_User_Mode_Only)                      // User-mode only.
@@ -91,6 +93,9 @@ extern "C" {
 
 #endif // !defined(_MP_H_skip_includes)
 
+#include "iocore.h"
+#include "cachecore.h"
+
 #define VENDOR_ID                   L"Arsenal Recon "
 #define VENDOR_ID_ascii             "Arsenal Recon "
 #define PRODUCT_ID                  L"Virtual "
@@ -99,8 +104,9 @@ extern "C" {
 #define PRODUCT_REV_ascii           "0001"
 #define MP_TAG_GENERAL              'cSmI'
 
-#define MAX_TARGETS                 8
-#define MAX_LUNS                    24
+#define MAX_BUSES                   8         // Same as SCSI_MAXIMUM_BUSES
+#define IMSCSI_MAXIMUM_TARGETS      128       // Upper limit for MaximumTargets registry value
+#define IMSCSI_MAXIMUM_LUNS         254       // Upper limit for MaximumLuns registry value
 #define MP_MAX_TRANSFER_SIZE        (32 * 1024)
 #define TIME_INTERVAL               (1 * 1000 * 1000) //1 second.
 #define DEVLIST_BUFFER_SIZE         1024
@@ -121,6 +127,57 @@ extern "C" {
 #define DEFAULT_DEBUG_LEVEL         2               
 #define DEFAULT_INITIATOR_ID        7
 #define DEFAULT_NUMBER_OF_BUSES     1
+#define DEFAULT_MAXIMUM_TARGETS     8                // Target ids per bus
+#define DEFAULT_MAXIMUM_LUNS        24               // Luns per target id
+#define DEFAULT_BLOCK_CACHE_SIZE    0                // MB of memory for block cache shared by LUs, 0 disables
+#define DEFAULT_PROXY_CACHE_SIZE    4096             // MB of local cache file per proxy LU, if ProxyCacheDirectory is set
+#define DEFAULT_PROXY_CACHE_POLICY  0                // Slot reuse in proxy cache files, 0 = clock, 1 = FIFO
+#define DEFAULT_WRITE_BACK_LIMIT    64               // MB written by write-back LU before file cache is flushed
+#define DEFAULT_MAX_TRANSFER_LENGTH (8UL << 20)      // Bytes per request reported to port driver
+#define MIN_MAX_TRANSFER_LENGTH     (64UL << 10)
+
+#define IMSCSI_MAX_ALLOCATED_RANGES_QUERY   256      // Entries per FSCTL_QUERY_ALLOCATED_RANGES when filtering UNMAP
+
+#define IMSCSI_WRITE_SAME_BUFFER_SIZE       (1UL << 20)  // Pattern buffer when WRITE SAME cannot zero without writing
+#define IMSCSI_WRITE_SAME_ZERO_CHUNK        (1UL << 30)  // Bytes per zero request for WRITE SAME
+
+// FUA bit is at same position in 10, 12 and 16 byte READ/WRITE CDBs
+#define IMSCSI_SRB_FUA(pSrb)        (((pSrb)->CdbLength >= 10) && ((PCDB)(pSrb)->Cdb)->CDB10.ForceUnitAccess)
+
+#define IMSCSI_VM_CHUNK_SHIFT               20       // VM disks are allocated and loaded in 1 MB chunks
+#define IMSCSI_VM_CHUNK_SIZE                (1UL << IMSCSI_VM_CHUNK_SHIFT)
+#define IMSCSI_VM_CHUNK_TABLE_SHIFT         10       // 1024 chunk pointers per second level chunk table
+#define IMSCSI_VM_CHUNK_TABLE_SIZE          (1UL << IMSCSI_VM_CHUNK_TABLE_SHIFT)
+#define IMSCSI_VM_BLOCK_SHIFT               16       // 64 KB blocks when compressing or deduplicating VM disk chunks
+#define IMSCSI_VM_BLOCK_SIZE                (1UL << IMSCSI_VM_BLOCK_SHIFT)
+#define IMSCSI_VM_BLOCKS_PER_CHUNK          (IMSCSI_VM_CHUNK_SIZE >> IMSCSI_VM_BLOCK_SHIFT)
+#define IMSCSI_VM_BLOCK_HASH_BUCKETS        4096
+#define IMSCSI_VM_RESIDENT_CHUNKS           64       // Uncompressed chunks kept in memory for compressed or deduplicated VM disks
+
+#define IMSCSI_READ_PIPELINE_DEPTH          2        // Read requests in flight when loading image files into memory
+#define IMSCSI_READ_MIN_REQUEST             (64UL << 10)
+#define IMSCSI_READ_INITIAL_REQUEST         (1UL << 20)
+#define IMSCSI_READ_MAX_REQUEST             (8UL << 20)
+
+#define IMSCSI_OVERLAY_BLOCK_SHIFT          16       // Write overlay differencing files store data in 64 KB blocks
+#define IMSCSI_OVERLAY_BLOCK_SIZE           (1UL << IMSCSI_OVERLAY_BLOCK_SHIFT)
+#define IMSCSI_OVERLAY_PAGE_SIZE            4096     // Header size and unit of bitmap updates in differencing files
+
+#define IMSCSI_CACHE_BLOCK_SHIFT            16       // Shared block cache stores 64 KB blocks of image files
+#define IMSCSI_CACHE_BLOCK_SIZE             (1UL << IMSCSI_CACHE_BLOCK_SHIFT)
+#define IMSCSI_CACHE_HASH_BUCKETS           4096
+#define IMSCSI_CACHE_MAX_RUN_BLOCKS         16       // Missing blocks read from image file in one request
+
+#define IMSCSI_HASH_QUEUE_DEPTH             8        // Buffers waiting for hash threads per LU
+
+#define IMSCSI_LATENCY_BUCKETS              32       // Latency histograms count log2 of microseconds
+#define IMSCSI_HASH_READ_SIZE               (1UL << 20)  // Idle reads of parts of disk not yet hashed
+
+#if _NT_TARGET_VERSION >= 0x602
+#define IMSCSI_VM_COMPRESSION_FORMAT        COMPRESSION_FORMAT_XPRESS
+#else
+#define IMSCSI_VM_COMPRESSION_FORMAT        COMPRESSION_FORMAT_LZNT1
+#endif
 
 #define GET_FLAG(Flags, Bit)        ((Flags) & (Bit))
 #define SET_FLAG(Flags, Bit)        ((Flags) |= (Bit))
@@ -130,6 +187,58 @@ extern "C" {
 #define SCSIOP_UNMAP 0x42
 #endif
 
+#ifndef SCSIOP_WRITE_SAME
+#define SCSIOP_WRITE_SAME 0x41
+#endif
+
+#ifndef SCSIOP_WRITE_SAME16
+#define SCSIOP_WRITE_SAME16 0x93
+#endif
+
+#ifndef SCSIOP_POPULATE_TOKEN
+#define SCSIOP_POPULATE_TOKEN 0x83                  // Also WRITE USING TOKEN
+#endif
+
+#ifndef SCSIOP_RECEIVE_ROD_TOKEN_INFORMATION
+#define SCSIOP_RECEIVE_ROD_TOKEN_INFORMATION 0x84
+#endif
+
+#ifndef SERVICE_ACTION_POPULATE_TOKEN
+#define SERVICE_ACTION_POPULATE_TOKEN 0x10
+#endif
+
+#ifndef SERVICE_ACTION_WRITE_USING_TOKEN
+#define SERVICE_ACTION_WRITE_USING_TOKEN 0x11
+#endif
+
+#ifndef SERVICE_ACTION_RECEIVE_TOKEN_INFORMATION
+#define SERVICE_ACTION_RECEIVE_TOKEN_INFORMATION 0x07
+#endif
+
+#ifndef VPD_THIRD_PARTY_COPY
+#define VPD_THIRD_PARTY_COPY 0x8F
+#endif
+
+#ifndef SERVICE_ACTION_GET_LBA_STATUS
+#define SERVICE_ACTION_GET_LBA_STATUS 0x12          // SERVICE ACTION IN(16), same opcode as READ CAPACITY(16)
+#endif
+
+#define IMSCSI_LBA_STATUS_MAPPED        0x00
+#define IMSCSI_LBA_STATUS_DEALLOCATED   0x01
+
+    typedef struct _IMSCSI_LBA_STATUS_DESCRIPTOR {        // GET LBA STATUS parameter data, big endian.
+        UCHAR                 StartingLba[8];
+        UCHAR                 LogicalBlockCount[4];
+        UCHAR                 ProvisioningStatus;
+        UCHAR                 Reserved[3];
+    } IMSCSI_LBA_STATUS_DESCRIPTOR, *PIMSCSI_LBA_STATUS_DESCRIPTOR;
+
+    typedef struct _IMSCSI_LBA_STATUS_HEADER {
+        UCHAR                 ParameterDataLength[4];     // Bytes that follow this field.
+        UCHAR                 Reserved[4];
+        IMSCSI_LBA_STATUS_DESCRIPTOR Descriptors[1];
+    } IMSCSI_LBA_STATUS_HEADER, *PIMSCSI_LBA_STATUS_HEADER;
+
     typedef struct _MPDriverInfo         MPDriverInfo, *pMPDriverInfo;
     typedef struct _MP_REG_INFO          MP_REG_INFO, *pMP_REG_INFO;
     typedef struct _HW_LU_EXTENSION      HW_LU_EXTENSION, *pHW_LU_EXTENSION;
@@ -146,9 +255,34 @@ extern "C" {
         UNICODE_STRING   ProductId;
         UNICODE_STRING   ProductRevision;
         ULONG            NumberOfBuses;       // Number of buses (paths) supported by this adapter
+        ULONG            MaximumTargets;     // Target ids per bus
+        ULONG            MaximumLuns;        // Luns per target id
         ULONG            InitiatorID;        // Adapter's target ID
+        ULONG            BlockCacheSize;     // MB of memory for block cache shared by LUs
+        UNICODE_STRING   ProxyCacheDirectory; // Native path to directory for proxy cache files, empty disables
+        ULONG            ProxyCacheSize;     // MB of cache file per proxy LU
+        ULONG            ProxyCachePolicy;   // Slot reuse order in proxy cache files
+        ULONG            WriteBackLimit;     // MB of unflushed writes per write-back LU
+        ULONG            MaximumTransferLength; // Bytes per request for all LUs on adapter
     } MP_REG_INFO, *pMP_REG_INFO;
 
+    typedef struct _IMSCSI_BLOCK_CACHE {                  // Image file block cache shared by all LUs.
+        KSPIN_LOCK                     Lock;
+        LIST_ENTRY                     FileList;          // Image files of LUs using the cache.
+        PLIST_ENTRY                    Hash;              // Hash buckets of cached blocks, NULL if cache is disabled.
+        LIST_ENTRY                     LruList;           // Cached blocks, least recently used first.
+        ULONG                          Blocks;
+        ULONG                          MaxBlocks;
+    } IMSCSI_BLOCK_CACHE, *PIMSCSI_BLOCK_CACHE;
+
+    typedef struct _IMSCSI_SRB_TRACE {                    // SRB trace buffer, see srbtrace.cpp.
+        KSPIN_LOCK                     Lock;              // Serializes starting and stopping.
+        PIMSCSI_TRACE_RECORD           Records;
+        ULONG                          Capacity;
+        BOOLEAN volatile               Enabled;
+        LONGLONG volatile              Next;              // Sequence number of next record.
+    } IMSCSI_SRB_TRACE, *PIMSCSI_SRB_TRACE;
+
     typedef struct _MPDriverInfo {                        // The master miniport object. In effect, an extension of the driver object for the miniport.
         MP_REG_INFO                    MPRegInfo;
         KSPIN_LOCK                     DrvInfoLock;
@@ -158,17 +292,23 @@ extern "C" {
         UCHAR                          GlobalsInitialized;
         KEVENT                         StopWorker;
         PKTHREAD                       WorkerThread;
-        LIST_ENTRY                     RequestList;
-        KSPIN_LOCK                     RequestListLock;
-        KEVENT                         RequestEvent;
+        IMSCSI_CORE_QUEUE              RequestQueue;
 #ifdef USE_SCSIPORT
         PDEVICE_OBJECT                 ControllerObject;
         LIST_ENTRY                     ResponseList;
         KSPIN_LOCK                     ResponseListLock;
         KEVENT                         ResponseEvent;
+        PKTHREAD                       CompletionThread;  // Calls SMP_IMSCSI_CHECK when work is added to ResponseList.
+        LONG                           CompletionLatency[IMSCSI_LATENCY_BUCKETS];  // Work done to RequestComplete.
 #endif
+        LARGE_INTEGER                  PerformanceFrequency;
+        LONGLONG volatile              WorkerBusyTicks;   // Global worker thread, same as in HW_LU_EXTENSION.
+        BOOLEAN volatile               WorkerBusy;
         ULONG                          DrvInfoNbrMPHBAObj;// Count of items in ListMPHBAObj.
         ULONG                          RandomSeed;
+        PVOID                          TokenRngHandle;    // BCRYPT_ALG_HANDLE for ROD tokens, see odx.cpp.
+        IMSCSI_BLOCK_CACHE             BlockCache;
+        IMSCSI_SRB_TRACE               Trace;
     } MPDriverInfo, *pMPDriverInfo;
 
     typedef struct _DEVICE_THREAD {
@@ -185,11 +325,20 @@ extern "C" {
         LIST_ENTRY                     List;              // Pointers to next and previous HW_HBA_EXT objects.
         LIST_ENTRY                     LUList;
         KSPIN_LOCK                     LUListLock;
+        pHW_LU_EXTENSION volatile     *LUTable;           // Read without lock, see ScsiGetLUExtension.
+        RTL_BITMAP                     DeviceNumbers;     // Device numbers in use or reserved, same index as LUTable.
+        ULONG                          DeviceNumberHint;  // No free device number below this index.
+        LIST_ENTRY                     CopyOperations;    // ROD tokens and copy results, see odx.cpp.
+        KSPIN_LOCK                     CopyOperationLock;
+        ULONG                          CopyOperationCount;
 #ifdef USE_SCSIPORT
         LONG                           WorkItems;
 #endif
         PDRIVER_OBJECT                 DriverObject;
         ULONG                          SRBsSeen;
+        ULONG                          WMISRBsSeen;
+        SCSI_WMILIB_CONTEXT            WmiLibContext;     // Adapter data blocks, see wmi.cpp.
+        SCSI_WMILIB_CONTEXT            LUWmiLibContext;   // Data blocks of each LU.
         UCHAR                          HostTargetId;
         SCSI_ADAPTER_CONTROL_TYPE      AdapterState;
         UCHAR                          VendorId[9];
@@ -226,14 +375,42 @@ extern "C" {
                 ULONG_PTR shared_memory_size;
             };
         };
+
+        LONGLONG volatile RoundTrips;    // Requests sent through this connection
     } PROXY_CONNECTION, *PPROXY_CONNECTION;
 
+    typedef struct _IMSCSI_VM_BLOCK {                     // Compressed and/or shared block of VM disk contents.
+        LIST_ENTRY            HashListEntry;
+        ULONGLONG             Hash;
+        ULONG                 RefCount;
+        ULONG                 DataSize;                   // IMSCSI_VM_BLOCK_SIZE if stored uncompressed.
+        UCHAR                 Data[1];
+    } IMSCSI_VM_BLOCK, *PIMSCSI_VM_BLOCK;
+
+    typedef struct _IMSCSI_VM_CHUNK {                     // Chunk table entry for VM disk.
+        PUCHAR                Data;                       // Uncompressed contents, NULL if packed or not allocated.
+        PIMSCSI_VM_BLOCK     *Blocks;                     // Packed contents, NULL entries for zero blocks.
+        BOOLEAN               Accessed;                   // Used since last pass of packing.
+    } IMSCSI_VM_CHUNK, *PIMSCSI_VM_CHUNK;
+
+    typedef struct _IMSCSI_IMAGE_SEGMENT {                // Segment file of a split image.
+        LONGLONG              StartOffset;                // Image offset where segment begins.
+        LONGLONG              Length;
+        HANDLE                FileHandle;                 // NULL for first segment, that uses ImageFile.
+        PFILE_OBJECT          FileObject;
+        KEVENT                Event;                      // Completion of request sent to segment.
+        IO_STATUS_BLOCK       IoStatus;
+        BOOLEAN               Pending;                    // Request sent, Event not yet waited for.
+    } IMSCSI_IMAGE_SEGMENT, *PIMSCSI_IMAGE_SEGMENT;
+
+    typedef struct DECLSPEC_CACHEALIGN _IMSCSI_CPU_STATISTICS { // Counters updated by one processor, summed when queried.
+        IMSCSI_LU_STATISTICS  Counters;                   // ProxyRoundTrips is kept in PROXY_CONNECTION instead.
+    } IMSCSI_CPU_STATISTICS, *PIMSCSI_CPU_STATISTICS;
+
     typedef struct _HW_LU_EXTENSION {                     // LUN extension allocated by port driver.
         LIST_ENTRY            List;                       // Pointers to next and previous HW_LU_EXTENSION objects, used in HW_HBA_EXT.
         pHW_HBA_EXT           pHBAExt;
-        LIST_ENTRY            RequestList;
-        KSPIN_LOCK            RequestListLock;
-        KEVENT                RequestEvent;
+        IMSCSI_CORE_LU        Core;                       // Request queue, last I/O buffer and write-back state.
         KEVENT                Initialized;
         PKTHREAD              WorkerThread;
         KEVENT                StopThread;
@@ -245,10 +422,6 @@ extern "C" {
         BOOLEAN               RemovableMedia;
         BOOLEAN               ReadOnly;
         ULONG                 FakeDiskSignature;
-        PVOID                 LastIoBuffer;
-        LONGLONG              LastIoStartSector;
-        ULONG                 LastIoLength;
-        KSPIN_LOCK            LastIoLock;
         DEVICE_NUMBER         DeviceNumber;
         UNICODE_STRING        ObjectName;
         HANDLE                ImageFile;
@@ -259,9 +432,47 @@ extern "C" {
         BOOLEAN               SupportsUnmap;
         BOOLEAN               SupportsZero;
         BOOLEAN               NoFileLevelTrim;
-        PUCHAR                ImageBuffer;
+        BOOLEAN               ProxyAllocatedRanges;       // Proxy answers IMDPROXY_REQ_ALLOCATED_RANGES.
+        BOOLEAN               ProxyCopy;                  // Proxy answers IMDPROXY_REQ_COPY, ProxyIdentity is valid.
+        UCHAR                 ProxyIdentity[16];          // Image identity reported by proxy, used as copy source.
+        ULONG                 OptimalTransferGranularity; // Bytes, block or chunk size of back end, 0 if unknown.
+        ULONG                 OptimalTransferLength;      // Bytes, 0 if unknown.
+        ULONG                 MaxTransferLength;          // Bytes, 0 if only limited by adapter.
+        ULONG                 UnmapGranularity;           // Bytes deallocated together by back end, 0 if unknown.
+        ULONG                 MaxUnmapDescriptors;        // Per UNMAP request, 0 if not limited.
+        PIMSCSI_VM_CHUNK     *VMChunkTable;               // Directory of second level chunk tables for VM disk.
+        ULONG                 VMChunkTableSize;           // Number of entries in VMChunkTable.
+        BOOLEAN               VMCompress;                 // Compress chunks not recently used.
+        BOOLEAN               VMDedup;                    // Share identical blocks of packed chunks.
+        ULONG                 VMResidentChunks;           // Number of chunks currently uncompressed in memory.
+        ULONG                 VMPackChunk;                // Next chunk to consider for packing.
+        PVOID                 VMCompressWorkSpace;
+        PUCHAR                VMBlockBuffer;              // Work buffer for compression and block comparison.
+        PLIST_ENTRY           VMBlockHash;                // Hash buckets for deduplication.
         BOOLEAN               UseProxy;
         PFILE_OBJECT          FileObject;
+        BOOLEAN               VMLazyLoad;                 // VM disk is still being loaded from ImageFile.
+        RTL_BITMAP            VMLoadedChunks;             // Chunks of VM disk loaded so far, valid if VMLazyLoad.
+        ULONG                 VMPrefetchChunk;            // Hint for next chunk to load in background.
+        HANDLE                OverlayFile;                // Differencing file if write overlay is used, otherwise NULL.
+        UNICODE_STRING        OverlayName;
+        RTL_BITMAP            OverlayBlocks;              // Blocks present in differencing file.
+        LONGLONG              OverlayDataOffset;          // Offset of first block in differencing file.
+        PUCHAR                OverlayBlockBuffer;         // Work buffer for partial block writes and commit.
+        PIMSCSI_IMAGE_SEGMENT Segments;                   // Segment table sorted by StartOffset, NULL if not split image.
+        ULONG                 SegmentCount;
+        UNICODE_STRING        SegmentNames;               // Names of segments after first, separated by null characters.
+        PVOID                 CacheFile;                  // Image file identity in shared block cache, NULL if not cached.
+        PVOID                 ProxyCache;                 // Local cache file for proxy, NULL if not cached.
+        PVOID                 ImageHash;                  // Digest computation state, NULL if not hashing.
+        PVOID                 MerkleIndex;                // Chunk hashes reads are checked against, NULL if not verifying.
+        LONG volatile         WriteGeneration;            // Changed by every write, invalidates ROD tokens.
+        LONG volatile         CopyReferences;             // Copies from this LU in other LU worker threads.
+        BOOLEAN               NoDuplicateExtents;         // File system does not support block cloning.
+        PIMSCSI_CPU_STATISTICS Statistics;                // One entry per processor, NULL if allocation failed.
+        ULONG                 StatisticsCount;
+        LONGLONG volatile     WorkerBusyTicks;            // Performance counter ticks worker thread spent serving requests.
+        BOOLEAN volatile      WorkerBusy;                 // Worker thread is serving a request.
     } HW_LU_EXTENSION, *pHW_LU_EXTENSION;
 
     typedef struct _HW_SRB_EXTENSION {
@@ -272,6 +483,7 @@ extern "C" {
         LIST_ENTRY           RequestListEntry;
 #ifdef USE_SCSIPORT
         LIST_ENTRY           ResponseListEntry;
+        LARGE_INTEGER        ResponseQueued;              // Performance counter when added to ResponseList.
 #endif
         pHW_HBA_EXT          pHBAExt;
         pHW_LU_EXTENSION     pLUExt;
@@ -283,6 +495,7 @@ extern "C" {
         PVOID                AllocatedBuffer;
         BOOLEAN              CopyBack;
         PKEVENT              CallerWaitEvent;
+        LARGE_INTEGER        Started;                     // Performance counter when queued, zero if not counted in LU statistics.
     } MP_WorkRtnParms, *pMP_WorkRtnParms;
 
     enum ResultType {
@@ -324,6 +537,13 @@ extern "C" {
             __in pHW_HBA_EXT DevExt
             );
 
+#if defined(USE_STORPORT) && _NT_TARGET_VERSION >= 0x601
+    VOID
+        ImScsiInitializePerfOpts(
+            __in PVOID
+            );
+#endif
+
     BOOLEAN
         MpHwInitialize(
             __in PVOID
@@ -429,6 +649,37 @@ extern "C" {
             __in PSCSI_REQUEST_BLOCK  pSrb
             );
 
+    ULONG
+        ImScsiGetHBAExtensionSize();
+
+    VOID
+        ImScsiInitializeLUTable(
+            __in pHW_HBA_EXT      pHBAExt);
+
+    NTSTATUS
+        ImScsiReserveDeviceNumber(
+            __in pHW_HBA_EXT              pHBAExt,
+            __inout PDEVICE_NUMBER        DeviceNumber,
+            __inout __deref PKIRQL        LowestAssumedIrql);
+
+    VOID
+        ImScsiReleaseDeviceNumber(
+            __in pHW_HBA_EXT              pHBAExt,
+            __in PDEVICE_NUMBER           DeviceNumber);
+
+    VOID
+        ImScsiPublishLU(
+            __in pHW_HBA_EXT      pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiUnpublishLU(
+            __in pHW_HBA_EXT      pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiWaitForLULookups();
+
     UCHAR
         ScsiGetLUExtension(
             __in pHW_HBA_EXT								pHBAExt,      // Adapter device-object extension from port driver.
@@ -693,6 +944,89 @@ extern "C" {
             __in PKIRQL               LowestAssumedIrql
             );
 
+    VOID
+        ScsiOpWriteSame(
+            __in pHW_HBA_EXT          pHBAExt, // Adapter device-object extension from port driver.
+            __in pHW_LU_EXTENSION     pLUExt,  // LUN device-object extension from port driver.        
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PUCHAR               pResult,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiOpGetLbaStatus(
+            __in pHW_HBA_EXT          pHBAExt, // Adapter device-object extension from port driver.
+            __in pHW_LU_EXTENSION     pLUExt,  // LUN device-object extension from port driver.        
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PUCHAR               pResult,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiOpSynchronizeCache(
+            __in pHW_HBA_EXT          pHBAExt, // Adapter device-object extension from port driver.
+            __in pHW_LU_EXTENSION     pLUExt,  // LUN device-object extension from port driver.        
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PUCHAR               pResult,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiOpFlush(
+            __in pHW_HBA_EXT          pHBAExt,
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PUCHAR               pResult,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiGetWriteSameRange(
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __out PLARGE_INTEGER      StartingSector,
+            __out PULONG              NumBlocks,
+            __out PBOOLEAN            NoDataOut
+            );
+
+    VOID
+        ScsiOpTokenOperation(
+            __in pHW_HBA_EXT          pHBAExt, // Adapter device-object extension from port driver.
+            __in pHW_LU_EXTENSION     pLUExt,  // LUN device-object extension from port driver.        
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PUCHAR               pResult,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiOpReceiveRodTokenInformation(
+            __in pHW_HBA_EXT          pHBAExt,
+            __in pHW_LU_EXTENSION     pLUExt,
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __in PKIRQL               LowestAssumedIrql
+            );
+
+    VOID
+        ScsiOpVPDThirdPartyCopy(
+            __in pHW_LU_EXTENSION     pLUExt,
+            __in PSCSI_REQUEST_BLOCK  pSrb
+            );
+
+    VOID
+        ImScsiInitializeTokenRng();
+
+    VOID
+        ImScsiFreeTokenRng();
+
+    VOID
+        ImScsiInitializeCopyOperations(
+            __in pHW_HBA_EXT          pHBAExt
+            );
+
+    VOID
+        ImScsiFreeCopyOperations(
+            __in pHW_HBA_EXT          pHBAExt,
+            __inout __deref PKIRQL    LowestAssumedIrql
+            );
+
     VOID
         ScsiOpReadTOC(__in pHW_HBA_EXT          pHBAExt,      // Adapter device-object extension from port driver.
             __in pHW_LU_EXTENSION     device_extension,       // LUN device-object extension from port driver.
@@ -788,6 +1122,15 @@ extern "C" {
             __inout __deref PSRB_IMSCSI_EXTEND_DEVICE       extend_device_data
             );
 
+    VOID
+        ImScsiWriteOverlayDevice(
+            __in pHW_HBA_EXT          pHBAExt,
+            __in PSCSI_REQUEST_BLOCK  pSrb,
+            __inout __deref PUCHAR         pResult,
+            __inout __deref PKIRQL         LowestAssumedIrql,
+            __inout __deref PSRB_IMSCSI_WRITE_OVERLAY       overlay_data
+            );
+
     NTSTATUS
         ImScsiInitializeLU(__inout __deref pHW_LU_EXTENSION LUExtension,
             __inout __deref PSRB_IMSCSI_CREATE_DATA CreateData,
@@ -831,6 +1174,18 @@ extern "C" {
             __out __deref PIMDPROXY_INFO_RESP ProxyInfoResponse,
             __in ULONG ProxyInfoResponseLength);
 
+    NTSTATUS
+        ImScsiQueryIdentityProxy(__in __deref PPROXY_CONNECTION Proxy,
+            __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+            __in __deref PKEVENT CancelEvent,
+            __out __deref PIMDPROXY_IDENTITY_RESP ProxyIdentityResponse);
+
+    NTSTATUS
+        ImScsiQueryLimitsProxy(__in __deref PPROXY_CONNECTION Proxy,
+            __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+            __in __deref PKEVENT CancelEvent,
+            __out __deref PIMDPROXY_LIMITS_RESP ProxyLimitsResponse);
+
     NTSTATUS
         ImScsiReadProxy(__in __deref PPROXY_CONNECTION Proxy,
             __out __deref PIO_STATUS_BLOCK IoStatusBlock,
@@ -846,6 +1201,15 @@ extern "C" {
             PVOID Buffer,
             __in ULONG Length,
             __in __deref PLARGE_INTEGER ByteOffset);
+
+    NTSTATUS
+        ImScsiCopyProxy(__in __deref PPROXY_CONNECTION Proxy,
+            __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+            __in __deref PKEVENT CancelEvent,
+            __in_bcount(16) const UCHAR *SourceIdentity,
+            __in LONGLONG SourceOffset,
+            __in LONGLONG Offset,
+            __in LONGLONG Length);
     
     IO_COMPLETION_ROUTINE
         ImScsiParallelReadWriteImageCompletion;
@@ -857,6 +1221,38 @@ extern "C" {
             __inout __deref PKIRQL        LowestAssumedIrql
             );
 
+    pMP_WorkRtnParms
+        ImScsiAllocateWorkItem(
+            __in pHW_HBA_EXT          pHBAExt,
+            __in pHW_LU_EXTENSION     pLUExt,
+            __in PSCSI_REQUEST_BLOCK  pSrb
+            );
+
+    VOID
+        ImScsiInsertWorkItem(
+            __in pMP_WorkRtnParms         pWkRtnParms,
+            __inout __deref PUCHAR        pResult,
+            __inout __deref PKIRQL        LowestAssumedIrql
+            );
+
+    VOID
+        ImScsiQueueWorkItem(
+            __in pHW_HBA_EXT              pHBAExt,
+            __in pHW_LU_EXTENSION         pLUExt,
+            __in PSCSI_REQUEST_BLOCK      pSrb,
+            __inout __deref PUCHAR        pResult,
+            __inout __deref PKIRQL        LowestAssumedIrql
+            );
+
+    VOID
+        ImScsiDropLastIoBuffer(
+            __in pHW_LU_EXTENSION         pLUExt,
+            __inout __deref PKIRQL        LowestAssumedIrql
+            );
+
+    extern
+        const IMSCSI_CORE_BACKEND ImScsiLUBackend;        // Read and write path of LUs, see workerthread.cpp.
+
     NTSTATUS
         ImScsiReadDevice(
             __in pHW_LU_EXTENSION pLUExt,
@@ -879,6 +1275,258 @@ extern "C" {
             __in pHW_LU_EXTENSION pLUExt,
             __in PSCSI_REQUEST_BLOCK pSrb);
 
+    VOID
+        ImScsiWriteSameDevice(
+            __in pHW_HBA_EXT pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PSCSI_REQUEST_BLOCK pSrb);
+
+    VOID
+        ImScsiQueryBackendLimits(
+            __inout pHW_LU_EXTENSION pLUExt,
+            __in BOOLEAN ProxySupportsLimits);
+
+    VOID
+        ImScsiGetLbaStatusDevice(
+            __in pHW_HBA_EXT pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PSCSI_REQUEST_BLOCK pSrb);
+
+    NTSTATUS
+        ImScsiFlushLU(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiFlushDevice(
+            __in pHW_HBA_EXT pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PSCSI_REQUEST_BLOCK pSrb);
+
+    VOID
+        ImScsiWriteUsingToken(
+            __in pHW_HBA_EXT pHBAExt,
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PSCSI_REQUEST_BLOCK pSrb);
+
+    NTSTATUS
+        ImScsiOpenWriteOverlay(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PUNICODE_STRING  OverlayName);
+
+    VOID
+        ImScsiCloseWriteOverlay(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    NTSTATUS
+        ImScsiReadOverlay(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   ByteOffset,
+            __in PULONG           Length
+            );
+
+    NTSTATUS
+        ImScsiWriteOverlay(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   ByteOffset,
+            __in PULONG           Length
+            );
+
+    NTSTATUS
+        ImScsiDiscardOverlayLU(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    NTSTATUS
+        ImScsiCommitOverlayLU(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiInitializeBlockCache(
+            __in ULONG SizeInMegabytes);
+
+    VOID
+        ImScsiFreeBlockCache();
+
+    NTSTATUS
+        ImScsiOpenCacheFile(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiCloseCacheFile(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiInvalidateCache(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in LONGLONG         ByteOffset,
+            __in LONGLONG         Length);
+
+    NTSTATUS
+        ImScsiReadCachedFile(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   ByteOffset,
+            __in ULONG            Length,
+            __out PIO_STATUS_BLOCK IoStatus
+            );
+
+    NTSTATUS
+        ImScsiOpenProxyCache(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in LONGLONG         ImageSize,
+            __in BOOLEAN          SupportsIdentity);
+
+    VOID
+        ImScsiCloseProxyCache(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiInvalidateProxyCache(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in LONGLONG         ByteOffset,
+            __in LONGLONG         Length);
+
+    NTSTATUS
+        ImScsiReadProxyCached(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   ByteOffset,
+            __in ULONG            Length,
+            __out PIO_STATUS_BLOCK IoStatus
+            );
+
+    NTSTATUS
+        ImScsiStartImageHash(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiStopImageHash(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiFreeImageHash(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiHashReadData(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in LONGLONG         Offset,
+            __in ULONG            Length);
+
+    BOOLEAN
+        ImScsiHashIdle(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    NTSTATUS
+        ImScsiQueryHashDevice(
+            __in            pHW_HBA_EXT             pHBAExt,
+            __inout __deref PSRB_IMSCSI_QUERY_HASH  query_hash,
+            __inout __deref PKIRQL                  LowestAssumedIrql);
+
+    VOID
+        ImScsiAllocateStatistics(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiFreeStatistics(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiStatisticsStart(
+            __in pMP_WorkRtnParms pWkRtnParms);
+
+    VOID
+        ImScsiStatisticsDone(
+            __in pMP_WorkRtnParms pWkRtnParms);
+
+    VOID
+        ImScsiCountRequest(
+            __in pHW_LU_EXTENSION    pLUExt,
+            __in PSCSI_REQUEST_BLOCK pSrb,
+            __in LONGLONG            Ticks);
+
+    VOID
+        ImScsiCountCacheAccess(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in ULONG            Hits,
+            __in ULONG            Misses);
+
+    BOOLEAN
+        ImScsiSumStatistics(
+            __in  pHW_LU_EXTENSION      pLUExt,
+            __out PIMSCSI_LU_STATISTICS Statistics);
+
+    NTSTATUS
+        ImScsiQueryStatisticsDevice(
+            __in            pHW_HBA_EXT                   pHBAExt,
+            __inout __deref PSRB_IMSCSI_QUERY_STATISTICS  query_statistics,
+            __inout __deref PKIRQL                        LowestAssumedIrql);
+
+    VOID
+        ImScsiTraceSrbEvent(
+            __in UCHAR               Stage,
+            __in PSCSI_REQUEST_BLOCK pSrb);
+
+    // Records an SRB trace event. Only a test of a global flag while
+    // tracing is stopped.
+    FORCEINLINE
+        VOID
+        ImScsiTraceSrb(UCHAR Stage, PSCSI_REQUEST_BLOCK pSrb)
+    {
+        if (pMPDrvInfoGlobal->Trace.Enabled)
+            ImScsiTraceSrbEvent(Stage, pSrb);
+    }
+
+    NTSTATUS
+        ImScsiSetTrace(
+            __inout __deref PSRB_IMSCSI_SET_TRACE         set_trace,
+            __inout __deref PKIRQL                        LowestAssumedIrql);
+
+    NTSTATUS
+        ImScsiReadTrace(
+            __inout __deref PSRB_IMSCSI_READ_TRACE        read_trace,
+            __in            ULONG                         max_length);
+
+    VOID
+        ImScsiFreeTrace();
+
+    NTSTATUS
+        ImScsiOpenMerkleIndex(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    VOID
+        ImScsiCloseMerkleIndex(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    NTSTATUS
+        ImScsiVerifyReadData(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   Offset,
+            __in ULONG            Length);
+
+    NTSTATUS
+        ImScsiOpenImageSegments(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in PUNICODE_STRING  SegmentNames,
+            __out PLARGE_INTEGER  ImageSize);
+
+    VOID
+        ImScsiCloseImageSegments(
+            __in pHW_LU_EXTENSION pLUExt);
+
+    NTSTATUS
+        ImScsiReadWriteSegments(
+            __in pHW_LU_EXTENSION pLUExt,
+            __in UCHAR            MajorFunction,
+            __in PVOID            Buffer,
+            __in PLARGE_INTEGER   ByteOffset,
+            __in ULONG            Length,
+            __out PIO_STATUS_BLOCK IoStatus
+            );
+
     NTSTATUS
         ImScsiSafeIOStream(__in PFILE_OBJECT FileObject,
             __in UCHAR MajorFunction,
@@ -910,6 +1558,68 @@ extern "C" {
     BOOLEAN
         ImScsiFillMemoryDisk(pHW_LU_EXTENSION LUExtension);
 
+    NTSTATUS
+        ImScsiLoadMemoryDiskRange(
+            __in pHW_LU_EXTENSION LUExtension,
+            __in PLARGE_INTEGER Offset,
+            __in ULONG Length,
+            __in BOOLEAN ForWrite);
+
+    BOOLEAN
+        ImScsiPrefetchMemoryDisk(pHW_LU_EXTENSION LUExtension);
+
+    PIMSCSI_VM_CHUNK*
+        ImScsiAllocateVMChunkTable(
+            __in LONGLONG DiskSize,
+            __out PULONG TableSize);
+
+    NTSTATUS
+        ImScsiResizeVMChunkTable(
+            __in pHW_LU_EXTENSION LUExtension,
+            __in LONGLONG NewDiskSize);
+
+    VOID
+        ImScsiFreeVMChunkTable(
+            __in pHW_LU_EXTENSION LUExtension);
+
+    NTSTATUS
+        ImScsiInitializeVMPacking(
+            __in pHW_LU_EXTENSION LUExtension,
+            __in BOOLEAN Compress,
+            __in BOOLEAN Dedup);
+
+    BOOLEAN
+        ImScsiPackMemoryDisk(pHW_LU_EXTENSION LUExtension);
+
+    NTSTATUS
+        ImScsiReadVMDisk(
+            __in pHW_LU_EXTENSION LUExtension,
+            __out PUCHAR Buffer,
+            __in LONGLONG Offset,
+            __in ULONG Length);
+
+    NTSTATUS
+        ImScsiWriteVMDisk(
+            __in pHW_LU_EXTENSION LUExtension,
+            __in_opt const UCHAR *Buffer,
+            __in LONGLONG Offset,
+            __in ULONG Length);
+
+    typedef NTSTATUS
+        (*PIMSCSI_READ_CALLBACK)(
+            __in PVOID Context,
+            __in ULONGLONG Position,
+            __in PUCHAR Data,
+            __in ULONG Length);
+
+    NTSTATUS
+        ImScsiPipelinedReadFile(__in HANDLE FileHandle,
+            __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+            __in ULONGLONG Length,
+            __in __deref PLARGE_INTEGER Offset,
+            __in PIMSCSI_READ_CALLBACK Callback,
+            __in_opt PVOID Context);
+
     NTSTATUS
         ImScsiSafeReadFile(__in HANDLE FileHandle,
             __out __deref PIO_STATUS_BLOCK IoStatusBlock,
@@ -917,13 +1627,55 @@ extern "C" {
             __in SIZE_T Length,
             __in __deref PLARGE_INTEGER Offset);
 
-    PIRP
-        ImScsiBuildCompletionIrp();
+    VOID
+        ImScsiCallForCompletion(pMP_WorkRtnParms pWkRtnParms,
+            PKIRQL LowestAssumedIrql);
+
+    KSTART_ROUTINE
+        ImScsiCompletionThread;
 
     NTSTATUS
-        ImScsiCallForCompletion(PIRP Irp,
-            pMP_WorkRtnParms pWkRtnParms,
-            PKIRQL LowestAssumedIrql);
+        ImScsiStartCompletionThread();
+
+#if _NT_TARGET_VERSION >= 0x601
+#define ImScsiGetProcessorCount()   KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS)
+#define ImScsiGetProcessorIndex()   KeGetCurrentProcessorNumberEx(NULL)
+#else
+#define ImScsiGetProcessorCount()   ((ULONG)KeNumberProcessors)
+#define ImScsiGetProcessorIndex()   KeGetCurrentProcessorNumber()
+#endif
+
+    FORCEINLINE
+        LONGLONG
+        ImScsiTicksToMicroseconds(LONGLONG Ticks, LONGLONG Frequency)
+    {
+        if ((Ticks <= 0) || (Frequency <= 0))
+            return 0;
+
+        // Split to avoid overflow for long periods.
+        return (Ticks / Frequency) * 1000000 +
+            (Ticks % Frequency) * 1000000 / Frequency;
+    }
+
+    FORCEINLINE
+        ULONG
+        ImScsiGetLatencyBucket(LONGLONG Ticks, LONGLONG Frequency)
+    {
+        ULONGLONG microseconds;
+        ULONG bucket;
+
+        if ((Ticks <= 0) || (Frequency <= 0))
+            return 0;
+
+        microseconds = (ULONGLONG)Ticks * 1000000 / (ULONGLONG)Frequency;
+
+        for (bucket = 0;
+            (microseconds != 0) && (bucket < IMSCSI_LATENCY_BUCKETS - 1);
+            bucket++)
+            microseconds >>= 1;
+
+        return bucket;
+    }
 
     FORCEINLINE
         BOOLEAN
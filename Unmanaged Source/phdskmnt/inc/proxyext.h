@@ -0,0 +1,140 @@
+/// proxyext.h
+/// Requests and flags added to the ImDisk proxy protocol by this driver.
+/// Builds without Windows headers, such as the Linux benchmark harness
+/// and proxy provider in iobench, also get the base protocol definitions
+/// otherwise found in imdproxy.h.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _PROXYEXT_H_
+#define _PROXYEXT_H_
+
+#if !defined(_WIN32)
+
+#include "rwcore.h"
+
+#define IMDPROXY_REQ_NULL           0x00
+#define IMDPROXY_REQ_INFO           0x01
+#define IMDPROXY_REQ_READ           0x02
+#define IMDPROXY_REQ_WRITE          0x03
+#define IMDPROXY_REQ_CONNECT        0x04
+#define IMDPROXY_REQ_CLOSE          0x05
+
+#define IMDPROXY_FLAG_RO            0x01
+
+typedef struct _IMDPROXY_INFO_RESP
+{
+    ULONGLONG file_size;
+    ULONGLONG req_alignment;
+    ULONGLONG flags;
+} IMDPROXY_INFO_RESP, *PIMDPROXY_INFO_RESP;
+
+typedef struct _IMDPROXY_READ_REQ
+{
+    ULONGLONG request_code;
+    ULONGLONG offset;
+    ULONGLONG length;
+} IMDPROXY_READ_REQ, *PIMDPROXY_READ_REQ;
+
+typedef struct _IMDPROXY_READ_RESP
+{
+    ULONGLONG errorno;
+    ULONGLONG length;
+} IMDPROXY_READ_RESP, *PIMDPROXY_READ_RESP;
+
+typedef IMDPROXY_READ_REQ IMDPROXY_WRITE_REQ, *PIMDPROXY_WRITE_REQ;
+typedef IMDPROXY_READ_RESP IMDPROXY_WRITE_RESP, *PIMDPROXY_WRITE_RESP;
+
+#endif
+
+// Allocated ranges query to proxy services. Request header is same as
+// IMDPROXY_READ_REQ with offset and length of range to query. Response
+// header is same as IMDPROXY_READ_RESP, followed by length bytes of
+// DEVICE_DATA_SET_RANGE entries for allocated parts of the range, sorted
+// and non-overlapping.
+#ifndef IMDPROXY_REQ_ALLOCATED_RANGES
+#define IMDPROXY_REQ_ALLOCATED_RANGES 0x0A
+#endif
+
+#ifndef IMDPROXY_FLAG_SUPPORTS_ALLOCATED_RANGES
+#define IMDPROXY_FLAG_SUPPORTS_ALLOCATED_RANGES 0x20
+#endif
+
+// Image identity query to proxy services. Request is only the request
+// code, response is IMDPROXY_IDENTITY_RESP. Identity is unique for the
+// image on the provider, such as a GUID or a file system file id.
+// Generation changes each time image contents are modified, also by
+// writes on the connection itself. Used to validate persistent cache
+// files, which are not used with services without this request.
+#ifndef IMDPROXY_REQ_IDENTITY
+#define IMDPROXY_REQ_IDENTITY 0x0B
+#endif
+
+#ifndef IMDPROXY_FLAG_SUPPORTS_IDENTITY
+#define IMDPROXY_FLAG_SUPPORTS_IDENTITY 0x40
+#endif
+
+typedef struct _IMDPROXY_IDENTITY_RESP
+{
+    ULONGLONG errorno;
+    UCHAR identity[16];
+    ULONGLONG generation;
+} IMDPROXY_IDENTITY_RESP, *PIMDPROXY_IDENTITY_RESP;
+
+// Transfer limits query to proxy services. Request is only the request
+// code, response is IMDPROXY_LIMITS_RESP. All fields are in bytes and 0
+// if not known, such as chunk size of compressed or differencing image
+// formats as optimal_granularity. Reported in Block Limits VPD page of
+// proxy LUs.
+#ifndef IMDPROXY_REQ_LIMITS
+#define IMDPROXY_REQ_LIMITS 0x0C
+#endif
+
+#ifndef IMDPROXY_FLAG_SUPPORTS_LIMITS
+#define IMDPROXY_FLAG_SUPPORTS_LIMITS 0x80
+#endif
+
+typedef struct _IMDPROXY_LIMITS_RESP
+{
+    ULONGLONG errorno;
+    ULONGLONG optimal_granularity;
+    ULONGLONG optimal_transfer_length;
+    ULONGLONG max_transfer_length;
+    ULONGLONG unmap_granularity;
+} IMDPROXY_LIMITS_RESP, *PIMDPROXY_LIMITS_RESP;
+
+// Copy within provider, used for offloaded copies between proxy LUs.
+// Request is IMDPROXY_COPY_REQ, response is same as IMDPROXY_WRITE_RESP
+// with number of bytes copied. Source image is selected by identity
+// returned by IMDPROXY_REQ_IDENTITY on its own connection, destination
+// is the image of the connection request is sent on. Services that
+// cannot access source image answer with an error, such as EXDEV, and
+// the driver copies data through its own buffers where it can. Only
+// used with services that also support IMDPROXY_REQ_IDENTITY.
+#ifndef IMDPROXY_REQ_COPY
+#define IMDPROXY_REQ_COPY 0x0D
+#endif
+
+#ifndef IMDPROXY_FLAG_SUPPORTS_COPY
+#define IMDPROXY_FLAG_SUPPORTS_COPY 0x100
+#endif
+
+typedef struct _IMDPROXY_COPY_REQ
+{
+    ULONGLONG request_code;
+    UCHAR source_identity[16];
+    ULONGLONG source_offset;
+    ULONGLONG offset;
+    ULONGLONG length;
+} IMDPROXY_COPY_REQ, *PIMDPROXY_COPY_REQ;
+
+typedef IMDPROXY_READ_RESP IMDPROXY_COPY_RESP, *PIMDPROXY_COPY_RESP;
+
+#endif // _PROXYEXT_H_
@@ -0,0 +1,212 @@
+/// rwcore.h
+/// Decoding and checks of SCSI read and write requests. Depends on no kernel
+/// or Windows headers, so the same code can be built and measured in user
+/// mode, also on other platforms.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifndef _RWCORE_H_
+#define _RWCORE_H_
+
+#if !defined(_WIN32)
+
+#include <stdint.h>
+
+typedef uint8_t UCHAR;
+typedef uint32_t ULONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uint8_t BOOLEAN;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#ifndef FORCEINLINE
+#define FORCEINLINE static inline
+#endif
+
+#ifndef MAXLONGLONG
+#define MAXLONGLONG INT64_MAX
+#endif
+
+#endif
+
+#ifndef SCSIOP_READ6
+#define SCSIOP_READ6                0x08
+#define SCSIOP_WRITE6               0x0A
+#define SCSIOP_READ                 0x28
+#define SCSIOP_WRITE                0x2A
+#define SCSIOP_WRITE_SAME           0x41
+#define SCSIOP_READ16               0x88
+#define SCSIOP_WRITE16              0x8A
+#define SCSIOP_WRITE_SAME16         0x93
+#define SCSIOP_READ12               0xA8
+#define SCSIOP_WRITE12              0xAA
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Result of ImScsiCheckReadWrite. Each value other than IMSCSI_RW_OK maps
+/// to one kind of CHECK CONDITION in driver.
+///
+typedef enum _IMSCSI_RW_CHECK
+{
+    IMSCSI_RW_OK,
+    IMSCSI_RW_WRITE_PROTECTED,
+    IMSCSI_RW_OUT_OF_BOUNDS
+} IMSCSI_RW_CHECK;
+
+///
+/// Read or write request decoded from CDB by ImScsiDecodeReadWrite.
+///
+typedef struct _IMSCSI_RW_REQUEST
+{
+    /// First block.
+    LONGLONG    StartingSector;
+
+    /// Byte offset of first block on virtual disk, not including image
+    /// file offset.
+    LONGLONG    StartingOffset;
+
+    /// Number of whole blocks in data transfer.
+    ULONG       NumBlocks;
+
+    BOOLEAN     Write;
+} IMSCSI_RW_REQUEST, *PIMSCSI_RW_REQUEST;
+
+///
+/// Logical block address of a READ, WRITE or WRITE SAME CDB of any size.
+/// Zero for other commands.
+///
+FORCEINLINE
+LONGLONG
+ImScsiCdbGetLogicalBlock(const UCHAR *Cdb)
+{
+    LONGLONG logical_block = 0;
+    int first_byte = 2;
+    int bytes;
+    int i;
+
+    switch (Cdb[0])
+    {
+    case SCSIOP_READ6:
+    case SCSIOP_WRITE6:
+        return ((LONGLONG)(Cdb[1] & 0x1F) << 16) |
+            ((LONGLONG)Cdb[2] << 8) | Cdb[3];
+
+    case SCSIOP_READ:
+    case SCSIOP_WRITE:
+    case SCSIOP_READ12:
+    case SCSIOP_WRITE12:
+    case SCSIOP_WRITE_SAME:
+        bytes = 4;
+        break;
+
+    case SCSIOP_READ16:
+    case SCSIOP_WRITE16:
+    case SCSIOP_WRITE_SAME16:
+        bytes = 8;
+        break;
+
+    default:
+        return 0;
+    }
+
+    for (i = first_byte; i < first_byte + bytes; i++)
+    {
+        logical_block = (logical_block << 8) | Cdb[i];
+    }
+
+    return logical_block;
+}
+
+///
+/// Decodes a READ or WRITE (10) or (16) CDB. Returns FALSE if byte offset of
+/// starting block does not fit in a LONGLONG.
+///
+FORCEINLINE
+BOOLEAN
+ImScsiDecodeReadWrite(
+    const UCHAR         *Cdb,
+    ULONG               DataTransferLength,
+    UCHAR               BlockPower,
+    PIMSCSI_RW_REQUEST  Request)
+{
+    Request->StartingSector = ImScsiCdbGetLogicalBlock(Cdb);
+    Request->NumBlocks = DataTransferLength >> BlockPower;
+    Request->Write = (Cdb[0] == SCSIOP_WRITE) | (Cdb[0] == SCSIOP_WRITE16);
+
+    // Check if startingSector << blockPower fits within a LONGLONG.
+    if (Request->StartingSector & ~(MAXLONGLONG >> BlockPower))
+    {
+        Request->StartingOffset = 0;
+        return FALSE;
+    }
+
+    Request->StartingOffset = Request->StartingSector << BlockPower;
+
+    return TRUE;
+}
+
+///
+/// Checks a decoded request against write protection and size of virtual
+/// disk.
+///
+FORCEINLINE
+IMSCSI_RW_CHECK
+ImScsiCheckReadWrite(
+    const IMSCSI_RW_REQUEST *Request,
+    LONGLONG                DiskSize,
+    UCHAR                   BlockPower,
+    BOOLEAN                 ReadOnly)
+{
+    if (Request->Write && ReadOnly)
+    {
+        return IMSCSI_RW_WRITE_PROTECTED;
+    }
+
+    if ((Request->StartingSector + Request->NumBlocks) >
+        (DiskSize >> BlockPower))
+    {
+        return IMSCSI_RW_OUT_OF_BOUNDS;
+    }
+
+    return IMSCSI_RW_OK;
+}
+
+///
+/// Checks if a read request is entirely within the data of the last I/O
+/// buffer of an LU.
+///
+FORCEINLINE
+BOOLEAN
+ImScsiLastIoCovers(
+    const IMSCSI_RW_REQUEST *Request,
+    ULONG                   DataTransferLength,
+    UCHAR                   BlockPower,
+    LONGLONG                LastIoStartSector,
+    ULONG                   LastIoLength)
+{
+    return !Request->Write &&
+        (LastIoStartSector <= Request->StartingSector) &&
+        ((Request->StartingOffset - (LastIoStartSector << BlockPower) +
+        DataTransferLength) <= LastIoLength);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _RWCORE_H_
@@ -0,0 +1,302 @@
+/// iocore.cpp
+/// Request queue, last I/O cache and back-end dispatch of read and write
+/// requests. Same source is built into the driver and into the user mode
+/// benchmark harness, see iocore.h.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#ifdef IMSCSI_CORE_USER_MODE
+
+#include "iocore.h"
+
+#define RtlMoveMemory                       memmove
+
+#else
+
+#include "phdskmnt.h"
+
+#define ImScsiCoreInitializeLock            KeInitializeSpinLock
+#define ImScsiCoreAcquireLock               ImScsiAcquireLock
+#define ImScsiCoreReleaseLock               ImScsiReleaseLock
+#define ImScsiCoreInitializeEvent(Event)    KeInitializeEvent((Event), SynchronizationEvent, FALSE)
+#define ImScsiCoreSetEvent(Event)           KeSetEvent((Event), (KPRIORITY)0, FALSE)
+#define ImScsiCoreAllocate(Size)            ExAllocatePoolWithTag(NonPagedPool, (Size), MP_TAG_GENERAL)
+#define ImScsiCoreFree(Block)               ExFreePoolWithTag((Block), MP_TAG_GENERAL)
+
+#endif
+
+VOID
+ImScsiCoreInitializeQueue(
+    PIMSCSI_CORE_QUEUE          Queue)
+{
+    InitializeListHead(&Queue->List);
+    ImScsiCoreInitializeLock(&Queue->Lock);
+    ImScsiCoreInitializeEvent(&Queue->Event);
+}
+
+VOID
+ImScsiCoreQueueInsert(
+    PIMSCSI_CORE_QUEUE          Queue,
+    PLIST_ENTRY                 Entry,
+    PKIRQL                      LowestAssumedIrql)
+{
+    IMSCSI_CORE_LOCK_HANDLE lock_handle;
+
+    ImScsiCoreAcquireLock(&Queue->Lock, &lock_handle, *LowestAssumedIrql);
+
+    InsertTailList(&Queue->List, Entry);
+
+    ImScsiCoreReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    ImScsiCoreSetEvent(&Queue->Event);
+}
+
+PLIST_ENTRY
+ImScsiCoreQueueRemove(
+    PIMSCSI_CORE_QUEUE          Queue,
+    PKIRQL                      LowestAssumedIrql)
+{
+    IMSCSI_CORE_LOCK_HANDLE lock_handle;
+    PLIST_ENTRY entry;
+
+    ImScsiCoreAcquireLock(&Queue->Lock, &lock_handle, *LowestAssumedIrql);
+
+    entry = RemoveHeadList(&Queue->List);
+
+    ImScsiCoreReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    if (entry == &Queue->List)
+    {
+        return NULL;
+    }
+
+    return entry;
+}
+
+VOID
+ImScsiCoreInitializeLU(
+    PIMSCSI_CORE_LU             Lu,
+    const IMSCSI_CORE_BACKEND  *Backend,
+    PVOID                       Context)
+{
+    Lu->Backend = Backend;
+    Lu->Context = Context;
+
+    ImScsiCoreInitializeQueue(&Lu->Queue);
+
+    Lu->LastIo.Buffer = NULL;
+    Lu->LastIo.StartSector = 0;
+    Lu->LastIo.Length = 0;
+    ImScsiCoreInitializeLock(&Lu->LastIo.Lock);
+
+    Lu->WriteBack = FALSE;
+    Lu->WriteBackDirty = 0;
+    Lu->WriteBackLimit = 0;
+}
+
+BOOLEAN
+ImScsiCoreReadLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    const IMSCSI_RW_REQUEST    *Request,
+    ULONG                       DataTransferLength,
+    UCHAR                       BlockPower,
+    PVOID                       Destination,
+    PKIRQL                      LowestAssumedIrql)
+{
+    IMSCSI_CORE_LOCK_HANDLE lock_handle;
+    BOOLEAN hit;
+
+    ImScsiCoreAcquireLock(&LastIo->Lock, &lock_handle, *LowestAssumedIrql);
+
+    hit = (LastIo->Buffer != NULL) &&
+        ImScsiLastIoCovers(Request, DataTransferLength, BlockPower,
+        LastIo->StartSector, LastIo->Length);
+
+    if (hit)
+    {
+        RtlMoveMemory(
+            Destination,
+            (PUCHAR)LastIo->Buffer + Request->StartingOffset -
+            (LastIo->StartSector << BlockPower),
+            DataTransferLength);
+    }
+
+    ImScsiCoreReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    return hit;
+}
+
+VOID
+ImScsiCoreStoreLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    LONGLONG                    StartSector,
+    ULONG                       Length,
+    PVOID                       Buffer,
+    PKIRQL                      LowestAssumedIrql)
+{
+    IMSCSI_CORE_LOCK_HANDLE lock_handle;
+    PVOID old_buffer;
+
+    ImScsiCoreAcquireLock(&LastIo->Lock, &lock_handle, *LowestAssumedIrql);
+
+    old_buffer = LastIo->Buffer;
+
+    LastIo->StartSector = StartSector;
+    LastIo->Length = Length;
+    LastIo->Buffer = Buffer;
+
+    ImScsiCoreReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    if (old_buffer != NULL)
+    {
+        ImScsiCoreFree(old_buffer);
+    }
+}
+
+VOID
+ImScsiCoreDropLastIo(
+    PIMSCSI_CORE_LAST_IO        LastIo,
+    PKIRQL                      LowestAssumedIrql)
+{
+    IMSCSI_CORE_LOCK_HANDLE lock_handle;
+    PVOID old_buffer;
+
+    ImScsiCoreAcquireLock(&LastIo->Lock, &lock_handle, *LowestAssumedIrql);
+
+    old_buffer = LastIo->Buffer;
+    LastIo->Buffer = NULL;
+
+    ImScsiCoreReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    if (old_buffer != NULL)
+    {
+        ImScsiCoreFree(old_buffer);
+    }
+}
+
+NTSTATUS
+ImScsiCoreFlush(
+    PIMSCSI_CORE_LU             Lu)
+{
+    Lu->WriteBackDirty = 0;
+
+    if (Lu->Backend->Flush == NULL)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    return Lu->Backend->Flush(Lu->Context);
+}
+
+NTSTATUS
+ImScsiCoreDispatchReadWrite(
+    PIMSCSI_CORE_LU             Lu,
+    const IMSCSI_RW_REQUEST    *Request,
+    PVOID                       SystemBuffer,
+    PULONG                      Length,
+    BOOLEAN                     ForceUnitAccess,
+    PKIRQL                      LowestAssumedIrql)
+{
+    NTSTATUS status;
+    PVOID buffer;
+
+    buffer = ImScsiCoreAllocate(*Length);
+
+    if (buffer == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    if (Request->Write)
+    {
+        RtlMoveMemory(buffer, SystemBuffer, *Length);
+
+        status = Lu->Backend->Write(Lu->Context, buffer,
+            Request->StartingOffset, Length);
+
+        // Write-back data is flushed when FUA is requested or when too
+        // much has been written since last flush.
+        if (NT_SUCCESS(status) && Lu->WriteBack)
+        {
+            Lu->WriteBackDirty += *Length;
+
+            if (ForceUnitAccess ||
+                (Lu->WriteBackDirty >= Lu->WriteBackLimit))
+            {
+                status = ImScsiCoreFlush(Lu);
+            }
+        }
+    }
+    else
+    {
+        status = Lu->Backend->Read(Lu->Context, buffer,
+            Request->StartingOffset, Length);
+
+        if (NT_SUCCESS(status))
+        {
+            RtlMoveMemory(SystemBuffer, buffer, *Length);
+        }
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        ImScsiCoreFree(buffer);
+        return status;
+    }
+
+    ImScsiCoreStoreLastIo(&Lu->LastIo, Request->StartingSector, *Length,
+        buffer, LowestAssumedIrql);
+
+    return status;
+}
+
+VOID
+ImScsiCoreGetSense(
+    NTSTATUS                    Status,
+    PIMSCSI_CORE_SENSE          Sense)
+{
+    switch (Status)
+    {
+    case STATUS_INVALID_BUFFER_SIZE:
+        Sense->SrbStatus = SRB_STATUS_ERROR;
+        Sense->SenseKey = SCSI_SENSE_ILLEGAL_REQUEST;
+        Sense->AdditionalSenseCode = SCSI_ADSENSE_INVALID_CDB;
+        Sense->AdditionalSenseCodeQualifier = 0;
+        break;
+
+    case STATUS_DEVICE_BUSY:
+        Sense->SrbStatus = SRB_STATUS_BUSY;
+        Sense->SenseKey = SCSI_SENSE_NOT_READY;
+        Sense->AdditionalSenseCode = SCSI_ADSENSE_LUN_NOT_READY;
+        Sense->AdditionalSenseCodeQualifier = SCSI_SENSEQ_BECOMING_READY;
+        break;
+
+    case STATUS_DATA_ERROR:
+        Sense->SrbStatus = SRB_STATUS_ERROR;
+        Sense->SenseKey = SCSI_SENSE_MEDIUM_ERROR;
+        Sense->AdditionalSenseCode = SCSI_ADSENSE_UNRECOVERED_ERROR;
+        Sense->AdditionalSenseCodeQualifier = 0;
+        break;
+
+    case STATUS_INSUFFICIENT_RESOURCES:
+        Sense->SrbStatus = SRB_STATUS_ERROR;
+        Sense->SenseKey = SCSI_SENSE_NO_SENSE;
+        Sense->AdditionalSenseCode = 0;
+        Sense->AdditionalSenseCodeQualifier = 0;
+        break;
+
+    default:
+        Sense->SrbStatus = SRB_STATUS_PARITY_ERROR;
+        Sense->SenseKey = SCSI_SENSE_NO_SENSE;
+        Sense->AdditionalSenseCode = 0;
+        Sense->AdditionalSenseCodeQualifier = 0;
+        break;
+    }
+}
@@ -39,7 +39,6 @@ __inout __deref PKIRQL         LowestAssumedIrql
 )
 {
     pHW_HBA_EXT             pHBAExt = pLUExt->pHBAExt;
-    pHW_LU_EXTENSION *      ppLUExt = NULL;
     PLIST_ENTRY             list_ptr;
     pMP_WorkRtnParms        free_worker_params = NULL;
     KLOCK_QUEUE_HANDLE      LockHandle;
@@ -66,15 +65,11 @@ __inout __deref PKIRQL         LowestAssumedIrql
     ImScsiAcquireLock(                   // Serialize the linked list of LUN extensions.              
         &pHBAExt->LUListLock, &LockHandle, *LowestAssumedIrql);
 
-    ppLUExt = (pHW_LU_EXTENSION*)StoragePortGetLogicalUnit(
-        pHBAExt,
-        pLUExt->DeviceNumber.PathId,
-        pLUExt->DeviceNumber.TargetId,
-        pLUExt->DeviceNumber.Lun
-        );
+    // New requests will not find this LU. Memory is freed after
+    // ImScsiWaitForLULookups in global worker thread.
+    ImScsiUnpublishLU(pHBAExt, pLUExt);
 
-    if (ppLUExt != NULL)
-        *ppLUExt = NULL;
+    ImScsiReleaseDeviceNumber(pHBAExt, &pLUExt->DeviceNumber);
 
     for (list_ptr = pHBAExt->LUList.Flink;
         list_ptr != &pHBAExt->LUList;
@@ -86,7 +81,6 @@ __inout __deref PKIRQL         LowestAssumedIrql
 
         if (object == pLUExt)
         {
-            KLOCK_QUEUE_HANDLE inner_lock_handle;
             KIRQL inner_assumed_irql = DISPATCH_LEVEL;
 
             list_ptr->Blink->Flink = list_ptr->Flink;
@@ -105,15 +99,8 @@ __inout __deref PKIRQL         LowestAssumedIrql
             // after this function has run to completion.
             KdPrint(("PhDskMnt::ImScsiCleanupLU: Setting request to wait for LU worker thread.\n"));
 
-            ImScsiAcquireLock(&pMPDrvInfoGlobal->RequestListLock,
-                &inner_lock_handle, inner_assumed_irql);
-
-            InsertTailList(&pMPDrvInfoGlobal->RequestList,
-                &free_worker_params->RequestListEntry);
-
-            ImScsiReleaseLock(&inner_lock_handle, &inner_assumed_irql);
-
-            KeSetEvent(&pMPDrvInfoGlobal->RequestEvent, (KPRIORITY)0, FALSE);
+            ImScsiCoreQueueInsert(&pMPDrvInfoGlobal->RequestQueue,
+                &free_worker_params->RequestListEntry, &inner_assumed_irql);
 
             break;
         }
@@ -121,33 +108,66 @@ __inout __deref PKIRQL         LowestAssumedIrql
 
     ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
 
+    /// Wait for copy operations in other LU worker threads
+    /// that still read from this LU, see odx.cpp.
+    KeMemoryBarrier();
+
+    while (pLUExt->CopyReferences != 0)
+    {
+        LARGE_INTEGER wait_time;
+
+        KdPrint(("PhDskMnt::ImScsiCleanupLU: Waiting for %i copy operations.\n",
+            pLUExt->CopyReferences));
+
+        wait_time.QuadPart = -100000;
+        KeDelayExecutionThread(KernelMode, FALSE, &wait_time);
+    }
+
+    /// Write cached data before handles are closed.
+    if (pLUExt->Core.WriteBack)
+        ImScsiFlushLU(pLUExt);
+
     /// Cleanup all file handles, object name buffers,
     /// proxy refs etc.
+    ImScsiStopImageHash(pLUExt);
+
+    ImScsiCloseMerkleIndex(pLUExt);
+
     if (pLUExt->UseProxy)
     {
+        ImScsiCloseProxyCache(pLUExt);
         ImScsiCloseProxy(&pLUExt->Proxy);
     }
 
-    if (pLUExt->LastIoBuffer != NULL)
-    {
-        ExFreePoolWithTag(pLUExt->LastIoBuffer, MP_TAG_GENERAL);
-        pLUExt->LastIoBuffer = NULL;
-    }
+    ImScsiDropLastIoBuffer(pLUExt, LowestAssumedIrql);
 
     if (pLUExt->VMDisk)
     {
-        SIZE_T free_size = 0;
-        if (pLUExt->ImageBuffer != NULL)
+        ImScsiFreeVMChunkTable(pLUExt);
+
+        // Image file is still open if lazy loading did not finish
+        if (pLUExt->ImageFile != NULL)
         {
-            ZwFreeVirtualMemory(NtCurrentProcess(),
-                (PVOID*)&pLUExt->ImageBuffer,
-                &free_size, MEM_RELEASE);
+            ZwClose(pLUExt->ImageFile);
+            pLUExt->ImageFile = NULL;
+        }
+
+        if (pLUExt->VMLoadedChunks.Buffer != NULL)
+        {
+            ExFreePoolWithTag(pLUExt->VMLoadedChunks.Buffer, MP_TAG_GENERAL);
+            pLUExt->VMLoadedChunks.Buffer = NULL;
         }
 
-        pLUExt->ImageBuffer = NULL;
+        pLUExt->VMLazyLoad = FALSE;
     }
     else
     {
+        ImScsiCloseWriteOverlay(pLUExt);
+
+        ImScsiCloseImageSegments(pLUExt);
+
+        ImScsiCloseCacheFile(pLUExt);
+
         if (pLUExt->FileObject != NULL)
         {
             ObDereferenceObject(pLUExt->FileObject);
@@ -184,7 +204,6 @@ __inout __deref PKIRQL    LowestAssumedIrql
 )
 {
     PSRB_IMSCSI_CREATE_DATA new_device = (PSRB_IMSCSI_CREATE_DATA)pSrb->DataBuffer;
-    PLIST_ENTRY             list_ptr;
     pHW_LU_EXTENSION        pLUExt = NULL;
     NTSTATUS                ntstatus;
 
@@ -195,38 +214,18 @@ __inout __deref PKIRQL    LowestAssumedIrql
         new_device->Fields.DeviceNumber.TargetId,
         new_device->Fields.DeviceNumber.Lun));
 
+    // Device number was reserved by ImScsiCreateDevice, no other LU
+    // can have it until this LU is cleaned up.
+
     ImScsiAcquireLock(                   // Serialize the linked list of LUN extensions.              
         &pHBAExt->LUListLock, &LockHandle, *LowestAssumedIrql);
 
-    for (list_ptr = pHBAExt->LUList.Flink;
-        list_ptr != &pHBAExt->LUList;
-        list_ptr = list_ptr->Flink
-        )
-    {
-        pHW_LU_EXTENSION object;
-        object = CONTAINING_RECORD(list_ptr, HW_LU_EXTENSION, List);
-
-        if (object->DeviceNumber.LongNumber ==
-            new_device->Fields.DeviceNumber.LongNumber)
-        {
-            pLUExt = object;
-            break;
-        }
-    }
-
-    if (pLUExt != NULL)
-    {
-        ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
-
-        ntstatus = STATUS_OBJECT_NAME_COLLISION;
-
-        goto Done;
-    }
-
     pLUExt = (pHW_LU_EXTENSION)ExAllocatePoolWithTag(NonPagedPool, sizeof(HW_LU_EXTENSION), MP_TAG_GENERAL);
 
     if (pLUExt == NULL)
     {
+        ImScsiReleaseDeviceNumber(pHBAExt, &new_device->Fields.DeviceNumber);
+
         ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
 
         ntstatus = STATUS_INSUFFICIENT_RESOURCES;
@@ -236,12 +235,16 @@ __inout __deref PKIRQL    LowestAssumedIrql
 
     RtlZeroMemory(pLUExt, sizeof(HW_LU_EXTENSION));
 
+    ImScsiAllocateStatistics(pLUExt);
+
     pLUExt->DeviceNumber = new_device->Fields.DeviceNumber;
 
     KeInitializeEvent(&pLUExt->StopThread, NotificationEvent, FALSE);
 
     InsertHeadList(&pHBAExt->LUList, &pLUExt->List);
 
+    ImScsiPublishLU(pHBAExt, pLUExt);
+
     ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
 
     pLUExt->pHBAExt = pHBAExt;
@@ -268,7 +271,6 @@ PIRP Irp,
 PVOID Context)
 {
     UNREFERENCED_PARAMETER(DeviceObject);
-    UNREFERENCED_PARAMETER(Context);
 
     if (!NT_SUCCESS(Irp->IoStatus.Status))
         DbgPrint("PhDskMnt::ImScsiIoCtlCallCompletion: SMB_IMSCSI_CHECK failed: 0x%X\n",
@@ -276,9 +278,8 @@ PVOID Context)
     else
         KdPrint2(("PhDskMnt::ImScsiIoCtlCallCompletion: Finished SMB_IMSCSI_CHECK.\n"));
 
-    ExFreePoolWithTag(Irp->AssociatedIrp.SystemBuffer, MP_TAG_GENERAL);
-
-    ImScsiFreeIrpWithMdls(Irp);
+    // IRP is reused by ImScsiCompletionThread, which waits for this event.
+    KeSetEvent((PKEVENT)Context, (KPRIORITY)0, FALSE);
 
     return STATUS_MORE_PROCESSING_REQUIRED;
 }
@@ -351,6 +352,8 @@ PVOID Context)
         }
     }
 
+    ImScsiTraceSrb(IMSCSI_TRACE_BACKEND_DONE, pWkRtnParms->pSrb);
+
     if (Irp->MdlAddress != pWkRtnParms->pOriginalMdl)
     {
         ImScsiFreeIrpWithMdls(Irp);
@@ -360,21 +363,14 @@ PVOID Context)
         IoFreeIrp(Irp);
     }
 
+    ImScsiStatisticsDone(pWkRtnParms);
+
     if (pWkRtnParms->AllocatedBuffer != NULL)
     {
-        PCDB pCdb = (PCDB)pWkRtnParms->pSrb->Cdb;
         LARGE_INTEGER startingSector;
-        KLOCK_QUEUE_HANDLE LockHandle;
 
-        if ((pCdb->AsByte[0] == SCSIOP_READ16) |
-            (pCdb->AsByte[0] == SCSIOP_WRITE16))
-        {
-            REVERSE_BYTES_QUAD(&startingSector, pCdb->CDB16.LogicalBlock);
-        }
-        else
-        {
-            REVERSE_BYTES(&startingSector, &pCdb->CDB10.LogicalBlockByte0);
-        }
+        startingSector.QuadPart =
+            ImScsiCdbGetLogicalBlock(pWkRtnParms->pSrb->Cdb);
 
         if (thread == NULL)
         {
@@ -386,21 +382,9 @@ PVOID Context)
             lowest_assumed_irql = pWkRtnParms->LowestAssumedIrql;
         }
 
-        ImScsiAcquireLock(&pWkRtnParms->pLUExt->LastIoLock, &LockHandle,
-            lowest_assumed_irql);
-
-        if (pWkRtnParms->pLUExt->LastIoBuffer != NULL)
-        {
-            ExFreePoolWithTag(pWkRtnParms->pLUExt->LastIoBuffer,
-                MP_TAG_GENERAL);
-        }
-
-        pWkRtnParms->pLUExt->LastIoStartSector = startingSector.QuadPart;
-        pWkRtnParms->pLUExt->LastIoLength =
-            pWkRtnParms->pSrb->DataTransferLength;
-        pWkRtnParms->pLUExt->LastIoBuffer = pWkRtnParms->AllocatedBuffer;
-
-        ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+        ImScsiCoreStoreLastIo(&pWkRtnParms->pLUExt->Core.LastIo,
+            startingSector.QuadPart, pWkRtnParms->pSrb->DataTransferLength,
+            pWkRtnParms->AllocatedBuffer, &lowest_assumed_irql);
     }
 
 #ifdef USE_SCSIPORT
@@ -414,6 +398,8 @@ PVOID Context)
     {
         KdPrint2(("PhDskMnt::ImScsiParallelReadWriteImageCompletion sending 'RequestComplete', 'NextRequest' and 'NextLuRequest' to ScsiPort.\n"));
 
+        ImScsiTraceSrb(IMSCSI_TRACE_COMPLETE, pWkRtnParms->pSrb);
+
         ScsiPortNotification(RequestComplete, pWkRtnParms->pHBAExt, pWkRtnParms->pSrb);
         ScsiPortNotification(NextRequest, pWkRtnParms->pHBAExt);
         ScsiPortNotification(NextLuRequest, pWkRtnParms->pHBAExt, 0, 0, 0);
@@ -422,35 +408,9 @@ PVOID Context)
     }
     else
     {
-        PIRP ioctl_irp = NULL;
-        KIRQL known_irql;
-
-        if (pWkRtnParms->AllocatedBuffer != NULL)
-        {
-            known_irql = lowest_assumed_irql;
-        }
-        else
-        {
-            known_irql = KeGetCurrentIrql();
-        }
-        
-        if (known_irql == PASSIVE_LEVEL)
-        {
-            ioctl_irp = ImScsiBuildCompletionIrp();
-
-            if (ioctl_irp == NULL)
-            {
-                DbgPrint("PhDskMnt::ImScsiParallelReadWriteImageCompletion: ImScsiBuildCompletionIrp failed.\n");
-            }
-        }
-        else
-        {
-            KdPrint2(("PhDskMnt::ImScsiParallelReadWriteImageCompletion: IRQL too high to call for Srb completion through SMP_IMSCSI_CHECK. Queuing for timer instead.\n"));
-        }
-
         KdPrint2(("PhDskMnt::ImScsiParallelReadWriteImageCompletion calling for Srb completion.\n"));
 
-        ImScsiCallForCompletion(ioctl_irp, pWkRtnParms, &lowest_assumed_irql);
+        ImScsiCallForCompletion(pWkRtnParms, &lowest_assumed_irql);
     }
 
 #endif
@@ -458,6 +418,7 @@ PVOID Context)
 #ifdef USE_STORPORT
 
     KdPrint2(("PhDskMnt::ImScsiParallelReadWriteImageCompletion sending 'RequestComplete' to port StorPort.\n"));
+    ImScsiTraceSrb(IMSCSI_TRACE_COMPLETE, pWkRtnParms->pSrb);
     StorPortNotification(RequestComplete, pWkRtnParms->pHBAExt, pWkRtnParms->pSrb);
 
     ExFreePoolWithTag(pWkRtnParms, MP_TAG_GENERAL);
@@ -468,58 +429,25 @@ PVOID Context)
 }
 
 #ifdef USE_SCSIPORT
-PIRP
-ImScsiBuildCompletionIrp()
-{
-    PIRP ioctl_irp;
-    PIO_STACK_LOCATION ioctl_stack;
-    PSRB_IMSCSI_CHECK completion_srb;
-
-    completion_srb = (PSRB_IMSCSI_CHECK)ExAllocatePoolWithTag(NonPagedPool,
-        sizeof(*completion_srb), MP_TAG_GENERAL);
-
-    if (completion_srb == NULL)
-    {
-        return NULL;
-    }
-
-    ImScsiInitializeSrbIoBlock(&completion_srb->SrbIoControl,
-        sizeof(*completion_srb), SMP_IMSCSI_CHECK, 0);
-
-    ioctl_irp = IoAllocateIrp(
-        pMPDrvInfoGlobal->ControllerObject->StackSize, FALSE);
-
-    if (ioctl_irp == NULL)
-    {
-        ExFreePoolWithTag(completion_srb, MP_TAG_GENERAL);
-        return NULL;
-    }
-
-    ioctl_irp->AssociatedIrp.SystemBuffer = completion_srb;
-
-    ioctl_stack = IoGetNextIrpStackLocation(ioctl_irp);
-    ioctl_stack->MajorFunction = IRP_MJ_DEVICE_CONTROL;
-    ioctl_stack->Parameters.DeviceIoControl.InputBufferLength =
-        sizeof(*completion_srb);
-    ioctl_stack->Parameters.DeviceIoControl.IoControlCode =
-        IOCTL_SCSI_MINIPORT;
-
-    IoSetCompletionRoutine(ioctl_irp, ImScsiIoCtlCallCompletion,
-        NULL, TRUE, TRUE, TRUE);
-
-    return ioctl_irp;
-}
-
-NTSTATUS
-ImScsiCallForCompletion(__in __deref PIRP Irp OPTIONAL,
-__in __deref pMP_WorkRtnParms pWkRtnParms,
+//
+// SCSIPORT only accepts RequestComplete notifications from within miniport
+// callbacks. Finished work is queued on ResponseList, which is drained by
+// MpHwStartIo before each new SRB. ImScsiCompletionThread sends an
+// SMP_IMSCSI_CHECK request whenever work is queued, so that one call
+// completes everything queued so far. MpHwTimer polls the list as a fallback
+// if the controller device object cannot be found.
+//
+VOID
+ImScsiCallForCompletion(__in __deref pMP_WorkRtnParms pWkRtnParms,
 __inout __deref PKIRQL LowestAssumedIrql)
 {
     KLOCK_QUEUE_HANDLE lock_handle;
 
-    KdPrint2(("PhDskMnt::ImScsiCallForCompletion: Invoking SMB_IMSCSI_CHECK for work: 0x%p.\n",
+    KdPrint2(("PhDskMnt::ImScsiCallForCompletion: Queuing for SMB_IMSCSI_CHECK work: 0x%p.\n",
         pWkRtnParms));
 
+    pWkRtnParms->ResponseQueued = KeQueryPerformanceCounter(NULL);
+
     ImScsiAcquireLock(&pMPDrvInfoGlobal->ResponseListLock,
         &lock_handle, *LowestAssumedIrql);
 
@@ -529,14 +457,7 @@ __inout __deref PKIRQL LowestAssumedIrql)
 
     ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
 
-    if (Irp != NULL)
-    {
-        return IoCallDriver(pMPDrvInfoGlobal->ControllerObject, Irp);
-    }
-    else
-    {
-        return STATUS_SUCCESS;
-    }
+    KeSetEvent(&pMPDrvInfoGlobal->ResponseEvent, (KPRIORITY)0, FALSE);
 }
 #endif // USE_SCSIPORT
 
@@ -547,7 +468,6 @@ __inout __deref PUCHAR   pResult,
 __inout __deref PKIRQL   LowestAssumedIrql
 )
 {
-    PCDB pCdb = (PCDB)pWkRtnParms->pSrb->Cdb;
     PIO_STACK_LOCATION lower_io_stack = NULL;
     PDEVICE_OBJECT lower_device =
         IoGetRelatedDeviceObject(pWkRtnParms->pLUExt->FileObject);
@@ -557,15 +477,8 @@ __inout __deref PKIRQL   LowestAssumedIrql
     UCHAR function = 0;
     BOOLEAN use_mdl = FALSE;
 
-    if ((pCdb->AsByte[0] == SCSIOP_READ16) |
-        (pCdb->AsByte[0] == SCSIOP_WRITE16))
-    {
-        REVERSE_BYTES_QUAD(&starting_sector, pCdb->CDB16.LogicalBlock);
-    }
-    else
-    {
-        REVERSE_BYTES(&starting_sector, &pCdb->CDB10.LogicalBlockByte0);
-    }
+    starting_sector.QuadPart =
+        ImScsiCdbGetLogicalBlock(pWkRtnParms->pSrb->Cdb);
 
     starting_offset.QuadPart = (starting_sector.QuadPart <<
         pWkRtnParms->pLUExt->BlockPower) +
@@ -732,7 +645,10 @@ __inout __deref PKIRQL   LowestAssumedIrql
     else if (function == IRP_MJ_WRITE)
     {
         lower_irp->Flags |= IRP_WRITE_OPERATION;
-        lower_io_stack->Flags |= SL_WRITE_THROUGH;
+
+        if ((!pWkRtnParms->pLUExt->Core.WriteBack) ||
+            IMSCSI_SRB_FUA(pWkRtnParms->pSrb))
+            lower_io_stack->Flags |= SL_WRITE_THROUGH;
     }
 
     lower_irp->Flags |= IRP_NOCACHE;
@@ -748,9 +664,13 @@ __inout __deref PKIRQL   LowestAssumedIrql
     pWkRtnParms->pReqThread = PsGetCurrentThread();
     pWkRtnParms->LowestAssumedIrql = *LowestAssumedIrql;
 
+    ImScsiStatisticsStart(pWkRtnParms);
+
     IoSetCompletionRoutine(lower_irp, ImScsiParallelReadWriteImageCompletion,
         pWkRtnParms, TRUE, TRUE, TRUE);
 
+    ImScsiTraceSrb(IMSCSI_TRACE_BACKEND_SUBMIT, pWkRtnParms->pSrb);
+
     IoCallDriver(lower_device, lower_irp);
 
     *pResult = ResultQueued;
@@ -776,20 +696,29 @@ __in PULONG           Length
 
     if (pLUExt->VMDisk)
     {
-#ifdef _WIN64
-        ULONG_PTR vm_offset = Offset->QuadPart;
-#else
-        ULONG_PTR vm_offset = Offset->LowPart;
-#endif
+        status = ImScsiLoadMemoryDiskRange(pLUExt, Offset, *Length, FALSE);
 
-        RtlCopyMemory(Buffer,
-            pLUExt->ImageBuffer + vm_offset,
-            *Length);
+        if (NT_SUCCESS(status))
+        {
+            status = ImScsiReadVMDisk(pLUExt,
+                (PUCHAR)Buffer,
+                Offset->QuadPart,
+                *Length);
+        }
 
-        status = STATUS_SUCCESS;
-        io_status.Status = status;
-        io_status.Information = *Length;
+        if (NT_SUCCESS(status))
+        {
+            io_status.Status = status;
+            io_status.Information = *Length;
+        }
     }
+    else if (pLUExt->ProxyCache != NULL)
+        status = ImScsiReadProxyCached(
+        pLUExt,
+        Buffer,
+        &byteoffset,
+        *Length,
+        &io_status);
     else if (pLUExt->UseProxy)
         status = ImScsiReadProxy(
         &pLUExt->Proxy,
@@ -798,6 +727,21 @@ __in PULONG           Length
         Buffer,
         *Length,
         &byteoffset);
+    else if (pLUExt->Segments != NULL)
+        status = ImScsiReadWriteSegments(
+        pLUExt,
+        IRP_MJ_READ,
+        Buffer,
+        &byteoffset,
+        *Length,
+        &io_status);
+    else if (pLUExt->CacheFile != NULL)
+        status = ImScsiReadCachedFile(
+        pLUExt,
+        Buffer,
+        &byteoffset,
+        *Length,
+        &io_status);
     else if (pLUExt->ImageFile != NULL)
         status = NtReadFile(
         pLUExt->ImageFile,
@@ -850,21 +794,20 @@ ImScsiZeroDevice(
 
     if (pLUExt->VMDisk)
     {
-#ifdef _WIN64
-        ULONG_PTR vm_offset = Offset->QuadPart;
-#else
-        ULONG_PTR vm_offset = Offset->LowPart;
-#endif
-
-        RtlZeroMemory(pLUExt->ImageBuffer + vm_offset,
-            Length);
+        status = ImScsiLoadMemoryDiskRange(pLUExt, Offset, Length, TRUE);
 
-        status = STATUS_SUCCESS;
+        if (NT_SUCCESS(status))
+        {
+            status = ImScsiWriteVMDisk(pLUExt,
+                NULL,
+                Offset->QuadPart,
+                Length);
+        }
     }
     else if (pLUExt->UseProxy)
     {
         DEVICE_DATA_SET_RANGE range;
-        range.StartingOffset = Offset->QuadPart;
+        range.StartingOffset = byteoffset.QuadPart;
         range.LengthInBytes = Length;
 
         status = ImScsiUnmapOrZeroProxy(
@@ -874,12 +817,15 @@ ImScsiZeroDevice(
             &pLUExt->StopThread,
             1,
             &range);
+
+        ImScsiInvalidateProxyCache(pLUExt, range.StartingOffset,
+            range.LengthInBytes);
     }
     else if (pLUExt->ImageFile != NULL)
     {
         FILE_ZERO_DATA_INFORMATION zerodata;
-        zerodata.FileOffset = *Offset;
-        zerodata.BeyondFinalZero.QuadPart = Offset->QuadPart + Length;
+        zerodata.FileOffset = byteoffset;
+        zerodata.BeyondFinalZero.QuadPart = byteoffset.QuadPart + Length;
 
         status = ZwFsControlFile(
             pLUExt->ImageFile,
@@ -917,6 +863,9 @@ __in PULONG           Length
     {
         status = ImScsiZeroDevice(pLUExt, Offset, *Length);
 
+        ImScsiInvalidateCache(pLUExt,
+            Offset->QuadPart + pLUExt->ImageOffset.QuadPart, *Length);
+
         if (NT_SUCCESS(status))
         {
             KdPrint2(("PhDskMnt::ImScsiWriteDevice: Zero block set at %I64i, bytes: %u.\n",
@@ -940,19 +889,21 @@ __in PULONG           Length
 
     if (pLUExt->VMDisk)
     {
-#ifdef _WIN64
-        ULONG_PTR vm_offset = Offset->QuadPart;
-#else
-        ULONG_PTR vm_offset = Offset->LowPart;
-#endif
+        status = ImScsiLoadMemoryDiskRange(pLUExt, Offset, *Length, TRUE);
 
-        RtlCopyMemory(pLUExt->ImageBuffer + vm_offset,
-            Buffer,
-            *Length);
+        if (NT_SUCCESS(status))
+        {
+            status = ImScsiWriteVMDisk(pLUExt,
+                (const UCHAR*)Buffer,
+                Offset->QuadPart,
+                *Length);
+        }
 
-        status = STATUS_SUCCESS;
-        io_status.Status = status;
-        io_status.Information = *Length;
+        if (NT_SUCCESS(status))
+        {
+            io_status.Status = status;
+            io_status.Information = *Length;
+        }
     }
     else if (pLUExt->UseProxy)
     {
@@ -963,6 +914,18 @@ __in PULONG           Length
             Buffer,
             *Length,
             &byteoffset);
+
+        ImScsiInvalidateProxyCache(pLUExt, byteoffset.QuadPart, *Length);
+    }
+    else if (pLUExt->Segments != NULL)
+    {
+        status = ImScsiReadWriteSegments(
+            pLUExt,
+            IRP_MJ_WRITE,
+            Buffer,
+            &byteoffset,
+            *Length,
+            &io_status);
     }
     else if (pLUExt->ImageFile != NULL)
     {
@@ -976,6 +939,8 @@ __in PULONG           Length
             *Length,
             &byteoffset,
             NULL);
+
+        ImScsiInvalidateCache(pLUExt, byteoffset.QuadPart, *Length);
     }
 
     if (NT_SUCCESS(status))
@@ -1020,57 +985,41 @@ ImScsiExtendLU(
         goto done;
     }
 
+    // Differencing file of a write overlay is laid out for a fixed disk
+    // size. Split images would need a new segment file.
+    if ((device_extension->OverlayFile != NULL) ||
+        (device_extension->Segments != NULL))
+    {
+        status = STATUS_INVALID_DEVICE_REQUEST;
+        goto done;
+    }
+
     if (device_extension->VMDisk)
     {
-        PVOID new_image_buffer = NULL;
-        SIZE_T free_size = 0;
-#ifdef _WIN64
-        ULONG_PTR old_size =
-            device_extension->DiskSize.QuadPart;
-        SIZE_T max_size = new_size.EndOfFile.QuadPart;
-#else
-        ULONG_PTR old_size =
-            device_extension->DiskSize.LowPart;
-        SIZE_T max_size = new_size.EndOfFile.LowPart;
-
-        // A vm type disk cannot be extended to a larger size than
-        // 2 GB.
-        if (new_size.EndOfFile.QuadPart & 0xFFFFFFFF80000000)
-        {
-            status = STATUS_INVALID_DEVICE_REQUEST;
-            goto done;
-        }
-#endif // _WIN64
+        // Lazy loading needs to finish before chunk table changes size.
+        if (device_extension->VMLazyLoad)
+        {
+            while (ImScsiPrefetchMemoryDisk(device_extension));
 
-        KdPrint(("ImScsi: Allocating %I64u bytes.\n",
-            max_size));
+            if (device_extension->VMLazyLoad)
+            {
+                status = STATUS_DEVICE_NOT_READY;
+                goto done;
+            }
+        }
 
-        status = ZwAllocateVirtualMemory(NtCurrentProcess(),
-            &new_image_buffer,
-            0,
-            &max_size,
-            MEM_COMMIT,
-            PAGE_READWRITE);
+        // Only the chunk table is reallocated, chunks are allocated when
+        // written to.
+        status = ImScsiResizeVMChunkTable(device_extension,
+            new_size.EndOfFile.QuadPart);
 
         if (!NT_SUCCESS(status))
         {
-            status = STATUS_NO_MEMORY;
             goto done;
         }
 
-        RtlCopyMemory(new_image_buffer,
-            device_extension->ImageBuffer,
-            min(old_size, max_size));
-
-        ZwFreeVirtualMemory(NtCurrentProcess(),
-            (PVOID*)&device_extension->ImageBuffer,
-            &free_size,
-            MEM_RELEASE);
-
-        device_extension->ImageBuffer = (PUCHAR)new_image_buffer;
         device_extension->DiskSize = new_size.EndOfFile;
 
-        status = STATUS_SUCCESS;
         goto done;
     }
 
@@ -1155,11 +1104,20 @@ __in __deref PETHREAD ClientThread)
     HANDLE thread_handle = NULL;
     NTSTATUS status;
     HANDLE file_handle = NULL;
-    PUCHAR image_buffer = NULL;
+    PIMSCSI_VM_CHUNK *chunk_table = NULL;
+    ULONG chunk_table_size = 0;
     PROXY_CONNECTION proxy = { };
     ULONG alignment_requirement;
     BOOLEAN proxy_supports_unmap = FALSE;
+    BOOLEAN proxy_supports_allocated_ranges = FALSE;
+    BOOLEAN proxy_supports_copy = FALSE;
+    BOOLEAN proxy_supports_limits = FALSE;
+    BOOLEAN proxy_supports_identity = FALSE;
     BOOLEAN proxy_supports_zero = FALSE;
+    LONGLONG proxy_image_size = 0;
+    UNICODE_STRING overlay_name = { 0 };
+    UNICODE_STRING segment_names = { 0 };
+    BOOLEAN segment_auto_size = FALSE;
 
     ASSERT(CreateData != NULL);
 
@@ -1224,63 +1182,243 @@ __in __deref PETHREAD ClientThread)
         return STATUS_NOT_IMPLEMENTED;
     }
 
-    // Cannot create >= 2 GB VM disk in 32 bit version.
-#ifndef _WIN64
-    if ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM) &
-        ((CreateData->Fields.DiskSize.QuadPart & 0xFFFFFFFF80000000) !=
-        0))
+    // Digests are only meaningful for unmodified contents.
+    if ((CreateData->Fields.Flags & IMSCSI_HASH_IMAGE) &&
+        ((!IMSCSI_READONLY(CreateData->Fields.Flags)) ||
+        (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY)))
     {
-        KdPrint(("PhDskMnt: Cannot create >= 2GB vm disks on 32-bit system.\n"));
+        KdPrint(("PhDskMnt: Image hashing needs read-only virtual disk without write overlay.\n"));
+
+        ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+            0,
+            0,
+            NULL,
+            0,
+            1000,
+            STATUS_INVALID_PARAMETER,
+            102,
+            STATUS_INVALID_PARAMETER,
+            0,
+            0,
+            NULL,
+            L"Image hashing needs read-only virtual disk without write overlay."));
 
         return STATUS_INVALID_PARAMETER;
     }
-#endif
 
-    file_name.Length = CreateData->Fields.FileNameLength;
-    file_name.MaximumLength = CreateData->Fields.FileNameLength;
-    file_name.Buffer = NULL;
-
-    // If a file is to be opened or created, allocate name buffer and open that
-    // file...
-    if ((CreateData->Fields.FileNameLength > 0) |
-        ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &
-        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_AWEALLOC)))
+    // Merkle index file is found next to image file.
+    if ((CreateData->Fields.Flags & IMSCSI_VERIFY_IMAGE) &&
+        ((!IMSCSI_READONLY(CreateData->Fields.Flags)) ||
+        (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY) ||
+        (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_PROXY) ||
+        (CreateData->Fields.FileNameLength == 0)))
     {
-        IO_STATUS_BLOCK io_status;
-        OBJECT_ATTRIBUTES object_attributes;
-        UNICODE_STRING real_file_name;
-        ACCESS_MASK desired_access = 0;
-        ULONG share_access = 0;
-        ULONG create_options = 0;
-
-        if (CreateData->Fields.FileNameLength > 0)
-        {
-            file_name.Buffer = (PWCHAR)ExAllocatePoolWithTag(NonPagedPool,
-                file_name.MaximumLength, MP_TAG_GENERAL);
+        KdPrint(("PhDskMnt: Image verification needs read-only image file without write overlay.\n"));
 
-            if (file_name.Buffer == NULL)
-            {
-                KdPrint(("PhDskMnt: Error allocating buffer for filename.\n"));
+        ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+            0,
+            0,
+            NULL,
+            0,
+            1000,
+            STATUS_INVALID_PARAMETER,
+            102,
+            STATUS_INVALID_PARAMETER,
+            0,
+            0,
+            NULL,
+            L"Image verification needs read-only image file without write overlay."));
 
-                ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
-                    0,
-                    0,
-                    NULL,
-                    0,
-                    1000,
-                    STATUS_INSUFFICIENT_RESOURCES,
-                    102,
-                    STATUS_INSUFFICIENT_RESOURCES,
-                    0,
-                    0,
-                    NULL,
-                    L"Memory allocation error."));
+        return STATUS_INVALID_PARAMETER;
+    }
 
-                return STATUS_INSUFFICIENT_RESOURCES;
-            }
+    // Parallel I/O would bypass verification.
+    if ((CreateData->Fields.Flags & IMSCSI_VERIFY_IMAGE) &&
+        (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &&
+        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_PARALLEL_IO))
+        CreateData->Fields.Flags &= ~IMSCSI_FILE_TYPE_PARALLEL_IO;
+
+    // Write-back caching uses file system cache of image file or
+    // write overlay, other backing stores complete writes directly.
+    if ((CreateData->Fields.Flags & IMSCSI_WRITE_BACK) &&
+        ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM) ||
+        ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &&
+        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_AWEALLOC)) ||
+        ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_PROXY) &&
+        !(CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY)) ||
+        (CreateData->Fields.Flags & IMSCSI_MULTI_SEGMENT)))
+    {
+        KdPrint(("PhDskMnt: Write-back caching needs image file or write overlay.\n"));
 
-            RtlCopyMemory(file_name.Buffer, CreateData->Fields.FileName,
-                CreateData->Fields.FileNameLength);
+        ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+            0,
+            0,
+            NULL,
+            0,
+            1000,
+            STATUS_INVALID_PARAMETER,
+            102,
+            STATUS_INVALID_PARAMETER,
+            0,
+            0,
+            NULL,
+            L"Write-back caching needs image file or write overlay."));
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    // With write overlay, FileName is image file name followed by a null
+    // character and differencing file name. Image file name is used as
+    // file name from here, differencing file is opened last.
+    if (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY)
+    {
+        USHORT name_length = 0;
+
+        while ((name_length < CreateData->Fields.FileNameLength /
+            sizeof(*CreateData->Fields.FileName)) &&
+            (CreateData->Fields.FileName[name_length] != 0))
+            name_length++;
+
+        if ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM) ||
+            ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &&
+            (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_AWEALLOC)) ||
+            (name_length == 0) ||
+            ((name_length + 1U) * sizeof(*CreateData->Fields.FileName) >=
+            CreateData->Fields.FileNameLength))
+        {
+            KdPrint(("PhDskMnt: Write overlay needs image file or proxy and differencing file name.\n"));
+
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                STATUS_INVALID_PARAMETER,
+                102,
+                STATUS_INVALID_PARAMETER,
+                0,
+                0,
+                NULL,
+                L"Write overlay needs image file or proxy and differencing file name."));
+
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        overlay_name.Buffer = CreateData->Fields.FileName + name_length + 1;
+        overlay_name.Length = (USHORT)(CreateData->Fields.FileNameLength -
+            (name_length + 1) * sizeof(*CreateData->Fields.FileName));
+        overlay_name.MaximumLength = overlay_name.Length;
+
+        CreateData->Fields.FileNameLength =
+            name_length * sizeof(*CreateData->Fields.FileName);
+
+        // Parallel I/O would bypass the overlay.
+        if ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &&
+            (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_PARALLEL_IO))
+            CreateData->Fields.Flags &= ~IMSCSI_FILE_TYPE_PARALLEL_IO;
+    }
+
+    // With split images, FileName is a list of segment file names separated
+    // by null characters. First segment is opened as image file, others are
+    // opened last.
+    if (CreateData->Fields.Flags & IMSCSI_MULTI_SEGMENT)
+    {
+        USHORT name_length = 0;
+
+        while ((name_length < CreateData->Fields.FileNameLength /
+            sizeof(*CreateData->Fields.FileName)) &&
+            (CreateData->Fields.FileName[name_length] != 0))
+            name_length++;
+
+        if ((IMSCSI_TYPE(CreateData->Fields.Flags) != IMSCSI_TYPE_FILE) ||
+            (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_AWEALLOC) ||
+            (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY) ||
+            (name_length == 0))
+        {
+            KdPrint(("PhDskMnt: Split image needs file type and segment file names.\n"));
+
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                STATUS_INVALID_PARAMETER,
+                102,
+                STATUS_INVALID_PARAMETER,
+                0,
+                0,
+                NULL,
+                L"Split image needs file type and segment file names."));
+
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if ((name_length + 1U) * sizeof(*CreateData->Fields.FileName) <
+            CreateData->Fields.FileNameLength)
+        {
+            segment_names.Buffer = CreateData->Fields.FileName + name_length + 1;
+            segment_names.Length = (USHORT)(CreateData->Fields.FileNameLength -
+                (name_length + 1) * sizeof(*CreateData->Fields.FileName));
+            segment_names.MaximumLength = segment_names.Length;
+        }
+
+        CreateData->Fields.FileNameLength =
+            name_length * sizeof(*CreateData->Fields.FileName);
+
+        segment_auto_size = CreateData->Fields.DiskSize.QuadPart == 0;
+
+        // Parallel I/O would only reach first segment.
+        if (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_PARALLEL_IO)
+            CreateData->Fields.Flags &= ~IMSCSI_FILE_TYPE_PARALLEL_IO;
+    }
+
+    file_name.Length = CreateData->Fields.FileNameLength;
+    file_name.MaximumLength = CreateData->Fields.FileNameLength;
+    file_name.Buffer = NULL;
+
+    // If a file is to be opened or created, allocate name buffer and open that
+    // file...
+    if ((CreateData->Fields.FileNameLength > 0) |
+        ((IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &
+        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) == IMSCSI_FILE_TYPE_AWEALLOC)))
+    {
+        IO_STATUS_BLOCK io_status;
+        OBJECT_ATTRIBUTES object_attributes;
+        UNICODE_STRING real_file_name;
+        ACCESS_MASK desired_access = 0;
+        ULONG share_access = 0;
+        ULONG create_options = 0;
+
+        if (CreateData->Fields.FileNameLength > 0)
+        {
+            file_name.Buffer = (PWCHAR)ExAllocatePoolWithTag(NonPagedPool,
+                file_name.MaximumLength, MP_TAG_GENERAL);
+
+            if (file_name.Buffer == NULL)
+            {
+                KdPrint(("PhDskMnt: Error allocating buffer for filename.\n"));
+
+                ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                    0,
+                    0,
+                    NULL,
+                    0,
+                    1000,
+                    STATUS_INSUFFICIENT_RESOURCES,
+                    102,
+                    STATUS_INSUFFICIENT_RESOURCES,
+                    0,
+                    0,
+                    NULL,
+                    L"Memory allocation error."));
+
+                return STATUS_INSUFFICIENT_RESOURCES;
+            }
+
+            RtlCopyMemory(file_name.Buffer, CreateData->Fields.FileName,
+                CreateData->Fields.FileNameLength);
         }
 
         // If no device-type specified, check if filename ends with .iso or .nrg.
@@ -1446,19 +1584,29 @@ __in __deref PETHREAD ClientThread)
             if ((IMSCSI_TYPE(CreateData->Fields.Flags) ==
                 IMSCSI_TYPE_PROXY) ||
                 ((IMSCSI_TYPE(CreateData->Fields.Flags) != IMSCSI_TYPE_VM) &&
-                !IMSCSI_READONLY(CreateData->Fields.Flags)))
+                !IMSCSI_READONLY(CreateData->Fields.Flags) &&
+                !(CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY)))
                 desired_access |= GENERIC_WRITE;
 
             share_access = FILE_SHARE_READ | FILE_SHARE_DELETE;
 
             if (IMSCSI_READONLY(CreateData->Fields.Flags) ||
-                (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM))
+                (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM) ||
+                (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY))
                 share_access |= FILE_SHARE_WRITE;
 
             create_options = FILE_NON_DIRECTORY_FILE |
-                FILE_NO_INTERMEDIATE_BUFFERING |
                 FILE_SYNCHRONOUS_IO_NONALERT;
 
+            // Write-back caching of image file needs cached handle,
+            // parallel I/O sends non-cached requests regardless.
+            if (!(CreateData->Fields.Flags & IMSCSI_WRITE_BACK) ||
+                (IMSCSI_TYPE(CreateData->Fields.Flags) != IMSCSI_TYPE_FILE) ||
+                (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) != IMSCSI_FILE_TYPE_QUEUED_IO) ||
+                IMSCSI_READONLY(CreateData->Fields.Flags) ||
+                (CreateData->Fields.Flags & IMSCSI_WRITE_OVERLAY))
+                create_options |= FILE_NO_INTERMEDIATE_BUFFERING;
+
             if (IMSCSI_SPARSE_FILE(CreateData->Fields.Flags))
                 create_options |= FILE_OPEN_FOR_BACKUP_INTENT;
 
@@ -1544,6 +1692,7 @@ __in __deref PETHREAD ClientThread)
             (status == STATUS_NO_SUCH_FILE)) &
             (CreateData->Fields.DiskSize.QuadPart != 0) &
             (!IMSCSI_READONLY(CreateData->Fields.Flags)) &
+            ((CreateData->Fields.Flags & (IMSCSI_WRITE_OVERLAY | IMSCSI_MULTI_SEGMENT)) == 0) &
             (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE))
         {
 
@@ -1762,15 +1911,11 @@ __in __deref PETHREAD ClientThread)
                 return status;
             }
 
-            // Allocate virtual memory for 'vm' type.
+            // Allocate chunk table for 'vm' type. Memory for contents is
+            // allocated in chunks when data is loaded or written.
             if (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_VM)
             {
-                SIZE_T max_size;
-
                 // If no size given for VM disk, use size of pre-load image file.
-                // This code is somewhat easier for 64 bit architectures.
-
-#ifdef _WIN64
                 if (CreateData->Fields.DiskSize.QuadPart == 0)
                 {
                     CreateData->Fields.DiskSize.QuadPart =
@@ -1778,43 +1923,11 @@ __in __deref PETHREAD ClientThread)
                         CreateData->Fields.ImageOffset.QuadPart;
                 }
 
-                max_size = CreateData->Fields.DiskSize.QuadPart;
-#else
-                if (CreateData->Fields.DiskSize.QuadPart == 0)
-                {
-                    // Check that file size < 2 GB.
-                    if ((disk_size.QuadPart -
-                        CreateData->Fields.ImageOffset.QuadPart) &
-                        0xFFFFFFFF80000000)
-                    {
-                        ZwClose(file_handle);
-
-                        if (file_name.Buffer != NULL)
-                            ExFreePoolWithTag(file_name.Buffer, MP_TAG_GENERAL);
-
-                        KdPrint(("PhDskMnt: VM disk >= 2GB not supported.\n"));
-
-                        return STATUS_INSUFFICIENT_RESOURCES;
-                    }
-                    else
-                    {
-                        CreateData->Fields.DiskSize.QuadPart =
-                            disk_size.QuadPart -
-                            CreateData->Fields.ImageOffset.QuadPart;
-                    }
-                }
-
-                max_size = CreateData->Fields.DiskSize.LowPart;
-#endif
+                chunk_table = ImScsiAllocateVMChunkTable(
+                    CreateData->Fields.DiskSize.QuadPart,
+                    &chunk_table_size);
 
-                status =
-                    ZwAllocateVirtualMemory(NtCurrentProcess(),
-                    (PVOID*)&image_buffer,
-                    0,
-                    &max_size,
-                    MEM_COMMIT,
-                    PAGE_READWRITE);
-                if (!NT_SUCCESS(status))
+                if (chunk_table == NULL)
                 {
                     ZwClose(file_handle);
 
@@ -1827,16 +1940,15 @@ __in __deref PETHREAD ClientThread)
                         NULL,
                         0,
                         1000,
-                        status,
+                        STATUS_NO_MEMORY,
                         102,
-                        status,
+                        STATUS_NO_MEMORY,
                         0,
                         0,
                         NULL,
                         L"Not enough memory for VM disk."));
 
-                    KdPrint(("PhDskMnt: Error allocating vm for image. (%#x)\n",
-                        status));
+                    KdPrint(("PhDskMnt: Error allocating chunk table for vm disk.\n"));
 
                     return STATUS_NO_MEMORY;
                 }
@@ -1913,7 +2025,8 @@ __in __deref PETHREAD ClientThread)
                 else if ((disk_size.QuadPart <
                     CreateData->Fields.DiskSize.QuadPart +
                     CreateData->Fields.ImageOffset.QuadPart) &
-                    (!IMSCSI_READONLY(CreateData->Fields.Flags)))
+                    (!IMSCSI_READONLY(CreateData->Fields.Flags)) &
+                    ((CreateData->Fields.Flags & (IMSCSI_WRITE_OVERLAY | IMSCSI_MULTI_SEGMENT)) == 0))
                 {
                     LARGE_INTEGER new_image_size;
                     new_image_size.QuadPart =
@@ -2032,6 +2145,8 @@ __in __deref PETHREAD ClientThread)
 
             alignment_requirement = (ULONG)proxy_info.req_alignment - 1;
 
+            proxy_image_size = proxy_info.file_size;
+
             if (proxy_info.flags & IMDPROXY_FLAG_RO)
                 CreateData->Fields.Flags |= IMSCSI_OPTION_RO;
 
@@ -2041,6 +2156,18 @@ __in __deref PETHREAD ClientThread)
             if (proxy_info.flags & IMDPROXY_FLAG_SUPPORTS_ZERO)
                 proxy_supports_zero = TRUE;
 
+            if (proxy_info.flags & IMDPROXY_FLAG_SUPPORTS_ALLOCATED_RANGES)
+                proxy_supports_allocated_ranges = TRUE;
+
+            if (proxy_info.flags & IMDPROXY_FLAG_SUPPORTS_IDENTITY)
+                proxy_supports_identity = TRUE;
+
+            if (proxy_info.flags & IMDPROXY_FLAG_SUPPORTS_COPY)
+                proxy_supports_copy = TRUE;
+
+            if (proxy_info.flags & IMDPROXY_FLAG_SUPPORTS_LIMITS)
+                proxy_supports_limits = TRUE;
+
             KdPrint(("PhDskMnt: Got from proxy: Siz=0x%08x%08x Flg=%#x Alg=%#x.\n",
                 CreateData->Fields.DiskSize.HighPart,
                 CreateData->Fields.DiskSize.LowPart,
@@ -2050,8 +2177,6 @@ __in __deref PETHREAD ClientThread)
 
         if (CreateData->Fields.DiskSize.QuadPart == 0)
         {
-            SIZE_T free_size = 0;
-
             ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
                 0,
                 0,
@@ -2073,37 +2198,23 @@ __in __deref PETHREAD ClientThread)
                 ZwClose(file_handle);
             if (file_name.Buffer != NULL)
                 ExFreePoolWithTag(file_name.Buffer, MP_TAG_GENERAL);
-            if (image_buffer != NULL)
-                ZwFreeVirtualMemory(NtCurrentProcess(),
-                (PVOID*)&image_buffer,
-                &free_size, MEM_RELEASE);
+            if (chunk_table != NULL)
+                ExFreePoolWithTag(chunk_table, MP_TAG_GENERAL);
 
             return STATUS_INVALID_PARAMETER;
         }
     }
-    // Blank vm-disk, just allocate...
+    // Blank vm-disk, just allocate chunk table...
     else
     {
-        SIZE_T max_size;
-#ifdef _WIN64
-        max_size = CreateData->Fields.DiskSize.QuadPart;
-#else
-        max_size = CreateData->Fields.DiskSize.LowPart;
-#endif
+        chunk_table = ImScsiAllocateVMChunkTable(
+            CreateData->Fields.DiskSize.QuadPart,
+            &chunk_table_size);
 
-        image_buffer = NULL;
-        status =
-            ZwAllocateVirtualMemory(NtCurrentProcess(),
-            (PVOID*)&image_buffer,
-            0,
-            &max_size,
-            MEM_COMMIT,
-            PAGE_READWRITE);
-        if (!NT_SUCCESS(status))
+        if (chunk_table == NULL)
         {
             KdPrint
-                (("PhDskMnt: Error allocating virtual memory for vm disk (%#x).\n",
-                status));
+                (("PhDskMnt: Error allocating chunk table for vm disk.\n"));
 
             ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
                 0,
@@ -2111,9 +2222,9 @@ __in __deref PETHREAD ClientThread)
                 NULL,
                 0,
                 1000,
-                status,
+                STATUS_NO_MEMORY,
                 102,
-                status,
+                STATUS_NO_MEMORY,
                 0,
                 0,
                 NULL,
@@ -2170,8 +2281,16 @@ __in __deref PETHREAD ClientThread)
         LUExtension->DeviceType = DIRECT_ACCESS_DEVICE;
     }
 
+    ImScsiCoreInitializeLU(&LUExtension->Core, &ImScsiLUBackend, LUExtension);
+
     if (IMSCSI_READONLY(CreateData->Fields.Flags))
         LUExtension->ReadOnly = TRUE;
+    else if (CreateData->Fields.Flags & IMSCSI_WRITE_BACK)
+    {
+        LUExtension->Core.WriteBack = TRUE;
+        LUExtension->Core.WriteBackLimit =
+            (LONGLONG)pMPDrvInfoGlobal->MPRegInfo.WriteBackLimit << 20;
+    }
 
     if (IMSCSI_REMOVABLE(CreateData->Fields.Flags))
         LUExtension->RemovableMedia = TRUE;
@@ -2222,18 +2341,185 @@ __in __deref PETHREAD ClientThread)
     else
         LUExtension->AWEAllocDisk = FALSE;
 
-    LUExtension->ImageBuffer = image_buffer;
+    LUExtension->VMChunkTable = chunk_table;
+    LUExtension->VMChunkTableSize = chunk_table_size;
     LUExtension->ImageFile = file_handle;
 
+    // VM disk to be loaded from image file on demand. Chunks not yet
+    // accessed are loaded by the worker thread when idle.
+    if (LUExtension->VMDisk &&
+        (file_handle != NULL) &&
+        (CreateData->Fields.Flags & IMSCSI_VM_LAZY_LOAD))
+    {
+        ULONG chunks = (ULONG)((LUExtension->DiskSize.QuadPart +
+            IMSCSI_VM_CHUNK_SIZE - 1) >> IMSCSI_VM_CHUNK_SHIFT);
+
+        PULONG bitmap_buffer = (PULONG)ExAllocatePoolWithTag(PagedPool,
+            ((chunks + 31) >> 5) * sizeof(ULONG), MP_TAG_GENERAL);
+
+        if (bitmap_buffer != NULL)
+        {
+            RtlInitializeBitMap(&LUExtension->VMLoadedChunks, bitmap_buffer, chunks);
+            RtlClearAllBits(&LUExtension->VMLoadedChunks);
+            LUExtension->VMPrefetchChunk = 0;
+            LUExtension->VMLazyLoad = TRUE;
+
+            KdPrint(("PhDskMnt::ImScsiInitializeLU: Lazy loading %u chunks of image file.\n", chunks));
+        }
+        else
+        {
+            DbgPrint("PhDskMnt::ImScsiInitializeLU: Memory allocation failed. Image file will be loaded before use.\n");
+
+            CreateData->Fields.Flags &= ~IMSCSI_VM_LAZY_LOAD;
+        }
+    }
+
+    // Compressed and/or deduplicated VM disk.
+    if (LUExtension->VMDisk &&
+        (CreateData->Fields.Flags & (IMSCSI_VM_COMPRESS | IMSCSI_VM_DEDUP)))
+    {
+        status = ImScsiInitializeVMPacking(LUExtension,
+            (CreateData->Fields.Flags & IMSCSI_VM_COMPRESS) ? TRUE : FALSE,
+            (CreateData->Fields.Flags & IMSCSI_VM_DEDUP) ? TRUE : FALSE);
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiInitializeLU: Cannot initialize compression (%#x). VM disk will be uncompressed.\n",
+                status);
+
+            CreateData->Fields.Flags &= ~(IMSCSI_VM_COMPRESS | IMSCSI_VM_DEDUP);
+        }
+    }
+
     // Use proxy service.
     if (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_PROXY)
     {
         LUExtension->Proxy = proxy;
         LUExtension->UseProxy = TRUE;
+
+        // Optional local cache file for slow proxies, mount continues
+        // without cache on failure.
+        status = ImScsiOpenProxyCache(LUExtension, proxy_image_size,
+            proxy_supports_identity);
+
+        if (!NT_SUCCESS(status) && (status != STATUS_NOT_SUPPORTED))
+            DbgPrint("PhDskMnt::ImScsiInitializeLU: Proxy will not be cached (%#x).\n",
+                status);
     }
     else
         LUExtension->UseProxy = FALSE;
 
+    // Write overlay. Image file or proxy was opened without write access
+    // above, writes go to differencing file.
+    if (overlay_name.Length > 0)
+    {
+        status = ImScsiOpenWriteOverlay(LUExtension, &overlay_name);
+
+        if (!NT_SUCCESS(status))
+        {
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                status,
+                102,
+                status,
+                0,
+                0,
+                NULL,
+                L"Cannot open differencing file."));
+
+            return status;
+        }
+
+        // Return full name to caller.
+        CreateData->Fields.FileNameLength += sizeof(*CreateData->Fields.FileName) +
+            overlay_name.Length;
+    }
+
+    // Split image. First segment was opened as image file above.
+    if (CreateData->Fields.Flags & IMSCSI_MULTI_SEGMENT)
+    {
+        LARGE_INTEGER image_size;
+
+        status = ImScsiOpenImageSegments(LUExtension, &segment_names, &image_size);
+
+        if (!NT_SUCCESS(status))
+        {
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                status,
+                102,
+                status,
+                0,
+                0,
+                NULL,
+                L"Cannot open image segment files."));
+
+            return status;
+        }
+
+        // Size was taken from first segment above if not specified.
+        if (segment_auto_size)
+        {
+            LUExtension->DiskSize.QuadPart = image_size.QuadPart -
+                LUExtension->ImageOffset.QuadPart;
+
+            CreateData->Fields.DiskSize = LUExtension->DiskSize;
+        }
+
+        // Return full name list to caller.
+        if (segment_names.Length > 0)
+            CreateData->Fields.FileNameLength += sizeof(*CreateData->Fields.FileName) +
+                segment_names.Length;
+    }
+
+    // Queued I/O image files share blocks in adapter-wide cache with other
+    // LUs using the same image file.
+    if ((file_handle != NULL) &&
+        (IMSCSI_TYPE(CreateData->Fields.Flags) == IMSCSI_TYPE_FILE) &&
+        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) != IMSCSI_FILE_TYPE_AWEALLOC) &&
+        (IMSCSI_FILE_TYPE(CreateData->Fields.Flags) != IMSCSI_FILE_TYPE_PARALLEL_IO) &&
+        (LUExtension->Segments == NULL))
+    {
+        status = ImScsiOpenCacheFile(LUExtension);
+
+        if (!NT_SUCCESS(status) && (status != STATUS_NOT_SUPPORTED))
+            DbgPrint("PhDskMnt::ImScsiInitializeLU: Image file will not be cached (%#x).\n",
+                status);
+    }
+
+    // Reads are checked against Merkle index created for image file.
+    if (CreateData->Fields.Flags & IMSCSI_VERIFY_IMAGE)
+    {
+        status = ImScsiOpenMerkleIndex(LUExtension);
+
+        if (!NT_SUCCESS(status))
+        {
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                status,
+                102,
+                status,
+                0,
+                0,
+                NULL,
+                L"Cannot open Merkle index file."));
+
+            return status;
+        }
+    }
+
     // If we are going to fake a disk signature if existing one
     // is all zeroes and device is read-only, prepare that fake
     // disk sig here.
@@ -2247,7 +2533,8 @@ __in __deref PETHREAD ClientThread)
 
     if ((LUExtension->FileObject == NULL) &&
         (!LUExtension->AWEAllocDisk) &&
-        (!LUExtension->VMDisk) &&
+        (LUExtension->OverlayFile == NULL) &&
+        (LUExtension->Segments == NULL) &&
         ((!LUExtension->UseProxy) ||
             proxy_supports_unmap))
     {
@@ -2256,23 +2543,80 @@ __in __deref PETHREAD ClientThread)
 
     if ((LUExtension->FileObject == NULL) &&
         (!LUExtension->AWEAllocDisk) &&
-        (!LUExtension->VMDisk) &&
+        (LUExtension->OverlayFile == NULL) &&
+        (LUExtension->Segments == NULL) &&
         ((!LUExtension->UseProxy) ||
             proxy_supports_zero))
     {
         LUExtension->SupportsZero = TRUE;
     }
 
-    KeInitializeSpinLock(&LUExtension->RequestListLock);
-    InitializeListHead(&LUExtension->RequestList);
-    KeInitializeEvent(&LUExtension->RequestEvent, SynchronizationEvent, FALSE);
-
-    KeInitializeEvent(&LUExtension->Initialized, NotificationEvent, FALSE);
+    if (LUExtension->UseProxy &&
+        (LUExtension->OverlayFile == NULL) &&
+        proxy_supports_allocated_ranges)
+    {
+        LUExtension->ProxyAllocatedRanges = TRUE;
+    }
 
-    KeInitializeSpinLock(&LUExtension->LastIoLock);
+    // Offloaded copies within proxy service name source image by its
+    // identity, so both requests are needed.
+    if (LUExtension->UseProxy &&
+        (LUExtension->OverlayFile == NULL) &&
+        proxy_supports_copy &&
+        proxy_supports_identity)
+    {
+        IMDPROXY_IDENTITY_RESP identity_resp;
+        IO_STATUS_BLOCK io_status;
+
+        status = ImScsiQueryIdentityProxy(&LUExtension->Proxy,
+            &io_status,
+            NULL,
+            &identity_resp);
+
+        if (NT_SUCCESS(status))
+        {
+            RtlCopyMemory(LUExtension->ProxyIdentity, identity_resp.identity,
+                sizeof(LUExtension->ProxyIdentity));
+
+            LUExtension->ProxyCopy = TRUE;
+        }
+        else
+        {
+            KdPrint(("PhDskMnt::ImScsiInitializeLU: Proxy identity query failed, copy offload disabled (%#x).\n",
+                status));
+        }
+    }
+
+    ImScsiQueryBackendLimits(LUExtension, proxy_supports_limits);
+
+    KeInitializeEvent(&LUExtension->Initialized, NotificationEvent, FALSE);
 
     KeSetEvent(&LUExtension->Initialized, (KPRIORITY)0, FALSE);
 
+    if (CreateData->Fields.Flags & IMSCSI_HASH_IMAGE)
+    {
+        status = ImScsiStartImageHash(LUExtension);
+
+        if (!NT_SUCCESS(status))
+        {
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                status,
+                102,
+                status,
+                0,
+                0,
+                NULL,
+                L"Cannot start image hashing."));
+
+            return status;
+        }
+    }
+
     KdPrint(("PhDskMnt::ImScsiCreateLU: Creating worker thread for pLUExt=0x%p.\n",
         LUExtension));
 
@@ -2349,200 +2693,2173 @@ __in __deref PETHREAD ClientThread)
 }
 
 
-BOOLEAN
-ImScsiFillMemoryDisk(pHW_LU_EXTENSION LUExtension)
+//
+// VM disks are stored in chunks of IMSCSI_VM_CHUNK_SIZE bytes, allocated when
+// first written to. A chunk is found through a directory of second level
+// tables, each with IMSCSI_VM_CHUNK_TABLE_SIZE chunk entries. Second level
+// tables are also allocated on demand. Chunks that are not allocated read as
+// zeros. Data beyond end of disk in last chunk is always kept zeroed.
+//
+// With IMSCSI_VM_COMPRESS or IMSCSI_VM_DEDUP, chunks not recently used are
+// packed into blocks of IMSCSI_VM_BLOCK_SIZE bytes by the worker thread, up
+// to IMSCSI_VM_RESIDENT_CHUNKS chunks are kept uncompressed. Zero blocks are
+// not stored, other blocks are compressed and/or shared with identical
+// blocks in other chunks. Packed chunks are unpacked again when accessed.
+//
+
+PIMSCSI_VM_CHUNK*
+ImScsiAllocateVMChunkTable(
+    __in LONGLONG DiskSize,
+    __out PULONG TableSize)
 {
-    LARGE_INTEGER byte_offset = LUExtension->ImageOffset;
-    IO_STATUS_BLOCK io_status;
-    NTSTATUS status;
-#ifdef _WIN64
-    SIZE_T disk_size = LUExtension->DiskSize.QuadPart;
-#else
-    SIZE_T disk_size = LUExtension->DiskSize.LowPart;
-#endif
+    ULONGLONG chunks = ((ULONGLONG)DiskSize + IMSCSI_VM_CHUNK_SIZE - 1) >>
+        IMSCSI_VM_CHUNK_SHIFT;
+    ULONGLONG table_size = (chunks + IMSCSI_VM_CHUNK_TABLE_SIZE - 1) >>
+        IMSCSI_VM_CHUNK_TABLE_SHIFT;
+    PIMSCSI_VM_CHUNK *chunk_table;
 
-    KdPrint(("PhDskMnt: Reading image file into vm disk buffer.\n"));
+    *TableSize = 0;
 
-    status =
-        ImScsiSafeReadFile(
-        LUExtension->ImageFile,
-        &io_status,
-        LUExtension->ImageBuffer,
-        disk_size,
-        &byte_offset);
+    // Chunk numbers need to fit in 32 bits
+    if ((DiskSize <= 0) || (chunks > MAXULONG))
+    {
+        KdPrint(("PhDskMnt::ImScsiAllocateVMChunkTable: Invalid vm disk size %I64i.\n",
+            DiskSize));
 
-    ZwClose(LUExtension->ImageFile);
-    LUExtension->ImageFile = NULL;
+        return NULL;
+    }
 
-    // Failure to read pre-load image is now considered a fatal error
-    if (!NT_SUCCESS(status))
-    {
-        KdPrint(("PhDskMnt: Failed to read image file (%#x).\n", status));
+    chunk_table = (PIMSCSI_VM_CHUNK*)ExAllocatePoolWithTag(PagedPool,
+        (SIZE_T)table_size * sizeof(PIMSCSI_VM_CHUNK), MP_TAG_GENERAL);
 
-        return FALSE;
+    if (chunk_table == NULL)
+    {
+        return NULL;
     }
 
-    KdPrint(("PhDskMnt: Image loaded successfully.\n"));
+    RtlZeroMemory(chunk_table, (SIZE_T)table_size * sizeof(PIMSCSI_VM_CHUNK));
 
-    return TRUE;
+    *TableSize = (ULONG)table_size;
+
+    KdPrint(("PhDskMnt::ImScsiAllocateVMChunkTable: %I64u chunks, %u chunk tables.\n",
+        chunks, *TableSize));
+
+    return chunk_table;
 }
 
-VOID
-ImScsiUnmapDevice(
-    __in pHW_HBA_EXT pHBAExt,
-    __in pHW_LU_EXTENSION pLUExt,
-    __in PSCSI_REQUEST_BLOCK pSrb)
+PIMSCSI_VM_CHUNK
+ImScsiGetVMChunkEntry(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in ULONG Chunk,
+    __in BOOLEAN Allocate)
 {
-    PUNMAP_LIST_HEADER list = (PUNMAP_LIST_HEADER)pSrb->DataBuffer;
-    USHORT descrlength = RtlUshortByteSwap(*(PUSHORT)list->BlockDescrDataLength);
+    ULONG table_index = Chunk >> IMSCSI_VM_CHUNK_TABLE_SHIFT;
+    PIMSCSI_VM_CHUNK table;
 
-    UNREFERENCED_PARAMETER(pHBAExt);
-    UNREFERENCED_PARAMETER(pLUExt);
+    if (table_index >= LUExtension->VMChunkTableSize)
+    {
+        return NULL;
+    }
 
-    if ((ULONG)descrlength + FIELD_OFFSET(UNMAP_LIST_HEADER, Descriptors) >
-        pSrb->DataTransferLength)
+    table = LUExtension->VMChunkTable[table_index];
+
+    if ((table == NULL) && Allocate)
     {
-        KdBreakPoint();
-        ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
-        return;
+        table = (PIMSCSI_VM_CHUNK)ExAllocatePoolWithTag(PagedPool,
+            IMSCSI_VM_CHUNK_TABLE_SIZE * sizeof(IMSCSI_VM_CHUNK), MP_TAG_GENERAL);
+
+        if (table == NULL)
+        {
+            DbgPrint("PhDskMnt::ImScsiGetVMChunkEntry: Memory allocation failed for chunk table.\n");
+
+            return NULL;
+        }
+
+        RtlZeroMemory(table, IMSCSI_VM_CHUNK_TABLE_SIZE * sizeof(IMSCSI_VM_CHUNK));
+
+        LUExtension->VMChunkTable[table_index] = table;
     }
 
-    USHORT items = descrlength / sizeof(*list->Descriptors);
+    if (table == NULL)
+    {
+        return NULL;
+    }
 
-    NTSTATUS status = STATUS_SUCCESS;
+    return &table[Chunk & (IMSCSI_VM_CHUNK_TABLE_SIZE - 1)];
+}
 
-    IO_STATUS_BLOCK io_status;
+ULONGLONG
+ImScsiHashVMBlock(
+    __in const UCHAR *Data)
+{
+    // FNV-1a, 64 bits at a time
+    const ULONGLONG *ptr = (const ULONGLONG*)Data;
+    ULONGLONG hash = 14695981039346656037ULL;
 
-    if (pLUExt->UseProxy)
+    for (ULONG i = 0; i < IMSCSI_VM_BLOCK_SIZE / sizeof(ULONGLONG); i++)
     {
-        WPoolMem<DEVICE_DATA_SET_RANGE, PagedPool> range(sizeof(DEVICE_DATA_SET_RANGE) * items);
+        hash ^= ptr[i];
+        hash *= 1099511628211ULL;
+    }
 
-        if (!range)
-        {
-            ScsiSetError(pSrb, SRB_STATUS_ERROR);
-            return;
-        }
+    return hash;
+}
 
-        for (USHORT i = 0; i < items; i++)
-        {
-            LONGLONG startingSector = RtlUlonglongByteSwap(*(PULONGLONG)list->Descriptors[i].StartingLba);
-            ULONG numBlocks = RtlUlongByteSwap(*(PULONG)list->Descriptors[i].LbaCount);
+NTSTATUS
+ImScsiExpandVMBlock(
+    __in PIMSCSI_VM_BLOCK Block,
+    __out PUCHAR Buffer)
+{
+    ULONG final_size;
+    NTSTATUS status;
 
-            range[i].StartingOffset = (startingSector << pLUExt->BlockPower) + pLUExt->ImageOffset.QuadPart;
-            range[i].LengthInBytes = (ULONGLONG)numBlocks << pLUExt->BlockPower;
+    if (Block->DataSize == IMSCSI_VM_BLOCK_SIZE)
+    {
+        RtlCopyMemory(Buffer, Block->Data, IMSCSI_VM_BLOCK_SIZE);
 
-            KdPrint(("PhDskMnt::ImScsiDispatchUnmap: Offset: %I64i, bytes: %I64u\n",
-                range[i].StartingOffset, range[i].LengthInBytes));
-        }
+        return STATUS_SUCCESS;
+    }
 
-        status = ImScsiUnmapOrZeroProxy(
-            &pLUExt->Proxy,
-            IMDPROXY_REQ_UNMAP,
-            &io_status,
-            &pLUExt->StopThread,
-            items,
-            range);
+    status = RtlDecompressBuffer(IMSCSI_VM_COMPRESSION_FORMAT,
+        Buffer,
+        IMSCSI_VM_BLOCK_SIZE,
+        Block->Data,
+        Block->DataSize,
+        &final_size);
+
+    if (NT_SUCCESS(status) && (final_size < IMSCSI_VM_BLOCK_SIZE))
+    {
+        RtlZeroMemory(Buffer + final_size, IMSCSI_VM_BLOCK_SIZE - final_size);
     }
-    else if (pLUExt->ImageFile != NULL)
+
+    return status;
+}
+
+VOID
+ImScsiReleaseVMBlock(
+    __in PIMSCSI_VM_BLOCK Block)
+{
+    if (--Block->RefCount > 0)
     {
-        FILE_ZERO_DATA_INFORMATION zerodata;
+        return;
+    }
 
-#if _NT_TARGET_VERSION >= 0x602
-        ULONG fltrim_size = FIELD_OFFSET(FILE_LEVEL_TRIM, Ranges) +
-            (items * sizeof(FILE_LEVEL_TRIM_RANGE));
+    RemoveEntryList(&Block->HashListEntry);
 
-        WPoolMem<FILE_LEVEL_TRIM, PagedPool> fltrim;
+    ExFreePoolWithTag(Block, MP_TAG_GENERAL);
+}
 
-        if (!pLUExt->NoFileLevelTrim)
+PIMSCSI_VM_BLOCK
+ImScsiStoreVMBlock(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in const UCHAR *Data)
+{
+    PIMSCSI_VM_BLOCK block;
+    PLIST_ENTRY bucket = NULL;
+    ULONGLONG hash = 0;
+    ULONG data_size = IMSCSI_VM_BLOCK_SIZE;
+    const UCHAR *stored_data = Data;
+
+    if (LUExtension->VMDedup)
+    {
+        hash = ImScsiHashVMBlock(Data);
+
+        bucket = &LUExtension->VMBlockHash[hash & (IMSCSI_VM_BLOCK_HASH_BUCKETS - 1)];
+
+        for (PLIST_ENTRY entry = bucket->Flink;
+            entry != bucket;
+            entry = entry->Flink)
         {
-            fltrim.Alloc(fltrim_size);
+            block = CONTAINING_RECORD(entry, IMSCSI_VM_BLOCK, HashListEntry);
 
-            if (!fltrim)
+            if ((block->Hash != hash) ||
+                (!NT_SUCCESS(ImScsiExpandVMBlock(block, LUExtension->VMBlockBuffer))) ||
+                (RtlCompareMemory(LUExtension->VMBlockBuffer, Data,
+                    IMSCSI_VM_BLOCK_SIZE) != IMSCSI_VM_BLOCK_SIZE))
             {
-                ScsiSetError(pSrb, SRB_STATUS_ERROR);
-                return;
+                continue;
             }
 
-            fltrim->NumRanges = items;
+            block->RefCount++;
+
+            return block;
         }
-#endif
+    }
 
-        for (int i = 0; i < items; i++)
+    if (LUExtension->VMCompress)
+    {
+        ULONG compressed_size;
+
+        NTSTATUS status = RtlCompressBuffer(
+            IMSCSI_VM_COMPRESSION_FORMAT | COMPRESSION_ENGINE_STANDARD,
+            (PUCHAR)Data,
+            IMSCSI_VM_BLOCK_SIZE,
+            LUExtension->VMBlockBuffer,
+            IMSCSI_VM_BLOCK_SIZE,
+            4096,
+            &compressed_size,
+            LUExtension->VMCompressWorkSpace);
+
+        // Keep blocks that do not compress by at least one eighth uncompressed
+        if (NT_SUCCESS(status) &&
+            (compressed_size < IMSCSI_VM_BLOCK_SIZE - (IMSCSI_VM_BLOCK_SIZE >> 3)))
         {
-            LONGLONG startingSector = RtlUlonglongByteSwap(*(PULONGLONG)list->Descriptors[i].StartingLba);
-            ULONG numBlocks = RtlUlongByteSwap(*(PULONG)list->Descriptors[i].LbaCount);
+            data_size = compressed_size;
+            stored_data = LUExtension->VMBlockBuffer;
+        }
+    }
 
-            zerodata.FileOffset.QuadPart = (startingSector << pLUExt->BlockPower) + pLUExt->ImageOffset.QuadPart;
-            zerodata.BeyondFinalZero.QuadPart = ((LONGLONG)numBlocks << pLUExt->BlockPower) +
-                zerodata.FileOffset.QuadPart;
+    block = (PIMSCSI_VM_BLOCK)ExAllocatePoolWithTag(PagedPool,
+        FIELD_OFFSET(IMSCSI_VM_BLOCK, Data) + data_size, MP_TAG_GENERAL);
 
-            KdPrint(("PhDskMnt::ImScsiDispatchUnmap: Zero data request from 0x%I64X to 0x%I64X\n",
-                zerodata.FileOffset.QuadPart, zerodata.BeyondFinalZero.QuadPart));
+    if (block == NULL)
+    {
+        return NULL;
+    }
 
-#if _NT_TARGET_VERSION >= 0x602
-            if (!pLUExt->NoFileLevelTrim)
-            {
-                fltrim->Ranges[i].Offset = zerodata.FileOffset.QuadPart;
-                fltrim->Ranges[i].Length = (LONGLONG)numBlocks << pLUExt->BlockPower;
+    block->Hash = hash;
+    block->RefCount = 1;
+    block->DataSize = data_size;
+    RtlCopyMemory(block->Data, stored_data, data_size);
 
-                KdPrint(("PhDskMnt::ImScsiDispatchUnmap: File level trim request 0x%I64X bytes at 0x%I64X\n",
-                    fltrim->Ranges[i].Length, fltrim->Ranges[i].Offset));
-            }
-#endif
+    if (bucket != NULL)
+    {
+        InsertHeadList(bucket, &block->HashListEntry);
+    }
+    else
+    {
+        InitializeListHead(&block->HashListEntry);
+    }
 
-            status = ZwFsControlFile(
-                pLUExt->ImageFile,
-                NULL,
-                NULL,
-                NULL,
-                &io_status,
-                FSCTL_SET_ZERO_DATA,
-                &zerodata,
-                sizeof(zerodata),
-                NULL,
-                0);
+    return block;
+}
 
-            KdPrint(("PhDskMnt::ImScsiDispatchUnmap: FSCTL_SET_ZERO_DATA result: 0x%#X\n", status));
+VOID
+ImScsiReleaseVMChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in PIMSCSI_VM_CHUNK Entry)
+{
+    if (Entry->Data != NULL)
+    {
+        SIZE_T free_size = 0;
 
-            if (!NT_SUCCESS(status))
+        ZwFreeVirtualMemory(NtCurrentProcess(),
+            (PVOID*)&Entry->Data,
+            &free_size,
+            MEM_RELEASE);
+
+        Entry->Data = NULL;
+
+        LUExtension->VMResidentChunks--;
+    }
+
+    if (Entry->Blocks != NULL)
+    {
+        for (ULONG i = 0; i < IMSCSI_VM_BLOCKS_PER_CHUNK; i++)
+        {
+            if (Entry->Blocks[i] != NULL)
             {
-                goto done;
+                ImScsiReleaseVMBlock(Entry->Blocks[i]);
             }
         }
 
-#if _NT_TARGET_VERSION >= 0x602
-        if (!pLUExt->NoFileLevelTrim)
+        ExFreePoolWithTag(Entry->Blocks, MP_TAG_GENERAL);
+
+        Entry->Blocks = NULL;
+    }
+}
+
+//
+// Replaces uncompressed contents of a chunk with packed blocks. Chunk is left
+// uncompressed if there is not enough memory.
+//
+BOOLEAN
+ImScsiPackVMChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in PIMSCSI_VM_CHUNK Entry)
+{
+    PIMSCSI_VM_BLOCK *blocks;
+    BOOLEAN empty = TRUE;
+
+    blocks = (PIMSCSI_VM_BLOCK*)ExAllocatePoolWithTag(PagedPool,
+        IMSCSI_VM_BLOCKS_PER_CHUNK * sizeof(PIMSCSI_VM_BLOCK), MP_TAG_GENERAL);
+
+    if (blocks == NULL)
+    {
+        return FALSE;
+    }
+
+    RtlZeroMemory(blocks, IMSCSI_VM_BLOCKS_PER_CHUNK * sizeof(PIMSCSI_VM_BLOCK));
+
+    for (ULONG i = 0; i < IMSCSI_VM_BLOCKS_PER_CHUNK; i++)
+    {
+        PUCHAR data = Entry->Data + (i << IMSCSI_VM_BLOCK_SHIFT);
+
+        if (ImScsiIsBufferZero(data, IMSCSI_VM_BLOCK_SIZE))
         {
-            status = ZwFsControlFile(
-                pLUExt->ImageFile,
-                NULL,
-                NULL,
-                NULL,
-                &io_status,
-                FSCTL_FILE_LEVEL_TRIM,
-                fltrim,
-                fltrim_size,
-                NULL,
-                0);
+            continue;
+        }
 
-            KdPrint(("PhDskMnt::ImScsiDispatchUnmap: FSCTL_FILE_LEVEL_TRIM result: %#x\n", status));
+        blocks[i] = ImScsiStoreVMBlock(LUExtension, data);
 
-            if (!NT_SUCCESS(status))
+        if (blocks[i] == NULL)
+        {
+            while (i-- > 0)
             {
-                pLUExt->NoFileLevelTrim = TRUE;
+                if (blocks[i] != NULL)
+                {
+                    ImScsiReleaseVMBlock(blocks[i]);
+                }
             }
+
+            ExFreePoolWithTag(blocks, MP_TAG_GENERAL);
+
+            return FALSE;
         }
-#endif
+
+        empty = FALSE;
+    }
+
+    ImScsiReleaseVMChunk(LUExtension, Entry);
+
+    if (empty)
+    {
+        ExFreePoolWithTag(blocks, MP_TAG_GENERAL);
     }
     else
     {
-        status = STATUS_NOT_SUPPORTED;
+        Entry->Blocks = blocks;
     }
 
-done:
+    return TRUE;
+}
+
+NTSTATUS
+ImScsiUnpackVMChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in PIMSCSI_VM_CHUNK Entry)
+{
+    PVOID chunk_buffer = NULL;
+    SIZE_T chunk_size = IMSCSI_VM_CHUNK_SIZE;
+    SIZE_T free_size = 0;
+    NTSTATUS status;
 
-    KdPrint(("PhDskMnt::ImScsiDispatchUnmap: Result: %#x\n", status));
+    status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+        &chunk_buffer,
+        0,
+        &chunk_size,
+        MEM_COMMIT,
+        PAGE_READWRITE);
 
-    ScsiSetSuccess(pSrb, 0);
+    if (!NT_SUCCESS(status))
+    {
+        return status;
+    }
+
+    for (ULONG i = 0; i < IMSCSI_VM_BLOCKS_PER_CHUNK; i++)
+    {
+        if (Entry->Blocks[i] == NULL)
+        {
+            continue;
+        }
+
+        status = ImScsiExpandVMBlock(Entry->Blocks[i],
+            (PUCHAR)chunk_buffer + (i << IMSCSI_VM_BLOCK_SHIFT));
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiUnpackVMChunk: Failed to decompress block (%#x).\n",
+                status);
+
+            ZwFreeVirtualMemory(NtCurrentProcess(),
+                &chunk_buffer,
+                &free_size,
+                MEM_RELEASE);
+
+            return status;
+        }
+    }
+
+    ImScsiReleaseVMChunk(LUExtension, Entry);
+
+    Entry->Data = (PUCHAR)chunk_buffer;
+
+    LUExtension->VMResidentChunks++;
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Returns uncompressed contents of a chunk in ChunkBuffer, or NULL if chunk
+// is not allocated and Allocate is FALSE.
+//
+NTSTATUS
+ImScsiGetVMChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in ULONG Chunk,
+    __in BOOLEAN Allocate,
+    __out PUCHAR *ChunkBuffer)
+{
+    PIMSCSI_VM_CHUNK entry;
+    NTSTATUS status;
+
+    *ChunkBuffer = NULL;
+
+    // Keep number of uncompressed chunks bounded also when worker thread
+    // never gets idle.
+    if (LUExtension->VMResidentChunks >= 2 * IMSCSI_VM_RESIDENT_CHUNKS)
+    {
+        ImScsiPackMemoryDisk(LUExtension);
+    }
+
+    entry = ImScsiGetVMChunkEntry(LUExtension, Chunk, Allocate);
+
+    if (entry == NULL)
+    {
+        return Allocate ? STATUS_INSUFFICIENT_RESOURCES : STATUS_SUCCESS;
+    }
+
+    entry->Accessed = TRUE;
+
+    if ((entry->Data == NULL) && (entry->Blocks != NULL))
+    {
+        status = ImScsiUnpackVMChunk(LUExtension, entry);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+    }
+
+    if ((entry->Data == NULL) && Allocate)
+    {
+        PVOID chunk_buffer = NULL;
+        SIZE_T chunk_size = IMSCSI_VM_CHUNK_SIZE;
+
+        status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+            &chunk_buffer,
+            0,
+            &chunk_size,
+            MEM_COMMIT,
+            PAGE_READWRITE);
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiGetVMChunk: Error allocating vm for chunk %u (%#x).\n",
+                Chunk, status);
+
+            return status;
+        }
+
+        entry->Data = (PUCHAR)chunk_buffer;
+
+        LUExtension->VMResidentChunks++;
+    }
+
+    *ChunkBuffer = entry->Data;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiFreeVMChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in ULONG Chunk)
+{
+    PIMSCSI_VM_CHUNK entry = ImScsiGetVMChunkEntry(LUExtension, Chunk, FALSE);
+
+    if (entry != NULL)
+    {
+        ImScsiReleaseVMChunk(LUExtension, entry);
+    }
+}
+
+//
+// Called by worker thread when idle, and when too many chunks are
+// uncompressed. Packs next chunk not accessed since last pass. Returns TRUE
+// if there are still more uncompressed chunks than should be kept.
+//
+BOOLEAN
+ImScsiPackMemoryDisk(pHW_LU_EXTENSION LUExtension)
+{
+    ULONG chunks = LUExtension->VMChunkTableSize << IMSCSI_VM_CHUNK_TABLE_SHIFT;
+
+    if ((!(LUExtension->VMCompress | LUExtension->VMDedup)) ||
+        (LUExtension->VMResidentChunks <= IMSCSI_VM_RESIDENT_CHUNKS))
+    {
+        return FALSE;
+    }
+
+    // Two passes are enough to find a chunk that has not been accessed.
+    for (ULONG i = 0; i < 2 * LUExtension->VMChunkTableSize + 2 * chunks; i++)
+    {
+        ULONG chunk = LUExtension->VMPackChunk;
+        PIMSCSI_VM_CHUNK table =
+            LUExtension->VMChunkTable[chunk >> IMSCSI_VM_CHUNK_TABLE_SHIFT];
+
+        if (table == NULL)
+        {
+            chunk = (chunk | (IMSCSI_VM_CHUNK_TABLE_SIZE - 1)) + 1;
+
+            LUExtension->VMPackChunk = chunk < chunks ? chunk : 0;
+
+            continue;
+        }
+
+        LUExtension->VMPackChunk = chunk + 1 < chunks ? chunk + 1 : 0;
+
+        PIMSCSI_VM_CHUNK entry = &table[chunk & (IMSCSI_VM_CHUNK_TABLE_SIZE - 1)];
+
+        if (entry->Data == NULL)
+        {
+            continue;
+        }
+
+        if (entry->Accessed)
+        {
+            entry->Accessed = FALSE;
+            continue;
+        }
+
+        if (!ImScsiPackVMChunk(LUExtension, entry))
+        {
+            DbgPrint("PhDskMnt::ImScsiPackMemoryDisk: Not enough memory to pack chunk %u.\n",
+                chunk);
+
+            return FALSE;
+        }
+
+        KdPrint2(("PhDskMnt::ImScsiPackMemoryDisk: Packed chunk %u, %u chunks left uncompressed.\n",
+            chunk, LUExtension->VMResidentChunks));
+
+        return LUExtension->VMResidentChunks > IMSCSI_VM_RESIDENT_CHUNKS;
+    }
+
+    return FALSE;
+}
+
+NTSTATUS
+ImScsiInitializeVMPacking(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in BOOLEAN Compress,
+    __in BOOLEAN Dedup)
+{
+    NTSTATUS status;
+
+    LUExtension->VMBlockBuffer = (PUCHAR)ExAllocatePoolWithTag(PagedPool,
+        IMSCSI_VM_BLOCK_SIZE, MP_TAG_GENERAL);
+
+    if (LUExtension->VMBlockBuffer == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    if (Compress)
+    {
+        ULONG workspace_size;
+        ULONG fragment_workspace_size;
+
+        status = RtlGetCompressionWorkSpaceSize(
+            IMSCSI_VM_COMPRESSION_FORMAT | COMPRESSION_ENGINE_STANDARD,
+            &workspace_size,
+            &fragment_workspace_size);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        LUExtension->VMCompressWorkSpace = ExAllocatePoolWithTag(PagedPool,
+            workspace_size, MP_TAG_GENERAL);
+
+        if (LUExtension->VMCompressWorkSpace == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    if (Dedup)
+    {
+        LUExtension->VMBlockHash = (PLIST_ENTRY)ExAllocatePoolWithTag(PagedPool,
+            IMSCSI_VM_BLOCK_HASH_BUCKETS * sizeof(LIST_ENTRY), MP_TAG_GENERAL);
+
+        if (LUExtension->VMBlockHash == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        for (ULONG i = 0; i < IMSCSI_VM_BLOCK_HASH_BUCKETS; i++)
+        {
+            InitializeListHead(&LUExtension->VMBlockHash[i]);
+        }
+    }
+
+    LUExtension->VMCompress = Compress;
+    LUExtension->VMDedup = Dedup;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+ImScsiResizeVMChunkTable(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in LONGLONG NewDiskSize)
+{
+    ULONG new_table_size;
+    PIMSCSI_VM_CHUNK *new_table =
+        ImScsiAllocateVMChunkTable(NewDiskSize, &new_table_size);
+
+    if (new_table == NULL)
+    {
+        return STATUS_NO_MEMORY;
+    }
+
+    // Release chunks beyond new end of disk and clear data beyond new end
+    // in new last chunk, so that it reads as zeros if disk is extended again.
+    if (NewDiskSize < LUExtension->DiskSize.QuadPart)
+    {
+        ULONG new_chunks = (ULONG)((NewDiskSize + IMSCSI_VM_CHUNK_SIZE - 1) >>
+            IMSCSI_VM_CHUNK_SHIFT);
+        ULONG old_chunks = (ULONG)((LUExtension->DiskSize.QuadPart +
+            IMSCSI_VM_CHUNK_SIZE - 1) >> IMSCSI_VM_CHUNK_SHIFT);
+        ULONG tail = (ULONG)(NewDiskSize & (IMSCSI_VM_CHUNK_SIZE - 1));
+
+        for (ULONG chunk = new_chunks; chunk < old_chunks; chunk++)
+        {
+            ImScsiFreeVMChunk(LUExtension, chunk);
+        }
+
+        if (tail != 0)
+        {
+            PUCHAR last_chunk;
+            NTSTATUS status = ImScsiGetVMChunk(LUExtension, new_chunks - 1,
+                FALSE, &last_chunk);
+
+            if (!NT_SUCCESS(status))
+            {
+                ExFreePoolWithTag(new_table, MP_TAG_GENERAL);
+
+                return status;
+            }
+
+            if (last_chunk != NULL)
+            {
+                RtlZeroMemory(last_chunk + tail, IMSCSI_VM_CHUNK_SIZE - tail);
+            }
+        }
+
+        for (ULONG i = new_table_size; i < LUExtension->VMChunkTableSize; i++)
+        {
+            if (LUExtension->VMChunkTable[i] != NULL)
+            {
+                ExFreePoolWithTag(LUExtension->VMChunkTable[i], MP_TAG_GENERAL);
+            }
+        }
+    }
+
+    RtlCopyMemory(new_table, LUExtension->VMChunkTable,
+        min(new_table_size, LUExtension->VMChunkTableSize) * sizeof(PIMSCSI_VM_CHUNK));
+
+    ExFreePoolWithTag(LUExtension->VMChunkTable, MP_TAG_GENERAL);
+
+    LUExtension->VMChunkTable = new_table;
+    LUExtension->VMChunkTableSize = new_table_size;
+    LUExtension->VMPackChunk = 0;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiFreeVMChunkTable(
+    __in pHW_LU_EXTENSION LUExtension)
+{
+    if (LUExtension->VMChunkTable != NULL)
+    {
+        for (ULONG i = 0; i < LUExtension->VMChunkTableSize; i++)
+        {
+            PIMSCSI_VM_CHUNK table = LUExtension->VMChunkTable[i];
+
+            if (table == NULL)
+            {
+                continue;
+            }
+
+            for (ULONG j = 0; j < IMSCSI_VM_CHUNK_TABLE_SIZE; j++)
+            {
+                ImScsiReleaseVMChunk(LUExtension, &table[j]);
+            }
+
+            ExFreePoolWithTag(table, MP_TAG_GENERAL);
+        }
+
+        ExFreePoolWithTag(LUExtension->VMChunkTable, MP_TAG_GENERAL);
+
+        LUExtension->VMChunkTable = NULL;
+        LUExtension->VMChunkTableSize = 0;
+    }
+
+    if (LUExtension->VMBlockHash != NULL)
+    {
+        ExFreePoolWithTag(LUExtension->VMBlockHash, MP_TAG_GENERAL);
+        LUExtension->VMBlockHash = NULL;
+    }
+
+    if (LUExtension->VMCompressWorkSpace != NULL)
+    {
+        ExFreePoolWithTag(LUExtension->VMCompressWorkSpace, MP_TAG_GENERAL);
+        LUExtension->VMCompressWorkSpace = NULL;
+    }
+
+    if (LUExtension->VMBlockBuffer != NULL)
+    {
+        ExFreePoolWithTag(LUExtension->VMBlockBuffer, MP_TAG_GENERAL);
+        LUExtension->VMBlockBuffer = NULL;
+    }
+
+    LUExtension->VMCompress = FALSE;
+    LUExtension->VMDedup = FALSE;
+}
+
+NTSTATUS
+ImScsiReadVMDisk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __out PUCHAR Buffer,
+    __in LONGLONG Offset,
+    __in ULONG Length)
+{
+    while (Length > 0)
+    {
+        ULONG chunk = (ULONG)(Offset >> IMSCSI_VM_CHUNK_SHIFT);
+        ULONG chunk_offset = (ULONG)(Offset & (IMSCSI_VM_CHUNK_SIZE - 1));
+        ULONG length = min(Length, IMSCSI_VM_CHUNK_SIZE - chunk_offset);
+        PUCHAR chunk_buffer;
+
+        NTSTATUS status = ImScsiGetVMChunk(LUExtension, chunk, FALSE, &chunk_buffer);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        if (chunk_buffer != NULL)
+        {
+            RtlCopyMemory(Buffer, chunk_buffer + chunk_offset, length);
+        }
+        else
+        {
+            RtlZeroMemory(Buffer, length);
+        }
+
+        Buffer += length;
+        Offset += length;
+        Length -= length;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Writes to VM disk, allocating chunks as needed. If Buffer is NULL the range
+// is zeroed instead and chunks that are completely covered are released.
+//
+NTSTATUS
+ImScsiWriteVMDisk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in_opt const UCHAR *Buffer,
+    __in LONGLONG Offset,
+    __in ULONG Length)
+{
+    while (Length > 0)
+    {
+        ULONG chunk = (ULONG)(Offset >> IMSCSI_VM_CHUNK_SHIFT);
+        ULONG chunk_offset = (ULONG)(Offset & (IMSCSI_VM_CHUNK_SIZE - 1));
+        ULONG length = min(Length, IMSCSI_VM_CHUNK_SIZE - chunk_offset);
+        PUCHAR chunk_buffer;
+        NTSTATUS status;
+
+        if ((Buffer == NULL) &&
+            (chunk_offset == 0) &&
+            ((length == IMSCSI_VM_CHUNK_SIZE) ||
+            (Offset + length >= LUExtension->DiskSize.QuadPart)))
+        {
+            ImScsiFreeVMChunk(LUExtension, chunk);
+        }
+        else
+        {
+            status = ImScsiGetVMChunk(LUExtension, chunk, Buffer != NULL,
+                &chunk_buffer);
+
+            if (!NT_SUCCESS(status))
+            {
+                return status;
+            }
+
+            if (Buffer != NULL)
+            {
+                RtlCopyMemory(chunk_buffer + chunk_offset, Buffer, length);
+
+                Buffer += length;
+            }
+            else if (chunk_buffer != NULL)
+            {
+                RtlZeroMemory(chunk_buffer + chunk_offset, length);
+            }
+        }
+
+        Offset += length;
+        Length -= length;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Loads one chunk of a VM disk from the image file. Chunks that contain only
+// zeros are released again.
+//
+NTSTATUS
+ImScsiLoadMemoryDiskChunk(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in ULONG Chunk)
+{
+    LARGE_INTEGER byte_offset;
+    IO_STATUS_BLOCK io_status;
+    NTSTATUS status;
+    LONGLONG vm_offset = (LONGLONG)Chunk << IMSCSI_VM_CHUNK_SHIFT;
+    SIZE_T length = (SIZE_T)min(IMSCSI_VM_CHUNK_SIZE,
+        LUExtension->DiskSize.QuadPart - vm_offset);
+    PUCHAR chunk_buffer;
+
+    byte_offset.QuadPart = LUExtension->ImageOffset.QuadPart + vm_offset;
+
+    KdPrint2(("PhDskMnt::ImScsiLoadMemoryDiskChunk: Loading chunk %u.\n", Chunk));
+
+    status = ImScsiGetVMChunk(LUExtension, Chunk, TRUE, &chunk_buffer);
+
+    if (!NT_SUCCESS(status))
+    {
+        return status;
+    }
+
+    status = ImScsiSafeReadFile(
+        LUExtension->ImageFile,
+        &io_status,
+        chunk_buffer,
+        length,
+        &byte_offset);
+
+    // Memory beyond end of image file is already zeroed
+    if (status == STATUS_END_OF_FILE)
+    {
+        status = STATUS_SUCCESS;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiLoadMemoryDiskChunk: Failed to read chunk %u of image file (%#x).\n",
+            Chunk, status);
+
+        return status;
+    }
+
+    if (ImScsiIsBufferZero(chunk_buffer, IMSCSI_VM_CHUNK_SIZE))
+    {
+        ImScsiFreeVMChunk(LUExtension, Chunk);
+    }
+
+    if (LUExtension->VMLazyLoad)
+    {
+        RtlSetBits(&LUExtension->VMLoadedChunks, Chunk, 1);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+ImScsiFillMemoryDiskCallback(__in PVOID Context,
+__in ULONGLONG Position,
+__in PUCHAR Data,
+__in ULONG Length)
+{
+    // Zero blocks are left unallocated
+    if (ImScsiIsBufferZero(Data, Length))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    return ImScsiWriteVMDisk((pHW_LU_EXTENSION)Context,
+        Data,
+        (LONGLONG)Position,
+        Length);
+}
+
+BOOLEAN
+ImScsiFillMemoryDisk(pHW_LU_EXTENSION LUExtension)
+{
+    LARGE_INTEGER byte_offset = LUExtension->ImageOffset;
+    IO_STATUS_BLOCK io_status;
+    NTSTATUS status;
+
+    KdPrint(("PhDskMnt: Reading image file into vm disk buffer.\n"));
+
+    // Image file is read while previously read data is stored in chunks
+    status = ImScsiPipelinedReadFile(
+        LUExtension->ImageFile,
+        &io_status,
+        LUExtension->DiskSize.QuadPart,
+        &byte_offset,
+        ImScsiFillMemoryDiskCallback,
+        LUExtension);
+
+    // Rest of disk beyond end of image file reads as zeros
+    if (status == STATUS_END_OF_FILE)
+    {
+        status = STATUS_SUCCESS;
+    }
+
+    ZwClose(LUExtension->ImageFile);
+    LUExtension->ImageFile = NULL;
+
+    // Failure to read pre-load image is now considered a fatal error
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt: Failed to read image file (%#x).\n", status));
+
+        return FALSE;
+    }
+
+    KdPrint(("PhDskMnt: Image loaded successfully.\n"));
+
+    return TRUE;
+}
+
+//
+// Makes sure that all chunks of a lazy loaded VM disk that are within a range
+// are in memory. For writes, chunks that will be completely overwritten are
+// only marked as loaded without reading them from the image file.
+//
+NTSTATUS
+ImScsiLoadMemoryDiskRange(
+    __in pHW_LU_EXTENSION LUExtension,
+    __in PLARGE_INTEGER Offset,
+    __in ULONG Length,
+    __in BOOLEAN ForWrite)
+{
+    LONGLONG end_offset = Offset->QuadPart + Length;
+    ULONG first_chunk;
+    ULONG last_chunk;
+
+    if ((!LUExtension->VMLazyLoad) | (Length == 0))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    first_chunk = (ULONG)(Offset->QuadPart >> IMSCSI_VM_CHUNK_SHIFT);
+    last_chunk = (ULONG)((end_offset - 1) >> IMSCSI_VM_CHUNK_SHIFT);
+
+    for (ULONG chunk = first_chunk; chunk <= last_chunk; chunk++)
+    {
+        if (RtlCheckBit(&LUExtension->VMLoadedChunks, chunk))
+        {
+            continue;
+        }
+
+        if (ForWrite)
+        {
+            LONGLONG chunk_start = (LONGLONG)chunk << IMSCSI_VM_CHUNK_SHIFT;
+            LONGLONG chunk_end = min(chunk_start + IMSCSI_VM_CHUNK_SIZE,
+                LUExtension->DiskSize.QuadPart);
+
+            if ((Offset->QuadPart <= chunk_start) && (end_offset >= chunk_end))
+            {
+                RtlSetBits(&LUExtension->VMLoadedChunks, chunk, 1);
+                continue;
+            }
+        }
+
+        NTSTATUS status = ImScsiLoadMemoryDiskChunk(LUExtension, chunk);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Called by worker thread when idle. Loads next chunk of a lazy loaded VM disk
+// that has not yet been accessed. When all chunks are loaded the image file is
+// closed. Returns TRUE if there are more chunks left to load.
+//
+BOOLEAN
+ImScsiPrefetchMemoryDisk(pHW_LU_EXTENSION LUExtension)
+{
+    ULONG chunk;
+    NTSTATUS status;
+
+    if (!LUExtension->VMLazyLoad)
+    {
+        return FALSE;
+    }
+
+    chunk = RtlFindClearBits(&LUExtension->VMLoadedChunks, 1,
+        LUExtension->VMPrefetchChunk);
+
+    if (chunk == 0xFFFFFFFF)
+    {
+        ZwClose(LUExtension->ImageFile);
+        LUExtension->ImageFile = NULL;
+
+        ExFreePoolWithTag(LUExtension->VMLoadedChunks.Buffer, MP_TAG_GENERAL);
+        LUExtension->VMLoadedChunks.Buffer = NULL;
+
+        LUExtension->VMLazyLoad = FALSE;
+
+        KdPrint(("PhDskMnt: Image loaded successfully.\n"));
+
+        return FALSE;
+    }
+
+    status = ImScsiLoadMemoryDiskChunk(LUExtension, chunk);
+
+    // Failure to read pre-load image is considered a fatal error, same as
+    // when the whole image is loaded at once.
+    if (!NT_SUCCESS(status))
+    {
+        ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+            0,
+            0,
+            NULL,
+            0,
+            1000,
+            status,
+            102,
+            status,
+            0,
+            0,
+            NULL,
+            L"Failed to read image file into VM disk."));
+
+        KeSetEvent(&LUExtension->StopThread, (KPRIORITY)0, FALSE);
+
+        return FALSE;
+    }
+
+    LUExtension->VMPrefetchChunk = chunk + 1;
+
+    return TRUE;
+}
+
+//
+// Sorts ranges by starting offset and merges adjacent or overlapping
+// ranges into one. Zero length ranges are dropped. Returns number of
+// ranges left in the array.
+//
+ULONG
+ImScsiCoalesceRanges(
+    __inout __deref PDEVICE_DATA_SET_RANGE Ranges,
+    __in ULONG Items)
+{
+    ULONG gap;
+    ULONG i;
+    ULONG merged;
+
+    // Shell sort on starting offset. Called at PASSIVE_LEVEL with at most a
+    // few thousand descriptors, so no need for anything more elaborate.
+    for (gap = Items >> 1; gap > 0; gap >>= 1)
+    {
+        for (i = gap; i < Items; i++)
+        {
+            DEVICE_DATA_SET_RANGE item = Ranges[i];
+            ULONG j;
+
+            for (j = i;
+                (j >= gap) && (Ranges[j - gap].StartingOffset > item.StartingOffset);
+                j -= gap)
+            {
+                Ranges[j] = Ranges[j - gap];
+            }
+
+            Ranges[j] = item;
+        }
+    }
+
+    merged = 0;
+
+    for (i = 0; i < Items; i++)
+    {
+        if (Ranges[i].LengthInBytes == 0)
+        {
+            continue;
+        }
+
+        if (merged > 0)
+        {
+            PDEVICE_DATA_SET_RANGE last = &Ranges[merged - 1];
+            LONGLONG last_end = last->StartingOffset + last->LengthInBytes;
+
+            if (Ranges[i].StartingOffset <= last_end)
+            {
+                LONGLONG end = Ranges[i].StartingOffset + Ranges[i].LengthInBytes;
+
+                if (end > last_end)
+                {
+                    last->LengthInBytes = end - last->StartingOffset;
+                }
+
+                continue;
+            }
+        }
+
+        Ranges[merged++] = Ranges[i];
+    }
+
+    return merged;
+}
+
+//
+// Drops ranges that are entirely within holes in a sparse image file. Ranges
+// must be sorted and non-overlapping. If allocation information cannot be
+// retrieved all ranges are kept. Returns number of ranges left in the array.
+//
+ULONG
+ImScsiDropUnallocatedRanges(
+    __in HANDLE FileHandle,
+    __inout __deref PDEVICE_DATA_SET_RANGE Ranges,
+    __in ULONG Items)
+{
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    IO_STATUS_BLOCK io_status;
+    NTSTATUS status;
+    ULONG allocated_items;
+    ULONG kept = 0;
+    ULONG i;
+    ULONG j = 0;
+
+    if (Items == 0)
+    {
+        return 0;
+    }
+
+    WPoolMem<FILE_ALLOCATED_RANGE_BUFFER, PagedPool> allocated(
+        sizeof(FILE_ALLOCATED_RANGE_BUFFER) * IMSCSI_MAX_ALLOCATED_RANGES_QUERY);
+
+    if (!allocated)
+    {
+        return Items;
+    }
+
+    query.FileOffset.QuadPart = Ranges[0].StartingOffset;
+    query.Length.QuadPart = Ranges[Items - 1].StartingOffset +
+        Ranges[Items - 1].LengthInBytes - Ranges[0].StartingOffset;
+
+    status = ZwFsControlFile(
+        FileHandle,
+        NULL,
+        NULL,
+        NULL,
+        &io_status,
+        FSCTL_QUERY_ALLOCATED_RANGES,
+        &query,
+        sizeof(query),
+        allocated,
+        sizeof(FILE_ALLOCATED_RANGE_BUFFER) * IMSCSI_MAX_ALLOCATED_RANGES_QUERY);
+
+    // STATUS_BUFFER_OVERFLOW means a heavily fragmented region. Not worth
+    // further queries, just trim everything in that case.
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint2(("PhDskMnt::ImScsiDropUnallocatedRanges: FSCTL_QUERY_ALLOCATED_RANGES result: %#x\n", status));
+        return Items;
+    }
+
+    allocated_items = (ULONG)(io_status.Information / sizeof(FILE_ALLOCATED_RANGE_BUFFER));
+
+    for (i = 0; i < Items; i++)
+    {
+        LONGLONG end = Ranges[i].StartingOffset + Ranges[i].LengthInBytes;
+
+        while ((j < allocated_items) &&
+            (allocated[j].FileOffset.QuadPart + allocated[j].Length.QuadPart <=
+                Ranges[i].StartingOffset))
+        {
+            j++;
+        }
+
+        if ((j < allocated_items) &&
+            (allocated[j].FileOffset.QuadPart < end))
+        {
+            Ranges[kept++] = Ranges[i];
+        }
+    }
+
+    return kept;
+}
+
+//
+// Fills Ranges with allocated parts of virtual disk between Offset and End.
+// Offsets are relative to start of virtual disk. *CoveredEnd is set to the
+// offset up to which returned ranges are complete. Back ends that cannot
+// tell return the whole range as allocated. Returns number of ranges.
+//
+ULONG
+ImScsiGetAllocatedRanges(
+    __in pHW_LU_EXTENSION pLUExt,
+    __in LONGLONG Offset,
+    __in LONGLONG End,
+    __out_ecount(MaxItems) PDEVICE_DATA_SET_RANGE Ranges,
+    __in ULONG MaxItems,
+    __out PLONGLONG CoveredEnd)
+{
+    ULONG items = 0;
+
+    *CoveredEnd = End;
+
+    if (pLUExt->VMDisk && !pLUExt->VMLazyLoad)
+    {
+        // Chunks never written are not allocated.
+        for (LONGLONG pos = Offset & ~(LONGLONG)(IMSCSI_VM_CHUNK_SIZE - 1);
+            pos < End;
+            pos += IMSCSI_VM_CHUNK_SIZE)
+        {
+            PIMSCSI_VM_CHUNK entry = ImScsiGetVMChunkEntry(pLUExt,
+                (ULONG)(pos >> IMSCSI_VM_CHUNK_SHIFT), FALSE);
+
+            if ((entry == NULL) ||
+                ((entry->Data == NULL) && (entry->Blocks == NULL)))
+            {
+                continue;
+            }
+
+            LONGLONG start = max(pos, Offset);
+            LONGLONG end = min(pos + IMSCSI_VM_CHUNK_SIZE, End);
+
+            if ((items > 0) &&
+                (Ranges[items - 1].StartingOffset +
+                    (LONGLONG)Ranges[items - 1].LengthInBytes == start))
+            {
+                Ranges[items - 1].LengthInBytes += end - start;
+                continue;
+            }
+
+            if (items == MaxItems)
+            {
+                *CoveredEnd = start;
+                break;
+            }
+
+            Ranges[items].StartingOffset = start;
+            Ranges[items].LengthInBytes = end - start;
+            items++;
+        }
+
+        return items;
+    }
+
+    if (pLUExt->UseProxy && pLUExt->ProxyAllocatedRanges)
+    {
+        IO_STATUS_BLOCK io_status;
+
+        NTSTATUS status = ImScsiQueryAllocatedRangesProxy(
+            &pLUExt->Proxy,
+            &io_status,
+            &pLUExt->StopThread,
+            Offset + pLUExt->ImageOffset.QuadPart,
+            End - Offset,
+            Ranges,
+            MaxItems);
+
+        if (NT_SUCCESS(status))
+        {
+            items = (ULONG)io_status.Information;
+
+            for (ULONG i = 0; i < items; i++)
+            {
+                Ranges[i].StartingOffset -= pLUExt->ImageOffset.QuadPart;
+            }
+
+            // Full buffer, there may be more ranges
+            if ((items > 0) && (items == MaxItems))
+            {
+                *CoveredEnd = Ranges[items - 1].StartingOffset +
+                    Ranges[items - 1].LengthInBytes;
+            }
+
+            return items;
+        }
+
+        KdPrint(("PhDskMnt::ImScsiGetAllocatedRanges: Proxy query failed: %#x\n", status));
+    }
+    else if ((pLUExt->ImageFile != NULL) &&
+        (!pLUExt->UseProxy) &&
+        (!pLUExt->VMDisk) &&
+        (!pLUExt->AWEAllocDisk) &&
+        (pLUExt->OverlayFile == NULL) &&
+        (pLUExt->Segments == NULL))
+    {
+        FILE_ALLOCATED_RANGE_BUFFER query;
+        IO_STATUS_BLOCK io_status;
+
+        WPoolMem<FILE_ALLOCATED_RANGE_BUFFER, PagedPool> allocated(
+            sizeof(FILE_ALLOCATED_RANGE_BUFFER) * MaxItems);
+
+        if (allocated)
+        {
+            query.FileOffset.QuadPart = Offset + pLUExt->ImageOffset.QuadPart;
+            query.Length.QuadPart = End - Offset;
+
+            NTSTATUS status = ZwFsControlFile(
+                pLUExt->ImageFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                FSCTL_QUERY_ALLOCATED_RANGES,
+                &query,
+                sizeof(query),
+                allocated,
+                sizeof(FILE_ALLOCATED_RANGE_BUFFER) * MaxItems);
+
+            // STATUS_BUFFER_OVERFLOW means more ranges than fit in buffer,
+            // ranges returned are still valid.
+            if (NT_SUCCESS(status) || (status == STATUS_BUFFER_OVERFLOW))
+            {
+                items = (ULONG)(io_status.Information / sizeof(FILE_ALLOCATED_RANGE_BUFFER));
+
+                for (ULONG i = 0; i < items; i++)
+                {
+                    Ranges[i].StartingOffset = allocated[i].FileOffset.QuadPart -
+                        pLUExt->ImageOffset.QuadPart;
+                    Ranges[i].LengthInBytes = allocated[i].Length.QuadPart;
+                }
+
+                if (status == STATUS_BUFFER_OVERFLOW)
+                {
+                    *CoveredEnd = items > 0 ?
+                        Ranges[items - 1].StartingOffset + Ranges[items - 1].LengthInBytes :
+                        Offset;
+                }
+
+                if ((items > 0) || NT_SUCCESS(status))
+                {
+                    return items;
+                }
+            }
+
+            KdPrint2(("PhDskMnt::ImScsiGetAllocatedRanges: FSCTL_QUERY_ALLOCATED_RANGES result: %#x\n", status));
+        }
+    }
+
+    // Write overlays, split images and proxies without support are
+    // reported as fully allocated.
+    *CoveredEnd = End;
+
+    Ranges[0].StartingOffset = Offset;
+    Ranges[0].LengthInBytes = End - Offset;
+
+    return 1;
+}
+
+//
+// Adds an LBA status descriptor, or extends previous descriptor if it has
+// same status and ends where this one starts. Returns FALSE if Descriptors
+// are full.
+//
+static
+BOOLEAN
+ImScsiAddLbaStatus(
+    __inout_ecount(MaxItems) PIMSCSI_LBA_STATUS_DESCRIPTOR Descriptors,
+    __inout PULONG Items,
+    __in ULONG MaxItems,
+    __in ULONGLONG StartingLba,
+    __in ULONGLONG Blocks,
+    __in UCHAR ProvisioningStatus)
+{
+    if (*Items > 0)
+    {
+        PIMSCSI_LBA_STATUS_DESCRIPTOR last = &Descriptors[*Items - 1];
+        ULONGLONG last_lba = RtlUlonglongByteSwap(*(PULONGLONG)last->StartingLba);
+        ULONG last_blocks = RtlUlongByteSwap(*(PULONG)last->LogicalBlockCount);
+
+        if ((last->ProvisioningStatus == ProvisioningStatus) &&
+            (last_lba + last_blocks == StartingLba))
+        {
+            *(PULONG)last->LogicalBlockCount =
+                RtlUlongByteSwap((ULONG)(last_blocks + Blocks));
+
+            return TRUE;
+        }
+    }
+
+    if (*Items >= MaxItems)
+    {
+        return FALSE;
+    }
+
+    PIMSCSI_LBA_STATUS_DESCRIPTOR descriptor = &Descriptors[(*Items)++];
+
+    RtlZeroMemory(descriptor, sizeof(*descriptor));
+
+    *(PULONGLONG)descriptor->StartingLba = RtlUlonglongByteSwap(StartingLba);
+    *(PULONG)descriptor->LogicalBlockCount = RtlUlongByteSwap((ULONG)Blocks);
+    descriptor->ProvisioningStatus = ProvisioningStatus;
+
+    return TRUE;
+}
+
+VOID
+ImScsiGetLbaStatusDevice(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    ULONG block_size = 1UL << pLUExt->BlockPower;
+    ULONGLONG disk_blocks = pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower;
+    ULONGLONG lba;
+    ULONG length;
+    ULONG max_descriptors;
+    ULONG descriptors = 0;
+    ULONG max_ranges;
+    ULONG ranges;
+    ULONG used;
+    LONGLONG covered_end;
+    ULONGLONG end_lba;
+    ULONGLONG covered_lba;
+    PUCHAR sysaddress = NULL;
+
+    REVERSE_BYTES_QUAD(&lba, &pSrb->Cdb[2]);
+    REVERSE_BYTES(&length, &pSrb->Cdb[10]);
+
+    length = min(length, pSrb->DataTransferLength);
+
+    // Descriptors that fit, but always at least one so that parameter data
+    // length can be reported.
+    max_descriptors = length >= FIELD_OFFSET(IMSCSI_LBA_STATUS_HEADER, Descriptors) ?
+        (length - FIELD_OFFSET(IMSCSI_LBA_STATUS_HEADER, Descriptors)) / sizeof(IMSCSI_LBA_STATUS_DESCRIPTOR) : 0;
+
+    max_descriptors = max(1UL, min(max_descriptors, IMSCSI_MAX_ALLOCATED_RANGES_QUERY));
+
+    // Each allocated range gives at most two descriptors
+    max_ranges = max_descriptors / 2 + 1;
+
+    // Block count in a descriptor is 32 bits
+    end_lba = min(disk_blocks, lba + MAXULONG);
+
+    KdPrint2(("PhDskMnt::ImScsiGetLbaStatusDevice: LBA=0x%I64X, AllocationLength=%u\n", lba, length));
+
+    ULONG storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, (PVOID*)&sysaddress);
+
+    if ((storage_status != STORAGE_STATUS_SUCCESS) | (sysaddress == NULL))
+    {
+        DbgPrint("PhDskMnt::ImScsiGetLbaStatusDevice: StorPortGetSystemAddress failed: status=0x%X\n",
+            storage_status);
+
+        ScsiSetError(pSrb, SRB_STATUS_ERROR);
+        return;
+    }
+
+    WPoolMem<UCHAR, PagedPool> parameter_data(FIELD_OFFSET(IMSCSI_LBA_STATUS_HEADER, Descriptors) +
+        max_descriptors * sizeof(IMSCSI_LBA_STATUS_DESCRIPTOR));
+
+    WPoolMem<DEVICE_DATA_SET_RANGE, PagedPool> range(sizeof(DEVICE_DATA_SET_RANGE) * max_ranges);
+
+    if ((!parameter_data) || (!range))
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
+        return;
+    }
+
+    PIMSCSI_LBA_STATUS_HEADER header = (PIMSCSI_LBA_STATUS_HEADER)(PUCHAR)parameter_data;
+
+    RtlZeroMemory(header, FIELD_OFFSET(IMSCSI_LBA_STATUS_HEADER, Descriptors));
+
+    ranges = ImScsiGetAllocatedRanges(pLUExt,
+        (LONGLONG)(lba << pLUExt->BlockPower),
+        (LONGLONG)(end_lba << pLUExt->BlockPower),
+        range,
+        max_ranges,
+        &covered_end);
+
+    covered_lba = min(end_lba, (ULONGLONG)covered_end >> pLUExt->BlockPower);
+
+    // Allocated ranges are rounded outwards to whole blocks, gaps between
+    // them are deallocated.
+    for (ULONG i = 0; i < ranges; i++)
+    {
+        ULONGLONG range_start = (ULONGLONG)range[i].StartingOffset >> pLUExt->BlockPower;
+        ULONGLONG range_end = (range[i].StartingOffset + range[i].LengthInBytes +
+            block_size - 1) >> pLUExt->BlockPower;
+
+        range_start = max(range_start, lba);
+        range_end = min(range_end, end_lba);
+
+        if (range_end <= lba)
+        {
+            continue;
+        }
+
+        if ((range_start > lba) &&
+            !ImScsiAddLbaStatus(header->Descriptors, &descriptors, max_descriptors,
+                lba, range_start - lba, IMSCSI_LBA_STATUS_DEALLOCATED))
+        {
+            break;
+        }
+
+        lba = range_start;
+
+        if (!ImScsiAddLbaStatus(header->Descriptors, &descriptors, max_descriptors,
+            lba, range_end - lba, IMSCSI_LBA_STATUS_MAPPED))
+        {
+            break;
+        }
+
+        lba = range_end;
+    }
+
+    if (covered_lba > lba)
+    {
+        ImScsiAddLbaStatus(header->Descriptors, &descriptors, max_descriptors,
+            lba, covered_lba - lba, IMSCSI_LBA_STATUS_DEALLOCATED);
+    }
+
+    // Nothing known about starting LBA, report as mapped.
+    if (descriptors == 0)
+    {
+        ImScsiAddLbaStatus(header->Descriptors, &descriptors, max_descriptors,
+            lba, end_lba - lba, IMSCSI_LBA_STATUS_MAPPED);
+    }
+
+    used = FIELD_OFFSET(IMSCSI_LBA_STATUS_HEADER, Descriptors) +
+        descriptors * sizeof(IMSCSI_LBA_STATUS_DESCRIPTOR);
+
+    *(PULONG)header->ParameterDataLength =
+        RtlUlongByteSwap(used - sizeof(header->ParameterDataLength));
+
+    KdPrint2(("PhDskMnt::ImScsiGetLbaStatusDevice: %u descriptors from %u ranges.\n",
+        descriptors, ranges));
+
+    used = min(used, length);
+
+    RtlCopyMemory(sysaddress, header, used);
+
+    ScsiSetSuccess(pSrb, used);
+}
+
+VOID
+ImScsiUnmapDevice(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    PUNMAP_LIST_HEADER list = (PUNMAP_LIST_HEADER)pSrb->DataBuffer;
+    USHORT descrlength = RtlUshortByteSwap(*(PUSHORT)list->BlockDescrDataLength);
+
+    UNREFERENCED_PARAMETER(pHBAExt);
+
+    if ((ULONG)descrlength + FIELD_OFFSET(UNMAP_LIST_HEADER, Descriptors) >
+        pSrb->DataTransferLength)
+    {
+        KdBreakPoint();
+        ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+        return;
+    }
+
+    USHORT items = descrlength / sizeof(*list->Descriptors);
+
+    NTSTATUS status = STATUS_SUCCESS;
+
+    IO_STATUS_BLOCK io_status;
+
+    if (items == 0)
+    {
+        ScsiSetSuccess(pSrb, 0);
+        return;
+    }
+
+    WPoolMem<DEVICE_DATA_SET_RANGE, PagedPool> range(sizeof(DEVICE_DATA_SET_RANGE) * items);
+
+    if (!range)
+    {
+        ScsiSetError(pSrb, SRB_STATUS_ERROR);
+        return;
+    }
+
+    for (USHORT i = 0; i < items; i++)
+    {
+        LONGLONG startingSector = RtlUlonglongByteSwap(*(PULONGLONG)list->Descriptors[i].StartingLba);
+        ULONG numBlocks = RtlUlongByteSwap(*(PULONG)list->Descriptors[i].LbaCount);
+
+        range[i].StartingOffset = (startingSector << pLUExt->BlockPower) + pLUExt->ImageOffset.QuadPart;
+        range[i].LengthInBytes = (ULONGLONG)numBlocks << pLUExt->BlockPower;
+
+        KdPrint2(("PhDskMnt::ImScsiUnmapDevice: Offset: %I64i, bytes: %I64u\n",
+            range[i].StartingOffset, range[i].LengthInBytes));
+    }
+
+    ULONG merged_items = ImScsiCoalesceRanges(range, items);
+
+    KdPrint(("PhDskMnt::ImScsiUnmapDevice: %u descriptors coalesced into %u ranges.\n",
+        (ULONG)items, merged_items));
+
+    if (pLUExt->VMDisk)
+    {
+        // Unmapped chunks are released and read back as zeros.
+        for (ULONG i = 0; i < merged_items; i++)
+        {
+            LARGE_INTEGER offset;
+            ULONGLONG length = range[i].LengthInBytes;
+
+            offset.QuadPart = range[i].StartingOffset - pLUExt->ImageOffset.QuadPart;
+
+            if (offset.QuadPart >= pLUExt->DiskSize.QuadPart)
+            {
+                continue;
+            }
+
+            length = min(length, (ULONGLONG)(pLUExt->DiskSize.QuadPart - offset.QuadPart));
+
+            while (length > 0)
+            {
+                ULONG block_length = (ULONG)min(length,
+                    (ULONGLONG)(MAXLONG & ~(IMSCSI_VM_CHUNK_SIZE - 1)));
+
+                status = ImScsiLoadMemoryDiskRange(pLUExt, &offset, block_length, TRUE);
+
+                if (NT_SUCCESS(status))
+                {
+                    status = ImScsiWriteVMDisk(pLUExt, NULL, offset.QuadPart, block_length);
+                }
+
+                if (!NT_SUCCESS(status))
+                {
+                    break;
+                }
+
+                offset.QuadPart += block_length;
+                length -= block_length;
+            }
+        }
+    }
+    else if (pLUExt->UseProxy)
+    {
+        if (merged_items > 0)
+        {
+            status = ImScsiUnmapOrZeroProxy(
+                &pLUExt->Proxy,
+                IMDPROXY_REQ_UNMAP,
+                &io_status,
+                &pLUExt->StopThread,
+                merged_items,
+                range);
+
+            for (ULONG i = 0; i < merged_items; i++)
+            {
+                ImScsiInvalidateProxyCache(pLUExt, range[i].StartingOffset,
+                    range[i].LengthInBytes);
+            }
+        }
+    }
+    else if (pLUExt->ImageFile != NULL)
+    {
+        FILE_ZERO_DATA_INFORMATION zerodata;
+        ULONG allocated_items = ImScsiDropUnallocatedRanges(pLUExt->ImageFile, range, merged_items);
+
+        KdPrint(("PhDskMnt::ImScsiUnmapDevice: %u ranges skipped, already unallocated.\n",
+            merged_items - allocated_items));
+
+        merged_items = allocated_items;
+
+        if (merged_items == 0)
+        {
+            goto done;
+        }
+
+#if _NT_TARGET_VERSION >= 0x602
+        ULONG fltrim_size = FIELD_OFFSET(FILE_LEVEL_TRIM, Ranges) +
+            (merged_items * sizeof(FILE_LEVEL_TRIM_RANGE));
+
+        WPoolMem<FILE_LEVEL_TRIM, PagedPool> fltrim;
+
+        if (!pLUExt->NoFileLevelTrim)
+        {
+            fltrim.Alloc(fltrim_size);
+
+            if (!fltrim)
+            {
+                ScsiSetError(pSrb, SRB_STATUS_ERROR);
+                return;
+            }
+
+            fltrim->NumRanges = merged_items;
+        }
+#endif
+
+        for (ULONG i = 0; i < merged_items; i++)
+        {
+            zerodata.FileOffset.QuadPart = range[i].StartingOffset;
+            zerodata.BeyondFinalZero.QuadPart = range[i].StartingOffset +
+                range[i].LengthInBytes;
+
+            KdPrint2(("PhDskMnt::ImScsiUnmapDevice: Zero data request from 0x%I64X to 0x%I64X\n",
+                zerodata.FileOffset.QuadPart, zerodata.BeyondFinalZero.QuadPart));
+
+#if _NT_TARGET_VERSION >= 0x602
+            if (!pLUExt->NoFileLevelTrim)
+            {
+                fltrim->Ranges[i].Offset = range[i].StartingOffset;
+                fltrim->Ranges[i].Length = range[i].LengthInBytes;
+            }
+#endif
+
+            status = ZwFsControlFile(
+                pLUExt->ImageFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                FSCTL_SET_ZERO_DATA,
+                &zerodata,
+                sizeof(zerodata),
+                NULL,
+                0);
+
+            ImScsiInvalidateCache(pLUExt, range[i].StartingOffset,
+                range[i].LengthInBytes);
+
+            if (!NT_SUCCESS(status))
+            {
+                KdPrint(("PhDskMnt::ImScsiUnmapDevice: FSCTL_SET_ZERO_DATA result: %#x\n", status));
+                goto done;
+            }
+        }
+
+#if _NT_TARGET_VERSION >= 0x602
+        if (!pLUExt->NoFileLevelTrim)
+        {
+            status = ZwFsControlFile(
+                pLUExt->ImageFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                FSCTL_FILE_LEVEL_TRIM,
+                fltrim,
+                fltrim_size,
+                NULL,
+                0);
+
+            KdPrint(("PhDskMnt::ImScsiUnmapDevice: FSCTL_FILE_LEVEL_TRIM of %u ranges result: %#x\n",
+                merged_items, status));
+
+            if (!NT_SUCCESS(status))
+            {
+                pLUExt->NoFileLevelTrim = TRUE;
+            }
+        }
+#endif
+    }
+    else
+    {
+        status = STATUS_NOT_SUPPORTED;
+    }
+
+done:
+
+    KdPrint(("PhDskMnt::ImScsiUnmapDevice: Result: %#x\n", status));
+
+    ScsiSetSuccess(pSrb, 0);
+}
+
+VOID
+ImScsiWriteSameDevice(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    LARGE_INTEGER starting_sector;
+    ULONG num_blocks;
+    BOOLEAN no_data_out;
+    ULONG block_size = 1UL << pLUExt->BlockPower;
+    LONGLONG offset;
+    LONGLONG end;
+    PUCHAR pattern = NULL;
+    PUCHAR buffer = NULL;
+    ULONG buffer_size;
+    NTSTATUS status = STATUS_SUCCESS;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    ScsiGetWriteSameRange(pSrb, &starting_sector, &num_blocks, &no_data_out);
+
+    offset = starting_sector.QuadPart << pLUExt->BlockPower;
+    end = offset + ((LONGLONG)num_blocks << pLUExt->BlockPower);
+
+    KdPrint2(("PhDskMnt::ImScsiWriteSameDevice: Offset=0x%I64X, Blocks=%u\n", offset, num_blocks));
+
+    if (!no_data_out)
+    {
+        ULONG storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, (PVOID*)&pattern);
+
+        if ((storage_status != STORAGE_STATUS_SUCCESS) | (pattern == NULL))
+        {
+            DbgPrint("PhDskMnt::ImScsiWriteSameDevice: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
+                storage_status,
+                pSrb->DataBuffer,
+                pattern);
+
+            ScsiSetError(pSrb, SRB_STATUS_ERROR);
+            return;
+        }
+
+        if (ImScsiIsBufferZero(pattern, block_size))
+        {
+            pattern = NULL;
+        }
+    }
+
+    // Last read or written data could be within range
+    ImScsiDropLastIoBuffer(pLUExt, &lowest_assumed_irql);
+
+    // Zero pattern, zero or deallocate range in image without sending data
+    if ((pattern == NULL) && pLUExt->SupportsZero)
+    {
+        while (offset < end)
+        {
+            LARGE_INTEGER chunk_offset;
+            ULONG chunk = (ULONG)min(end - offset, IMSCSI_WRITE_SAME_ZERO_CHUNK);
+
+            chunk_offset.QuadPart = offset;
+
+            status = ImScsiZeroDevice(pLUExt, &chunk_offset, chunk);
+
+            ImScsiInvalidateCache(pLUExt,
+                offset + pLUExt->ImageOffset.QuadPart, chunk);
+
+            if (!NT_SUCCESS(status))
+            {
+                break;
+            }
+
+            offset += chunk;
+        }
+
+        if (NT_SUCCESS(status))
+        {
+            goto done;
+        }
+
+        KdPrint(("PhDskMnt::ImScsiWriteSameDevice: Zero request failed: 0x%#X\n", status));
+
+        pLUExt->SupportsZero = FALSE;
+
+        status = STATUS_SUCCESS;
+    }
+
+    // Write pattern repeated in a buffer, through same path as WRITE
+    buffer_size = (ULONG)min(end - offset, IMSCSI_WRITE_SAME_BUFFER_SIZE);
+
+    if (buffer_size > 0)
+    {
+        buffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool, buffer_size, MP_TAG_GENERAL);
+
+        if (buffer == NULL)
+        {
+            status = STATUS_INSUFFICIENT_RESOURCES;
+            goto done;
+        }
+
+        if (pattern == NULL)
+        {
+            RtlZeroMemory(buffer, buffer_size);
+        }
+        else
+        {
+            for (ULONG i = 0; i < buffer_size; i += block_size)
+            {
+                RtlCopyMemory(buffer + i, pattern, block_size);
+            }
+        }
+    }
+
+    while (offset < end)
+    {
+        LARGE_INTEGER chunk_offset;
+        ULONG chunk = (ULONG)min(end - offset, buffer_size);
+
+        chunk_offset.QuadPart = offset;
+        offset += chunk;
+
+        if (pLUExt->OverlayFile != NULL)
+            status = ImScsiWriteOverlay(pLUExt, buffer, &chunk_offset, &chunk);
+        else
+            status = ImScsiWriteDevice(pLUExt, buffer, &chunk_offset, &chunk);
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+    }
+
+done:
+
+    if (buffer != NULL)
+    {
+        ExFreePoolWithTag(buffer, MP_TAG_GENERAL);
+    }
+
+    KdPrint2(("PhDskMnt::ImScsiWriteSameDevice: Result: %#x\n", status));
+
+    if (!NT_SUCCESS(status))
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_MEDIUM_ERROR, SCSI_ADSENSE_WRITE_ERROR, 0);
+        return;
+    }
+
+    ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+}
+
+NTSTATUS
+ImScsiFlushLU(
+    __in pHW_LU_EXTENSION pLUExt)
+{
+    IO_STATUS_BLOCK io_status;
+    NTSTATUS status;
+    HANDLE file = pLUExt->OverlayFile != NULL ?
+        pLUExt->OverlayFile : pLUExt->ImageFile;
+
+    pLUExt->Core.WriteBackDirty = 0;
+
+    if (file == NULL)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    status = ZwFlushBuffersFile(file, &io_status);
+
+    KdPrint2(("PhDskMnt::ImScsiFlushLU: Result: %#x\n", status));
+
+    return status;
+}
+
+VOID
+ImScsiFlushDevice(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    NTSTATUS status;
+
+    UNREFERENCED_PARAMETER(pHBAExt);
+
+    status = ImScsiFlushLU(pLUExt);
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiFlushDevice: Flush failed: %#x\n", status));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_MEDIUM_ERROR, SCSI_ADSENSE_WRITE_ERROR, 0);
+        return;
+    }
+
+    ScsiSetSuccess(pSrb, 0);
+}
+
+//
+// Sets transfer and unmap limits of LU from back end, reported in block
+// limits VPD page. Called when back end has been opened. Limits that cannot
+// be queried are left as zero, not reported.
+//
+VOID
+ImScsiQueryBackendLimits(
+    __inout pHW_LU_EXTENSION pLUExt,
+    __in BOOLEAN ProxySupportsLimits)
+{
+    ULONG block_size = 1UL << pLUExt->BlockPower;
+
+    if (pLUExt->VMDisk)
+    {
+        // Memory is allocated, loaded and released in chunks.
+        pLUExt->OptimalTransferGranularity = IMSCSI_VM_CHUNK_SIZE;
+        pLUExt->UnmapGranularity = IMSCSI_VM_CHUNK_SIZE;
+    }
+    else if (pLUExt->UseProxy)
+    {
+        // Requests larger than shared memory window are split.
+        if (pLUExt->Proxy.connection_type == PROXY_CONNECTION::PROXY_CONNECTION_SHM)
+        {
+            ULONG_PTR window = pLUExt->Proxy.shared_memory_size - IMDPROXY_HEADER_SIZE;
+
+            pLUExt->MaxTransferLength = (ULONG)min(window, MAXULONG) & ~(block_size - 1);
+            pLUExt->MaxUnmapDescriptors = (ULONG)min(window / sizeof(DEVICE_DATA_SET_RANGE), MAXLONG);
+        }
+
+        // Chunk size of image format and limits of storage behind proxy
+        // service. Called before worker thread is started, so connection
+        // can be used here.
+        if (ProxySupportsLimits)
+        {
+            IMDPROXY_LIMITS_RESP limits;
+            IO_STATUS_BLOCK io_status;
+
+            NTSTATUS status = ImScsiQueryLimitsProxy(&pLUExt->Proxy,
+                &io_status,
+                NULL,
+                &limits);
+
+            if (NT_SUCCESS(status))
+            {
+                pLUExt->OptimalTransferGranularity =
+                    (ULONG)min(limits.optimal_granularity, MAXLONG);
+                pLUExt->OptimalTransferLength =
+                    (ULONG)min(limits.optimal_transfer_length, MAXLONG) & ~(block_size - 1);
+                pLUExt->UnmapGranularity =
+                    (ULONG)min(limits.unmap_granularity, MAXLONG);
+
+                ULONG max_transfer = (ULONG)min(limits.max_transfer_length, MAXLONG) &
+                    ~(block_size - 1);
+
+                if ((max_transfer != 0) &&
+                    ((pLUExt->MaxTransferLength == 0) ||
+                        (max_transfer < pLUExt->MaxTransferLength)))
+                {
+                    pLUExt->MaxTransferLength = max_transfer;
+                }
+            }
+            else
+            {
+                KdPrint(("PhDskMnt::ImScsiQueryBackendLimits: Proxy limits query failed: %#x\n", status));
+            }
+        }
+
+        if (pLUExt->ProxyCache != NULL)
+        {
+            pLUExt->OptimalTransferGranularity =
+                max(pLUExt->OptimalTransferGranularity, IMSCSI_CACHE_CORE_BLOCK_SIZE);
+            pLUExt->OptimalTransferLength =
+                max(pLUExt->OptimalTransferLength,
+                    IMSCSI_CACHE_CORE_BLOCK_SIZE * IMSCSI_CACHE_CORE_MAX_RUN_BLOCKS);
+        }
+    }
+    else if ((pLUExt->ImageFile != NULL) && (!pLUExt->AWEAllocDisk))
+    {
+        FILE_FS_SIZE_INFORMATION fs_size;
+        STORAGE_PROPERTY_QUERY query = { 0 };
+        IO_STATUS_BLOCK io_status;
+        NTSTATUS status;
+
+        // Sparse image files are deallocated in clusters.
+        status = ZwQueryVolumeInformationFile(pLUExt->ImageFile,
+            &io_status,
+            &fs_size,
+            sizeof(fs_size),
+            FileFsSizeInformation);
+
+        if (NT_SUCCESS(status))
+        {
+            pLUExt->UnmapGranularity =
+                fs_size.SectorsPerAllocationUnit * fs_size.BytesPerSector;
+        }
+
+        // Limits of storage adapter and physical sector size of volume,
+        // where file system passes these queries down.
+        STORAGE_ADAPTER_DESCRIPTOR adapter = { 0 };
+
+        query.PropertyId = StorageAdapterProperty;
+        query.QueryType = PropertyStandardQuery;
+
+        status = ZwDeviceIoControlFile(pLUExt->ImageFile,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            IOCTL_STORAGE_QUERY_PROPERTY,
+            &query,
+            sizeof(query),
+            &adapter,
+            sizeof(adapter));
+
+        if (NT_SUCCESS(status) &&
+            (io_status.Information >= RTL_SIZEOF_THROUGH_FIELD(STORAGE_ADAPTER_DESCRIPTOR, MaximumPhysicalPages)))
+        {
+            ULONG max_transfer = adapter.MaximumTransferLength;
+
+            if ((adapter.MaximumPhysicalPages > 1) &&
+                (adapter.MaximumPhysicalPages - 1 < (MAXULONG >> PAGE_SHIFT)))
+            {
+                max_transfer = min(max_transfer,
+                    (adapter.MaximumPhysicalPages - 1) << PAGE_SHIFT);
+            }
+
+            pLUExt->MaxTransferLength = max_transfer & ~(block_size - 1);
+        }
+        else
+        {
+            KdPrint2(("PhDskMnt::ImScsiQueryBackendLimits: StorageAdapterProperty: %#x\n", status));
+        }
+
+#if _NT_TARGET_VERSION >= 0x600
+        STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR alignment = { 0 };
+
+        query.PropertyId = StorageAccessAlignmentProperty;
+
+        status = ZwDeviceIoControlFile(pLUExt->ImageFile,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            IOCTL_STORAGE_QUERY_PROPERTY,
+            &query,
+            sizeof(query),
+            &alignment,
+            sizeof(alignment));
+
+        if (NT_SUCCESS(status) &&
+            (io_status.Information >= RTL_SIZEOF_THROUGH_FIELD(STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR, BytesPerPhysicalSector)))
+        {
+            pLUExt->OptimalTransferGranularity = alignment.BytesPerPhysicalSector;
+        }
+#endif
+
+        // Reads are served in blocks by shared block cache.
+        if (pLUExt->CacheFile != NULL)
+        {
+            pLUExt->OptimalTransferGranularity =
+                max(pLUExt->OptimalTransferGranularity, IMSCSI_CACHE_BLOCK_SIZE);
+            pLUExt->OptimalTransferLength =
+                IMSCSI_CACHE_BLOCK_SIZE * IMSCSI_CACHE_MAX_RUN_BLOCKS;
+        }
+    }
+
+    // Differencing file stores data in blocks, partial blocks are merged
+    // with original image data.
+    if (pLUExt->OverlayFile != NULL)
+    {
+        pLUExt->OptimalTransferGranularity =
+            max(pLUExt->OptimalTransferGranularity, IMSCSI_OVERLAY_BLOCK_SIZE);
+    }
+
+    if (pLUExt->OptimalTransferGranularity <= block_size)
+    {
+        pLUExt->OptimalTransferGranularity = 0;
+    }
+
+    if (pLUExt->UnmapGranularity <= block_size)
+    {
+        pLUExt->UnmapGranularity = 0;
+    }
+
+    if ((pLUExt->MaxTransferLength != 0) &&
+        (pLUExt->OptimalTransferLength > pLUExt->MaxTransferLength))
+    {
+        pLUExt->OptimalTransferLength = pLUExt->MaxTransferLength;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiQueryBackendLimits: Granularity=%u OptimalTransfer=%u MaxTransfer=%u UnmapGranularity=%u MaxUnmapDescriptors=%u\n",
+        pLUExt->OptimalTransferGranularity,
+        pLUExt->OptimalTransferLength,
+        pLUExt->MaxTransferLength,
+        pLUExt->UnmapGranularity,
+        pLUExt->MaxUnmapDescriptors));
 }
 
@@ -0,0 +1,580 @@
+/// merkle.cpp
+/// Checks data read from image files against chunk hashes in a Merkle
+/// index file created by aimapi, so that an image can be verified while it
+/// is in use instead of in a separate full pass.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#if _NT_TARGET_VERSION >= 0x600
+#include <bcrypt.h>
+#endif
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Index file format is described with IMSCSI_MERKLE_HEADER in common.h.
+// When index is opened, root is computed from leaf hashes and compared to
+// root in header, so that a damaged or modified index file is detected
+// before any data is checked against it. Each chunk is then checked once,
+// the first time a read request touches it. The whole chunk is read into
+// a separate buffer, hashed and compared to its leaf hash, then the part
+// returned to the read request is compared to that buffer. Chunks that
+// have been checked are remembered in a bitmap.
+//
+// All checks run in LU worker thread, no locking is needed.
+//
+
+#if _NT_TARGET_VERSION >= 0x600
+
+typedef struct _IMSCSI_MERKLE_INDEX
+{
+    HANDLE File;
+    ULONG ChunkShift;
+    ULONG ChunkCount;
+    LONGLONG ImageSize;
+    RTL_BITMAP Verified;            // Chunks already checked.
+    PUCHAR ChunkBuffer;
+    BCRYPT_ALG_HANDLE AlgHandle;
+    PUCHAR HashObject;
+    ULONG HashObjectLength;
+} IMSCSI_MERKLE_INDEX, *PIMSCSI_MERKLE_INDEX;
+
+typedef struct _IMSCSI_MERKLE_NODE
+{
+    ULONG Level;
+    UCHAR Hash[IMSCSI_MERKLE_HASH_SIZE];
+} IMSCSI_MERKLE_NODE, *PIMSCSI_MERKLE_NODE;
+
+// Enough for any number of chunks that fits in a ULONG.
+#define IMSCSI_MERKLE_MAX_LEVELS    33
+
+VOID
+ImScsiFreeMerkleIndex(__in PIMSCSI_MERKLE_INDEX Index)
+{
+    if (Index->File != NULL)
+    {
+        ZwClose(Index->File);
+    }
+
+    if (Index->Verified.Buffer != NULL)
+    {
+        ExFreePoolWithTag(Index->Verified.Buffer, MP_TAG_GENERAL);
+    }
+
+    if (Index->ChunkBuffer != NULL)
+    {
+        ExFreePoolWithTag(Index->ChunkBuffer, MP_TAG_GENERAL);
+    }
+
+    if (Index->HashObject != NULL)
+    {
+        ExFreePoolWithTag(Index->HashObject, MP_TAG_GENERAL);
+    }
+
+    if (Index->AlgHandle != NULL)
+    {
+        BCryptCloseAlgorithmProvider(Index->AlgHandle, 0);
+    }
+
+    ExFreePoolWithTag(Index, MP_TAG_GENERAL);
+}
+
+NTSTATUS
+ImScsiMerkleHash(__in PIMSCSI_MERKLE_INDEX Index,
+__in UCHAR Prefix,
+__in_bcount(Length1) PVOID Data1,
+__in ULONG Length1,
+__in_bcount_opt(Length2) PVOID Data2,
+__in ULONG Length2,
+__out_bcount(IMSCSI_MERKLE_HASH_SIZE) PUCHAR Hash)
+{
+    BCRYPT_HASH_HANDLE hash_handle;
+    NTSTATUS status;
+
+    status = BCryptCreateHash(Index->AlgHandle, &hash_handle,
+        Index->HashObject, Index->HashObjectLength, NULL, 0, 0);
+
+    if (!NT_SUCCESS(status))
+    {
+        return status;
+    }
+
+    status = BCryptHashData(hash_handle, &Prefix, sizeof(Prefix), 0);
+
+    if (NT_SUCCESS(status))
+    {
+        status = BCryptHashData(hash_handle, (PUCHAR)Data1, Length1, 0);
+    }
+
+    if (NT_SUCCESS(status) && (Length2 > 0))
+    {
+        status = BCryptHashData(hash_handle, (PUCHAR)Data2, Length2, 0);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = BCryptFinishHash(hash_handle, Hash, IMSCSI_MERKLE_HASH_SIZE, 0);
+    }
+
+    BCryptDestroyHash(hash_handle);
+
+    return status;
+}
+
+NTSTATUS
+ImScsiCheckMerkleRoot(__in PIMSCSI_MERKLE_INDEX Index,
+__in_bcount(IMSCSI_MERKLE_HASH_SIZE) PUCHAR Root)
+{
+    // Roots of completed subtrees, lowest level on top. Equal levels are
+    // combined as leaves are added, remaining nodes are combined from top
+    // when all leaves are added. That gives same root as hashing level by
+    // level.
+    PIMSCSI_MERKLE_NODE stack;
+    ULONG depth = 0;
+    ULONG leaves_per_read = (1UL << Index->ChunkShift) / IMSCSI_MERKLE_HASH_SIZE;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    stack = (PIMSCSI_MERKLE_NODE)ExAllocatePoolWithTag(PagedPool,
+        IMSCSI_MERKLE_MAX_LEVELS * sizeof(IMSCSI_MERKLE_NODE), MP_TAG_GENERAL);
+
+    if (stack == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (ULONG first = 0; first < Index->ChunkCount; first += leaves_per_read)
+    {
+        ULONG count = min(Index->ChunkCount - first, leaves_per_read);
+        LARGE_INTEGER offset;
+        IO_STATUS_BLOCK io_status;
+
+        offset.QuadPart = IMSCSI_MERKLE_HEADER_SIZE +
+            (LONGLONG)first * IMSCSI_MERKLE_HASH_SIZE;
+
+        status = ZwReadFile(Index->File, NULL, NULL, NULL, &io_status,
+            Index->ChunkBuffer, count * IMSCSI_MERKLE_HASH_SIZE, &offset, NULL);
+
+        if (NT_SUCCESS(status) &&
+            (io_status.Information != count * IMSCSI_MERKLE_HASH_SIZE))
+        {
+            status = STATUS_FILE_CORRUPT_ERROR;
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        for (ULONG i = 0; i < count; i++)
+        {
+            RtlCopyMemory(stack[depth].Hash,
+                Index->ChunkBuffer + i * IMSCSI_MERKLE_HASH_SIZE,
+                IMSCSI_MERKLE_HASH_SIZE);
+            stack[depth].Level = 0;
+            depth++;
+
+            while ((depth >= 2) &&
+                (stack[depth - 2].Level == stack[depth - 1].Level))
+            {
+                status = ImScsiMerkleHash(Index, 1,
+                    stack[depth - 2].Hash, IMSCSI_MERKLE_HASH_SIZE,
+                    stack[depth - 1].Hash, IMSCSI_MERKLE_HASH_SIZE,
+                    stack[depth - 2].Hash);
+
+                if (!NT_SUCCESS(status))
+                {
+                    break;
+                }
+
+                stack[depth - 2].Level++;
+                depth--;
+            }
+
+            if (!NT_SUCCESS(status))
+            {
+                break;
+            }
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+    }
+
+    while (NT_SUCCESS(status) && (depth >= 2))
+    {
+        status = ImScsiMerkleHash(Index, 1,
+            stack[depth - 2].Hash, IMSCSI_MERKLE_HASH_SIZE,
+            stack[depth - 1].Hash, IMSCSI_MERKLE_HASH_SIZE,
+            stack[depth - 2].Hash);
+
+        depth--;
+    }
+
+    if (NT_SUCCESS(status) &&
+        ((depth != 1) ||
+        (RtlCompareMemory(stack[0].Hash, Root, IMSCSI_MERKLE_HASH_SIZE) !=
+        IMSCSI_MERKLE_HASH_SIZE)))
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    ExFreePoolWithTag(stack, MP_TAG_GENERAL);
+
+    return status;
+}
+
+NTSTATUS
+ImScsiOpenMerkleIndex(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_MERKLE_INDEX index;
+    UNICODE_STRING index_name;
+    OBJECT_ATTRIBUTES object_attributes;
+    IO_STATUS_BLOCK io_status;
+    LARGE_INTEGER offset = { 0 };
+    IMSCSI_MERKLE_HEADER header;
+    ULONGLONG chunk_count;
+    ULONG result_length;
+    NTSTATUS status;
+
+    if (pLUExt->ObjectName.Length == 0)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    index = (PIMSCSI_MERKLE_INDEX)ExAllocatePoolWithTag(NonPagedPool,
+        sizeof(IMSCSI_MERKLE_INDEX), MP_TAG_GENERAL);
+
+    if (index == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(index, sizeof(IMSCSI_MERKLE_INDEX));
+
+    index_name.Length = 0;
+    index_name.MaximumLength = pLUExt->ObjectName.Length +
+        sizeof(IMSCSI_MERKLE_INDEX_SUFFIX);
+
+    WPoolMem<WCHAR, PagedPool> index_name_buffer(index_name.MaximumLength);
+
+    if (!index_name_buffer)
+    {
+        ImScsiFreeMerkleIndex(index);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    index_name.Buffer = index_name_buffer;
+
+    RtlAppendUnicodeStringToString(&index_name, &pLUExt->ObjectName);
+    RtlAppendUnicodeToString(&index_name, IMSCSI_MERKLE_INDEX_SUFFIX);
+
+    InitializeObjectAttributes(&object_attributes,
+        &index_name,
+        OBJ_CASE_INSENSITIVE |
+        OBJ_KERNEL_HANDLE,
+        NULL,
+        NULL);
+
+    status = ZwCreateFile(
+        &index->File,
+        GENERIC_READ,
+        &object_attributes,
+        &io_status,
+        NULL,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE |
+        FILE_RANDOM_ACCESS |
+        FILE_SYNCHRONOUS_IO_NONALERT,
+        NULL,
+        0);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenMerkleIndex: Cannot open index file '%wZ' (%#x).\n",
+            &index_name, status);
+
+        index->File = NULL;
+        ImScsiFreeMerkleIndex(index);
+        return status;
+    }
+
+    status = ZwReadFile(index->File, NULL, NULL, NULL, &io_status,
+        &header, sizeof(header), &offset, NULL);
+
+    if (NT_SUCCESS(status) &&
+        ((io_status.Information != sizeof(header)) ||
+        (memcmp(header.Signature, IMSCSI_MERKLE_SIGNATURE,
+        sizeof(header.Signature)) != 0) ||
+        (header.Version != IMSCSI_MERKLE_VERSION) ||
+        (header.ChunkShift < IMSCSI_MERKLE_MIN_CHUNK_SHIFT) ||
+        (header.ChunkShift > IMSCSI_MERKLE_MAX_CHUNK_SHIFT)))
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenMerkleIndex: Bad index file '%wZ' (%#x).\n",
+            &index_name, status);
+
+        ImScsiFreeMerkleIndex(index);
+        return status;
+    }
+
+    // Index must describe exactly the virtual disk contents.
+    if (header.ImageSize.QuadPart != pLUExt->DiskSize.QuadPart)
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenMerkleIndex: Index is for %I64i bytes, disk is %I64i bytes.\n",
+            header.ImageSize.QuadPart, pLUExt->DiskSize.QuadPart);
+
+        ImScsiFreeMerkleIndex(index);
+        return STATUS_REVISION_MISMATCH;
+    }
+
+    chunk_count = ((ULONGLONG)header.ImageSize.QuadPart +
+        (1ULL << header.ChunkShift) - 1) >> header.ChunkShift;
+
+    if ((chunk_count == 0) || (chunk_count > MAXULONG - 31))
+    {
+        ImScsiFreeMerkleIndex(index);
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    index->ChunkShift = header.ChunkShift;
+    index->ChunkCount = (ULONG)chunk_count;
+    index->ImageSize = header.ImageSize.QuadPart;
+
+    index->Verified.Buffer = (PULONG)ExAllocatePoolWithTag(PagedPool,
+        ((index->ChunkCount + 31) >> 5) * sizeof(ULONG), MP_TAG_GENERAL);
+    index->ChunkBuffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+        1UL << index->ChunkShift, MP_TAG_GENERAL);
+
+    if ((index->Verified.Buffer == NULL) || (index->ChunkBuffer == NULL))
+    {
+        ImScsiFreeMerkleIndex(index);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlInitializeBitMap(&index->Verified, index->Verified.Buffer,
+        index->ChunkCount);
+    RtlClearAllBits(&index->Verified);
+
+    status = BCryptOpenAlgorithmProvider(&index->AlgHandle,
+        BCRYPT_SHA256_ALGORITHM, NULL, 0);
+
+    if (NT_SUCCESS(status))
+    {
+        status = BCryptGetProperty(index->AlgHandle,
+            BCRYPT_OBJECT_LENGTH, (PUCHAR)&index->HashObjectLength,
+            sizeof(index->HashObjectLength), &result_length, 0);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        index->HashObject = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+            index->HashObjectLength, MP_TAG_GENERAL);
+
+        if (index->HashObject == NULL)
+        {
+            status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenMerkleIndex: Cannot initialize SHA-256 (%#x).\n",
+            status);
+
+        ImScsiFreeMerkleIndex(index);
+        return status;
+    }
+
+    status = ImScsiCheckMerkleRoot(index, header.Root);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenMerkleIndex: Leaf hashes in '%wZ' do not match root (%#x).\n",
+            &index_name, status);
+
+        ImScsiFreeMerkleIndex(index);
+        return status;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiOpenMerkleIndex: Checking %u chunks of %u bytes against '%wZ'.\n",
+        index->ChunkCount, 1UL << index->ChunkShift, &index_name));
+
+    pLUExt->MerkleIndex = index;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiCloseMerkleIndex(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_MERKLE_INDEX index = (PIMSCSI_MERKLE_INDEX)pLUExt->MerkleIndex;
+
+    if (index == NULL)
+    {
+        return;
+    }
+
+    pLUExt->MerkleIndex = NULL;
+
+    ImScsiFreeMerkleIndex(index);
+}
+
+NTSTATUS
+ImScsiVerifyReadData(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in PLARGE_INTEGER Offset,
+__in ULONG Length)
+{
+    PIMSCSI_MERKLE_INDEX index = (PIMSCSI_MERKLE_INDEX)pLUExt->MerkleIndex;
+    LONGLONG end_offset;
+    ULONG first_chunk;
+    ULONG last_chunk;
+
+    if ((index == NULL) || (Length == 0))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    end_offset = min(Offset->QuadPart + Length, index->ImageSize);
+
+    if (Offset->QuadPart >= end_offset)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    first_chunk = (ULONG)(Offset->QuadPart >> index->ChunkShift);
+    last_chunk = (ULONG)((end_offset - 1) >> index->ChunkShift);
+
+    for (ULONG chunk = first_chunk; chunk <= last_chunk; chunk++)
+    {
+        LARGE_INTEGER chunk_offset;
+        ULONG chunk_length;
+        LONGLONG copy_start;
+        LONGLONG copy_end;
+        UCHAR leaf[IMSCSI_MERKLE_HASH_SIZE];
+        UCHAR stored_leaf[IMSCSI_MERKLE_HASH_SIZE];
+        LARGE_INTEGER leaf_offset;
+        IO_STATUS_BLOCK io_status;
+        NTSTATUS status;
+
+        if (RtlCheckBit(&index->Verified, chunk))
+        {
+            continue;
+        }
+
+        chunk_offset.QuadPart = (LONGLONG)chunk << index->ChunkShift;
+        chunk_length = (ULONG)min(index->ImageSize - chunk_offset.QuadPart,
+            1LL << index->ChunkShift);
+
+        status = ImScsiReadDevice(pLUExt, index->ChunkBuffer, &chunk_offset,
+            &chunk_length);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = ImScsiMerkleHash(index, 0, index->ChunkBuffer, chunk_length,
+            NULL, 0, leaf);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        leaf_offset.QuadPart = IMSCSI_MERKLE_HEADER_SIZE +
+            (LONGLONG)chunk * IMSCSI_MERKLE_HASH_SIZE;
+
+        status = ZwReadFile(index->File, NULL, NULL, NULL, &io_status,
+            stored_leaf, sizeof(stored_leaf), &leaf_offset, NULL);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        // Data returned to read request must be the data that was checked.
+        copy_start = max(Offset->QuadPart, chunk_offset.QuadPart);
+        copy_end = min(end_offset, chunk_offset.QuadPart + chunk_length);
+
+        if ((io_status.Information != sizeof(stored_leaf)) ||
+            (RtlCompareMemory(leaf, stored_leaf, sizeof(leaf)) != sizeof(leaf)) ||
+            (RtlCompareMemory((PUCHAR)Buffer + (copy_start - Offset->QuadPart),
+            index->ChunkBuffer + (copy_start - chunk_offset.QuadPart),
+            (SIZE_T)(copy_end - copy_start)) != (SIZE_T)(copy_end - copy_start)))
+        {
+            DbgPrint("PhDskMnt::ImScsiVerifyReadData: Chunk %u at offset %#I64x does not match index.\n",
+                chunk, chunk_offset.QuadPart);
+
+            ImScsiLogError((pMPDrvInfoGlobal->pDriverObj,
+                0,
+                0,
+                NULL,
+                0,
+                1000,
+                STATUS_DATA_ERROR,
+                102,
+                STATUS_DATA_ERROR,
+                0,
+                0,
+                NULL,
+                L"Image data does not match Merkle index."));
+
+            return STATUS_DATA_ERROR;
+        }
+
+        RtlSetBit(&index->Verified, chunk);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+#else
+
+NTSTATUS
+ImScsiOpenMerkleIndex(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+
+    return STATUS_NOT_SUPPORTED;
+}
+
+VOID
+ImScsiCloseMerkleIndex(__in pHW_LU_EXTENSION pLUExt)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+}
+
+NTSTATUS
+ImScsiVerifyReadData(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in PLARGE_INTEGER Offset,
+__in ULONG Length)
+{
+    UNREFERENCED_PARAMETER(pLUExt);
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(Offset);
+    UNREFERENCED_PARAMETER(Length);
+
+    return STATUS_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,1203 @@
+/// odx.cpp
+/// Offloaded data transfer between LUs of this driver. Implements POPULATE
+/// TOKEN, WRITE USING TOKEN and RECEIVE ROD TOKEN INFORMATION, advertised
+/// through third-party copy VPD page.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#if _NT_TARGET_VERSION >= 0x600
+#include <bcrypt.h>
+#endif
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// POPULATE TOKEN only records block ranges of source LU in a copy operation
+// record kept by the adapter, together with a random ROD token that is
+// returned to the initiator through RECEIVE ROD TOKEN INFORMATION. Token
+// identifier bytes come from kernel CNG random number generator, so that
+// other initiators cannot guess tokens for data they could not read. No data
+// is read at that point. A token is invalidated by any write to its source
+// LU, tracked with WriteGeneration counter in LU extension, by removal of
+// source LU, or when it has not been used within its inactivity timeout.
+//
+// WRITE USING TOKEN is queued to destination LU worker thread, which reads
+// directly from source LU image file and writes through the same path as
+// WRITE. When both LUs are plain image files, the file system is first
+// asked to clone the blocks with FSCTL_DUPLICATE_EXTENTS_TO_FILE. Source
+// LU is referenced with CopyReferences while it is read, ImScsiCleanupLU
+// waits for that count to drop to zero before image file is closed.
+//
+// Source LU is read outside its own worker thread, so only back ends where
+// that is safe can be used as source: image files without write overlay,
+// split segments or Merkle index verification. POPULATE TOKEN on other LUs
+// fails, and Windows falls back to ordinary reads and writes.
+//
+// Proxy LUs where the service answers IMDPROXY_REQ_COPY can also be used
+// as source. Source proxy connection is never used, destination LU sends
+// IMDPROXY_REQ_COPY with source image identity on its own connection, so
+// the copy is done within the service. WRITE USING TOKEN fails if that
+// service cannot reach source image, or if destination is not such a
+// proxy LU.
+//
+
+#define IMSCSI_ROD_TOKEN_SIZE               512
+#define IMSCSI_ROD_TOKEN_LENGTH             (IMSCSI_ROD_TOKEN_SIZE - 8)
+
+// Point in time copy, change vulnerable.
+#define IMSCSI_ROD_TYPE_PIT_CHANGE_VULNERABLE   0x00800001UL
+
+#define IMSCSI_ODX_MAX_RANGES               64
+#define IMSCSI_ODX_MAX_OPERATIONS           64        // Records kept per adapter.
+#define IMSCSI_ODX_DEFAULT_TIMEOUT          30        // Seconds.
+#define IMSCSI_ODX_MAX_TIMEOUT              300
+#define IMSCSI_ODX_OPTIMAL_TRANSFER         (64UL << 20)
+#define IMSCSI_ODX_COPY_BUFFER_SIZE         (1UL << 20)
+
+#define IMSCSI_COPY_STATUS_SUCCESS          0x01
+#define IMSCSI_COPY_STATUS_ERROR            0x02
+
+#define IMSCSI_TRANSFER_COUNT_UNITS_BLOCKS  0xF1
+
+#define IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION  0x23
+#define IMSCSI_ADSENSQ_UNSUPPORTED_TOKEN_TYPE   0x01
+#define IMSCSI_ADSENSQ_TOKEN_UNKNOWN            0x04
+#define IMSCSI_ADSENSQ_TOKEN_REVOKED            0x06
+#define IMSCSI_ADSENSQ_TOKEN_EXPIRED            0x07
+
+#define IMSCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST 0x26
+#define IMSCSI_ADSENSE_TOO_MANY_SEGMENT_DESCRIPTORS 0x26
+#define IMSCSI_ADSENSQ_TOO_MANY_SEGMENT_DESCRIPTORS 0x08
+
+// Offsets in POPULATE TOKEN and WRITE USING TOKEN parameter lists.
+#define IMSCSI_POPULATE_TOKEN_INACTIVITY_TIMEOUT    4
+#define IMSCSI_POPULATE_TOKEN_RANGE_LIST_LENGTH     14
+#define IMSCSI_POPULATE_TOKEN_RANGES                16
+#define IMSCSI_WRITE_USING_TOKEN_OFFSET_INTO_ROD    8
+#define IMSCSI_WRITE_USING_TOKEN_TOKEN              16
+#define IMSCSI_WRITE_USING_TOKEN_RANGE_LIST_LENGTH  534
+#define IMSCSI_WRITE_USING_TOKEN_RANGES             536
+
+#define IMSCSI_RRTI_HEADER_SIZE             32
+
+typedef struct _IMSCSI_RANGE_DESCRIPTOR
+{
+    UCHAR LogicalBlockAddress[8];
+    UCHAR NumberOfLogicalBlocks[4];
+    UCHAR Reserved[4];
+} IMSCSI_RANGE_DESCRIPTOR, *PIMSCSI_RANGE_DESCRIPTOR;
+
+typedef struct _IMSCSI_COPY_RANGE
+{
+    LONGLONG StartingBlock;
+    ULONG Blocks;
+} IMSCSI_COPY_RANGE, *PIMSCSI_COPY_RANGE;
+
+typedef struct _IMSCSI_COPY_OPERATION
+{
+    LIST_ENTRY ListEntry;
+    DEVICE_NUMBER DeviceNumber;         // LU command was sent to.
+    ULONG ListIdentifier;
+    UCHAR ServiceAction;
+    UCHAR CopyStatus;
+    SENSE_DATA SenseData;               // Valid if CopyStatus is error.
+    ULONGLONG TransferCount;            // Blocks.
+    ULONGLONG Expires;                  // Interrupt time.
+    ULONGLONG Timeout;                  // Inactivity timeout, 100 ns units.
+
+    // Following fields only used for tokens created by POPULATE TOKEN.
+    pHW_LU_EXTENSION Source;            // Identity only, found again by DeviceNumber.
+    LONG SourceGeneration;
+    UCHAR BlockPower;
+    ULONG RangeCount;
+    UCHAR Token[IMSCSI_ROD_TOKEN_SIZE];
+    IMSCSI_COPY_RANGE Ranges[1];
+} IMSCSI_COPY_OPERATION, *PIMSCSI_COPY_OPERATION;
+
+static
+ULONG
+ImScsiGetBigEndianUlong(const UCHAR *Bytes)
+{
+    return RtlUlongByteSwap(*(UNALIGNED ULONG*)Bytes);
+}
+
+static
+BOOLEAN
+ImScsiCanCopyFromLU(
+    __in pHW_LU_EXTENSION pLUExt)
+{
+    if (pLUExt->UseProxy)
+    {
+        return pLUExt->ProxyCopy &&
+            (pLUExt->OverlayFile == NULL);
+    }
+
+    return (pLUExt->ImageFile != NULL) &&
+        (!pLUExt->VMDisk) &&
+        (!pLUExt->AWEAllocDisk) &&
+        (pLUExt->OverlayFile == NULL) &&
+        (pLUExt->Segments == NULL) &&
+        (pLUExt->MerkleIndex == NULL);
+}
+
+// Random number generator provider is opened with BCRYPT_PROV_DISPATCH,
+// POPULATE TOKEN can be called at DISPATCH_LEVEL. Without kernel CNG, or if
+// provider cannot be opened, POPULATE TOKEN is rejected.
+VOID
+ImScsiInitializeTokenRng()
+{
+#if _NT_TARGET_VERSION >= 0x600
+
+    BCRYPT_ALG_HANDLE alg_handle = NULL;
+
+    NTSTATUS status = BCryptOpenAlgorithmProvider(&alg_handle,
+        BCRYPT_RNG_ALGORITHM, NULL, BCRYPT_PROV_DISPATCH);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiInitializeTokenRng: Error opening RNG provider: %#x\n",
+            status);
+
+        return;
+    }
+
+    pMPDrvInfoGlobal->TokenRngHandle = alg_handle;
+
+#endif
+}
+
+VOID
+ImScsiFreeTokenRng()
+{
+#if _NT_TARGET_VERSION >= 0x600
+
+    if (pMPDrvInfoGlobal->TokenRngHandle != NULL)
+    {
+        BCryptCloseAlgorithmProvider(
+            (BCRYPT_ALG_HANDLE)pMPDrvInfoGlobal->TokenRngHandle, 0);
+
+        pMPDrvInfoGlobal->TokenRngHandle = NULL;
+    }
+
+#endif
+}
+
+static
+NTSTATUS
+ImScsiGenerateTokenIdentifier(
+    __out_bcount(Length) PUCHAR Buffer,
+    __in ULONG Length)
+{
+#if _NT_TARGET_VERSION >= 0x600
+
+    if (pMPDrvInfoGlobal->TokenRngHandle == NULL)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    return BCryptGenRandom(
+        (BCRYPT_ALG_HANDLE)pMPDrvInfoGlobal->TokenRngHandle,
+        Buffer, Length, 0);
+
+#else
+
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(Length);
+
+    return STATUS_NOT_SUPPORTED;
+
+#endif
+}
+
+VOID
+ImScsiInitializeCopyOperations(
+    __in pHW_HBA_EXT pHBAExt)
+{
+    KeInitializeSpinLock(&pHBAExt->CopyOperationLock);
+    InitializeListHead(&pHBAExt->CopyOperations);
+    pHBAExt->CopyOperationCount = 0;
+}
+
+VOID
+ImScsiFreeCopyOperations(
+    __in pHW_HBA_EXT pHBAExt,
+    __inout __deref PKIRQL LowestAssumedIrql)
+{
+    KLOCK_QUEUE_HANDLE lock_handle;
+
+    ImScsiAcquireLock(&pHBAExt->CopyOperationLock, &lock_handle, *LowestAssumedIrql);
+
+    while (!IsListEmpty(&pHBAExt->CopyOperations))
+    {
+        PIMSCSI_COPY_OPERATION operation = CONTAINING_RECORD(
+            RemoveHeadList(&pHBAExt->CopyOperations),
+            IMSCSI_COPY_OPERATION, ListEntry);
+
+        ExFreePoolWithTag(operation, MP_TAG_GENERAL);
+    }
+
+    pHBAExt->CopyOperationCount = 0;
+
+    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+}
+
+// Called with CopyOperationLock held. Removes expired records and makes
+// room for one new record.
+static
+VOID
+ImScsiPruneCopyOperations(
+    __in pHW_HBA_EXT pHBAExt,
+    __in ULONGLONG CurrentTime)
+{
+    PLIST_ENTRY entry = pHBAExt->CopyOperations.Flink;
+
+    while (entry != &pHBAExt->CopyOperations)
+    {
+        PIMSCSI_COPY_OPERATION operation =
+            CONTAINING_RECORD(entry, IMSCSI_COPY_OPERATION, ListEntry);
+
+        entry = entry->Flink;
+
+        if (operation->Expires <= CurrentTime)
+        {
+            RemoveEntryList(&operation->ListEntry);
+            pHBAExt->CopyOperationCount--;
+            ExFreePoolWithTag(operation, MP_TAG_GENERAL);
+        }
+    }
+
+    // Oldest records first in list
+    while (pHBAExt->CopyOperationCount >= IMSCSI_ODX_MAX_OPERATIONS)
+    {
+        PIMSCSI_COPY_OPERATION operation = CONTAINING_RECORD(
+            RemoveHeadList(&pHBAExt->CopyOperations),
+            IMSCSI_COPY_OPERATION, ListEntry);
+
+        pHBAExt->CopyOperationCount--;
+        ExFreePoolWithTag(operation, MP_TAG_GENERAL);
+    }
+}
+
+// Called with CopyOperationLock held.
+static
+PIMSCSI_COPY_OPERATION
+ImScsiFindCopyOperation(
+    __in pHW_HBA_EXT pHBAExt,
+    __in PDEVICE_NUMBER DeviceNumber,
+    __in ULONG ListIdentifier)
+{
+    for (PLIST_ENTRY entry = pHBAExt->CopyOperations.Flink;
+        entry != &pHBAExt->CopyOperations;
+        entry = entry->Flink)
+    {
+        PIMSCSI_COPY_OPERATION operation =
+            CONTAINING_RECORD(entry, IMSCSI_COPY_OPERATION, ListEntry);
+
+        if ((operation->DeviceNumber.LongNumber == DeviceNumber->LongNumber) &&
+            (operation->ListIdentifier == ListIdentifier))
+        {
+            return operation;
+        }
+    }
+
+    return NULL;
+}
+
+// Adds record, replacing any earlier record with same list identifier on
+// same LU.
+static
+VOID
+ImScsiInsertCopyOperation(
+    __in pHW_HBA_EXT pHBAExt,
+    __in PIMSCSI_COPY_OPERATION Operation,
+    __inout __deref PKIRQL LowestAssumedIrql)
+{
+    KLOCK_QUEUE_HANDLE lock_handle;
+    ULONGLONG current_time = KeQueryInterruptTime();
+
+    Operation->Expires = current_time + Operation->Timeout;
+
+    ImScsiAcquireLock(&pHBAExt->CopyOperationLock, &lock_handle, *LowestAssumedIrql);
+
+    PIMSCSI_COPY_OPERATION previous = ImScsiFindCopyOperation(pHBAExt,
+        &Operation->DeviceNumber, Operation->ListIdentifier);
+
+    if (previous != NULL)
+    {
+        RemoveEntryList(&previous->ListEntry);
+        pHBAExt->CopyOperationCount--;
+        ExFreePoolWithTag(previous, MP_TAG_GENERAL);
+    }
+
+    ImScsiPruneCopyOperations(pHBAExt, current_time);
+
+    InsertTailList(&pHBAExt->CopyOperations, &Operation->ListEntry);
+    pHBAExt->CopyOperationCount++;
+
+    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+}
+
+static
+VOID
+ScsiOpPopulateToken(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    PUCHAR list = (PUCHAR)pSrb->DataBuffer;
+    ULONG list_length = ImScsiGetBigEndianUlong(&pSrb->Cdb[10]);
+
+    if ((list_length > pSrb->DataTransferLength) ||
+        (list_length < IMSCSI_POPULATE_TOKEN_RANGES))
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    ULONG descr_length = RtlUshortByteSwap(
+        *(UNALIGNED USHORT*)&list[IMSCSI_POPULATE_TOKEN_RANGE_LIST_LENGTH]);
+
+    if ((descr_length == 0) ||
+        (descr_length + IMSCSI_POPULATE_TOKEN_RANGES > list_length))
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, IMSCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST, 0);
+        return;
+    }
+
+    ULONG range_count = descr_length / sizeof(IMSCSI_RANGE_DESCRIPTOR);
+
+    if (range_count > IMSCSI_ODX_MAX_RANGES)
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST,
+            IMSCSI_ADSENSE_TOO_MANY_SEGMENT_DESCRIPTORS, IMSCSI_ADSENSQ_TOO_MANY_SEGMENT_DESCRIPTORS);
+        return;
+    }
+
+    if (!ImScsiCanCopyFromLU(pLUExt))
+    {
+        KdPrint(("PhDskMnt::ScsiOpPopulateToken: Device type cannot be copy source.\n"));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST,
+            IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION, 0);
+        return;
+    }
+
+    if (pMPDrvInfoGlobal->TokenRngHandle == NULL)
+    {
+        KdPrint(("PhDskMnt::ScsiOpPopulateToken: No random number generator for tokens.\n"));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST,
+            IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION, 0);
+        return;
+    }
+
+    ULONG timeout = ImScsiGetBigEndianUlong(&list[IMSCSI_POPULATE_TOKEN_INACTIVITY_TIMEOUT]);
+
+    if (timeout == 0)
+    {
+        timeout = IMSCSI_ODX_DEFAULT_TIMEOUT;
+    }
+    else if (timeout > IMSCSI_ODX_MAX_TIMEOUT)
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, IMSCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST, 0);
+        return;
+    }
+
+    PIMSCSI_COPY_OPERATION operation = (PIMSCSI_COPY_OPERATION)
+        ExAllocatePoolWithTag(NonPagedPool,
+        FIELD_OFFSET(IMSCSI_COPY_OPERATION, Ranges) + range_count * sizeof(IMSCSI_COPY_RANGE),
+        MP_TAG_GENERAL);
+
+    if (operation == NULL)
+    {
+        DbgPrint("PhDskMnt::ScsiOpPopulateToken: Memory allocation failed.\n");
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
+        return;
+    }
+
+    RtlZeroMemory(operation, FIELD_OFFSET(IMSCSI_COPY_OPERATION, Ranges));
+
+    PIMSCSI_RANGE_DESCRIPTOR descriptors =
+        (PIMSCSI_RANGE_DESCRIPTOR)&list[IMSCSI_POPULATE_TOKEN_RANGES];
+
+    LONGLONG disk_blocks = pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower;
+    ULONGLONG total_blocks = 0;
+
+    for (ULONG i = 0; i < range_count; i++)
+    {
+        LONGLONG starting_block =
+            RtlUlonglongByteSwap(*(UNALIGNED ULONGLONG*)descriptors[i].LogicalBlockAddress);
+        ULONG blocks = ImScsiGetBigEndianUlong(descriptors[i].NumberOfLogicalBlocks);
+
+        if ((starting_block < 0) ||
+            (starting_block > disk_blocks) ||
+            (blocks > disk_blocks - starting_block))
+        {
+            KdPrint(("PhDskMnt::ScsiOpPopulateToken: Out of bounds: sector: %I64X, blocks: %u\n",
+                starting_block, blocks));
+
+            ExFreePoolWithTag(operation, MP_TAG_GENERAL);
+
+            ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
+            return;
+        }
+
+        operation->Ranges[i].StartingBlock = starting_block;
+        operation->Ranges[i].Blocks = blocks;
+
+        total_blocks += blocks;
+    }
+
+    operation->DeviceNumber = pLUExt->DeviceNumber;
+    operation->ListIdentifier = ImScsiGetBigEndianUlong(&pSrb->Cdb[6]);
+    operation->ServiceAction = SERVICE_ACTION_POPULATE_TOKEN;
+    operation->CopyStatus = IMSCSI_COPY_STATUS_SUCCESS;
+    operation->TransferCount = total_blocks;
+    operation->Timeout = (ULONGLONG)timeout * 10000000;
+    operation->Source = pLUExt;
+    operation->SourceGeneration = pLUExt->WriteGeneration;
+    operation->BlockPower = pLUExt->BlockPower;
+    operation->RangeCount = range_count;
+
+    // ROD TYPE, ROD TOKEN LENGTH, then random token identifier
+    *(UNALIGNED ULONG*)&operation->Token[0] =
+        RtlUlongByteSwap(IMSCSI_ROD_TYPE_PIT_CHANGE_VULNERABLE);
+    *(UNALIGNED USHORT*)&operation->Token[4] =
+        RtlUshortByteSwap(IMSCSI_ROD_TOKEN_LENGTH);
+
+    NTSTATUS status = ImScsiGenerateTokenIdentifier(&operation->Token[8], 32);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ScsiOpPopulateToken: Random token generation failed: %#x\n",
+            status);
+
+        ExFreePoolWithTag(operation, MP_TAG_GENERAL);
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
+        return;
+    }
+
+    *(UNALIGNED ULONG*)&operation->Token[40] =
+        pLUExt->DeviceNumber.LongNumber;
+
+    KdPrint2(("PhDskMnt::ScsiOpPopulateToken: %u ranges, %I64u blocks.\n",
+        range_count, total_blocks));
+
+    ImScsiInsertCopyOperation(pHBAExt, operation, LowestAssumedIrql);
+
+    ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+}
+
+VOID
+ScsiOpTokenOperation(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PUCHAR               pResult,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    UCHAR service_action = pSrb->Cdb[1] & 0x1F;
+
+    KdPrint2(("PhDskMnt::ScsiOpTokenOperation:  pHBAExt = 0x%p, pSrb=0x%p, Action=0x%X\n",
+        pHBAExt, pSrb, (int)service_action));
+
+    // Check device shutdown condition
+    if (KeReadStateEvent(&pLUExt->StopThread))
+    {
+        KdPrint(("PhDskMnt::ScsiOpTokenOperation: Rejected. Device shutting down.\n"));
+
+        ScsiSetError(pSrb, SRB_STATUS_NO_DEVICE);
+
+        return;
+    }
+
+    if (service_action == SERVICE_ACTION_POPULATE_TOKEN)
+    {
+        ScsiOpPopulateToken(pHBAExt, pLUExt, pSrb, LowestAssumedIrql);
+        return;
+    }
+
+    if (service_action != SERVICE_ACTION_WRITE_USING_TOKEN)
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    // Check write protection
+    if (pLUExt->ReadOnly)
+    {
+        KdPrint(("PhDskMnt::ScsiOpTokenOperation: Rejected. Write attempt on read-only device.\n"));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_DATA_PROTECT, SCSI_ADSENSE_WRITE_PROTECT, 0);
+
+        return;
+    }
+
+    ULONG list_length = ImScsiGetBigEndianUlong(&pSrb->Cdb[10]);
+
+    if ((list_length > pSrb->DataTransferLength) ||
+        (list_length < IMSCSI_WRITE_USING_TOKEN_RANGES))
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    // Tokens of this LU are no longer valid
+    InterlockedIncrement(&pLUExt->WriteGeneration);
+
+    // Queue work item, which will run in the System process.
+    ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+
+    KdPrint2(("PhDskMnt::ScsiOpTokenOperation:  End. *Result=%i\n", (INT)*pResult));
+}
+
+VOID
+ScsiOpReceiveRodTokenInformation(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    PUCHAR response = (PUCHAR)pSrb->DataBuffer;
+    ULONG allocation_length = ImScsiGetBigEndianUlong(&pSrb->Cdb[10]);
+    ULONG list_identifier = ImScsiGetBigEndianUlong(&pSrb->Cdb[2]);
+    KLOCK_QUEUE_HANDLE lock_handle;
+
+    KdPrint2(("PhDskMnt::ScsiOpReceiveRodTokenInformation:  pHBAExt = 0x%p, pSrb=0x%p, List=0x%X\n",
+        pHBAExt, pSrb, list_identifier));
+
+    if ((pSrb->Cdb[1] & 0x1F) != SERVICE_ACTION_RECEIVE_TOKEN_INFORMATION)
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    allocation_length = min(allocation_length, pSrb->DataTransferLength);
+
+    ImScsiAcquireLock(&pHBAExt->CopyOperationLock, &lock_handle, *LowestAssumedIrql);
+
+    PIMSCSI_COPY_OPERATION operation = ImScsiFindCopyOperation(pHBAExt,
+        &pLUExt->DeviceNumber, list_identifier);
+
+    if (operation == NULL)
+    {
+        ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+
+        KdPrint(("PhDskMnt::ScsiOpReceiveRodTokenInformation: Unknown list identifier 0x%X.\n",
+            list_identifier));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    UCHAR header[IMSCSI_RRTI_HEADER_SIZE] = { 0 };
+    ULONG sense_length = 0;
+    ULONG token_length = 0;
+
+    if (operation->CopyStatus != IMSCSI_COPY_STATUS_SUCCESS)
+    {
+        sense_length = sizeof(SENSE_DATA);
+    }
+    else if (operation->ServiceAction == SERVICE_ACTION_POPULATE_TOKEN)
+    {
+        token_length = 2 + IMSCSI_ROD_TOKEN_SIZE;
+    }
+
+    ULONG total_length = IMSCSI_RRTI_HEADER_SIZE + sense_length + 4 + token_length;
+
+    *(UNALIGNED ULONG*)&header[0] = RtlUlongByteSwap(total_length - 4);
+    header[4] = operation->ServiceAction;
+    header[5] = operation->CopyStatus;
+    header[12] = sense_length != 0 ? SCSISTAT_CHECK_CONDITION : SCSISTAT_GOOD;
+    header[13] = (UCHAR)sense_length;
+    header[14] = (UCHAR)sense_length;
+    header[15] = IMSCSI_TRANSFER_COUNT_UNITS_BLOCKS;
+    *(UNALIGNED ULONGLONG*)&header[16] = RtlUlonglongByteSwap(operation->TransferCount);
+
+    RtlZeroMemory(response, allocation_length);
+
+    ULONG offset = min(allocation_length, IMSCSI_RRTI_HEADER_SIZE);
+
+    RtlCopyMemory(response, header, offset);
+
+    if (sense_length > 0)
+    {
+        ULONG length = min(allocation_length - offset, sense_length);
+
+        RtlCopyMemory(response + offset, &operation->SenseData, length);
+
+        offset += length;
+    }
+
+    if (allocation_length >= offset + 4)
+    {
+        *(UNALIGNED ULONG*)&response[offset] = RtlUlongByteSwap(token_length);
+
+        offset += 4;
+
+        // Two reserved bytes before token
+        if ((token_length > 0) && (allocation_length > offset + 2))
+        {
+            ULONG length = min(allocation_length - offset - 2, IMSCSI_ROD_TOKEN_SIZE);
+
+            RtlCopyMemory(response + offset + 2, operation->Token, length);
+
+            offset += 2 + length;
+        }
+    }
+    else
+    {
+        offset = allocation_length;
+    }
+
+    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+
+    ScsiSetSuccess(pSrb, offset);
+}
+
+VOID
+ScsiOpVPDThirdPartyCopy(
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb
+    )
+{
+    // Header, block device ROD token limits descriptor and supported
+    // commands descriptor.
+    const ULONG limits_length = 4 + 0x20;
+    const ULONG commands_length = 4 + 8;
+    const ULONG len = 4 + limits_length + commands_length;
+
+    PUCHAR page = (PUCHAR)pSrb->DataBuffer;
+
+    if (pSrb->DataTransferLength < len)
+    {
+        ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+        return;
+    }
+
+    RtlZeroMemory(page, len);
+
+    page[1] = VPD_THIRD_PARTY_COPY;
+    *(UNALIGNED USHORT*)&page[2] = RtlUshortByteSwap((USHORT)(len - 4));
+
+    PUCHAR limits = page + 4;
+    USHORT max_ranges = IMSCSI_ODX_MAX_RANGES;
+    ULONG max_timeout = IMSCSI_ODX_MAX_TIMEOUT;
+    ULONG default_timeout = IMSCSI_ODX_DEFAULT_TIMEOUT;
+    ULONGLONG max_token_transfer = (ULONGLONG)IMSCSI_ODX_MAX_RANGES * MAXULONG;
+    ULONGLONG optimal_transfer = IMSCSI_ODX_OPTIMAL_TRANSFER >> pLUExt->BlockPower;
+
+    // Descriptor type 0x0000, block device ROD token limits
+    limits[3] = 0x20;
+    REVERSE_BYTES_SHORT(&limits[10], &max_ranges);
+    REVERSE_BYTES(&limits[12], &max_timeout);
+    REVERSE_BYTES(&limits[16], &default_timeout);
+    REVERSE_BYTES_QUAD(&limits[20], &max_token_transfer);
+    REVERSE_BYTES_QUAD(&limits[28], &optimal_transfer);
+
+    // Descriptor type 0x0001, supported commands with service actions
+    PUCHAR commands = limits + limits_length;
+
+    commands[1] = 0x01;
+    commands[3] = 0x08;
+    commands[4] = 7;
+    commands[5] = SCSIOP_POPULATE_TOKEN;
+    commands[6] = 2;
+    commands[7] = SERVICE_ACTION_POPULATE_TOKEN;
+    commands[8] = SERVICE_ACTION_WRITE_USING_TOKEN;
+    commands[9] = SCSIOP_RECEIVE_ROD_TOKEN_INFORMATION;
+    commands[10] = 1;
+    commands[11] = SERVICE_ACTION_RECEIVE_TOKEN_INFORMATION;
+
+    ScsiSetSuccess(pSrb, len);
+}
+
+// Asks file system to share clusters of source image file with
+// destination image file. Fails if file system does not support block
+// cloning or if offsets are not cluster aligned.
+static
+NTSTATUS
+ImScsiDuplicateExtents(
+    __in pHW_LU_EXTENSION pSourceLUExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in LONGLONG SourceOffset,
+    __in LONGLONG Offset,
+    __in LONGLONG Length)
+{
+#ifdef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+
+    IO_STATUS_BLOCK io_status;
+    DUPLICATE_EXTENTS_DATA data;
+
+    data.FileHandle = pSourceLUExt->ImageFile;
+    data.SourceFileOffset.QuadPart = SourceOffset + pSourceLUExt->ImageOffset.QuadPart;
+    data.TargetFileOffset.QuadPart = Offset + pLUExt->ImageOffset.QuadPart;
+    data.ByteCount.QuadPart = Length;
+
+    NTSTATUS status = ZwFsControlFile(
+        pLUExt->ImageFile,
+        NULL,
+        NULL,
+        NULL,
+        &io_status,
+        FSCTL_DUPLICATE_EXTENTS_TO_FILE,
+        &data,
+        sizeof(data),
+        NULL,
+        0);
+
+    if ((status == STATUS_INVALID_DEVICE_REQUEST) ||
+        (status == STATUS_NOT_SUPPORTED) ||
+        (status == STATUS_NOT_SAME_DEVICE))
+    {
+        KdPrint(("PhDskMnt::ImScsiDuplicateExtents: Block cloning not supported: %#x\n", status));
+
+        pLUExt->NoDuplicateExtents = TRUE;
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        pLUExt->Modified = TRUE;
+
+        ImScsiInvalidateCache(pLUExt,
+            data.TargetFileOffset.QuadPart, Length);
+    }
+
+    return status;
+
+#else
+
+    UNREFERENCED_PARAMETER(pSourceLUExt);
+    UNREFERENCED_PARAMETER(SourceOffset);
+    UNREFERENCED_PARAMETER(Offset);
+    UNREFERENCED_PARAMETER(Length);
+
+    pLUExt->NoDuplicateExtents = TRUE;
+
+    return STATUS_NOT_SUPPORTED;
+
+#endif
+}
+
+static
+NTSTATUS
+ImScsiCopyBlocks(
+    __in pHW_LU_EXTENSION pSourceLUExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __inout __deref PUCHAR *Buffer,
+    __in LONGLONG SourceBlock,
+    __in LONGLONG Block,
+    __in ULONG Blocks)
+{
+    LONGLONG source_offset = SourceBlock << pLUExt->BlockPower;
+    LONGLONG offset = Block << pLUExt->BlockPower;
+    LONGLONG end = offset + ((LONGLONG)Blocks << pLUExt->BlockPower);
+    NTSTATUS status;
+
+    if (pSourceLUExt->UseProxy)
+    {
+        IO_STATUS_BLOCK io_status;
+
+        if (!pLUExt->ProxyCopy)
+        {
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        pLUExt->Modified = TRUE;
+
+        status = ImScsiCopyProxy(&pLUExt->Proxy,
+            &io_status,
+            &pLUExt->StopThread,
+            pSourceLUExt->ProxyIdentity,
+            source_offset + pSourceLUExt->ImageOffset.QuadPart,
+            offset + pLUExt->ImageOffset.QuadPart,
+            end - offset);
+
+        ImScsiInvalidateProxyCache(pLUExt,
+            offset + pLUExt->ImageOffset.QuadPart, end - offset);
+
+        return status;
+    }
+
+    if ((!pLUExt->NoDuplicateExtents) &&
+        (!pLUExt->UseProxy) &&
+        ImScsiCanCopyFromLU(pLUExt) &&
+        NT_SUCCESS(ImScsiDuplicateExtents(pSourceLUExt, pLUExt,
+            source_offset, offset, end - offset)))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    if (*Buffer == NULL)
+    {
+        *Buffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+            IMSCSI_ODX_COPY_BUFFER_SIZE, MP_TAG_GENERAL);
+
+        if (*Buffer == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    while (offset < end)
+    {
+        LARGE_INTEGER chunk_offset;
+        ULONG chunk = (ULONG)min(end - offset, IMSCSI_ODX_COPY_BUFFER_SIZE);
+        ULONG length = chunk;
+
+        chunk_offset.QuadPart = source_offset;
+
+        status = ImScsiReadDevice(pSourceLUExt, *Buffer, &chunk_offset, &length);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        if (length < chunk)
+        {
+            RtlZeroMemory(*Buffer + length, chunk - length);
+        }
+
+        chunk_offset.QuadPart = offset;
+
+        if (pLUExt->OverlayFile != NULL)
+            status = ImScsiWriteOverlay(pLUExt, *Buffer, &chunk_offset, &chunk);
+        else
+            status = ImScsiWriteDevice(pLUExt, *Buffer, &chunk_offset, &chunk);
+
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        source_offset += chunk;
+        offset += chunk;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiWriteUsingToken(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    PUCHAR list = NULL;
+    PIMSCSI_COPY_OPERATION operation = NULL;
+    pHW_LU_EXTENSION source = NULL;
+    PUCHAR buffer = NULL;
+    UCHAR sense_key = SCSI_SENSE_NO_SENSE;
+    UCHAR adsense = 0;
+    UCHAR adsensq = 0;
+    ULONGLONG transfer_count = 0;
+    LONGLONG disk_blocks = pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower;
+    KLOCK_QUEUE_HANDLE lock_handle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    ULONG storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, (PVOID*)&list);
+
+    if ((storage_status != STORAGE_STATUS_SUCCESS) | (list == NULL))
+    {
+        DbgPrint("PhDskMnt::ImScsiWriteUsingToken: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
+            storage_status,
+            pSrb->DataBuffer,
+            list);
+
+        ScsiSetError(pSrb, SRB_STATUS_ERROR);
+        return;
+    }
+
+    ULONG list_length = ImScsiGetBigEndianUlong(&pSrb->Cdb[10]);
+
+    ULONG descr_length = RtlUshortByteSwap(
+        *(UNALIGNED USHORT*)&list[IMSCSI_WRITE_USING_TOKEN_RANGE_LIST_LENGTH]);
+
+    ULONG range_count = descr_length / sizeof(IMSCSI_RANGE_DESCRIPTOR);
+
+    ULONGLONG offset_into_rod = RtlUlonglongByteSwap(
+        *(UNALIGNED ULONGLONG*)&list[IMSCSI_WRITE_USING_TOKEN_OFFSET_INTO_ROD]);
+
+    PIMSCSI_RANGE_DESCRIPTOR descriptors =
+        (PIMSCSI_RANGE_DESCRIPTOR)&list[IMSCSI_WRITE_USING_TOKEN_RANGES];
+
+    if ((descr_length == 0) ||
+        (descr_length + IMSCSI_WRITE_USING_TOKEN_RANGES > list_length))
+    {
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST;
+        goto done;
+    }
+
+    if (range_count > IMSCSI_ODX_MAX_RANGES)
+    {
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_TOO_MANY_SEGMENT_DESCRIPTORS;
+        adsensq = IMSCSI_ADSENSQ_TOO_MANY_SEGMENT_DESCRIPTORS;
+        goto done;
+    }
+
+    for (ULONG i = 0; i < range_count; i++)
+    {
+        LONGLONG starting_block =
+            RtlUlonglongByteSwap(*(UNALIGNED ULONGLONG*)descriptors[i].LogicalBlockAddress);
+        ULONG blocks = ImScsiGetBigEndianUlong(descriptors[i].NumberOfLogicalBlocks);
+
+        if ((starting_block < 0) ||
+            (starting_block > disk_blocks) ||
+            (blocks > disk_blocks - starting_block))
+        {
+            sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+            adsense = SCSI_ADSENSE_ILLEGAL_BLOCK;
+            goto done;
+        }
+    }
+
+    // Take a copy of token record, it could be removed by other requests
+    // while data is copied.
+    ImScsiAcquireLock(&pHBAExt->CopyOperationLock, &lock_handle, lowest_assumed_irql);
+
+    for (PLIST_ENTRY entry = pHBAExt->CopyOperations.Flink;
+        entry != &pHBAExt->CopyOperations;
+        entry = entry->Flink)
+    {
+        PIMSCSI_COPY_OPERATION token =
+            CONTAINING_RECORD(entry, IMSCSI_COPY_OPERATION, ListEntry);
+
+        if ((token->ServiceAction != SERVICE_ACTION_POPULATE_TOKEN) ||
+            (RtlCompareMemory(token->Token, &list[IMSCSI_WRITE_USING_TOKEN_TOKEN],
+                IMSCSI_ROD_TOKEN_SIZE) != IMSCSI_ROD_TOKEN_SIZE))
+        {
+            continue;
+        }
+
+        ULONGLONG current_time = KeQueryInterruptTime();
+
+        if (token->Expires <= current_time)
+        {
+            adsensq = IMSCSI_ADSENSQ_TOKEN_EXPIRED;
+            break;
+        }
+
+        token->Expires = current_time + token->Timeout;
+
+        SIZE_T size = FIELD_OFFSET(IMSCSI_COPY_OPERATION, Ranges) +
+            token->RangeCount * sizeof(IMSCSI_COPY_RANGE);
+
+        operation = (PIMSCSI_COPY_OPERATION)
+            ExAllocatePoolWithTag(NonPagedPool, size, MP_TAG_GENERAL);
+
+        if (operation != NULL)
+        {
+            RtlCopyMemory(operation, token, size);
+        }
+
+        break;
+    }
+
+    ImScsiReleaseLock(&lock_handle, &lowest_assumed_irql);
+
+    if (operation == NULL)
+    {
+        KdPrint(("PhDskMnt::ImScsiWriteUsingToken: Token not found.\n"));
+
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION;
+        if (adsensq == 0)
+        {
+            adsensq = IMSCSI_ADSENSQ_TOKEN_UNKNOWN;
+        }
+        goto done;
+    }
+
+    // Find and reference source LU. Raised to DISPATCH_LEVEL so that LU
+    // cannot be freed between lookup and reference, see
+    // ImScsiWaitForLULookups.
+    {
+        KIRQL old_irql;
+        KIRQL lookup_irql = DISPATCH_LEVEL;
+
+        KeRaiseIrql(DISPATCH_LEVEL, &old_irql);
+
+        ScsiGetLUExtension(pHBAExt, &source,
+            operation->DeviceNumber.PathId,
+            operation->DeviceNumber.TargetId,
+            operation->DeviceNumber.Lun,
+            &lookup_irql);
+
+        if (source != operation->Source)
+        {
+            source = NULL;
+        }
+        else
+        {
+            InterlockedIncrement(&source->CopyReferences);
+
+            if (KeReadStateEvent(&source->StopThread))
+            {
+                InterlockedDecrement(&source->CopyReferences);
+                source = NULL;
+            }
+        }
+
+        KeLowerIrql(old_irql);
+    }
+
+    if ((source == NULL) ||
+        (source->WriteGeneration != operation->SourceGeneration))
+    {
+        KdPrint(("PhDskMnt::ImScsiWriteUsingToken: Source device removed or modified.\n"));
+
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION;
+        adsensq = IMSCSI_ADSENSQ_TOKEN_REVOKED;
+        goto done;
+    }
+
+    if (operation->BlockPower != pLUExt->BlockPower)
+    {
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION;
+        adsensq = IMSCSI_ADSENSQ_UNSUPPORTED_TOKEN_TYPE;
+        goto done;
+    }
+
+    // Last read or written data could be within range
+    ImScsiDropLastIoBuffer(pLUExt, &lowest_assumed_irql);
+
+    {
+        ULONG source_range = 0;
+        ULONGLONG source_position = offset_into_rod;
+
+        for (ULONG i = 0; i < range_count; i++)
+        {
+            LONGLONG block =
+                RtlUlonglongByteSwap(*(UNALIGNED ULONGLONG*)descriptors[i].LogicalBlockAddress);
+            ULONG blocks = ImScsiGetBigEndianUlong(descriptors[i].NumberOfLogicalBlocks);
+
+            while (blocks > 0)
+            {
+                // Skip to range in token where next data is
+                while ((source_range < operation->RangeCount) &&
+                    (source_position >= operation->Ranges[source_range].Blocks))
+                {
+                    source_position -= operation->Ranges[source_range].Blocks;
+                    source_range++;
+                }
+
+                if (source_range >= operation->RangeCount)
+                {
+                    break;
+                }
+
+                ULONG piece = (ULONG)min(blocks,
+                    operation->Ranges[source_range].Blocks - source_position);
+
+                NTSTATUS status = ImScsiCopyBlocks(source, pLUExt, &buffer,
+                    operation->Ranges[source_range].StartingBlock + (LONGLONG)source_position,
+                    block, piece);
+
+                if (!NT_SUCCESS(status))
+                {
+                    KdPrint(("PhDskMnt::ImScsiWriteUsingToken: Copy failed: %#x\n", status));
+
+                    sense_key = SCSI_SENSE_MEDIUM_ERROR;
+                    adsense = SCSI_ADSENSE_WRITE_ERROR;
+                    goto done;
+                }
+
+                transfer_count += piece;
+                source_position += piece;
+                block += piece;
+                blocks -= piece;
+            }
+        }
+    }
+
+    // Source was written while data was copied, result is not a point in
+    // time copy.
+    if (source->WriteGeneration != operation->SourceGeneration)
+    {
+        sense_key = SCSI_SENSE_ILLEGAL_REQUEST;
+        adsense = IMSCSI_ADSENSE_INVALID_TOKEN_OPERATION;
+        adsensq = IMSCSI_ADSENSQ_TOKEN_REVOKED;
+    }
+
+done:
+
+    if (source != NULL)
+    {
+        InterlockedDecrement(&source->CopyReferences);
+    }
+
+    if (buffer != NULL)
+    {
+        ExFreePoolWithTag(buffer, MP_TAG_GENERAL);
+    }
+
+    KdPrint2(("PhDskMnt::ImScsiWriteUsingToken: %I64u blocks, sense %#x/%#x/%#x\n",
+        transfer_count, (int)sense_key, (int)adsense, (int)adsensq));
+
+    // Record result for RECEIVE ROD TOKEN INFORMATION, reusing token copy
+    // when there is one.
+    if (operation == NULL)
+    {
+        operation = (PIMSCSI_COPY_OPERATION)ExAllocatePoolWithTag(NonPagedPool,
+            sizeof(IMSCSI_COPY_OPERATION), MP_TAG_GENERAL);
+    }
+
+    if (operation != NULL)
+    {
+        RtlZeroMemory(operation, FIELD_OFFSET(IMSCSI_COPY_OPERATION, Source));
+
+        operation->DeviceNumber = pLUExt->DeviceNumber;
+        operation->ListIdentifier = ImScsiGetBigEndianUlong(&pSrb->Cdb[6]);
+        operation->ServiceAction = SERVICE_ACTION_WRITE_USING_TOKEN;
+        operation->TransferCount = transfer_count;
+        operation->Timeout = (ULONGLONG)IMSCSI_ODX_DEFAULT_TIMEOUT * 10000000;
+        operation->Source = NULL;
+        operation->RangeCount = 0;
+
+        if (sense_key == SCSI_SENSE_NO_SENSE)
+        {
+            operation->CopyStatus = IMSCSI_COPY_STATUS_SUCCESS;
+        }
+        else
+        {
+            operation->CopyStatus = IMSCSI_COPY_STATUS_ERROR;
+            operation->SenseData.ErrorCode = 0x70;    // Fixed format, current error
+            operation->SenseData.SenseKey = sense_key;
+            operation->SenseData.AdditionalSenseLength =
+                sizeof(SENSE_DATA) - FIELD_OFFSET(SENSE_DATA, CommandSpecificInformation);
+            operation->SenseData.AdditionalSenseCode = adsense;
+            operation->SenseData.AdditionalSenseCodeQualifier = adsensq;
+        }
+
+        ImScsiInsertCopyOperation(pHBAExt, operation, &lowest_assumed_irql);
+    }
+
+    if (sense_key != SCSI_SENSE_NO_SENSE)
+    {
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, sense_key, adsense, adsensq);
+        return;
+    }
+
+    ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+}
@@ -0,0 +1,823 @@
+/// overlay.cpp
+/// Copy-on-write write overlay for file and proxy type virtual disks. Image
+/// file or proxy is never written to, all writes go to a differencing file
+/// that can later be discarded or committed to the image.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Differencing file layout:
+//
+// 0                          IMSCSI_OVERLAY_HEADER, padded to
+//                            IMSCSI_OVERLAY_PAGE_SIZE bytes.
+// IMSCSI_OVERLAY_PAGE_SIZE   Block bitmap, one bit per block, padded to a
+//                            multiple of IMSCSI_OVERLAY_PAGE_SIZE bytes.
+// DataOffset                 Block N is stored at DataOffset + N *
+//                            IMSCSI_OVERLAY_BLOCK_SIZE. File is sparse, so
+//                            blocks never written use no disk space.
+//
+// The whole bitmap is kept in memory, so finding where a block is stored is
+// a single bit test. Block data is always written to the differencing file
+// before the bitmap page that marks the block as present.
+//
+
+#define IMSCSI_OVERLAY_SIGNATURE        "AIMDELTA"
+#define IMSCSI_OVERLAY_VERSION          1
+
+typedef struct _IMSCSI_OVERLAY_HEADER
+{
+    UCHAR       Signature[8];
+    ULONG       Version;
+    ULONG       BlockShift;
+    LONGLONG    DiskSize;
+    LONGLONG    BitmapOffset;
+    LONGLONG    DataOffset;
+} IMSCSI_OVERLAY_HEADER, *PIMSCSI_OVERLAY_HEADER;
+
+FORCEINLINE
+BOOLEAN
+ImScsiIsOverlayBlockPresent(__in pHW_LU_EXTENSION pLUExt,
+__in ULONG Block)
+{
+    return (BOOLEAN)((Block < pLUExt->OverlayBlocks.SizeOfBitMap) &&
+        RtlCheckBit(&pLUExt->OverlayBlocks, Block));
+}
+
+//
+// Writes bitmap pages covering a range of blocks to differencing file.
+//
+NTSTATUS
+ImScsiWriteOverlayBitmap(__in pHW_LU_EXTENSION pLUExt,
+__in ULONG FirstBlock,
+__in ULONG NumberOfBlocks)
+{
+    const ULONG bits_per_page = IMSCSI_OVERLAY_PAGE_SIZE << 3;
+    ULONG first_page = FirstBlock / bits_per_page;
+    ULONG last_page = (FirstBlock + NumberOfBlocks - 1) / bits_per_page;
+    IO_STATUS_BLOCK io_status;
+    LARGE_INTEGER offset;
+
+    offset.QuadPart = IMSCSI_OVERLAY_PAGE_SIZE +
+        ((LONGLONG)first_page * IMSCSI_OVERLAY_PAGE_SIZE);
+
+    return ZwWriteFile(pLUExt->OverlayFile,
+        NULL,
+        NULL,
+        NULL,
+        &io_status,
+        (PUCHAR)pLUExt->OverlayBlocks.Buffer +
+        ((SIZE_T)first_page * IMSCSI_OVERLAY_PAGE_SIZE),
+        (last_page - first_page + 1) * IMSCSI_OVERLAY_PAGE_SIZE,
+        &offset,
+        NULL);
+}
+
+//
+// Reads one block from image, zero-filled beyond end of disk.
+//
+NTSTATUS
+ImScsiReadOverlayBaseBlock(__in pHW_LU_EXTENSION pLUExt,
+__in ULONG Block,
+__out PUCHAR Buffer)
+{
+    NTSTATUS status;
+    LARGE_INTEGER offset;
+    ULONG length = IMSCSI_OVERLAY_BLOCK_SIZE;
+
+    offset.QuadPart = (LONGLONG)Block << IMSCSI_OVERLAY_BLOCK_SHIFT;
+
+    if (pLUExt->DiskSize.QuadPart - offset.QuadPart < (LONGLONG)length)
+        length = (ULONG)(pLUExt->DiskSize.QuadPart - offset.QuadPart);
+
+    status = ImScsiReadDevice(pLUExt, Buffer, &offset, &length);
+
+    if (NT_SUCCESS(status) && (length < IMSCSI_OVERLAY_BLOCK_SIZE))
+        RtlZeroMemory(Buffer + length, IMSCSI_OVERLAY_BLOCK_SIZE - length);
+
+    return status;
+}
+
+NTSTATUS
+ImScsiOpenWriteOverlay(
+__in pHW_LU_EXTENSION pLUExt,
+__in PUNICODE_STRING  OverlayName)
+{
+    NTSTATUS status;
+    OBJECT_ATTRIBUTES object_attributes;
+    IO_STATUS_BLOCK io_status;
+    HANDLE file_handle = NULL;
+    ULONGLONG blocks;
+    ULONG bitmap_size;
+    LONGLONG data_offset;
+    PULONG bitmap_buffer = NULL;
+    PUCHAR block_buffer = NULL;
+    PWCHAR name_buffer = NULL;
+    WPoolMem<IMSCSI_OVERLAY_HEADER, PagedPool> header(IMSCSI_OVERLAY_PAGE_SIZE);
+
+    blocks = ((ULONGLONG)pLUExt->DiskSize.QuadPart +
+        IMSCSI_OVERLAY_BLOCK_SIZE - 1) >> IMSCSI_OVERLAY_BLOCK_SHIFT;
+
+    if (blocks > MAXLONG)
+    {
+        KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: Disk too large for write overlay.\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    bitmap_size = ((((ULONG)blocks + 7) >> 3) + IMSCSI_OVERLAY_PAGE_SIZE - 1) &
+        ~(IMSCSI_OVERLAY_PAGE_SIZE - 1);
+
+    data_offset = ((LONGLONG)IMSCSI_OVERLAY_PAGE_SIZE + bitmap_size +
+        IMSCSI_OVERLAY_BLOCK_SIZE - 1) & ~(LONGLONG)(IMSCSI_OVERLAY_BLOCK_SIZE - 1);
+
+    bitmap_buffer = (PULONG)ExAllocatePoolWithTag(PagedPool,
+        bitmap_size, MP_TAG_GENERAL);
+
+    block_buffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+        IMSCSI_OVERLAY_BLOCK_SIZE, MP_TAG_GENERAL);
+
+    name_buffer = (PWCHAR)ExAllocatePoolWithTag(NonPagedPool,
+        OverlayName->Length, MP_TAG_GENERAL);
+
+    if ((bitmap_buffer == NULL) || (block_buffer == NULL) ||
+        (name_buffer == NULL) || (!header))
+    {
+        status = STATUS_INSUFFICIENT_RESOURCES;
+        goto error;
+    }
+
+    RtlZeroMemory(bitmap_buffer, bitmap_size);
+    RtlZeroMemory(header, IMSCSI_OVERLAY_PAGE_SIZE);
+
+    InitializeObjectAttributes(&object_attributes,
+        OverlayName,
+        OBJ_CASE_INSENSITIVE |
+        OBJ_FORCE_ACCESS_CHECK,
+        NULL,
+        NULL);
+
+    status = ZwCreateFile(
+        &file_handle,
+        GENERIC_READ | GENERIC_WRITE,
+        &object_attributes,
+        &io_status,
+        NULL,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        FILE_OPEN_IF,
+        FILE_NON_DIRECTORY_FILE |
+        (pLUExt->Core.WriteBack ? 0 : FILE_WRITE_THROUGH) |
+        FILE_RANDOM_ACCESS |
+        FILE_SYNCHRONOUS_IO_NONALERT,
+        NULL,
+        0);
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: Cannot open '%wZ' (%#x).\n",
+            OverlayName, status));
+
+        file_handle = NULL;
+        goto error;
+    }
+
+    if (io_status.Information == FILE_CREATED)
+    {
+        FILE_END_OF_FILE_INFORMATION new_size;
+        LARGE_INTEGER offset = { 0 };
+
+        KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: Creating differencing file '%wZ'.\n",
+            OverlayName));
+
+        status = ZwFsControlFile(
+            file_handle,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            FSCTL_SET_SPARSE,
+            NULL,
+            0,
+            NULL,
+            0);
+
+        if (!NT_SUCCESS(status))
+            DbgPrint("PhDskMnt::ImScsiOpenWriteOverlay: Cannot set sparse attribute on differencing file: 0x%X\n",
+                status);
+
+        RtlCopyMemory(header->Signature, IMSCSI_OVERLAY_SIGNATURE,
+            sizeof(header->Signature));
+        header->Version = IMSCSI_OVERLAY_VERSION;
+        header->BlockShift = IMSCSI_OVERLAY_BLOCK_SHIFT;
+        header->DiskSize = pLUExt->DiskSize.QuadPart;
+        header->BitmapOffset = IMSCSI_OVERLAY_PAGE_SIZE;
+        header->DataOffset = data_offset;
+
+        status = ZwWriteFile(file_handle,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            header,
+            IMSCSI_OVERLAY_PAGE_SIZE,
+            &offset,
+            NULL);
+
+        if (!NT_SUCCESS(status))
+        {
+            goto error;
+        }
+
+        // Bitmap and data area read as zeros until written to.
+        new_size.EndOfFile.QuadPart = data_offset;
+
+        status = ZwSetInformationFile(file_handle,
+            &io_status,
+            &new_size,
+            sizeof new_size,
+            FileEndOfFileInformation);
+
+        if (!NT_SUCCESS(status))
+        {
+            goto error;
+        }
+    }
+    else
+    {
+        LARGE_INTEGER offset = { 0 };
+
+        status = ZwReadFile(file_handle,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            header,
+            IMSCSI_OVERLAY_PAGE_SIZE,
+            &offset,
+            NULL);
+
+        if (!NT_SUCCESS(status))
+        {
+            goto error;
+        }
+
+        if ((io_status.Information < sizeof(IMSCSI_OVERLAY_HEADER)) ||
+            (memcmp(header->Signature, IMSCSI_OVERLAY_SIGNATURE,
+            sizeof(header->Signature)) != 0) ||
+            (header->Version != IMSCSI_OVERLAY_VERSION) ||
+            (header->BlockShift != IMSCSI_OVERLAY_BLOCK_SHIFT) ||
+            (header->BitmapOffset != IMSCSI_OVERLAY_PAGE_SIZE) ||
+            (header->DataOffset != data_offset))
+        {
+            KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: '%wZ' is not a valid differencing file.\n",
+                OverlayName));
+
+            status = STATUS_FILE_INVALID;
+            goto error;
+        }
+
+        if (header->DiskSize != pLUExt->DiskSize.QuadPart)
+        {
+            KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: Differencing file is for a %I64i bytes disk, image is %I64i bytes.\n",
+                header->DiskSize, pLUExt->DiskSize.QuadPart));
+
+            status = STATUS_FILE_INVALID;
+            goto error;
+        }
+
+        offset.QuadPart = IMSCSI_OVERLAY_PAGE_SIZE;
+
+        status = ZwReadFile(file_handle,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            bitmap_buffer,
+            bitmap_size,
+            &offset,
+            NULL);
+
+        if (status == STATUS_END_OF_FILE)
+        {
+            status = STATUS_SUCCESS;
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            goto error;
+        }
+    }
+
+    RtlInitializeBitMap(&pLUExt->OverlayBlocks, bitmap_buffer, (ULONG)blocks);
+
+    KdPrint(("PhDskMnt::ImScsiOpenWriteOverlay: %u of %u blocks in differencing file.\n",
+        RtlNumberOfSetBits(&pLUExt->OverlayBlocks), (ULONG)blocks));
+
+    RtlCopyMemory(name_buffer, OverlayName->Buffer, OverlayName->Length);
+    pLUExt->OverlayName.Buffer = name_buffer;
+    pLUExt->OverlayName.Length = OverlayName->Length;
+    pLUExt->OverlayName.MaximumLength = OverlayName->Length;
+
+    pLUExt->OverlayDataOffset = data_offset;
+    pLUExt->OverlayBlockBuffer = block_buffer;
+    pLUExt->OverlayFile = file_handle;
+
+    return STATUS_SUCCESS;
+
+error:
+    if (file_handle != NULL)
+        ZwClose(file_handle);
+
+    if (bitmap_buffer != NULL)
+        ExFreePoolWithTag(bitmap_buffer, MP_TAG_GENERAL);
+
+    if (block_buffer != NULL)
+        ExFreePoolWithTag(block_buffer, MP_TAG_GENERAL);
+
+    if (name_buffer != NULL)
+        ExFreePoolWithTag(name_buffer, MP_TAG_GENERAL);
+
+    DbgPrint("PhDskMnt::ImScsiOpenWriteOverlay: Error opening differencing file: 0x%X\n", status);
+
+    return status;
+}
+
+VOID
+ImScsiCloseWriteOverlay(
+__in pHW_LU_EXTENSION pLUExt)
+{
+    if (pLUExt->OverlayFile != NULL)
+    {
+        ZwClose(pLUExt->OverlayFile);
+        pLUExt->OverlayFile = NULL;
+    }
+
+    if (pLUExt->OverlayBlocks.Buffer != NULL)
+    {
+        ExFreePoolWithTag(pLUExt->OverlayBlocks.Buffer, MP_TAG_GENERAL);
+        pLUExt->OverlayBlocks.Buffer = NULL;
+        pLUExt->OverlayBlocks.SizeOfBitMap = 0;
+    }
+
+    if (pLUExt->OverlayBlockBuffer != NULL)
+    {
+        ExFreePoolWithTag(pLUExt->OverlayBlockBuffer, MP_TAG_GENERAL);
+        pLUExt->OverlayBlockBuffer = NULL;
+    }
+
+    if (pLUExt->OverlayName.Buffer != NULL)
+    {
+        ExFreePoolWithTag(pLUExt->OverlayName.Buffer, MP_TAG_GENERAL);
+        pLUExt->OverlayName.Buffer = NULL;
+        pLUExt->OverlayName.Length = 0;
+        pLUExt->OverlayName.MaximumLength = 0;
+    }
+}
+
+NTSTATUS
+ImScsiReadOverlay(
+__in pHW_LU_EXTENSION pLUExt,
+__in PVOID            Buffer,
+__in PLARGE_INTEGER   ByteOffset,
+__in PULONG           Length
+)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PUCHAR buffer = (PUCHAR)Buffer;
+    LONGLONG offset = ByteOffset->QuadPart;
+    ULONG remaining = *Length;
+
+    KdPrint2(("PhDskMnt::ImScsiReadOverlay: pLUExt=%p, Buffer=%p, Offset=0x%I64X, Length=0x%X\n",
+        pLUExt, Buffer, offset, remaining));
+
+    while (remaining > 0)
+    {
+        ULONG block = (ULONG)(offset >> IMSCSI_OVERLAY_BLOCK_SHIFT);
+        BOOLEAN present = ImScsiIsOverlayBlockPresent(pLUExt, block);
+        ULONG run = IMSCSI_OVERLAY_BLOCK_SIZE -
+            (ULONG)(offset & (IMSCSI_OVERLAY_BLOCK_SIZE - 1));
+        ULONG done;
+        LARGE_INTEGER run_offset;
+
+        // Read following blocks stored in the same place with one request.
+        while ((run < remaining) &&
+            (ImScsiIsOverlayBlockPresent(pLUExt,
+            (ULONG)((offset + run) >> IMSCSI_OVERLAY_BLOCK_SHIFT)) == present))
+        {
+            run += IMSCSI_OVERLAY_BLOCK_SIZE;
+        }
+
+        if (run > remaining)
+        {
+            run = remaining;
+        }
+
+        done = run;
+
+        if (present)
+        {
+            IO_STATUS_BLOCK io_status;
+
+            run_offset.QuadPart = pLUExt->OverlayDataOffset + offset;
+
+            status = ZwReadFile(pLUExt->OverlayFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                buffer,
+                run,
+                &run_offset,
+                NULL);
+
+            if (NT_SUCCESS(status))
+            {
+                done = (ULONG)io_status.Information;
+            }
+            else if (status == STATUS_END_OF_FILE)
+            {
+                done = 0;
+                status = STATUS_SUCCESS;
+            }
+        }
+        else
+        {
+            run_offset.QuadPart = offset;
+
+            status = ImScsiReadDevice(pLUExt, buffer, &run_offset, &done);
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiReadOverlay: Read error at 0x%I64X: 0x%X\n",
+                offset, status);
+
+            break;
+        }
+
+        if (done < run)
+        {
+            RtlZeroMemory(buffer + done, run - done);
+        }
+
+        buffer += run;
+        offset += run;
+        remaining -= run;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        *Length = 0;
+    }
+
+    return status;
+}
+
+NTSTATUS
+ImScsiWriteOverlay(
+__in pHW_LU_EXTENSION pLUExt,
+__in PVOID            Buffer,
+__in PLARGE_INTEGER   ByteOffset,
+__in PULONG           Length
+)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PUCHAR buffer = (PUCHAR)Buffer;
+    LONGLONG offset = ByteOffset->QuadPart;
+    ULONG remaining = *Length;
+
+    KdPrint2(("PhDskMnt::ImScsiWriteOverlay: pLUExt=%p, Buffer=%p, Offset=0x%I64X, Length=0x%X\n",
+        pLUExt, Buffer, offset, remaining));
+
+    while (remaining > 0)
+    {
+        ULONG block = (ULONG)(offset >> IMSCSI_OVERLAY_BLOCK_SHIFT);
+        ULONG block_offset = (ULONG)(offset & (IMSCSI_OVERLAY_BLOCK_SIZE - 1));
+        ULONG run = IMSCSI_OVERLAY_BLOCK_SIZE - block_offset;
+        IO_STATUS_BLOCK io_status;
+        LARGE_INTEGER delta_offset;
+
+        if (ImScsiIsOverlayBlockPresent(pLUExt, block))
+        {
+            // Blocks already in differencing file are updated in place.
+            while ((run < remaining) &&
+                ImScsiIsOverlayBlockPresent(pLUExt,
+                (ULONG)((offset + run) >> IMSCSI_OVERLAY_BLOCK_SHIFT)))
+            {
+                run += IMSCSI_OVERLAY_BLOCK_SIZE;
+            }
+
+            if (run > remaining)
+            {
+                run = remaining;
+            }
+
+            delta_offset.QuadPart = pLUExt->OverlayDataOffset + offset;
+
+            status = ZwWriteFile(pLUExt->OverlayFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                buffer,
+                run,
+                &delta_offset,
+                NULL);
+        }
+        else if ((block_offset == 0) && (remaining >= IMSCSI_OVERLAY_BLOCK_SIZE))
+        {
+            // Whole new blocks need nothing from image.
+            while ((run + IMSCSI_OVERLAY_BLOCK_SIZE <= remaining) &&
+                !ImScsiIsOverlayBlockPresent(pLUExt,
+                block + (run >> IMSCSI_OVERLAY_BLOCK_SHIFT)))
+            {
+                run += IMSCSI_OVERLAY_BLOCK_SIZE;
+            }
+
+            delta_offset.QuadPart = pLUExt->OverlayDataOffset + offset;
+
+            status = ZwWriteFile(pLUExt->OverlayFile,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                buffer,
+                run,
+                &delta_offset,
+                NULL);
+
+            if (NT_SUCCESS(status))
+            {
+                RtlSetBits(&pLUExt->OverlayBlocks, block,
+                    run >> IMSCSI_OVERLAY_BLOCK_SHIFT);
+
+                status = ImScsiWriteOverlayBitmap(pLUExt, block,
+                    run >> IMSCSI_OVERLAY_BLOCK_SHIFT);
+            }
+        }
+        else
+        {
+            // Partially written new block, copy rest of it from image.
+            if (run > remaining)
+            {
+                run = remaining;
+            }
+
+            status = ImScsiReadOverlayBaseBlock(pLUExt, block,
+                pLUExt->OverlayBlockBuffer);
+
+            if (NT_SUCCESS(status))
+            {
+                RtlCopyMemory(pLUExt->OverlayBlockBuffer + block_offset,
+                    buffer, run);
+
+                delta_offset.QuadPart = pLUExt->OverlayDataOffset +
+                    ((LONGLONG)block << IMSCSI_OVERLAY_BLOCK_SHIFT);
+
+                status = ZwWriteFile(pLUExt->OverlayFile,
+                    NULL,
+                    NULL,
+                    NULL,
+                    &io_status,
+                    pLUExt->OverlayBlockBuffer,
+                    IMSCSI_OVERLAY_BLOCK_SIZE,
+                    &delta_offset,
+                    NULL);
+            }
+
+            if (NT_SUCCESS(status))
+            {
+                RtlSetBits(&pLUExt->OverlayBlocks, block, 1);
+
+                status = ImScsiWriteOverlayBitmap(pLUExt, block, 1);
+            }
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiWriteOverlay: Write error at 0x%I64X: 0x%X\n",
+                offset, status);
+
+            break;
+        }
+
+        buffer += run;
+        offset += run;
+        remaining -= run;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        *Length = 0;
+    }
+
+    return status;
+}
+
+NTSTATUS
+ImScsiDiscardOverlayLU(
+__in pHW_LU_EXTENSION pLUExt)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK io_status;
+    FILE_END_OF_FILE_INFORMATION new_size;
+
+    if (pLUExt->OverlayFile == NULL)
+    {
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiDiscardOverlayLU: Discarding %u blocks.\n",
+        RtlNumberOfSetBits(&pLUExt->OverlayBlocks)));
+
+    RtlClearAllBits(&pLUExt->OverlayBlocks);
+
+    status = ImScsiWriteOverlayBitmap(pLUExt, 0,
+        pLUExt->OverlayBlocks.SizeOfBitMap);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiDiscardOverlayLU: Error writing bitmap: 0x%X\n", status);
+
+        return status;
+    }
+
+    // Release space used by discarded blocks.
+    new_size.EndOfFile.QuadPart = pLUExt->OverlayDataOffset;
+
+    status = ZwSetInformationFile(pLUExt->OverlayFile,
+        &io_status,
+        &new_size,
+        sizeof new_size,
+        FileEndOfFileInformation);
+
+    if (!NT_SUCCESS(status))
+    {
+        // Blocks are already unreferenced, only space is wasted.
+        DbgPrint("PhDskMnt::ImScsiDiscardOverlayLU: Error truncating differencing file: 0x%X\n", status);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+ImScsiCommitOverlayLU(
+__in pHW_LU_EXTENSION pLUExt)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE image_file = NULL;
+    ULONG block;
+    ULONG blocks_copied = 0;
+
+    if (pLUExt->OverlayFile == NULL)
+    {
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    // Image file is opened read-only for overlay disks, open it again
+    // for writing while committing.
+    if (!pLUExt->UseProxy)
+    {
+        OBJECT_ATTRIBUTES object_attributes;
+        IO_STATUS_BLOCK io_status;
+
+        InitializeObjectAttributes(&object_attributes,
+            &pLUExt->ObjectName,
+            OBJ_CASE_INSENSITIVE |
+            OBJ_KERNEL_HANDLE,
+            NULL,
+            NULL);
+
+        status = ZwCreateFile(
+            &image_file,
+            GENERIC_WRITE,
+            &object_attributes,
+            &io_status,
+            NULL,
+            FILE_ATTRIBUTE_NORMAL,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            FILE_OPEN,
+            FILE_NON_DIRECTORY_FILE |
+            FILE_WRITE_THROUGH |
+            FILE_SYNCHRONOUS_IO_NONALERT,
+            NULL,
+            0);
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiCommitOverlayLU: Cannot open image file for writing: 0x%X\n", status);
+
+            return status;
+        }
+    }
+
+    for (block = 0; block < pLUExt->OverlayBlocks.SizeOfBitMap; block++)
+    {
+        IO_STATUS_BLOCK io_status;
+        LARGE_INTEGER offset;
+        ULONG length = IMSCSI_OVERLAY_BLOCK_SIZE;
+
+        if (!RtlCheckBit(&pLUExt->OverlayBlocks, block))
+        {
+            continue;
+        }
+
+        offset.QuadPart = pLUExt->OverlayDataOffset +
+            ((LONGLONG)block << IMSCSI_OVERLAY_BLOCK_SHIFT);
+
+        status = ZwReadFile(pLUExt->OverlayFile,
+            NULL,
+            NULL,
+            NULL,
+            &io_status,
+            pLUExt->OverlayBlockBuffer,
+            IMSCSI_OVERLAY_BLOCK_SIZE,
+            &offset,
+            NULL);
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        // Last block may extend beyond end of disk.
+        offset.QuadPart = (LONGLONG)block << IMSCSI_OVERLAY_BLOCK_SHIFT;
+
+        if (pLUExt->DiskSize.QuadPart - offset.QuadPart < (LONGLONG)length)
+        {
+            length = (ULONG)(pLUExt->DiskSize.QuadPart - offset.QuadPart);
+        }
+
+        offset.QuadPart += pLUExt->ImageOffset.QuadPart;
+
+        if (pLUExt->UseProxy)
+        {
+            status = ImScsiWriteProxy(
+                &pLUExt->Proxy,
+                &io_status,
+                &pLUExt->StopThread,
+                pLUExt->OverlayBlockBuffer,
+                length,
+                &offset);
+
+            ImScsiInvalidateProxyCache(pLUExt, offset.QuadPart, length);
+        }
+        else
+        {
+            status = ZwWriteFile(image_file,
+                NULL,
+                NULL,
+                NULL,
+                &io_status,
+                pLUExt->OverlayBlockBuffer,
+                length,
+                &offset,
+                NULL);
+
+            // Other LUs may have this image file cached.
+            ImScsiInvalidateCache(pLUExt, offset.QuadPart, length);
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        blocks_copied++;
+    }
+
+    if (image_file != NULL)
+    {
+        ZwClose(image_file);
+    }
+
+    KdPrint(("PhDskMnt::ImScsiCommitOverlayLU: %u blocks written to image. Status: 0x%X\n",
+        blocks_copied, status));
+
+    if (blocks_copied > 0)
+    {
+        pLUExt->Modified = TRUE;
+    }
+
+    // On failure, differencing file is left as is so that commit can be
+    // retried. Blocks already copied are identical in image and overlay.
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiCommitOverlayLU: Error writing to image: 0x%X\n", status);
+
+        return status;
+    }
+
+    return ImScsiDiscardOverlayLU(pLUExt);
+}
@@ -163,6 +163,37 @@ ImScsiFreeGlobalResources()
         }
 
 #ifdef USE_SCSIPORT
+        if ((pMPDrvInfoGlobal->GlobalsInitialized) &&
+            (pMPDrvInfoGlobal->CompletionThread != NULL))
+        {
+            ULONG i;
+
+            KdPrint(("PhDskMnt::ImScsiFreeGlobalResources: Waiting for completion thread %p.\n",
+                pMPDrvInfoGlobal->CompletionThread));
+
+#pragma warning(suppress: 28160)
+            KeSetEvent(&pMPDrvInfoGlobal->StopWorker, (KPRIORITY)0, TRUE);
+
+            KeWaitForSingleObject(
+                pMPDrvInfoGlobal->CompletionThread,
+                Executive,
+                KernelMode,
+                FALSE,
+                NULL);
+
+            ObDereferenceObject(pMPDrvInfoGlobal->CompletionThread);
+            pMPDrvInfoGlobal->CompletionThread = NULL;
+
+            for (i = 0; i < IMSCSI_LATENCY_BUCKETS; i++)
+            {
+                if (pMPDrvInfoGlobal->CompletionLatency[i] != 0)
+                {
+                    KdPrint(("PhDskMnt::ImScsiFreeGlobalResources: Completion latency < %u us: %i\n",
+                        1UL << i, pMPDrvInfoGlobal->CompletionLatency[i]));
+                }
+            }
+        }
+
         if (pMPDrvInfoGlobal->ControllerObject != NULL)
         {
             ObDereferenceObject(pMPDrvInfoGlobal->ControllerObject);
@@ -170,6 +201,12 @@ ImScsiFreeGlobalResources()
         }
 #endif
 
+        ImScsiFreeBlockCache();
+
+        ImScsiFreeTokenRng();
+
+        ImScsiFreeTrace();
+
 #ifndef MP_DrvInfo_Inline
         ExFreePoolWithTag(pMPDrvInfoGlobal, MP_TAG_GENERAL);
 #endif
@@ -254,6 +291,12 @@ __in PUNICODE_STRING pRegistryPath
 
     MpQueryRegParameters(pRegistryPath, &pMPDrvInfo->MPRegInfo);
 
+    ImScsiInitializeBlockCache(pMPDrvInfo->MPRegInfo.BlockCacheSize);
+
+    ImScsiInitializeTokenRng();
+
+    KeInitializeSpinLock(&pMPDrvInfo->Trace.Lock);
+
     // Set up information for ScsiPortInitialize().
 
 #ifdef USE_STORPORT
@@ -286,7 +329,7 @@ __in PUNICODE_STRING pRegistryPath
 
     hwInitData.MapBuffers = STORAGE_MAP_BUFFERS_SETTING;
 
-    hwInitData.DeviceExtensionSize = sizeof(HW_HBA_EXT);
+    hwInitData.DeviceExtensionSize = ImScsiGetHBAExtensionSize();   // Including LU table, see ImScsiInitializeLUTable.
     hwInitData.SpecificLuExtensionSize = sizeof(PVOID);
     hwInitData.SrbExtensionSize = sizeof(HW_SRB_EXTENSION);
 
@@ -405,16 +448,22 @@ __out      PBOOLEAN                        pBAgain
 
     KeInitializeSpinLock(&pHBAExt->LUListLock);
     InitializeListHead(&pHBAExt->LUList);
+    ImScsiInitializeLUTable(pHBAExt);
+    ImScsiInitializeCopyOperations(pHBAExt);
 
     pHBAExt->HostTargetId = (UCHAR)pMPDrvInfoGlobal->MPRegInfo.InitiatorID;
 
-    pConfigInfo->WmiDataProvider = FALSE;                       // Indicate WMI provider.
+    pConfigInfo->WmiDataProvider = TRUE;                        // Indicate WMI provider.
+
+    InitializeWmiContext(pHBAExt);
 
     pConfigInfo->Master = TRUE;
 
-    pConfigInfo->NumberOfPhysicalBreaks = 4096;
+    // Per LU limits of back ends are reported in block limits VPD page.
+    pConfigInfo->MaximumTransferLength = pMPDrvInfoGlobal->MPRegInfo.MaximumTransferLength;
 
-    pConfigInfo->MaximumTransferLength = 8 << 20;                     // 8 MB.
+    pConfigInfo->NumberOfPhysicalBreaks =
+        max(4096UL, (pConfigInfo->MaximumTransferLength >> PAGE_SHIFT) + 1);
 
 #ifdef USE_STORPORT
 
@@ -439,7 +488,10 @@ __out      PBOOLEAN                        pBAgain
 
     pConfigInfo->AlignmentMask = 0x3;                         // Indicate DWORD alignment.
     pConfigInfo->CachesData = FALSE;                       // Indicate miniport wants flush and shutdown notification.
-    pConfigInfo->MaximumNumberOfTargets = SCSI_MAXIMUM_TARGETS;        // Indicate maximum targets.
+    pConfigInfo->MaximumNumberOfTargets =
+        (UCHAR)pMPDrvInfoGlobal->MPRegInfo.MaximumTargets;                    // Indicate maximum targets.
+    pConfigInfo->MaximumNumberOfLogicalUnits =
+        (UCHAR)pMPDrvInfoGlobal->MPRegInfo.MaximumLuns;                       // Indicate maximum luns per target.
     pConfigInfo->NumberOfBuses =
         (UCHAR)pMPDrvInfoGlobal->MPRegInfo.NumberOfBuses;                     // Indicate number of buses.
     pConfigInfo->ScatterGather = TRUE;                        // Indicate scatter-gather (explicit setting needed for Win2003 at least).
@@ -479,9 +531,7 @@ __out      PBOOLEAN                        pBAgain
         HANDLE thread_handle;
         OBJECT_ATTRIBUTES object_attributes;
 
-        KeInitializeSpinLock(&pMPDrvInfoGlobal->RequestListLock);
-        InitializeListHead(&pMPDrvInfoGlobal->RequestList);
-        KeInitializeEvent(&pMPDrvInfoGlobal->RequestEvent, SynchronizationEvent, FALSE);
+        ImScsiCoreInitializeQueue(&pMPDrvInfoGlobal->RequestQueue);
 
 #ifdef USE_SCSIPORT
         KeInitializeSpinLock(&pMPDrvInfoGlobal->ResponseListLock);
@@ -489,6 +539,8 @@ __out      PBOOLEAN                        pBAgain
         InitializeListHead(&pMPDrvInfoGlobal->ResponseList);
 #endif
 
+        KeQueryPerformanceCounter(&pMPDrvInfoGlobal->PerformanceFrequency);
+
         KeInitializeEvent(&pMPDrvInfoGlobal->StopWorker, NotificationEvent, FALSE);
 
         pMPDrvInfoGlobal->GlobalsInitialized = TRUE;
@@ -532,6 +584,14 @@ __out      PBOOLEAN                        pBAgain
 
             ZwClose(thread_handle);
         }
+
+#ifdef USE_SCSIPORT
+        if (status == SP_RETURN_FOUND)
+        {
+            // Without completion thread, MpHwTimer still completes work.
+            ImScsiStartCompletionThread();
+        }
+#endif
     }
 
     //Done:
@@ -552,9 +612,78 @@ MpHwInitialize(__in PVOID pHBAExt)
 
     KdPrint2(("PhDskMnt::MpHwInitialize:  pHBAExt = 0x%p. IRQL=%i\n", pHBAExt, KeGetCurrentIrql()));
 
+#if defined(USE_STORPORT) && _NT_TARGET_VERSION >= 0x601
+
+    ImScsiInitializePerfOpts(pHBAExt);
+
+#endif
+
     return TRUE;
 }                                                     // End MpHwInitialize().
 
+#if defined(USE_STORPORT) && _NT_TARGET_VERSION >= 0x601
+/**************************************************************************************************/
+/*                                                                                                */
+/* Enables StorPort performance options supported by the running system. Requests are completed   */
+/* from LU worker threads on any processor. With DPC redirection, StorPort runs the completion    */
+/* DPC on the processor the request was issued from instead of the one that completed it. With    */
+/* concurrent channels, StartIo runs in parallel on all processors without the StartIo lock, LUs  */
+/* are found without locks and request queues have their own locks.                              */
+/*                                                                                                */
+/**************************************************************************************************/
+VOID
+ImScsiInitializePerfOpts(__in PVOID pHBAExt)
+{
+    PERF_CONFIGURATION_DATA perf_config = { 0 };
+    ULONG                   wanted_flags = STOR_PERF_DPC_REDIRECTION;
+    ULONG                   status;
+
+    perf_config.Version = STOR_PERF_VERSION;
+    perf_config.Size = sizeof(perf_config);
+
+    status = StorPortInitializePerfOpts(pHBAExt, TRUE, &perf_config);
+
+    if (status != STOR_STATUS_SUCCESS)
+    {
+        KdPrint(("PhDskMnt::ImScsiInitializePerfOpts: Query failed: 0x%X\n", status));
+        return;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiInitializePerfOpts: Supported flags 0x%X\n", perf_config.Flags));
+
+#if _NT_TARGET_VERSION >= 0x602
+    wanted_flags |= STOR_PERF_CONCURRENT_CHANNELS |
+        STOR_PERF_OPTIMIZE_FOR_COMPLETION_DURING_STARTIO;
+#endif
+
+    perf_config.Flags &= wanted_flags;
+
+#if _NT_TARGET_VERSION >= 0x602
+    if (perf_config.Flags & STOR_PERF_CONCURRENT_CHANNELS)
+    {
+        perf_config.ConcurrentChannels =
+            KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    }
+#endif
+
+    if (perf_config.Flags == 0)
+    {
+        return;
+    }
+
+    status = StorPortInitializePerfOpts(pHBAExt, FALSE, &perf_config);
+
+    if (status != STOR_STATUS_SUCCESS)
+    {
+        DbgPrint("PhDskMnt::ImScsiInitializePerfOpts: Failed to set flags 0x%X: 0x%X\n",
+            perf_config.Flags, status);
+        return;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiInitializePerfOpts: Enabled flags 0x%X\n", perf_config.Flags));
+}
+#endif
+
 /**************************************************************************************************/
 /*                                                                                                */
 /**************************************************************************************************/
@@ -644,6 +773,13 @@ __inout __deref PKIRQL LowestAssumedIrql
 
         KdPrint2(("PhDskMnt::ImScsiCompletePendingSrbs: Completing pWkRtnParms = 0x%p, pSrb = 0x%p\n", pWkRtnParms, pWkRtnParms->pSrb));
 
+        InterlockedIncrement(&pMPDrvInfoGlobal->CompletionLatency[
+            ImScsiGetLatencyBucket(
+                KeQueryPerformanceCounter(NULL).QuadPart - pWkRtnParms->ResponseQueued.QuadPart,
+                pMPDrvInfoGlobal->PerformanceFrequency.QuadPart)]);
+
+        ImScsiTraceSrb(IMSCSI_TRACE_COMPLETE, pWkRtnParms->pSrb);
+
         ScsiPortNotification(RequestComplete, pWkRtnParms->pHBAExt, pWkRtnParms->pSrb);
         ScsiPortNotification(NextRequest, pWkRtnParms->pHBAExt);
 
@@ -707,6 +843,8 @@ __inout __deref     PSCSI_REQUEST_BLOCK  pSrb
 
     _InterlockedExchangeAdd((volatile LONG *)&pHBAExt->SRBsSeen, 1);   // Bump count of SRBs encountered.
 
+    ImScsiTraceSrb(IMSCSI_TRACE_START_IO, pSrb);
+
     // Next, if true, will cause port driver to remove the associated LUNs if, for example, devmgmt.msc is asked "scan for hardware changes."
     //if (pHBAExt->bDontReport)
     //{                       // Act as though the HBA/path is gone?
@@ -750,6 +888,11 @@ __inout __deref     PSCSI_REQUEST_BLOCK  pSrb
         ScsiPnP(pHBAExt, (PSCSI_PNP_REQUEST_BLOCK)pSrb, &lowest_assumed_irql);
         break;
 
+    case SRB_FUNCTION_WMI:
+        _InterlockedExchangeAdd((volatile LONG *)&pHBAExt->WMISRBsSeen, 1);
+        HandleWmiSrb(pHBAExt, (PSCSI_WMI_REQUEST_BLOCK)pSrb);
+        break;
+
     case SRB_FUNCTION_POWER:
         KdPrint(("PhDskMnt::MpHwStartIo: SRB_FUNCTION_POWER.\n"));
         // Do nothing.
@@ -758,9 +901,10 @@ __inout __deref     PSCSI_REQUEST_BLOCK  pSrb
         break;
 
     case SRB_FUNCTION_SHUTDOWN:
-        KdPrint(("PhDskMnt::MpHwStartIo: SRB_FUNCTION_SHUTDOWN.\n"));
-        // Do nothing.
-        pSrb->SrbStatus = SRB_STATUS_SUCCESS;
+    case SRB_FUNCTION_FLUSH:
+        KdPrint(("PhDskMnt::MpHwStartIo: SRB_FUNCTION_SHUTDOWN/FLUSH.\n"));
+        // Only write-back LUs have anything to flush.
+        ScsiOpFlush(pHBAExt, pSrb, &Result, &lowest_assumed_irql);
 
         break;
 
@@ -777,6 +921,8 @@ __inout __deref     PSCSI_REQUEST_BLOCK  pSrb
 
     if (Result == ResultDone)
     {                         // Complete now?
+        ImScsiTraceSrb(IMSCSI_TRACE_COMPLETE, pSrb);
+
 #ifdef USE_SCSIPORT
         KdPrint2(("PhDskMnt::MpHwStartIo sending 'RequestComplete', 'NextRequest' and 'NextLuRequest' to ScsiPort.\n"));
         ScsiPortNotification(RequestComplete, pHBAExt, pSrb);
@@ -897,6 +1043,8 @@ __inout __deref PKIRQL LowestAssumedIrql
 
     ImScsiRemoveDevice(pHBAExt, &rem_data, LowestAssumedIrql);
 
+    ImScsiFreeCopyOperations(pHBAExt, LowestAssumedIrql);
+
     KdPrint2(("PhDskMnt::ImScsiStopAdapter End.\n"));
 
     return;
@@ -1138,151 +1286,362 @@ ImScsiLogDbgError(__in __deref PVOID Object,
     IoWriteErrorLogEntry(error_log_packet);
 }
 
+typedef struct _IMSCSI_READ_SLOT
+{
+    PUCHAR Buffer;
+    ULONG BufferSize;
+    KEVENT Event;
+    IO_STATUS_BLOCK IoStatus;
+    ULONGLONG Position;
+    ULONG Length;
+    BOOLEAN Pending;
+} IMSCSI_READ_SLOT, *PIMSCSI_READ_SLOT;
+
 //
-// Reads in a loop up to "Length" or until eof reached.
+// Reads in a loop up to "Length" or until eof reached. Up to
+// IMSCSI_READ_PIPELINE_DEPTH read requests are kept in flight, so that disk
+// reads overlap with Callback processing data already read. Callback is
+// called in file order. Request size adapts to observed throughput and
+// is reduced when the file system fails requests for lack of resources.
 //
 NTSTATUS
-ImScsiSafeReadFile(__in HANDLE FileHandle,
+ImScsiPipelinedReadFile(__in HANDLE FileHandle,
 __out __deref PIO_STATUS_BLOCK IoStatusBlock,
-PVOID Buffer,
-__in SIZE_T Length,
-__in __deref PLARGE_INTEGER Offset)
+__in ULONGLONG Length,
+__in __deref PLARGE_INTEGER Offset,
+__in PIMSCSI_READ_CALLBACK Callback,
+__in_opt PVOID Context)
 {
-    NTSTATUS status = STATUS_SUCCESS;
-    SIZE_T length_done = 0;
-    PUCHAR intermediate_buffer = NULL;
-    ULONG request_length;
+    NTSTATUS status;
+    PFILE_OBJECT file_object;
+    PDEVICE_OBJECT device_object;
+    IMSCSI_READ_SLOT slot[IMSCSI_READ_PIPELINE_DEPTH];
+    ULONG next_slot = 0;
+    ULONG oldest_slot = 0;
+    ULONG in_flight = 0;
+    ULONGLONG issued = 0;
+    ULONGLONG length_done = 0;
+    ULONG request_length = IMSCSI_READ_INITIAL_REQUEST;
+    BOOLEAN draining = FALSE;
+    BOOLEAN rewind = FALSE;
+    ULONGLONG rewind_position = 0;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER last_completion;
+    ULONGLONG last_rate = 0;
 
     ASSERT(FileHandle != NULL);
     ASSERT(IoStatusBlock != NULL);
-    ASSERT(Buffer != NULL);
+    ASSERT(Callback != NULL);
+
+    status = ObReferenceObjectByHandle(FileHandle,
+        FILE_READ_DATA,
+        *IoFileObjectType,
+        KernelMode,
+        (PVOID*)&file_object,
+        NULL);
 
-    if (Length > (8UL << 20))
+    if (!NT_SUCCESS(status))
     {
-        request_length = (8UL << 20);
+        DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: Cannot reference file object "
+            "(Status 0x%X)\n", status);
+
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = 0;
+        return status;
     }
-    else
+
+    device_object = IoGetRelatedDeviceObject(file_object);
+
+    RtlZeroMemory(slot, sizeof(slot));
+
+    for (ULONG i = 0; i < IMSCSI_READ_PIPELINE_DEPTH; i++)
     {
-        request_length = (ULONG)Length;
+        KeInitializeEvent(&slot[i].Event, NotificationEvent, FALSE);
     }
 
-    while (length_done < Length)
-    {
-        SIZE_T LongRequestLength = Length - length_done;
-        if (LongRequestLength < request_length)
-        {
-            request_length = (ULONG)LongRequestLength;
-        }
+    last_completion = KeQueryPerformanceCounter(&frequency);
 
-        for (;;)
+    for (;;)
+    {
+        // Keep the pipeline filled
+        while ((in_flight < IMSCSI_READ_PIPELINE_DEPTH) &&
+            (!draining) &&
+            (issued < Length))
         {
-            LARGE_INTEGER current_file_offset;
+            PIMSCSI_READ_SLOT read_slot = &slot[next_slot];
+            ULONG length = request_length;
+            LARGE_INTEGER file_offset;
+            PIRP irp = NULL;
 
-            current_file_offset.QuadPart = Offset->QuadPart + length_done;
+            if (Length - issued < length)
+            {
+                length = (ULONG)(Length - issued);
+            }
 
-            if (intermediate_buffer == NULL)
+            if (read_slot->BufferSize < length)
             {
-                intermediate_buffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
-                    request_length,
+                if (read_slot->Buffer != NULL)
+                {
+                    ExFreePoolWithTag(read_slot->Buffer, MP_TAG_GENERAL);
+                }
+
+                read_slot->BufferSize = 0;
+
+                read_slot->Buffer = (PUCHAR)ExAllocatePoolWithTag(NonPagedPool,
+                    length,
                     MP_TAG_GENERAL);
 
-                if (intermediate_buffer == NULL)
+                if (read_slot->Buffer != NULL)
                 {
-                    DbgPrint("PhDskMnt::ImScsiSafeReadFile: Insufficient paged pool to allocate "
-                        "intermediate buffer (%u bytes).\n", request_length);
-
-                    IoStatusBlock->Status = STATUS_INSUFFICIENT_RESOURCES;
-                    IoStatusBlock->Information = 0;
-                    return IoStatusBlock->Status;
+                    read_slot->BufferSize = length;
                 }
             }
 
-            status = ZwReadFile(FileHandle,
-                NULL,
-                NULL,
-                NULL,
-                IoStatusBlock,
-                intermediate_buffer,
-                request_length,
-                &current_file_offset,
-                NULL);
+            file_offset.QuadPart = Offset->QuadPart + issued;
 
-            if (((status == STATUS_INSUFFICIENT_RESOURCES) |
-                (status == STATUS_INVALID_BUFFER_SIZE) |
-                (status == STATUS_INVALID_PARAMETER)) &
-                (request_length >= 2048))
+            if (read_slot->Buffer != NULL)
             {
-                ExFreePoolWithTag(intermediate_buffer, MP_TAG_GENERAL);
-                intermediate_buffer = NULL;
-
-                DbgPrint("PhDskMnt::ImScsiSafeReadFile: ZwReadFile error reading "
-                    "%u bytes. Retrying with smaller read size. (Status 0x%X)\n",
-                    request_length,
-                    status);
-
-                request_length >>= 2;
-
-                continue;
+#pragma warning(suppress: 6102)
+                irp = IoBuildSynchronousFsdRequest(IRP_MJ_READ,
+                    device_object,
+                    read_slot->Buffer,
+                    length,
+                    &file_offset,
+                    &read_slot->Event,
+                    &read_slot->IoStatus);
             }
 
-            if (!NT_SUCCESS(status))
+            if (irp == NULL)
             {
-                DbgPrint("PhDskMnt::ImScsiSafeReadFile: ZwReadFile error reading "
-                    "%u bytes. (Status 0x%X)\n",
-                    request_length,
-                    status);
+                DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: Insufficient resources for "
+                    "reading %u bytes.\n", length);
 
+                if (request_length >= 2048)
+                {
+                    request_length >>= 2;
+                    continue;
+                }
+
+                // Try again when pending requests have completed
+                if (in_flight > 0)
+                {
+                    break;
+                }
+
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                draining = TRUE;
                 break;
             }
 
-            RtlCopyMemory((PUCHAR)Buffer + length_done, intermediate_buffer,
-                IoStatusBlock->Information);
+            irp->Flags |= IRP_NOCACHE;
 
-            break;
+            IoGetNextIrpStackLocation(irp)->FileObject = file_object;
+
+            KeClearEvent(&read_slot->Event);
+
+            read_slot->Position = issued;
+            read_slot->Length = length;
+            read_slot->Pending = (BOOLEAN)
+                (IoCallDriver(device_object, irp) == STATUS_PENDING);
+
+            issued += length;
+            in_flight++;
+            next_slot = (next_slot + 1) % IMSCSI_READ_PIPELINE_DEPTH;
         }
 
-        if (!NT_SUCCESS(status))
+        if (in_flight == 0)
         {
-            IoStatusBlock->Information = length_done;
             break;
         }
 
-        if (IoStatusBlock->Information == 0)
+        // Complete oldest request
+        PIMSCSI_READ_SLOT read_slot = &slot[oldest_slot];
+
+        if (read_slot->Pending)
+        {
+            KeWaitForSingleObject(&read_slot->Event,
+                Executive,
+                KernelMode,
+                FALSE,
+                NULL);
+        }
+
+        in_flight--;
+        oldest_slot = (oldest_slot + 1) % IMSCSI_READ_PIPELINE_DEPTH;
+
+        if (draining)
+        {
+            // Requests after a failed one are read again with smaller size
+            if (rewind && (in_flight == 0))
+            {
+                issued = rewind_position;
+                rewind = FALSE;
+                draining = FALSE;
+            }
+
+            continue;
+        }
+
+        NTSTATUS read_status = read_slot->IoStatus.Status;
+
+        if (((read_status == STATUS_INSUFFICIENT_RESOURCES) |
+            (read_status == STATUS_INVALID_BUFFER_SIZE) |
+            (read_status == STATUS_INVALID_PARAMETER)) &
+            (read_slot->Length >= 2048))
+        {
+            DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: Error reading "
+                "%u bytes. Retrying with smaller read size. (Status 0x%X)\n",
+                read_slot->Length,
+                read_status);
+
+            request_length = read_slot->Length >> 2;
+
+            rewind_position = read_slot->Position;
+            rewind = TRUE;
+            draining = TRUE;
+
+            if (in_flight == 0)
+            {
+                issued = rewind_position;
+                rewind = FALSE;
+                draining = FALSE;
+            }
+
+            continue;
+        }
+
+        if (!NT_SUCCESS(read_status))
+        {
+            DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: Error reading "
+                "%u bytes. (Status 0x%X)\n",
+                read_slot->Length,
+                read_status);
+
+            status = read_status;
+            draining = TRUE;
+            continue;
+        }
+
+        if (read_slot->IoStatus.Information == 0)
         {
-            DbgPrint("PhDskMnt::ImScsiSafeReadFile: IoStatusBlock->Information == 0, "
+            DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: IoStatusBlock->Information == 0, "
                 "returning STATUS_CONNECTION_RESET.\n");
 
             status = STATUS_CONNECTION_RESET;
-            break;
+            draining = TRUE;
+            continue;
+        }
+
+        ULONG length_read = (ULONG)read_slot->IoStatus.Information;
+
+        status = Callback(Context, read_slot->Position, read_slot->Buffer, length_read);
+
+        if (!NT_SUCCESS(status))
+        {
+            draining = TRUE;
+            continue;
+        }
+
+        length_done += length_read;
+
+        KdPrint2(("PhDskMnt::ImScsiPipelinedReadFile: Done %u bytes.\n",
+            length_read));
+
+        // Short read, remaining requests are beyond end of file
+        if (length_read < read_slot->Length)
+        {
+            status = STATUS_END_OF_FILE;
+            draining = TRUE;
+            continue;
         }
 
-        KdPrint(("PhDskMnt::ImScsiSafeReadFile: Done %u bytes.\n",
-            (ULONG)IoStatusBlock->Information));
+        // Grow request size as long as throughput improves, shrink it again
+        // if throughput drops noticeably.
+        LARGE_INTEGER now = KeQueryPerformanceCounter(NULL);
+        ULONGLONG elapsed = now.QuadPart - last_completion.QuadPart;
+
+        last_completion = now;
+
+        if ((elapsed > 0) && (read_slot->Length == request_length))
+        {
+            ULONGLONG rate = (ULONGLONG)length_read * frequency.QuadPart / elapsed;
+
+            if (rate >= last_rate)
+            {
+                if (request_length < IMSCSI_READ_MAX_REQUEST)
+                {
+                    request_length <<= 1;
+                }
+            }
+            else if (rate < last_rate - (last_rate >> 2))
+            {
+                if (request_length > IMSCSI_READ_MIN_REQUEST)
+                {
+                    request_length >>= 1;
+                }
+            }
 
-        length_done += IoStatusBlock->Information;
+            last_rate = rate;
+        }
     }
 
-    if (intermediate_buffer != NULL)
+    for (ULONG i = 0; i < IMSCSI_READ_PIPELINE_DEPTH; i++)
     {
-        ExFreePoolWithTag(intermediate_buffer, MP_TAG_GENERAL);
-        intermediate_buffer = NULL;
+        if (slot[i].Buffer != NULL)
+        {
+            ExFreePoolWithTag(slot[i].Buffer, MP_TAG_GENERAL);
+        }
     }
 
+    ObDereferenceObject(file_object);
+
     if (!NT_SUCCESS(status))
     {
-        DbgPrint("PhDskMnt::ImScsiSafeReadFile: Error return "
+        DbgPrint("PhDskMnt::ImScsiPipelinedReadFile: Error return "
             "(Status 0x%X)\n", status);
     }
     else
     {
-        KdPrint(("PhDskMnt::ImScsiSafeReadFile: Successful.\n"));
+        KdPrint(("PhDskMnt::ImScsiPipelinedReadFile: Successful, last request size %u bytes.\n",
+            request_length));
     }
 
     IoStatusBlock->Status = status;
-    IoStatusBlock->Information = length_done;
+    IoStatusBlock->Information = (ULONG_PTR)length_done;
     return status;
 }
 
+NTSTATUS
+ImScsiCopyReadData(__in PVOID Context,
+__in ULONGLONG Position,
+__in PUCHAR Data,
+__in ULONG Length)
+{
+    RtlCopyMemory((PUCHAR)Context + Position, Data, Length);
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Reads in a loop up to "Length" or until eof reached.
+//
+NTSTATUS
+ImScsiSafeReadFile(__in HANDLE FileHandle,
+__out __deref PIO_STATUS_BLOCK IoStatusBlock,
+PVOID Buffer,
+__in SIZE_T Length,
+__in __deref PLARGE_INTEGER Offset)
+{
+    ASSERT(Buffer != NULL);
+
+    return ImScsiPipelinedReadFile(FileHandle,
+        IoStatusBlock,
+        Length,
+        Offset,
+        ImScsiCopyReadData,
+        Buffer);
+}
+
 NTSTATUS
 ImScsiSafeIOStream(__in PFILE_OBJECT FileObject,
 __in UCHAR MajorFunction,
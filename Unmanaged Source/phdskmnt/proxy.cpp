@@ -100,6 +100,8 @@ __drv_when(ResponseDataBufferSize > 0, __inout __deref) ULONG *ResponseDataSize)
 
     ASSERT(Proxy != NULL);
 
+    Proxy->RoundTrips++;
+
     switch (Proxy->connection_type)
     {
     case PROXY_CONNECTION::PROXY_CONNECTION_DEVICE:
@@ -687,6 +689,104 @@ __in ULONG ProxyInfoResponseLength)
     return IoStatusBlock->Status;
 }
 
+NTSTATUS
+ImScsiQueryIdentityProxy(__in __deref PPROXY_CONNECTION Proxy,
+__out __deref PIO_STATUS_BLOCK IoStatusBlock,
+__in __deref PKEVENT CancelEvent,
+__out __deref PIMDPROXY_IDENTITY_RESP ProxyIdentityResponse)
+{
+    ULONGLONG proxy_req = IMDPROXY_REQ_IDENTITY;
+    NTSTATUS status;
+
+    ASSERT(Proxy != NULL);
+    ASSERT(IoStatusBlock != NULL);
+    ASSERT(ProxyIdentityResponse != NULL);
+
+    KdPrint2(("ImScsi Proxy Client: Sending IMDPROXY_REQ_IDENTITY.\n"));
+
+    status = ImScsiCallProxy(Proxy,
+        IoStatusBlock,
+        CancelEvent,
+        &proxy_req,
+        sizeof(proxy_req),
+        NULL,
+        0,
+        ProxyIdentityResponse,
+        sizeof(IMDPROXY_IDENTITY_RESP),
+        NULL,
+        0,
+        NULL);
+
+    if (!NT_SUCCESS(status))
+    {
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    if (ProxyIdentityResponse->errorno != 0)
+    {
+        KdPrint(("ImScsi Proxy Client: Server returned error %#I64x.\n",
+            ProxyIdentityResponse->errorno));
+        IoStatusBlock->Status = STATUS_IO_DEVICE_ERROR;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    IoStatusBlock->Status = STATUS_SUCCESS;
+    IoStatusBlock->Information = 0;
+    return IoStatusBlock->Status;
+}
+
+NTSTATUS
+ImScsiQueryLimitsProxy(__in __deref PPROXY_CONNECTION Proxy,
+__out __deref PIO_STATUS_BLOCK IoStatusBlock,
+__in __deref PKEVENT CancelEvent,
+__out __deref PIMDPROXY_LIMITS_RESP ProxyLimitsResponse)
+{
+    ULONGLONG proxy_req = IMDPROXY_REQ_LIMITS;
+    NTSTATUS status;
+
+    ASSERT(Proxy != NULL);
+    ASSERT(IoStatusBlock != NULL);
+    ASSERT(ProxyLimitsResponse != NULL);
+
+    KdPrint2(("ImScsi Proxy Client: Sending IMDPROXY_REQ_LIMITS.\n"));
+
+    status = ImScsiCallProxy(Proxy,
+        IoStatusBlock,
+        CancelEvent,
+        &proxy_req,
+        sizeof(proxy_req),
+        NULL,
+        0,
+        ProxyLimitsResponse,
+        sizeof(IMDPROXY_LIMITS_RESP),
+        NULL,
+        0,
+        NULL);
+
+    if (!NT_SUCCESS(status))
+    {
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    if (ProxyLimitsResponse->errorno != 0)
+    {
+        KdPrint(("ImScsi Proxy Client: Server returned error %#I64x.\n",
+            ProxyLimitsResponse->errorno));
+        IoStatusBlock->Status = STATUS_IO_DEVICE_ERROR;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    IoStatusBlock->Status = STATUS_SUCCESS;
+    IoStatusBlock->Information = 0;
+    return IoStatusBlock->Status;
+}
+
 NTSTATUS
 ImScsiReadProxy(__in __deref PPROXY_CONNECTION Proxy,
 __out __deref PIO_STATUS_BLOCK IoStatusBlock,
@@ -969,3 +1069,142 @@ ImScsiUnmapOrZeroProxy(
     IoStatusBlock->Information = 0;
     return IoStatusBlock->Status;
 }
+
+NTSTATUS
+ImScsiQueryAllocatedRangesProxy(
+    __in __deref PPROXY_CONNECTION Proxy,
+    __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+    __in __deref PKEVENT CancelEvent,
+    __in LONGLONG Offset,
+    __in LONGLONG Length,
+    __out_ecount(MaxItems) PDEVICE_DATA_SET_RANGE Ranges,
+    __in ULONG MaxItems)
+{
+    IMDPROXY_READ_REQ query_req;
+    IMDPROXY_READ_RESP query_resp;
+    NTSTATUS status;
+    ULONG byte_size = MaxItems * sizeof(DEVICE_DATA_SET_RANGE);
+
+    ASSERT(Proxy != NULL);
+    ASSERT(IoStatusBlock != NULL);
+    ASSERT(Ranges != NULL);
+
+    if ((Proxy->connection_type == PROXY_CONNECTION::PROXY_CONNECTION_SHM) &&
+        (byte_size > (Proxy->shared_memory_size - IMDPROXY_HEADER_SIZE)))
+    {
+        byte_size = (ULONG)(((Proxy->shared_memory_size - IMDPROXY_HEADER_SIZE) /
+            sizeof(DEVICE_DATA_SET_RANGE)) * sizeof(DEVICE_DATA_SET_RANGE));
+    }
+
+    query_req.request_code = IMDPROXY_REQ_ALLOCATED_RANGES;
+    query_req.offset = Offset;
+    query_req.length = Length;
+
+    KdPrint2(("ImScsi Proxy Client: IMDPROXY_REQ_ALLOCATED_RANGES %#I64x bytes at %#I64x.\n",
+        Length, Offset));
+
+    status = ImScsiCallProxy(Proxy,
+        IoStatusBlock,
+        CancelEvent,
+        &query_req,
+        sizeof(query_req),
+        NULL,
+        0,
+        &query_resp,
+        sizeof(query_resp),
+        Ranges,
+        byte_size,
+        (PULONG)&query_resp.length);
+
+    if (!NT_SUCCESS(status))
+    {
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = 0;
+        return status;
+    }
+
+    if (query_resp.errorno != 0)
+    {
+        KdPrint(("ImScsi Proxy Client: Server returned error %#I64x.\n",
+            query_resp.errorno));
+        IoStatusBlock->Status = STATUS_IO_DEVICE_ERROR;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    // Number of ranges received
+    IoStatusBlock->Status = STATUS_SUCCESS;
+    IoStatusBlock->Information = (ULONG_PTR)(query_resp.length / sizeof(DEVICE_DATA_SET_RANGE));
+    return IoStatusBlock->Status;
+}
+
+NTSTATUS
+ImScsiCopyProxy(
+    __in __deref PPROXY_CONNECTION Proxy,
+    __out __deref PIO_STATUS_BLOCK IoStatusBlock,
+    __in __deref PKEVENT CancelEvent,
+    __in_bcount(16) const UCHAR *SourceIdentity,
+    __in LONGLONG SourceOffset,
+    __in LONGLONG Offset,
+    __in LONGLONG Length)
+{
+    IMDPROXY_COPY_REQ copy_req;
+    IMDPROXY_COPY_RESP copy_resp;
+    NTSTATUS status;
+
+    ASSERT(Proxy != NULL);
+    ASSERT(IoStatusBlock != NULL);
+    ASSERT(SourceIdentity != NULL);
+
+    copy_req.request_code = IMDPROXY_REQ_COPY;
+    RtlCopyMemory(copy_req.source_identity, SourceIdentity,
+        sizeof(copy_req.source_identity));
+    copy_req.source_offset = SourceOffset;
+    copy_req.offset = Offset;
+    copy_req.length = Length;
+
+    KdPrint2(("ImScsi Proxy Client: IMDPROXY_REQ_COPY %#I64x bytes from %#I64x to %#I64x.\n",
+        Length, SourceOffset, Offset));
+
+    status = ImScsiCallProxy(Proxy,
+        IoStatusBlock,
+        CancelEvent,
+        &copy_req,
+        sizeof(copy_req),
+        NULL,
+        0,
+        &copy_resp,
+        sizeof(copy_resp),
+        NULL,
+        0,
+        NULL);
+
+    if (!NT_SUCCESS(status))
+    {
+        IoStatusBlock->Status = status;
+        IoStatusBlock->Information = 0;
+        return status;
+    }
+
+    if (copy_resp.errorno != 0)
+    {
+        KdPrint(("ImScsi Proxy Client: Server returned error %#I64x.\n",
+            copy_resp.errorno));
+        IoStatusBlock->Status = STATUS_NOT_SUPPORTED;
+        IoStatusBlock->Information = 0;
+        return IoStatusBlock->Status;
+    }
+
+    if (copy_resp.length != (ULONGLONG)Length)
+    {
+        KdPrint(("ImScsi Proxy Client: Copied %#I64x bytes, requested %#I64x.\n",
+            copy_resp.length, Length));
+        IoStatusBlock->Status = STATUS_IO_DEVICE_ERROR;
+        IoStatusBlock->Information = (ULONG_PTR)copy_resp.length;
+        return IoStatusBlock->Status;
+    }
+
+    IoStatusBlock->Status = STATUS_SUCCESS;
+    IoStatusBlock->Information = (ULONG_PTR)copy_resp.length;
+    return IoStatusBlock->Status;
+}
@@ -0,0 +1,379 @@
+/// proxycache.cpp
+/// Persistent local cache file for proxy virtual disks. Blocks read from a
+/// slow proxy, for example an image on a network share served by devio, are
+/// kept in a file on a local disk and survive remounts.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Cache files are created in the directory set by the ProxyCacheDirectory
+// registry value, named after a hash of the proxy connection name. Cache
+// file format, read-through and slot reuse are in cachecore.cpp, this file
+// connects the cache to the proxy and to a file opened with ZwCreateFile.
+//
+// Cache files are validated against image identity and generation
+// reported by the proxy with IMDPROXY_REQ_IDENTITY. Proxy services that do
+// not support that request get no cache, because there is no way to tell
+// whether image has been replaced or modified since cache file was saved.
+//
+// Proxy requests for a LU are only sent by the LU worker thread, so cache
+// structures are accessed without locks.
+//
+
+typedef struct _IMSCSI_PROXY_CACHE
+{
+    IMSCSI_CACHE_CORE Core;
+    HANDLE File;
+    pHW_LU_EXTENSION pLUExt;
+} IMSCSI_PROXY_CACHE, *PIMSCSI_PROXY_CACHE;
+
+FORCEINLINE
+ULONGLONG
+ImScsiProxyCacheHash(__in ULONGLONG Hash,
+__in_bcount(Length) const VOID *Data,
+__in SIZE_T Length)
+{
+    // FNV-1a
+    for (SIZE_T i = 0; i < Length; i++)
+    {
+        Hash ^= ((const UCHAR*)Data)[i];
+        Hash *= 1099511628211ULL;
+    }
+
+    return Hash;
+}
+
+NTSTATUS
+ImScsiProxyCacheFileRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)Context;
+    IO_STATUS_BLOCK io_status;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+
+    offset.QuadPart = Offset;
+
+    status = ZwReadFile(cache->File,
+        NULL,
+        NULL,
+        NULL,
+        &io_status,
+        Buffer,
+        *Length,
+        &offset,
+        NULL);
+
+    *Length = NT_SUCCESS(status) ? (ULONG)io_status.Information : 0;
+
+    return status;
+}
+
+NTSTATUS
+ImScsiProxyCacheFileWrite(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)Context;
+    IO_STATUS_BLOCK io_status;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+
+    offset.QuadPart = Offset;
+
+    status = ZwWriteFile(cache->File,
+        NULL,
+        NULL,
+        NULL,
+        &io_status,
+        Buffer,
+        *Length,
+        &offset,
+        NULL);
+
+    *Length = NT_SUCCESS(status) ? (ULONG)io_status.Information : 0;
+
+    return status;
+}
+
+// Cache file is opened write-through, nothing to flush.
+const IMSCSI_CORE_BACKEND ImScsiProxyCacheFileBackend = {
+    ImScsiProxyCacheFileRead,
+    ImScsiProxyCacheFileWrite,
+    NULL
+};
+
+NTSTATUS
+ImScsiProxyCacheImageRead(PVOID Context, PVOID Buffer, LONGLONG Offset, PULONG Length)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)Context;
+    IO_STATUS_BLOCK io_status;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+
+    offset.QuadPart = Offset;
+
+    status = ImScsiReadProxy(&cache->pLUExt->Proxy,
+        &io_status,
+        &cache->pLUExt->StopThread,
+        Buffer,
+        *Length,
+        &offset);
+
+    *Length = NT_SUCCESS(status) ? (ULONG)io_status.Information : 0;
+
+    return status;
+}
+
+// Cache only reads from image, writes go to proxy directly.
+const IMSCSI_CORE_BACKEND ImScsiProxyCacheImageBackend = {
+    ImScsiProxyCacheImageRead,
+    NULL,
+    NULL
+};
+
+NTSTATUS
+ImScsiOpenProxyCache(__in pHW_LU_EXTENSION pLUExt,
+__in LONGLONG ImageSize,
+__in BOOLEAN SupportsIdentity)
+{
+    PUNICODE_STRING directory = &pMPDrvInfoGlobal->MPRegInfo.ProxyCacheDirectory;
+    ULONGLONG max_slots = (ULONGLONG)pMPDrvInfoGlobal->MPRegInfo.ProxyCacheSize <<
+        (20 - IMSCSI_CACHE_CORE_BLOCK_SHIFT);
+    ULONGLONG name_hash = 14695981039346656037ULL;
+    UNICODE_STRING cache_name;
+    WCHAR hash_text[17];
+    OBJECT_ATTRIBUTES object_attributes;
+    IO_STATUS_BLOCK io_status;
+    IMDPROXY_IDENTITY_RESP identity;
+    PIMSCSI_PROXY_CACHE cache;
+    NTSTATUS status;
+
+    if ((directory->Length == 0) || (max_slots == 0) || (ImageSize <= 0))
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (!SupportsIdentity)
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenProxyCache: Proxy does not report image identity, cache disabled.\n");
+
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    status = ImScsiQueryIdentityProxy(&pLUExt->Proxy,
+        &io_status,
+        NULL,
+        &identity);
+
+    if (!NT_SUCCESS(status))
+    {
+        KdPrint(("PhDskMnt::ImScsiOpenProxyCache: Image identity query failed (%#x).\n",
+            status));
+
+        return status;
+    }
+
+    cache = (PIMSCSI_PROXY_CACHE)ExAllocatePoolWithTag(NonPagedPool,
+        sizeof(IMSCSI_PROXY_CACHE), MP_TAG_GENERAL);
+
+    if (cache == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(cache, sizeof(IMSCSI_PROXY_CACHE));
+
+    cache->pLUExt = pLUExt;
+
+    for (USHORT i = 0; i < pLUExt->ObjectName.Length / sizeof(WCHAR); i++)
+    {
+        WCHAR chr = RtlUpcaseUnicodeChar(pLUExt->ObjectName.Buffer[i]);
+
+        name_hash = ImScsiProxyCacheHash(name_hash, &chr, sizeof(chr));
+    }
+
+    // Cache file name is directory\<name hash>.aimcache
+    for (int i = 15; i >= 0; i--)
+    {
+        hash_text[i] = L"0123456789ABCDEF"[name_hash & 0xF];
+        name_hash >>= 4;
+    }
+
+    hash_text[16] = 0;
+
+    cache_name.Length = 0;
+    cache_name.MaximumLength = directory->Length + sizeof(hash_text) +
+        sizeof(L"\\.aimcache");
+
+    WPoolMem<WCHAR, PagedPool> cache_name_buffer(cache_name.MaximumLength);
+
+    if (!cache_name_buffer)
+    {
+        ExFreePoolWithTag(cache, MP_TAG_GENERAL);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    cache_name.Buffer = cache_name_buffer;
+
+    RtlAppendUnicodeStringToString(&cache_name, directory);
+    RtlAppendUnicodeToString(&cache_name, L"\\");
+    RtlAppendUnicodeToString(&cache_name, hash_text);
+    RtlAppendUnicodeToString(&cache_name, L".aimcache");
+
+    InitializeObjectAttributes(&object_attributes,
+        &cache_name,
+        OBJ_CASE_INSENSITIVE |
+        OBJ_KERNEL_HANDLE,
+        NULL,
+        NULL);
+
+    // Not shared, a second LU for same proxy runs without cache.
+    status = ZwCreateFile(
+        &cache->File,
+        GENERIC_READ | GENERIC_WRITE,
+        &object_attributes,
+        &io_status,
+        NULL,
+        FILE_ATTRIBUTE_NORMAL,
+        0,
+        FILE_OPEN_IF,
+        FILE_NON_DIRECTORY_FILE |
+        FILE_WRITE_THROUGH |
+        FILE_RANDOM_ACCESS |
+        FILE_SYNCHRONOUS_IO_NONALERT,
+        NULL,
+        0);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenProxyCache: Cannot open cache file '%wZ' (%#x).\n",
+            &cache_name, status);
+
+        ExFreePoolWithTag(cache, MP_TAG_GENERAL);
+        return status;
+    }
+
+    status = ImScsiCacheCoreOpen(&cache->Core,
+        &ImScsiProxyCacheFileBackend,
+        cache,
+        &ImScsiProxyCacheImageBackend,
+        cache,
+        ImageSize,
+        max_slots,
+        pMPDrvInfoGlobal->MPRegInfo.ProxyCachePolicy,
+        identity.identity,
+        identity.generation);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiOpenProxyCache: Cannot initialize cache file '%wZ' (%#x).\n",
+            &cache_name, status);
+
+        ZwClose(cache->File);
+        ExFreePoolWithTag(cache, MP_TAG_GENERAL);
+        return status;
+    }
+
+    KdPrint(("PhDskMnt::ImScsiOpenProxyCache: Cache file '%wZ', %u slots.\n",
+        &cache_name, cache->Core.Slots));
+
+    pLUExt->ProxyCache = cache;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiCloseProxyCache(__in pHW_LU_EXTENSION pLUExt)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)pLUExt->ProxyCache;
+    IMDPROXY_IDENTITY_RESP identity;
+    IO_STATUS_BLOCK io_status;
+    NTSTATUS status;
+
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    pLUExt->ProxyCache = NULL;
+
+    KdPrint(("PhDskMnt::ImScsiCloseProxyCache: %I64u hits, %I64u misses.\n",
+        cache->Core.Hits, cache->Core.Misses));
+
+    // Generation after own writes is saved with index.
+    status = ImScsiQueryIdentityProxy(&pLUExt->Proxy,
+        &io_status,
+        NULL,
+        &identity);
+
+    if (NT_SUCCESS(status))
+    {
+        status = ImScsiCacheCoreClose(&cache->Core, identity.generation);
+    }
+    else
+    {
+        ImScsiCacheCoreFree(&cache->Core);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiCloseProxyCache: Cannot save cache index (%#x). Cache is discarded on next mount.\n",
+            status);
+    }
+
+    ZwClose(cache->File);
+    ExFreePoolWithTag(cache, MP_TAG_GENERAL);
+}
+
+VOID
+ImScsiInvalidateProxyCache(__in pHW_LU_EXTENSION pLUExt,
+__in LONGLONG ByteOffset,
+__in LONGLONG Length)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)pLUExt->ProxyCache;
+
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    ImScsiCacheCoreInvalidate(&cache->Core, ByteOffset, Length);
+}
+
+NTSTATUS
+ImScsiReadProxyCached(__in pHW_LU_EXTENSION pLUExt,
+__in PVOID Buffer,
+__in PLARGE_INTEGER ByteOffset,
+__in ULONG Length,
+__out PIO_STATUS_BLOCK IoStatus)
+{
+    PIMSCSI_PROXY_CACHE cache = (PIMSCSI_PROXY_CACHE)pLUExt->ProxyCache;
+    ULONG length = Length;
+    ULONG hits;
+    ULONG misses;
+    NTSTATUS status;
+
+    status = ImScsiCacheCoreRead(&cache->Core,
+        Buffer,
+        ByteOffset->QuadPart,
+        &length,
+        &hits,
+        &misses);
+
+    ImScsiCountCacheAccess(pLUExt, hits, misses);
+
+    IoStatus->Status = status;
+    IoStatus->Information = NT_SUCCESS(status) ? length : 0;
+
+    return status;
+}
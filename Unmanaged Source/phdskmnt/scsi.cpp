@@ -187,8 +187,6 @@ __in PKIRQL               LowestAssumedIrql
     switch (pSrb->Cdb[0])
     {
     case SCSIOP_TEST_UNIT_READY:
-    case SCSIOP_SYNCHRONIZE_CACHE:
-    case SCSIOP_SYNCHRONIZE_CACHE16:
     case SCSIOP_VERIFY:
     case SCSIOP_VERIFY16:
     case SCSIOP_RESERVE_UNIT:
@@ -198,6 +196,11 @@ __in PKIRQL               LowestAssumedIrql
         ScsiSetSuccess(pSrb, 0);
         break;
 
+    case SCSIOP_SYNCHRONIZE_CACHE:
+    case SCSIOP_SYNCHRONIZE_CACHE16:
+        ScsiOpSynchronizeCache(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+        break;
+
     case SCSIOP_START_STOP_UNIT:
         ScsiOpStartStopUnit(pHBAExt, pLUExt, pSrb, LowestAssumedIrql);
         break;
@@ -207,10 +210,16 @@ __in PKIRQL               LowestAssumedIrql
         break;
 
     case SCSIOP_READ_CAPACITY:
-    case SCSIOP_READ_CAPACITY16:
         ScsiOpReadCapacity(pHBAExt, pLUExt, pSrb);
         break;
 
+    case SCSIOP_READ_CAPACITY16:    // Also GET LBA STATUS, by service action
+        if ((pSrb->Cdb[1] & 0x1F) == SERVICE_ACTION_GET_LBA_STATUS)
+            ScsiOpGetLbaStatus(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+        else
+            ScsiOpReadCapacity(pHBAExt, pLUExt, pSrb);
+        break;
+
     case SCSIOP_READ:
     case SCSIOP_READ16:
     case SCSIOP_WRITE:
@@ -222,6 +231,19 @@ __in PKIRQL               LowestAssumedIrql
         ScsiOpUnmap(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
         break;
 
+    case SCSIOP_WRITE_SAME:
+    case SCSIOP_WRITE_SAME16:
+        ScsiOpWriteSame(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+        break;
+
+    case SCSIOP_POPULATE_TOKEN:     // Also WRITE USING TOKEN, by service action
+        ScsiOpTokenOperation(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+        break;
+
+    case SCSIOP_RECEIVE_ROD_TOKEN_INFORMATION:
+        ScsiOpReceiveRodTokenInformation(pHBAExt, pLUExt, pSrb, LowestAssumedIrql);
+        break;
+
     case SCSIOP_READ_TOC:
         ScsiOpReadTOC(pHBAExt, pLUExt, pSrb);
         break;
@@ -719,133 +741,308 @@ done:
     return;
 }                                                     // End ScsiOpInquiry.
 
-/**************************************************************************************************/
-/*                                                                                                */
-/**************************************************************************************************/
-UCHAR
-ScsiGetLUExtension(
-__in pHW_HBA_EXT								pHBAExt,      // Adapter device-object extension from port driver.
-pHW_LU_EXTENSION * ppLUExt,
-__in UCHAR									PathId,
-__in UCHAR									TargetId,
-__in UCHAR									Lun,
-__in PKIRQL                                 LowestAssumedIrql
-)
+//
+// LUs are found by direct index on PathId, TargetId and Lun in
+// pHBAExt->LUTable, without taking LUListLock. Entries are set and cleared
+// under LUListLock when LUs are created and removed, LUList is still used
+// for enumeration. A lookup only uses the LU while at DISPATCH_LEVEL or
+// above, in the port driver's dispatch of the request. Before memory of a
+// removed LU is freed, ImScsiWaitForLULookups waits until every processor
+// has dropped below DISPATCH_LEVEL once, so no lookup that found the LU
+// before it was removed from the table can still be using it.
+//
+// The table and a bitmap of device numbers in use are sized from the
+// NumberOfBuses, MaximumTargets and MaximumLuns registry values and stored
+// after HW_HBA_EXT in the adapter extension allocated by the port driver.
+// Index order is the same as the order device numbers have always been
+// auto-selected in: TargetId first, then Lun, then PathId.
+//
+
+static
+ULONG
+ImScsiGetLUTableSize()
 {
-    PLIST_ENTRY           list_ptr;
-    pHW_LU_EXTENSION *    pPortLunExt = NULL;
-    UCHAR                 status;
-    KLOCK_QUEUE_HANDLE    LockHandle;
+    return pMPDrvInfoGlobal->MPRegInfo.NumberOfBuses *
+        pMPDrvInfoGlobal->MPRegInfo.MaximumTargets *
+        pMPDrvInfoGlobal->MPRegInfo.MaximumLuns;
+}
 
-    *ppLUExt = NULL;
+static
+BOOLEAN
+ImScsiGetLUTableIndex(
+__in UCHAR      PathId,
+__in UCHAR      TargetId,
+__in UCHAR      Lun,
+__out PULONG    Index)
+{
+    if ((PathId >= pMPDrvInfoGlobal->MPRegInfo.NumberOfBuses) ||
+        (TargetId >= pMPDrvInfoGlobal->MPRegInfo.MaximumTargets) ||
+        (Lun >= pMPDrvInfoGlobal->MPRegInfo.MaximumLuns))
+    {
+        return FALSE;
+    }
 
-    KdPrint2(("PhDskMnt::ScsiGetLUExtension: %d:%d:%d\n", PathId, TargetId, Lun));
+    *Index = ((PathId * pMPDrvInfoGlobal->MPRegInfo.MaximumLuns) + Lun) *
+        pMPDrvInfoGlobal->MPRegInfo.MaximumTargets + TargetId;
 
-    ImScsiAcquireLock(                   // Serialize the linked list of LUN extensions.              
-        &pHBAExt->LUListLock, &LockHandle, *LowestAssumedIrql);
+    return TRUE;
+}
 
-    pPortLunExt = (pHW_LU_EXTENSION*)StoragePortGetLogicalUnit(pHBAExt, PathId, TargetId, Lun);
+ULONG
+ImScsiGetHBAExtensionSize()
+{
+    ULONG table_size = ImScsiGetLUTableSize();
 
-    if (pPortLunExt == NULL)
-    {
-        KdPrint(("PhDskMnt::ScsiGetLUExtension: StoragePortGetLogicalUnit failed for %d:%d:%d\n",
-            PathId,
-            TargetId,
-            Lun));
+    return sizeof(HW_HBA_EXT) +
+        (table_size * sizeof(pHW_LU_EXTENSION)) +
+        (((table_size + 31) / 32) * sizeof(ULONG));
+}
 
-        status = SRB_STATUS_NO_DEVICE;
-        goto done;
+VOID
+ImScsiInitializeLUTable(
+__in pHW_HBA_EXT      pHBAExt)
+{
+    ULONG table_size = ImScsiGetLUTableSize();
+
+    pHBAExt->LUTable = (pHW_LU_EXTENSION volatile*)(pHBAExt + 1);
+
+    RtlZeroMemory((PVOID)pHBAExt->LUTable,
+        table_size * sizeof(pHW_LU_EXTENSION));
+
+    RtlInitializeBitMap(&pHBAExt->DeviceNumbers,
+        (PULONG)(pHBAExt->LUTable + table_size), table_size);
+
+    RtlClearAllBits(&pHBAExt->DeviceNumbers);
+
+    pHBAExt->DeviceNumberHint = 0;
+
+#ifdef USE_SCSIPORT
+    // With SCSIPORT, reserve device 0:0:0 as control device
+    RtlSetBits(&pHBAExt->DeviceNumbers, 0, 1);
+    pHBAExt->DeviceNumberHint = 1;
+#endif
+}
+
+// Marks a device number as in use until ImScsiReleaseDeviceNumber. If
+// LongNumber is IMSCSI_AUTO_DEVICE_NUMBER, lowest free number is selected
+// and returned in DeviceNumber.
+NTSTATUS
+ImScsiReserveDeviceNumber(
+__in pHW_HBA_EXT              pHBAExt,
+__inout PDEVICE_NUMBER        DeviceNumber,
+__inout __deref PKIRQL        LowestAssumedIrql)
+{
+    KLOCK_QUEUE_HANDLE  LockHandle;
+    NTSTATUS            status = STATUS_SUCCESS;
+    ULONG               index;
+
+    if (DeviceNumber->LongNumber != IMSCSI_AUTO_DEVICE_NUMBER &&
+        !ImScsiGetLUTableIndex(DeviceNumber->PathId,
+        DeviceNumber->TargetId, DeviceNumber->Lun, &index))
+    {
+        return STATUS_INVALID_PARAMETER;
     }
 
-    if (*pPortLunExt != NULL)
+    ImScsiAcquireLock(&pHBAExt->LUListLock, &LockHandle, *LowestAssumedIrql);
+
+    if (DeviceNumber->LongNumber == IMSCSI_AUTO_DEVICE_NUMBER)
     {
-        pHW_LU_EXTENSION pLUExt = *pPortLunExt;
+        // Hint is always at or below lowest free number, so search from
+        // there finds lowest free number without scanning used ones.
+        index = RtlFindClearBitsAndSet(&pHBAExt->DeviceNumbers, 1,
+            pHBAExt->DeviceNumberHint);
 
-        if ((pLUExt->DeviceNumber.PathId != PathId) |
-            (pLUExt->DeviceNumber.TargetId != TargetId) |
-            (pLUExt->DeviceNumber.Lun != Lun))
+        if (index == 0xFFFFFFFF)
         {
-            DbgPrint("PhDskMnt::ScsiGetLUExtension: LUExt %p for device %i:%i:%i returned for device %i:%i:%i!\n",
-                pLUExt,
-                (int)pLUExt->DeviceNumber.PathId,
-                (int)pLUExt->DeviceNumber.TargetId,
-                (int)pLUExt->DeviceNumber.Lun,
-                (int)PathId,
-                (int)TargetId,
-                (int)Lun);
+            status = STATUS_NO_MORE_ENTRIES;
         }
-        else if (KeReadStateEvent(&pLUExt->StopThread))
+        else
         {
-            DbgPrint("PhDskMnt::ScsiGetLUExtension: Device %i:%i:%i is stopping. MP reports missing to port driver.\n",
-                (int)pLUExt->DeviceNumber.PathId,
-                (int)pLUExt->DeviceNumber.TargetId,
-                (int)pLUExt->DeviceNumber.Lun);
-
-            *pPortLunExt = NULL;
+            ULONG lun_index = index / pMPDrvInfoGlobal->MPRegInfo.MaximumTargets;
 
-            status = SRB_STATUS_NO_DEVICE;
+            pHBAExt->DeviceNumberHint = index + 1;
 
-            goto done;
+            DeviceNumber->LongNumber = 0;
+            DeviceNumber->TargetId = (UCHAR)(index % pMPDrvInfoGlobal->MPRegInfo.MaximumTargets);
+            DeviceNumber->Lun = (UCHAR)(lun_index % pMPDrvInfoGlobal->MPRegInfo.MaximumLuns);
+            DeviceNumber->PathId = (UCHAR)(lun_index / pMPDrvInfoGlobal->MPRegInfo.MaximumLuns);
         }
-        else
-        {
-            if (!KeReadStateEvent(&pLUExt->Initialized))
-            {
-                DbgPrint("PhDskMnt::ScsiGetLUExtension: Warning: Device is not yet initialized!\n");
-            }
+    }
+    else if (RtlCheckBit(&pHBAExt->DeviceNumbers, index))
+    {
+        status = STATUS_OBJECT_NAME_COLLISION;
+    }
+    else
+    {
+        RtlSetBits(&pHBAExt->DeviceNumbers, index, 1);
+    }
 
-            *ppLUExt = pLUExt;
+    ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
 
-            KdPrint2(("PhDskMnt::ScsiGetLUExtension: Device %d:%d:%d has pLUExt=0x%p\n",
-                PathId, TargetId, Lun, *ppLUExt));
+    return status;
+}
 
-            status = SRB_STATUS_SUCCESS;
+// Called with LUListLock held.
+VOID
+ImScsiReleaseDeviceNumber(
+__in pHW_HBA_EXT              pHBAExt,
+__in PDEVICE_NUMBER           DeviceNumber)
+{
+    ULONG index;
 
-            goto done;
-        }
+    if (!ImScsiGetLUTableIndex(DeviceNumber->PathId,
+        DeviceNumber->TargetId, DeviceNumber->Lun, &index))
+    {
+        return;
     }
 
-    for (list_ptr = pHBAExt->LUList.Flink;
-        list_ptr != &pHBAExt->LUList;
-        list_ptr = list_ptr->Flink
-        )
+    RtlClearBits(&pHBAExt->DeviceNumbers, index, 1);
+
+    if (index < pHBAExt->DeviceNumberHint)
     {
-        pHW_LU_EXTENSION object;
-        object = CONTAINING_RECORD(list_ptr, HW_LU_EXTENSION, List);
+        pHBAExt->DeviceNumberHint = index;
+    }
+}
+
+VOID
+ImScsiPublishLU(
+__in pHW_HBA_EXT      pHBAExt,
+__in pHW_LU_EXTENSION pLUExt)
+{
+    ULONG index;
+
+    if (!ImScsiGetLUTableIndex(pLUExt->DeviceNumber.PathId,
+        pLUExt->DeviceNumber.TargetId, pLUExt->DeviceNumber.Lun, &index))
+    {
+        return;
+    }
 
-        if ((object->DeviceNumber.PathId == PathId) &&
-            (object->DeviceNumber.TargetId == TargetId) &&
-            (object->DeviceNumber.Lun == Lun) &&
-            !KeReadStateEvent(&object->StopThread))
+    InterlockedExchangePointer((PVOID volatile*)
+        &pHBAExt->LUTable[index], pLUExt);
+}
+
+VOID
+ImScsiUnpublishLU(
+__in pHW_HBA_EXT      pHBAExt,
+__in pHW_LU_EXTENSION pLUExt)
+{
+    ULONG index;
+
+    if (!ImScsiGetLUTableIndex(pLUExt->DeviceNumber.PathId,
+        pLUExt->DeviceNumber.TargetId, pLUExt->DeviceNumber.Lun, &index))
+    {
+        return;
+    }
+
+    InterlockedCompareExchangePointer((PVOID volatile*)
+        &pHBAExt->LUTable[index], NULL, pLUExt);
+}
+
+VOID
+ImScsiWaitForLULookups()
+{
+    PAGED_CODE();
+
+#if _NT_TARGET_VERSION >= 0x601
+
+    ULONG processor_count = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+
+    for (ULONG i = 0; i < processor_count; i++)
+    {
+        PROCESSOR_NUMBER processor_number;
+        GROUP_AFFINITY affinity = { 0 };
+        GROUP_AFFINITY previous_affinity;
+
+        if (!NT_SUCCESS(KeGetProcessorNumberFromIndex(i, &processor_number)))
         {
-            *ppLUExt = object;
-            break;
+            continue;
         }
+
+        affinity.Group = processor_number.Group;
+        affinity.Mask = (KAFFINITY)1 << processor_number.Number;
+
+        // Returns when this thread runs on that processor.
+        KeSetSystemGroupAffinityThread(&affinity, &previous_affinity);
+        KeRevertToUserGroupAffinityThread(&previous_affinity);
     }
 
-    if (*ppLUExt == NULL)
+#else
+
+    KAFFINITY active_processors = KeQueryActiveProcessors();
+
+    for (ULONG i = 0; i < sizeof(KAFFINITY) * 8; i++)
     {
-        KdPrint2(("PhDskMnt::ScsiGetLUExtension: No saved data for Lun.\n"));
+        if (active_processors & ((KAFFINITY)1 << i))
+        {
+            // Returns when this thread runs on that processor.
+            KeSetSystemAffinityThread((KAFFINITY)1 << i);
+        }
+    }
 
-        status = SRB_STATUS_NO_DEVICE;
+    KeRevertToUserAffinityThread();
 
-        goto done;
+#endif
+}
+
+/**************************************************************************************************/
+/*                                                                                                */
+/**************************************************************************************************/
+UCHAR
+ScsiGetLUExtension(
+__in pHW_HBA_EXT								pHBAExt,      // Adapter device-object extension from port driver.
+pHW_LU_EXTENSION * ppLUExt,
+__in UCHAR									PathId,
+__in UCHAR									TargetId,
+__in UCHAR									Lun,
+__in PKIRQL                                 LowestAssumedIrql
+)
+{
+    pHW_LU_EXTENSION      pLUExt;
+    ULONG                 index;
+
+    UNREFERENCED_PARAMETER(LowestAssumedIrql);
+
+    *ppLUExt = NULL;
+
+    KdPrint2(("PhDskMnt::ScsiGetLUExtension: %d:%d:%d\n", PathId, TargetId, Lun));
+
+    if (!ImScsiGetLUTableIndex(PathId, TargetId, Lun, &index))
+    {
+        KdPrint2(("PhDskMnt::ScsiGetLUExtension: No such device address.\n"));
+
+        return SRB_STATUS_NO_DEVICE;
     }
 
-    *pPortLunExt = *ppLUExt;
+    pLUExt = pHBAExt->LUTable[index];
 
-    status = SRB_STATUS_SUCCESS;
+    if (pLUExt == NULL)
+    {
+        KdPrint2(("PhDskMnt::ScsiGetLUExtension: No saved data for Lun.\n"));
 
-    KdPrint(("PhDskMnt::ScsiGetLUExtension: Device %d:%d:%d get pLUExt=0x%p\n",
-        PathId, TargetId, Lun, *ppLUExt));
+        return SRB_STATUS_NO_DEVICE;
+    }
 
-done:
+    if (KeReadStateEvent(&pLUExt->StopThread))
+    {
+        DbgPrint("PhDskMnt::ScsiGetLUExtension: Device %i:%i:%i is stopping. MP reports missing to port driver.\n",
+            (int)PathId,
+            (int)TargetId,
+            (int)Lun);
 
-    ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
+        return SRB_STATUS_NO_DEVICE;
+    }
 
-    KdPrint2(("PhDskMnt::ScsiGetLUExtension: End: status=0x%X\n", (int)status));
+    if (!KeReadStateEvent(&pLUExt->Initialized))
+    {
+        DbgPrint("PhDskMnt::ScsiGetLUExtension: Warning: Device is not yet initialized!\n");
+    }
 
-    return status;
+    *ppLUExt = pLUExt;
+
+    KdPrint2(("PhDskMnt::ScsiGetLUExtension: Device %d:%d:%d has pLUExt=0x%p\n",
+        PathId, TargetId, Lun, pLUExt));
+
+    return SRB_STATUS_SUCCESS;
 }                                                     // End ScsiOpInquiry.
 
 #if 0 // Report no serial number for CD/DVD units
@@ -1015,7 +1212,7 @@ ScsiOpVPDDiskUnit(
         PVPD_SUPPORTED_PAGES_PAGE pSupportedPages;
         ULONG len;
 
-        len = FIELD_OFFSET(VPD_SUPPORTED_PAGES_PAGE, SupportedPageList) + 3;
+        len = FIELD_OFFSET(VPD_SUPPORTED_PAGES_PAGE, SupportedPageList) + 4;
 
         if (pSrb->DataTransferLength < len)
         {
@@ -1026,10 +1223,11 @@ ScsiOpVPDDiskUnit(
         pSupportedPages = (PVPD_SUPPORTED_PAGES_PAGE)pSrb->DataBuffer;             // Point to output buffer.
 
         pSupportedPages->PageCode = VPD_SUPPORTED_PAGES;
-        pSupportedPages->PageLength = 3;
+        pSupportedPages->PageLength = 4;
         pSupportedPages->SupportedPageList[0] = VPD_SUPPORTED_PAGES;
-        pSupportedPages->SupportedPageList[1] = VPD_BLOCK_LIMITS;
-        pSupportedPages->SupportedPageList[2] = VPD_LOGICAL_BLOCK_PROVISIONING;
+        pSupportedPages->SupportedPageList[1] = VPD_THIRD_PARTY_COPY;
+        pSupportedPages->SupportedPageList[2] = VPD_BLOCK_LIMITS;
+        pSupportedPages->SupportedPageList[3] = VPD_LOGICAL_BLOCK_PROVISIONING;
 
         ScsiSetSuccess(pSrb, len);
     }
@@ -1048,27 +1246,32 @@ ScsiOpVPDDiskUnit(
             outputBuffer->PageCode = VPD_BLOCK_LIMITS;
 
             // 
-            // leave outputBuffer->Descriptors[0 : 15] as '0' indicating 'not supported' for those fields. 
+            // Transfer limits of back end, see ImScsiQueryBackendLimits.
+            // Fields left as '0' are not reported.
             // 
 
+            // (2:3) OPTIMAL TRANSFER LENGTH GRANULARITY
+            USHORT optimalGranularity = (USHORT)min(MAXUSHORT,
+                pLUExt->OptimalTransferGranularity >> pLUExt->BlockPower);
+
+            REVERSE_BYTES_SHORT(&outputBuffer->Descriptors[2], &optimalGranularity);
+
+            // (4:7) MAXIMUM TRANSFER LENGTH
+            ULONG maxTransferLength = pLUExt->MaxTransferLength >> pLUExt->BlockPower;
+
+            REVERSE_BYTES(&outputBuffer->Descriptors[4], &maxTransferLength);
+
+            // (8:11) OPTIMAL TRANSFER LENGTH
+            ULONG optimalTransferLength = pLUExt->OptimalTransferLength >> pLUExt->BlockPower;
+
+            REVERSE_BYTES(&outputBuffer->Descriptors[8], &optimalTransferLength);
+
             if (pSrb->DataTransferLength >= 0x24)
             {
-                // not worry about multiply overflow as max of DsmCapBlockCount is min(AHCI_MAX_TRANSFER_LENGTH / ATA_BLOCK_SIZE, 0xFFFF) 
-                // calculate how many LBA ranges can be associated with one DSM - Trim command 
-                ULONG maxLbaRangeEntryCountPerCmd;
-                if (pLUExt->UseProxy &&
-                    pLUExt->Proxy.connection_type == PROXY_CONNECTION::PROXY_CONNECTION_SHM)
-                {
-                    ULONG_PTR max_dsrs =
-                        (pLUExt->Proxy.shared_memory_size - sizeof(IMDPROXY_HEADER_SIZE)) /
-                        sizeof(DEVICE_DATA_SET_RANGE);
-
-                    maxLbaRangeEntryCountPerCmd = (ULONG)min(MAXLONG, max_dsrs);
-                }
-                else
-                {
-                    maxLbaRangeEntryCountPerCmd = MAXLONG;
-                }
+                // calculate how many LBA ranges can be associated with one UNMAP command,
+                // limited by shared memory window of proxy
+                ULONG maxLbaRangeEntryCountPerCmd = pLUExt->MaxUnmapDescriptors != 0 ?
+                    pLUExt->MaxUnmapDescriptors : MAXLONG;
 
                 // calculate how many LBA can be associated with one DSM - Trim command 
                 ULONG maxLbaCountPerCmd = MAXLONG;
@@ -1086,7 +1289,34 @@ ScsiOpVPDDiskUnit(
 
                 // (24:27) OPTIMAL UNMAP GRANULARITY 
                 // (28:31) UNMAP GRANULARITY ALIGNMENT; (28) bit7: UGAVALID 
-                //leave '0' indicates un-supported. 
+                // Image offset decides where back end granularity starts.
+                ULONG unmapGranularity = pLUExt->UnmapGranularity >> pLUExt->BlockPower;
+
+                REVERSE_BYTES(&outputBuffer->Descriptors[24], &unmapGranularity);
+
+                if ((unmapGranularity != 0) &&
+                    ((pLUExt->ImageOffset.QuadPart & ((1LL << pLUExt->BlockPower) - 1)) == 0))
+                {
+                    ULONG unmapAlignment = (ULONG)(((pLUExt->UnmapGranularity -
+                        (pLUExt->ImageOffset.QuadPart % pLUExt->UnmapGranularity)) %
+                        pLUExt->UnmapGranularity) >> pLUExt->BlockPower);
+
+                    REVERSE_BYTES(&outputBuffer->Descriptors[28], &unmapAlignment);
+
+                    outputBuffer->Descriptors[28] |= 0x80;
+                }
+
+                if (pSrb->DataTransferLength >= 0x2C)
+                {
+                    // (32:39) MAXIMUM WRITE SAME LENGTH, limited by 32 bit
+                    // block count in WRITE SAME(16). (0) bit0: WSNZ, a block
+                    // count of zero is not supported.
+                    ULONGLONG maxWriteSameLength = MAXULONG;
+
+                    REVERSE_BYTES_QUAD(&outputBuffer->Descriptors[32], &maxWriteSameLength);
+
+                    outputBuffer->Descriptors[0] |= 0x01;
+                }
 
                 // keep original 'pSrb->DataTransferLength' value. 
             }
@@ -1116,8 +1346,8 @@ ScsiOpVPDDiskUnit(
             outputBuffer->DP = 0;
             outputBuffer->ANC_SUP = pLUExt->SupportsUnmap;
             outputBuffer->LBPRZ = 0;
-            outputBuffer->LBPWS10 = 0;                   // does not support WRITE SAME(10) 
-            outputBuffer->LBPWS = 0;                     // does not support WRITE SAME 
+            outputBuffer->LBPWS10 = pLUExt->SupportsZero;  // WRITE SAME(10) with UNMAP deallocates
+            outputBuffer->LBPWS = pLUExt->SupportsZero;    // WRITE SAME(16) with UNMAP deallocates
             outputBuffer->LBPU = pLUExt->SupportsUnmap;  // supports UNMAP
 
             ScsiSetSuccess(pSrb, 0x08);
@@ -1125,6 +1355,10 @@ ScsiOpVPDDiskUnit(
         break;
     }
 
+    case VPD_THIRD_PARTY_COPY:
+        ScsiOpVPDThirdPartyCopy(pLUExt, pSrb);
+        break;
+
     default:
         ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
     }
@@ -1324,6 +1558,10 @@ __in __deref PSCSI_REQUEST_BLOCK  pSrb
     {
         REVERSE_BYTES(&readCapacity16->BytesPerBlock, &blockSize);
         REVERSE_BYTES_QUAD(&readCapacity16->LogicalBlockAddress, &maxBlocks);
+
+        // LBPME, logical block provisioning and GET LBA STATUS supported
+        if (pLUExt->SupportsUnmap && (pSrb->DataTransferLength > 14))
+            ((PUCHAR)pSrb->DataBuffer)[14] |= 0x80;
     }
 
     KdPrint2(("PhDskMnt::ScsiOpReadCapacity:  End.\n"));
@@ -1348,42 +1586,24 @@ __in PUCHAR               pResult,
 __in PKIRQL               LowestAssumedIrql
 )
 {
-    PCDB                         pCdb = (PCDB)pSrb->Cdb;
-    LONGLONG                     startingSector;
-    LONGLONG                     startingOffset;
-    ULONG                        numBlocks;
+    IMSCSI_RW_REQUEST            request;
     pMP_WorkRtnParms             pWkRtnParms;
-    KLOCK_QUEUE_HANDLE           lock_handle;
 
     KdPrint2(("PhDskMnt::ScsiOpReadWrite:  pHBAExt = 0x%p, pLUExt=0x%p, pSrb=0x%p\n", pHBAExt, pLUExt, pSrb));
 
     *pResult = ResultDone;                            // Assume no queuing.
 
-    if ((pCdb->AsByte[0] == SCSIOP_READ16) |
-        (pCdb->AsByte[0] == SCSIOP_WRITE16))
-    {
-        REVERSE_BYTES_QUAD(&startingSector, pCdb->CDB16.LogicalBlock);
-    }
-    else
+    if (!ImScsiDecodeReadWrite(pSrb->Cdb, pSrb->DataTransferLength,
+        pLUExt->BlockPower, &request))
     {
-        startingSector = 0;
-        REVERSE_BYTES(&startingSector, &pCdb->CDB10.LogicalBlockByte0);
-    }
-
-    if (startingSector & ~(MAXLONGLONG >> pLUExt->BlockPower))
-    {      // Check if startingSector << blockPower fits within a LONGLONG.
-        KdPrint(("PhDskMnt::ScsiOpReadWrite: Too large sector number: %I64X\n", startingSector));
+        KdPrint(("PhDskMnt::ScsiOpReadWrite: Too large sector number: %I64X\n", request.StartingSector));
 
         ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
 
         return;
     }
 
-    startingOffset = startingSector << pLUExt->BlockPower;
-
-    numBlocks = pSrb->DataTransferLength >> pLUExt->BlockPower;
-
-    KdPrint2(("PhDskMnt::ScsiOpReadWrite action: 0x%X, starting sector: 0x%I64X, number of blocks: 0x%X\n", (int)pSrb->Cdb[0], startingSector, numBlocks));
+    KdPrint2(("PhDskMnt::ScsiOpReadWrite action: 0x%X, starting sector: 0x%I64X, number of blocks: 0x%X\n", (int)pSrb->Cdb[0], request.StartingSector, request.NumBlocks));
     KdPrint2(("PhDskMnt::ScsiOpReadWrite pSrb: 0x%p, pSrb->DataBuffer: 0x%p\n", pSrb, pSrb->DataBuffer));
 
     if (!KeReadStateEvent(&pLUExt->Initialized))
@@ -1410,117 +1630,126 @@ __in PKIRQL               LowestAssumedIrql
         return;
     }
 
-    // Check write protection
-    if (((pSrb->Cdb[0] == SCSIOP_WRITE) |
-        (pSrb->Cdb[0] == SCSIOP_WRITE16)) &&
-        pLUExt->ReadOnly)
+    // Check write protection and disk bounds
+    switch (ImScsiCheckReadWrite(&request, pLUExt->DiskSize.QuadPart,
+        pLUExt->BlockPower, pLUExt->ReadOnly))
     {
+    case IMSCSI_RW_WRITE_PROTECTED:
         KdPrint(("PhDskMnt::ScsiOpReadWrite: Rejected. Write attempt on read-only device.\n"));
 
         ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_DATA_PROTECT, SCSI_ADSENSE_WRITE_PROTECT, 0);
 
         return;
-    }
 
-    // Check disk bounds
-    if ((startingSector + numBlocks) > (pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower))
-    {      // Starting sector beyond the bounds?
-        KdPrint(("PhDskMnt::ScsiOpReadWrite: Out of bounds: sector: %I64X, blocks: %d\n", startingSector, numBlocks));
+    case IMSCSI_RW_OUT_OF_BOUNDS:
+        KdPrint(("PhDskMnt::ScsiOpReadWrite: Out of bounds: sector: %I64X, blocks: %d\n", request.StartingSector, request.NumBlocks));
 
         ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
 
         return;
     }
 
-    // Intermediate non-paged cache
-    if (pLUExt->FileObject == NULL)
+    // Tokens of this LU are no longer valid
+    if (request.Write)
     {
-        ImScsiAcquireLock(&pLUExt->LastIoLock, &lock_handle, *LowestAssumedIrql);
+        InterlockedIncrement(&pLUExt->WriteGeneration);
+    }
 
-        if (((pSrb->Cdb[0] == SCSIOP_READ) |
-            (pSrb->Cdb[0] == SCSIOP_READ16)) &
-            (pLUExt->LastIoBuffer != NULL) &
-            (pLUExt->LastIoStartSector <= startingSector) &
-            ((startingOffset - (pLUExt->LastIoStartSector << pLUExt->BlockPower) + pSrb->DataTransferLength) <= pLUExt->LastIoLength))
+    // Intermediate non-paged cache. Unlocked check is only a hint, it is
+    // repeated under lock by ImScsiCoreReadLastIo.
+    if ((pLUExt->FileObject == NULL) &&
+        (pLUExt->Core.LastIo.Buffer != NULL) &&
+        ImScsiLastIoCovers(&request, pSrb->DataTransferLength,
+        pLUExt->BlockPower, pLUExt->Core.LastIo.StartSector,
+        pLUExt->Core.LastIo.Length))
+    {
+        PVOID sysaddress = NULL;
+        ULONG storage_status;
+
+        storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, &sysaddress);
+        if ((storage_status != STORAGE_STATUS_SUCCESS) | (sysaddress == NULL))
         {
-            PVOID sysaddress = NULL;
-            ULONG storage_status;
+            DbgPrint("PhDskMnt::ScsiOpReadWrite: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
+                storage_status,
+                pSrb->DataBuffer,
+                sysaddress);
 
-            storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, &sysaddress);
-            if ((storage_status != STORAGE_STATUS_SUCCESS) | (sysaddress == NULL))
-            {
-                ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+            ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
 
-                DbgPrint("PhDskMnt::ScsiOpReadWrite: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
-                    storage_status,
-                    pSrb->DataBuffer,
-                    sysaddress);
+            return;
+        }
 
-                ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
-            }
-            else
-            {
-                KdPrint(("PhDskMnt::ScsiOpReadWrite: Intermediate cache hit.\n"));
+        if (ImScsiCoreReadLastIo(&pLUExt->Core.LastIo, &request,
+            pSrb->DataTransferLength, pLUExt->BlockPower, sysaddress,
+            LowestAssumedIrql))
+        {
+            KdPrint(("PhDskMnt::ScsiOpReadWrite: Intermediate cache hit.\n"));
 
-                RtlMoveMemory(
-                    sysaddress,
-                    (PUCHAR)pLUExt->LastIoBuffer + startingOffset - (pLUExt->LastIoStartSector << pLUExt->BlockPower),
-                    pSrb->DataTransferLength
-                    );
+            ImScsiCountCacheAccess(pLUExt, 1, 0);
 
-                ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
 
-                ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
-            }
+            ImScsiCountRequest(pLUExt, pSrb, 0);
 
             return;
         }
-
-        ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
-    }
-
-    pWkRtnParms =                                     // Allocate parm area for work routine.
-        (pMP_WorkRtnParms)ExAllocatePoolWithTag(NonPagedPool, sizeof(MP_WorkRtnParms), MP_TAG_GENERAL);
-
-    if (pWkRtnParms == NULL)
-    {
-        DbgPrint("PhDskMnt::ScsiOpReadWrite Failed to allocate work parm structure\n");
-
-        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
-        return;
     }
 
-    RtlZeroMemory(pWkRtnParms, sizeof(MP_WorkRtnParms));
-
-    pWkRtnParms->pHBAExt = pHBAExt;
-    pWkRtnParms->pLUExt = pLUExt;
-    pWkRtnParms->pSrb = pSrb;
-
     if (pLUExt->FileObject != NULL)
     {
         // Service work item directly in calling thread context.
 
-        ImScsiParallelReadWriteImage(pWkRtnParms, pResult, LowestAssumedIrql);
+        pWkRtnParms = ImScsiAllocateWorkItem(pHBAExt, pLUExt, pSrb);
+
+        if (pWkRtnParms != NULL)
+        {
+            ImScsiParallelReadWriteImage(pWkRtnParms, pResult, LowestAssumedIrql);
+        }
     }
     else
     {
         // Queue work item, which will run in the System process.
 
-        KdPrint2(("PhDskMnt::ScsiOpReadWrite: Queuing work=0x%p\n", pWkRtnParms));
+        ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+    }
 
-        ImScsiAcquireLock(&pLUExt->RequestListLock, &lock_handle, *LowestAssumedIrql);
+    KdPrint2(("PhDskMnt::ScsiOpReadWrite:  End. *Result=%i\n", (INT)*pResult));
+}                                                     // End ScsiReadWriteSetup.
 
-        InsertTailList(&pLUExt->RequestList, &pWkRtnParms->RequestListEntry);
+//
+// Caching mode page, appended to MODE SENSE data when requested. Write
+// cache is reported enabled for write-back LUs. MODE SELECT is not
+// supported, so no bits are reported changeable. Returns page length,
+// which may be larger than what fitted in buffer.
+//
+static
+ULONG
+ScsiGetCachingModePage(
+__in_opt pHW_LU_EXTENSION     pLUExt,
+__in UCHAR                    PageControl,    // Byte 2 in MODE SENSE CDB
+__out_bcount(Length) PUCHAR   Buffer,
+__in ULONG                    Length
+)
+{
+    MODE_CACHING_PAGE caching_page = { 0 };
 
-        ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+    if (((PageControl & 0x3F) != MODE_PAGE_CACHING) &&
+        ((PageControl & 0x3F) != MODE_SENSE_RETURN_ALL))
+    {
+        return 0;
+    }
 
-        KeSetEvent(&pLUExt->RequestEvent, (KPRIORITY)0, FALSE);
+    caching_page.PageCode = MODE_PAGE_CACHING;
+    caching_page.PageLength = sizeof(MODE_CACHING_PAGE) - 2;
 
-        *pResult = ResultQueued;                          // Indicate queuing.
-    }
+    if (((PageControl & 0xC0) != MODE_SENSE_CHANGEABLE_VALUES) &&
+        (pLUExt != NULL ? pLUExt->Core.WriteBack : FALSE))
+        caching_page.WriteCacheEnable = 1;
 
-    KdPrint2(("PhDskMnt::ScsiOpReadWrite:  End. *Result=%i\n", (INT)*pResult));
-}                                                     // End ScsiReadWriteSetup.
+    RtlCopyMemory(Buffer, &caching_page, min(Length, sizeof(MODE_CACHING_PAGE)));
+
+    return sizeof(MODE_CACHING_PAGE);
+}
 
 /**************************************************************************************************/
 /*                                                                                                */
@@ -1551,6 +1780,12 @@ __in __deref PSCSI_REQUEST_BLOCK  pSrb
     if (pLUExt != NULL ? pLUExt->ReadOnly : FALSE)
         mph->DeviceSpecificParameter = MODE_DSP_WRITE_PROTECT;
 
+    if (pLUExt != NULL ? pLUExt->Core.WriteBack : FALSE)
+        mph->DeviceSpecificParameter |= MODE_DSP_FUA_SUPPORTED;
+
+    mph->ModeDataLength += (UCHAR)ScsiGetCachingModePage(pLUExt, pSrb->Cdb[2],
+        (PUCHAR)(mph + 1), pSrb->DataTransferLength - sizeof(MODE_PARAMETER_HEADER));
+
     if (pLUExt != NULL ? pLUExt->RemovableMedia : FALSE)
         mph->MediumType = RemovableMedia;
 
@@ -1570,7 +1805,6 @@ __in __deref PSCSI_REQUEST_BLOCK  pSrb
     PMODE_PARAMETER_HEADER10 mph = (PMODE_PARAMETER_HEADER10)pSrb->DataBuffer;
 
     UNREFERENCED_PARAMETER(pHBAExt);
-    UNREFERENCED_PARAMETER(pLUExt);
 
     KdPrint(("PhDskMnt::ScsiOpModeSense10:  pHBAExt = 0x%p, pLUExt=0x%p, pSrb=0x%p\n", pHBAExt, pLUExt, pSrb));
 
@@ -1587,6 +1821,12 @@ __in __deref PSCSI_REQUEST_BLOCK  pSrb
     if (pLUExt != NULL ? pLUExt->ReadOnly : FALSE)
         mph->DeviceSpecificParameter = MODE_DSP_WRITE_PROTECT;
 
+    if (pLUExt != NULL ? pLUExt->Core.WriteBack : FALSE)
+        mph->DeviceSpecificParameter |= MODE_DSP_FUA_SUPPORTED;
+
+    mph->ModeDataLength[1] += (UCHAR)ScsiGetCachingModePage(pLUExt, pSrb->Cdb[2],
+        (PUCHAR)(mph + 1), pSrb->DataTransferLength - sizeof(MODE_PARAMETER_HEADER10));
+
     if (pLUExt != NULL ? pLUExt->RemovableMedia : FALSE)
         mph->MediumType = RemovableMedia;
 
@@ -1603,7 +1843,8 @@ __in    __deref PSCSI_REQUEST_BLOCK pSrb,
 __inout __deref PKIRQL              LowestAssumedIrql
 )
 {
-    UCHAR                 count;
+    ULONG                 count;
+    ULONG                 list_length;
     PLIST_ENTRY           list_ptr;
     PLUN_LIST             pLunList = (PLUN_LIST)pSrb->DataBuffer; // Point to LUN list.
     KLOCK_QUEUE_HANDLE    LockHandle;
@@ -1619,7 +1860,7 @@ __inout __deref PKIRQL              LowestAssumedIrql
         &pHBAExt->LUListLock, &LockHandle, *LowestAssumedIrql);
 
     for (count = 0, list_ptr = pHBAExt->LUList.Flink;
-        (count < MAX_LUNS) & (list_ptr != &pHBAExt->LUList);
+        (count < pMPDrvInfoGlobal->MPRegInfo.MaximumLuns) & (list_ptr != &pHBAExt->LUList);
         list_ptr = list_ptr->Flink
         )
     {
@@ -1628,20 +1869,24 @@ __inout __deref PKIRQL              LowestAssumedIrql
 
         if ((object->DeviceNumber.PathId == pSrb->PathId) &
             (object->DeviceNumber.TargetId == pSrb->TargetId))
-            if (pSrb->DataTransferLength >= FIELD_OFFSET(LUN_LIST, Lun) + (sizeof(pLunList->Lun[0])*count))
-                pLunList->Lun[count++][1] = object->DeviceNumber.Lun;
-            else
-                break;
+        {
+            // Entries that do not fit are still counted in list length,
+            // so that initiator can retry with a large enough buffer.
+            if (pSrb->DataTransferLength >= FIELD_OFFSET(LUN_LIST, Lun) + (sizeof(pLunList->Lun[0])*(count + 1)))
+                pLunList->Lun[count][1] = object->DeviceNumber.Lun;
+
+            count++;
+        }
     }
 
     ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
 
-    KdPrint(("PhDskMnt::ScsiOpReportLuns:  Reported %i LUNs\n", (int)count));
+    KdPrint(("PhDskMnt::ScsiOpReportLuns:  Reported %u LUNs\n", count));
 
-    pLunList->LunListLength[3] =                  // Set length needed for LUNs.
-        (UCHAR)(8 * count);
+    list_length = 8 * count;                          // Set length needed for LUNs, big endian.
 
-    // Set the LUN numbers if there is enough room, and set only those LUNs to be reported.
+    if (pSrb->DataTransferLength >= sizeof(pLunList->LunListLength))
+        REVERSE_BYTES(pLunList->LunListLength, &list_length);
 
     ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
 
@@ -1757,40 +2002,223 @@ ScsiOpUnmap(
         }
     }
 
-    pMP_WorkRtnParms pWkRtnParms =                                     // Allocate parm area for work routine.
-        (pMP_WorkRtnParms)ExAllocatePoolWithTag(NonPagedPool, sizeof(MP_WorkRtnParms), MP_TAG_GENERAL);
+    // Tokens of this LU are no longer valid
+    InterlockedIncrement(&pLUExt->WriteGeneration);
+
+    // Queue work item, which will run in the System process.
+    ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+
+    KdPrint2(("PhDskMnt::ScsiOpUnmap:  End. *Result=%i\n", (INT)*pResult));
+}
+
+VOID
+ScsiGetWriteSameRange(
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __out PLARGE_INTEGER      StartingSector,
+    __out PULONG              NumBlocks,
+    __out PBOOLEAN            NoDataOut
+    )
+{
+    *NumBlocks = 0;
+    StartingSector->QuadPart = 0;
+
+    if (pSrb->Cdb[0] == SCSIOP_WRITE_SAME16)
+    {
+        REVERSE_BYTES_QUAD(StartingSector, &pSrb->Cdb[2]);
+        REVERSE_BYTES(NumBlocks, &pSrb->Cdb[10]);
+        *NoDataOut = (pSrb->Cdb[1] & 0x01) != 0;       // NDOB, pattern is zeros
+    }
+    else
+    {
+        REVERSE_BYTES(StartingSector, &pSrb->Cdb[2]);
+        REVERSE_BYTES_SHORT(NumBlocks, &pSrb->Cdb[7]);
+        *NoDataOut = FALSE;
+    }
+}
+
+// WRITE SAME(10/16). The UNMAP bit needs no special handling: a zero
+// pattern is written through ImScsiZeroDevice, which deallocates in sparse
+// image files and sends IMDPROXY_REQ_ZERO to proxies.
+VOID
+ScsiOpWriteSame(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PUCHAR               pResult,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    LARGE_INTEGER startingSector;
+    ULONG numBlocks;
+    BOOLEAN noDataOut;
+
+    KdPrint2(("PhDskMnt::ScsiOpWriteSame:  pHBAExt = 0x%p, pSrb=0x%p\n", pHBAExt, pSrb));
+
+    ScsiGetWriteSameRange(pSrb, &startingSector, &numBlocks, &noDataOut);
+
+    // Check device shutdown condition
+    if (KeReadStateEvent(&pLUExt->StopThread))
+    {
+        KdPrint(("PhDskMnt::ScsiOpWriteSame: Rejected. Device shutting down.\n"));
+
+        ScsiSetError(pSrb, SRB_STATUS_NO_DEVICE);
+
+        return;
+    }
+
+    // Check write protection
+    if (pLUExt->ReadOnly)
+    {
+        KdPrint(("PhDskMnt::ScsiOpWriteSame: Rejected. Write attempt on read-only device.\n"));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_DATA_PROTECT, SCSI_ADSENSE_WRITE_PROTECT, 0);
 
-    if (pWkRtnParms == NULL)
+        return;
+    }
+
+    // Block count zero means rest of disk, not supported (WSNZ in block limits page)
+    if ((numBlocks == 0) ||
+        ((!noDataOut) && (pSrb->DataTransferLength < (1UL << pLUExt->BlockPower))))
     {
-        DbgPrint("PhDskMnt::ScsiOpUnmap Failed to allocate work parm structure\n");
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_INVALID_CDB, 0);
+        return;
+    }
+
+    if (startingSector.QuadPart & ~(MAXLONGLONG >> pLUExt->BlockPower))
+    {      // Check if startingSector << blockPower fits within a LONGLONG.
+        KdPrint(("PhDskMnt::ScsiOpWriteSame: Too large sector number: %I64X\n", startingSector));
 
-        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
         return;
     }
 
-    RtlZeroMemory(pWkRtnParms, sizeof(MP_WorkRtnParms));
+    // Check disk bounds
+    if ((startingSector.QuadPart + numBlocks) > (pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower))
+    {      // Starting sector beyond the bounds?
+        KdPrint(("PhDskMnt::ScsiOpWriteSame: Out of bounds: sector: %I64X, blocks: %u\n", startingSector, numBlocks));
+
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
+        return;
+    }
 
-    pWkRtnParms->pHBAExt = pHBAExt;
-    pWkRtnParms->pLUExt = pLUExt;
-    pWkRtnParms->pSrb = pSrb;
+    // Tokens of this LU are no longer valid
+    InterlockedIncrement(&pLUExt->WriteGeneration);
 
     // Queue work item, which will run in the System process.
+    ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
 
-    KdPrint2(("PhDskMnt::ScsiOpUnmap: Queuing work=0x%p\n", pWkRtnParms));
+    KdPrint2(("PhDskMnt::ScsiOpWriteSame:  End. *Result=%i\n", (INT)*pResult));
+}
 
-    KLOCK_QUEUE_HANDLE           lock_handle;
+VOID
+ScsiOpGetLbaStatus(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PUCHAR               pResult,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    ULONGLONG startingLba;
+    ULONG allocationLength;
 
-    ImScsiAcquireLock(&pLUExt->RequestListLock, &lock_handle, *LowestAssumedIrql);
+    KdPrint2(("PhDskMnt::ScsiOpGetLbaStatus:  pHBAExt = 0x%p, pSrb=0x%p\n", pHBAExt, pSrb));
 
-    InsertTailList(&pLUExt->RequestList, &pWkRtnParms->RequestListEntry);
+    REVERSE_BYTES_QUAD(&startingLba, &pSrb->Cdb[2]);
+    REVERSE_BYTES(&allocationLength, &pSrb->Cdb[10]);
 
-    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+    if ((allocationLength == 0) || (pSrb->DataTransferLength == 0))
+    {
+        ScsiSetSuccess(pSrb, 0);
+        return;
+    }
 
-    KeSetEvent(&pLUExt->RequestEvent, (KPRIORITY)0, FALSE);
+    // Check disk bounds
+    if (startingLba >= (ULONGLONG)(pLUExt->DiskSize.QuadPart >> pLUExt->BlockPower))
+    {
+        KdPrint(("PhDskMnt::ScsiOpGetLbaStatus: Out of bounds: LBA: %I64X\n", startingLba));
 
-    *pResult = ResultQueued;                          // Indicate queuing.
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ADSENSE_ILLEGAL_BLOCK, 0);
+        return;
+    }
 
-    KdPrint2(("PhDskMnt::ScsiOpUnmap:  End. *Result=%i\n", (INT)*pResult));
+    // Check device shutdown condition
+    if (KeReadStateEvent(&pLUExt->StopThread))
+    {
+        KdPrint(("PhDskMnt::ScsiOpGetLbaStatus: Rejected. Device shutting down.\n"));
+
+        ScsiSetError(pSrb, SRB_STATUS_NO_DEVICE);
+
+        return;
+    }
+
+    // Allocation information comes from image file, VM disk chunk table or
+    // proxy, all accessed from worker thread.
+    ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+
+    KdPrint2(("PhDskMnt::ScsiOpGetLbaStatus:  End. *Result=%i\n", (INT)*pResult));
+}
+
+VOID
+ScsiOpSynchronizeCache(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PUCHAR               pResult,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    KdPrint2(("PhDskMnt::ScsiOpSynchronizeCache:  pHBAExt = 0x%p, pSrb=0x%p\n", pHBAExt, pSrb));
+
+    // Without write-back, all writes are already written through
+    if (!pLUExt->Core.WriteBack)
+    {
+        ScsiSetSuccess(pSrb, 0);
+        return;
+    }
+
+    // Check device shutdown condition, data is flushed by ImScsiCleanupLU
+    if (KeReadStateEvent(&pLUExt->StopThread))
+    {
+        KdPrint(("PhDskMnt::ScsiOpSynchronizeCache: Rejected. Device shutting down.\n"));
+
+        ScsiSetError(pSrb, SRB_STATUS_NO_DEVICE);
+
+        return;
+    }
+
+    // Queue work item, flush is ordered after writes already queued.
+    ImScsiQueueWorkItem(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
+
+    KdPrint2(("PhDskMnt::ScsiOpSynchronizeCache:  End. *Result=%i\n", (INT)*pResult));
+}
+
+//
+// SRB_FUNCTION_SHUTDOWN and SRB_FUNCTION_FLUSH are sent by class driver
+// at system shutdown and when disk is flushed without SCSI CDB.
+//
+VOID
+ScsiOpFlush(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __in PUCHAR               pResult,
+    __in PKIRQL               LowestAssumedIrql
+    )
+{
+    pHW_LU_EXTENSION pLUExt = NULL;
+    UCHAR status;
+
+    status = ScsiGetLUExtension(pHBAExt, &pLUExt, pSrb->PathId,
+        pSrb->TargetId, pSrb->Lun, LowestAssumedIrql);
+
+    if ((status != SRB_STATUS_SUCCESS) || (pLUExt == NULL) ||
+        !KeReadStateEvent(&pLUExt->Initialized))
+    {
+        ScsiSetSuccess(pSrb, 0);
+        return;
+    }
+
+    ScsiOpSynchronizeCache(pHBAExt, pLUExt, pSrb, pResult, LowestAssumedIrql);
 }
 
 VOID
@@ -0,0 +1,419 @@
+/// segments.cpp
+/// Split raw images, where image contents are stored in several segment
+/// files, such as image.001, image.002 and so on.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#pragma warning(disable : 4204)
+#pragma warning(disable : 4221)
+
+//
+// Segment table has one entry per segment file, in image order, so that
+// StartOffset is increasing. Segment for an image offset is found with a
+// binary search. Requests that span segment boundaries are split and the
+// parts are sent to all segments involved before waiting for any of them.
+//
+// First segment is the image file opened by ImScsiInitializeLU, other
+// segments are opened here with the same access and options. Requests are
+// sent as non-cached IRPs directly to the file objects, so all segments
+// except the last one must have a size that is a multiple of sector size.
+//
+
+//
+// Returns index of segment that holds image offset, or last segment if
+// offset is beyond end of image.
+//
+ULONG
+ImScsiFindImageSegment(__in pHW_LU_EXTENSION pLUExt,
+__in LONGLONG Offset)
+{
+    ULONG low = 0;
+    ULONG high = pLUExt->SegmentCount - 1;
+
+    while (low < high)
+    {
+        ULONG middle = low + ((high - low + 1) >> 1);
+
+        if (pLUExt->Segments[middle].StartOffset <= Offset)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+NTSTATUS
+ImScsiOpenImageSegments(
+__in pHW_LU_EXTENSION pLUExt,
+__in PUNICODE_STRING  SegmentNames,
+__out PLARGE_INTEGER  ImageSize)
+{
+    NTSTATUS status;
+    IO_STATUS_BLOCK io_status;
+    ULONG count = 1;
+    ULONG i;
+    USHORT name_start;
+    USHORT name_chars = SegmentNames->Length / sizeof(*SegmentNames->Buffer);
+    LONGLONG start_offset = 0;
+    ACCESS_MASK desired_access = GENERIC_READ;
+    ULONG share_access = FILE_SHARE_READ | FILE_SHARE_DELETE;
+
+    ASSERT(pLUExt->ImageFile != NULL);
+
+    for (i = 0; i < name_chars; i++)
+    {
+        if ((SegmentNames->Buffer[i] != 0) &&
+            ((i == 0) || (SegmentNames->Buffer[i - 1] == 0)))
+        {
+            count++;
+        }
+    }
+
+    KdPrint(("PhDskMnt::ImScsiOpenImageSegments: Opening image with %u segments.\n",
+        count));
+
+    pLUExt->Segments = (PIMSCSI_IMAGE_SEGMENT)ExAllocatePoolWithTag(NonPagedPool,
+        count * sizeof(IMSCSI_IMAGE_SEGMENT), MP_TAG_GENERAL);
+
+    if (pLUExt->Segments == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(pLUExt->Segments, count * sizeof(IMSCSI_IMAGE_SEGMENT));
+
+    if (SegmentNames->Length > 0)
+    {
+        pLUExt->SegmentNames.Buffer = (PWCHAR)ExAllocatePoolWithTag(PagedPool,
+            SegmentNames->Length, MP_TAG_GENERAL);
+
+        if (pLUExt->SegmentNames.Buffer == NULL)
+        {
+            ImScsiCloseImageSegments(pLUExt);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlCopyMemory(pLUExt->SegmentNames.Buffer, SegmentNames->Buffer,
+            SegmentNames->Length);
+
+        pLUExt->SegmentNames.Length = SegmentNames->Length;
+        pLUExt->SegmentNames.MaximumLength = SegmentNames->Length;
+    }
+
+    if (!pLUExt->ReadOnly)
+    {
+        desired_access |= GENERIC_WRITE;
+    }
+    else
+    {
+        share_access |= FILE_SHARE_WRITE;
+    }
+
+    name_start = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        PIMSCSI_IMAGE_SEGMENT segment = &pLUExt->Segments[i];
+        HANDLE file_handle;
+        LARGE_INTEGER segment_size;
+
+        pLUExt->SegmentCount = i + 1;
+
+        KeInitializeEvent(&segment->Event, NotificationEvent, FALSE);
+
+        if (i == 0)
+        {
+            file_handle = pLUExt->ImageFile;
+        }
+        else
+        {
+            OBJECT_ATTRIBUTES object_attributes;
+            UNICODE_STRING segment_name;
+            USHORT name_end;
+
+            while ((name_start < name_chars) &&
+                (SegmentNames->Buffer[name_start] == 0))
+            {
+                name_start++;
+            }
+
+            name_end = name_start;
+
+            while ((name_end < name_chars) &&
+                (SegmentNames->Buffer[name_end] != 0))
+            {
+                name_end++;
+            }
+
+            segment_name.Buffer = SegmentNames->Buffer + name_start;
+            segment_name.Length = (USHORT)((name_end - name_start) *
+                sizeof(*SegmentNames->Buffer));
+            segment_name.MaximumLength = segment_name.Length;
+
+            name_start = name_end;
+
+            InitializeObjectAttributes(&object_attributes,
+                &segment_name,
+                OBJ_CASE_INSENSITIVE |
+                OBJ_FORCE_ACCESS_CHECK,
+                NULL,
+                NULL);
+
+            status = ZwCreateFile(
+                &segment->FileHandle,
+                desired_access,
+                &object_attributes,
+                &io_status,
+                NULL,
+                FILE_ATTRIBUTE_NORMAL,
+                share_access,
+                FILE_OPEN,
+                FILE_NON_DIRECTORY_FILE |
+                FILE_NO_INTERMEDIATE_BUFFERING |
+                FILE_RANDOM_ACCESS |
+                FILE_SYNCHRONOUS_IO_NONALERT,
+                NULL,
+                0);
+
+            if (!NT_SUCCESS(status))
+            {
+                KdPrint(("PhDskMnt::ImScsiOpenImageSegments: Cannot open '%wZ' (%#x).\n",
+                    &segment_name, status));
+
+                segment->FileHandle = NULL;
+                ImScsiCloseImageSegments(pLUExt);
+                return status;
+            }
+
+            file_handle = segment->FileHandle;
+        }
+
+        status = ImScsiGetDiskSize(file_handle, &io_status, &segment_size);
+
+        if (NT_SUCCESS(status))
+        {
+            status = ObReferenceObjectByHandle(file_handle,
+                FILE_READ_DATA | (pLUExt->ReadOnly ? 0 : FILE_WRITE_DATA),
+                *IoFileObjectType,
+                KernelMode,
+                (PVOID*)&segment->FileObject,
+                NULL);
+
+            if (!NT_SUCCESS(status))
+            {
+                segment->FileObject = NULL;
+            }
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            DbgPrint("PhDskMnt::ImScsiOpenImageSegments: Cannot use segment %u (%#x).\n",
+                i, status);
+
+            ImScsiCloseImageSegments(pLUExt);
+            return status;
+        }
+
+        // Parts of requests are sent to segments as sector aligned
+        // non-cached requests.
+        if ((i + 1 < count) &&
+            ((segment_size.QuadPart & ((1LL << pLUExt->BlockPower) - 1)) != 0))
+        {
+            DbgPrint("PhDskMnt::ImScsiOpenImageSegments: Size of segment %u, 0x%I64X, is not a multiple of sector size.\n",
+                i, segment_size.QuadPart);
+
+            ImScsiCloseImageSegments(pLUExt);
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        segment->StartOffset = start_offset;
+        segment->Length = segment_size.QuadPart;
+
+        start_offset += segment_size.QuadPart;
+    }
+
+    ImageSize->QuadPart = start_offset;
+
+    KdPrint(("PhDskMnt::ImScsiOpenImageSegments: Total image size 0x%I64X.\n",
+        start_offset));
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiCloseImageSegments(
+__in pHW_LU_EXTENSION pLUExt)
+{
+    if (pLUExt->Segments != NULL)
+    {
+        for (ULONG i = 0; i < pLUExt->SegmentCount; i++)
+        {
+            if (pLUExt->Segments[i].FileObject != NULL)
+            {
+                ObDereferenceObject(pLUExt->Segments[i].FileObject);
+            }
+
+            if (pLUExt->Segments[i].FileHandle != NULL)
+            {
+                ZwClose(pLUExt->Segments[i].FileHandle);
+            }
+        }
+
+        ExFreePoolWithTag(pLUExt->Segments, MP_TAG_GENERAL);
+        pLUExt->Segments = NULL;
+        pLUExt->SegmentCount = 0;
+    }
+
+    if (pLUExt->SegmentNames.Buffer != NULL)
+    {
+        ExFreePoolWithTag(pLUExt->SegmentNames.Buffer, MP_TAG_GENERAL);
+        pLUExt->SegmentNames.Buffer = NULL;
+        pLUExt->SegmentNames.Length = 0;
+        pLUExt->SegmentNames.MaximumLength = 0;
+    }
+}
+
+NTSTATUS
+ImScsiReadWriteSegments(
+__in pHW_LU_EXTENSION pLUExt,
+__in UCHAR            MajorFunction,
+__in PVOID            Buffer,
+__in PLARGE_INTEGER   ByteOffset,
+__in ULONG            Length,
+__out PIO_STATUS_BLOCK IoStatus)
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PUCHAR buffer = (PUCHAR)Buffer;
+    LONGLONG position = ByteOffset->QuadPart;
+    ULONG length_done = 0;
+    ULONG first = ImScsiFindImageSegment(pLUExt, position);
+    ULONG last = first;
+    ULONG i;
+
+    // Send a request to each segment the range touches. Each segment gets
+    // at most one part of a request, so the completion event and I/O status
+    // block in the segment table entry can be used.
+    for (i = first;
+        (i < pLUExt->SegmentCount) && (length_done < Length);
+        i++)
+    {
+        PIMSCSI_IMAGE_SEGMENT segment = &pLUExt->Segments[i];
+        LARGE_INTEGER segment_offset;
+        ULONG part_length = Length - length_done;
+        PDEVICE_OBJECT device_object;
+        PIO_STACK_LOCATION io_stack;
+        PIRP irp;
+
+        segment_offset.QuadPart = position - segment->StartOffset;
+
+        if (segment_offset.QuadPart >= segment->Length)
+        {
+            continue;
+        }
+
+        if ((LONGLONG)part_length > segment->Length - segment_offset.QuadPart)
+        {
+            part_length = (ULONG)(segment->Length - segment_offset.QuadPart);
+        }
+
+        device_object = IoGetRelatedDeviceObject(segment->FileObject);
+
+        KeClearEvent(&segment->Event);
+
+#pragma warning(suppress: 6102)
+        irp = IoBuildSynchronousFsdRequest(MajorFunction,
+            device_object,
+            buffer + length_done,
+            part_length,
+            &segment_offset,
+            &segment->Event,
+            &segment->IoStatus);
+
+        if (irp == NULL)
+        {
+            DbgPrint("PhDskMnt::ImScsiReadWriteSegments: Insufficient resources for "
+                "%u bytes to segment %u.\n", part_length, i);
+
+            status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        irp->Flags |= IRP_NOCACHE;
+
+        io_stack = IoGetNextIrpStackLocation(irp);
+        io_stack->FileObject = segment->FileObject;
+
+        KdPrint2(("PhDskMnt::ImScsiReadWriteSegments: Segment %u offset 0x%I64X length 0x%X.\n",
+            i, segment_offset.QuadPart, part_length));
+
+        segment->Pending = TRUE;
+
+        IoCallDriver(device_object, irp);
+
+        last = i + 1;
+        position += part_length;
+        length_done += part_length;
+    }
+
+    // Wait for all parts, also after a failure, because buffer and segment
+    // table entries are in use until each request has completed.
+    for (i = first; i < last; i++)
+    {
+        PIMSCSI_IMAGE_SEGMENT segment = &pLUExt->Segments[i];
+
+        if (!segment->Pending)
+        {
+            continue;
+        }
+
+        KeWaitForSingleObject(&segment->Event,
+            Executive,
+            KernelMode,
+            FALSE,
+            NULL);
+
+        segment->Pending = FALSE;
+
+        if (NT_SUCCESS(status) && !NT_SUCCESS(segment->IoStatus.Status))
+        {
+            DbgPrint("PhDskMnt::ImScsiReadWriteSegments: Request to segment %u failed (%#x).\n",
+                i, segment->IoStatus.Status);
+
+            status = segment->IoStatus.Status;
+        }
+    }
+
+    // Image is shorter than virtual disk. Read-only virtual disks can be
+    // created like that, reads beyond image end return zeros.
+    if (NT_SUCCESS(status) && (length_done < Length))
+    {
+        if (MajorFunction == IRP_MJ_READ)
+        {
+            RtlZeroMemory(buffer + length_done, Length - length_done);
+            length_done = Length;
+        }
+        else
+        {
+            status = STATUS_DISK_FULL;
+        }
+    }
+
+    IoStatus->Status = status;
+    IoStatus->Information = NT_SUCCESS(status) ? length_done : 0;
+
+    return status;
+}
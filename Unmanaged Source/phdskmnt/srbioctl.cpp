@@ -217,6 +217,111 @@ __inout __deref PKIRQL         LowestAssumedIrql
         break;
     }
 
+    case SMP_IMSCSI_QUERY_HASH:
+    {
+        PSRB_IMSCSI_QUERY_HASH srb_buffer = (PSRB_IMSCSI_QUERY_HASH)pSrb->DataBuffer;
+
+        KdPrint2(("PhDskMnt::ScsiIoControl: Request SMP_IMSCSI_QUERY_HASH.\n"));
+
+        if (!SRB_IO_CONTROL_SIZE_OK(srb_buffer))
+        {
+            KdPrint(("PhDskMnt::ScsiIoControl: Bad SMP_IMSCSI_QUERY_HASH request.\n"));
+
+            ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+            goto Done;
+        }
+
+        srb_io_control->ReturnCode = ImScsiQueryHashDevice(pHBAExt, srb_buffer, LowestAssumedIrql);
+
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+
+        break;
+    }
+
+    case SMP_IMSCSI_QUERY_STATISTICS:
+    {
+        PSRB_IMSCSI_QUERY_STATISTICS srb_buffer = (PSRB_IMSCSI_QUERY_STATISTICS)pSrb->DataBuffer;
+
+        KdPrint2(("PhDskMnt::ScsiIoControl: Request SMP_IMSCSI_QUERY_STATISTICS.\n"));
+
+        if (!SRB_IO_CONTROL_SIZE_OK(srb_buffer))
+        {
+            KdPrint(("PhDskMnt::ScsiIoControl: Bad SMP_IMSCSI_QUERY_STATISTICS request.\n"));
+
+            ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+            goto Done;
+        }
+
+        srb_io_control->ReturnCode = ImScsiQueryStatisticsDevice(pHBAExt, srb_buffer, LowestAssumedIrql);
+
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+
+        break;
+    }
+
+    case SMP_IMSCSI_SET_TRACE:
+    {
+        PSRB_IMSCSI_SET_TRACE srb_buffer = (PSRB_IMSCSI_SET_TRACE)pSrb->DataBuffer;
+
+        KdPrint2(("PhDskMnt::ScsiIoControl: Request SMP_IMSCSI_SET_TRACE.\n"));
+
+        if (!SRB_IO_CONTROL_SIZE_OK(srb_buffer))
+        {
+            KdPrint(("PhDskMnt::ScsiIoControl: Bad SMP_IMSCSI_SET_TRACE request.\n"));
+
+            ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+            goto Done;
+        }
+
+        srb_io_control->ReturnCode = ImScsiSetTrace(srb_buffer, LowestAssumedIrql);
+
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+
+        break;
+    }
+
+    case SMP_IMSCSI_READ_TRACE:
+    {
+        PSRB_IMSCSI_READ_TRACE srb_buffer = (PSRB_IMSCSI_READ_TRACE)pSrb->DataBuffer;
+
+        KdPrint2(("PhDskMnt::ScsiIoControl: Request SMP_IMSCSI_READ_TRACE.\n"));
+
+        if (!SRB_IO_CONTROL_SIZE_OK(srb_buffer))
+        {
+            KdPrint(("PhDskMnt::ScsiIoControl: Bad SMP_IMSCSI_READ_TRACE request.\n"));
+
+            ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+            goto Done;
+        }
+
+        srb_io_control->ReturnCode = ImScsiReadTrace(srb_buffer, pSrb->DataTransferLength);
+
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+
+        break;
+    }
+
+    case SMP_IMSCSI_DISCARD_OVERLAY:
+    case SMP_IMSCSI_COMMIT_OVERLAY:
+    {
+        PSRB_IMSCSI_WRITE_OVERLAY srb_buffer = (PSRB_IMSCSI_WRITE_OVERLAY)pSrb->DataBuffer;
+
+        KdPrint2(("PhDskMnt::ScsiIoControl: Request SMP_IMSCSI_%s_OVERLAY.\n",
+            srb_io_control->ControlCode == SMP_IMSCSI_COMMIT_OVERLAY ? "COMMIT" : "DISCARD"));
+
+        if (!SRB_IO_CONTROL_SIZE_OK(srb_buffer))
+        {
+            KdPrint(("PhDskMnt::ScsiIoControl: Bad write overlay request.\n"));
+
+            ScsiSetError(pSrb, SRB_STATUS_DATA_OVERRUN);
+            goto Done;
+        }
+
+        ImScsiWriteOverlayDevice(pHBAExt, pSrb, pResult, LowestAssumedIrql, srb_buffer);
+
+        break;
+    }
+
     default:
 
         DbgPrint("PhDskMnt::ScsiExecute: Unknown IOControl code=0x%X\n", srb_io_control->ControlCode);
@@ -240,103 +345,34 @@ __inout __deref PUCHAR         pResult,
 __inout __deref PKIRQL         LowestAssumedIrql
 )
 {
-    pHW_LU_EXTENSION        pLUExt = NULL;
     PSRB_IMSCSI_CREATE_DATA new_device = (PSRB_IMSCSI_CREATE_DATA)pSrb->DataBuffer;
     pMP_WorkRtnParms        pWkRtnParms;
     KLOCK_QUEUE_HANDLE      lock_handle;
+    NTSTATUS                status;
 
-    // If auto-selecting device number
     if (new_device->Fields.DeviceNumber.LongNumber == IMSCSI_AUTO_DEVICE_NUMBER)
     {
         KdPrint(("PhDskMnt::ImScsiCreateDevice: Auto-select device number.\n"));
+    }
 
-        for (new_device->Fields.DeviceNumber.PathId = 0;
-            new_device->Fields.DeviceNumber.PathId < pMPDrvInfoGlobal->MPRegInfo.NumberOfBuses;
-            new_device->Fields.DeviceNumber.PathId++)
-        {
-            for (new_device->Fields.DeviceNumber.Lun = 0;
-                new_device->Fields.DeviceNumber.Lun < MAX_LUNS;
-                new_device->Fields.DeviceNumber.Lun++)
-            {
-                for (new_device->Fields.DeviceNumber.TargetId = 0;
-                    new_device->Fields.DeviceNumber.TargetId < MAX_TARGETS;
-                    new_device->Fields.DeviceNumber.TargetId++)
-                {
-#ifdef USE_SCSIPORT
-                    // With SCSIPORT, reserve device 0:0:0 as control device
-                    if (new_device->Fields.DeviceNumber.LongNumber == 0)
-                        continue;
-#endif
-
-                    ScsiGetLUExtension(
-                        pHBAExt,
-                        &pLUExt,
-                        new_device->Fields.DeviceNumber.PathId,
-                        new_device->Fields.DeviceNumber.TargetId,
-                        new_device->Fields.DeviceNumber.Lun,
-                        LowestAssumedIrql
-                        );
-
-                    if (pLUExt == NULL)
-                        break;
-                }
-
-                if (pLUExt == NULL)
-                    break;
-            }
-
-            if (pLUExt == NULL)
-                break;
-        }
-
-        if (pLUExt != NULL)
-        {
-            KdPrint(("PhDskMnt::ImScsiCreateDevice: No free device number found.\n"));
-            new_device->SrbIoControl.ReturnCode = (ULONG)STATUS_NO_MORE_ENTRIES;
-            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
-            return;
-        }
+    // Device number stays reserved until the LU is cleaned up, or until
+    // creation fails before the LU exists.
+    status = ImScsiReserveDeviceNumber(pHBAExt,
+        &new_device->Fields.DeviceNumber, LowestAssumedIrql);
 
-        KdPrint(("PhDskMnt::ImScsiCreateDevice: PathId=%i, TargetId=%i, Lun=%i.\n",
-            (int)new_device->Fields.DeviceNumber.PathId,
-            (int)new_device->Fields.DeviceNumber.TargetId,
-            (int)new_device->Fields.DeviceNumber.Lun));
-    }
-    else
+    if (!NT_SUCCESS(status))
     {
-        KdPrint(("PhDskMnt::ImScsiCreateDevice: PathId=%i, TargetId=%i, Lun=%i.\n",
-            (int)new_device->Fields.DeviceNumber.PathId,
-            (int)new_device->Fields.DeviceNumber.TargetId,
-            (int)new_device->Fields.DeviceNumber.Lun));
-
-#ifdef USE_SCSIPORT
-        if (new_device->Fields.DeviceNumber.LongNumber == 0)
-        {
-            DbgPrint("PhDskMnt::ImScsiCreateDevice: Device number 0:0:0 is reserved.\n");
-            new_device->SrbIoControl.ReturnCode = (ULONG)STATUS_OBJECT_NAME_COLLISION;
-            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
-            return;
-        }
-#endif
-
-        ScsiGetLUExtension(
-            pHBAExt,
-            &pLUExt,
-            new_device->Fields.DeviceNumber.PathId,
-            new_device->Fields.DeviceNumber.TargetId,
-            new_device->Fields.DeviceNumber.Lun,
-            LowestAssumedIrql
-            );
-
-        if (pLUExt != NULL)
-        {
-            KdPrint(("PhDskMnt::ImScsiCreateDevice: Device already exists.\n"));
-            new_device->SrbIoControl.ReturnCode = (ULONG)STATUS_OBJECT_NAME_COLLISION;
-            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
-            return;
-        }
+        KdPrint(("PhDskMnt::ImScsiCreateDevice: Device number not available (%#x).\n", status));
+        new_device->SrbIoControl.ReturnCode = (ULONG)status;
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        return;
     }
 
+    KdPrint(("PhDskMnt::ImScsiCreateDevice: PathId=%i, TargetId=%i, Lun=%i.\n",
+        (int)new_device->Fields.DeviceNumber.PathId,
+        (int)new_device->Fields.DeviceNumber.TargetId,
+        (int)new_device->Fields.DeviceNumber.Lun));
+
     pWkRtnParms =                                     // Allocate parm area for work routine.
         (pMP_WorkRtnParms)ExAllocatePoolWithTag(NonPagedPool, sizeof(MP_WorkRtnParms), MP_TAG_GENERAL);
 
@@ -344,6 +380,12 @@ __inout __deref PKIRQL         LowestAssumedIrql
     {
         DbgPrint("PhDskMnt::ImScsiCreateDevice Failed to allocate work parm structure\n");
 
+        ImScsiAcquireLock(&pHBAExt->LUListLock, &lock_handle, *LowestAssumedIrql);
+
+        ImScsiReleaseDeviceNumber(pHBAExt, &new_device->Fields.DeviceNumber);
+
+        ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+
         new_device->SrbIoControl.ReturnCode = (ULONG)STATUS_INSUFFICIENT_RESOURCES;
         ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
         return;
@@ -363,13 +405,8 @@ __inout __deref PKIRQL         LowestAssumedIrql
 
     new_device->SrbIoControl.ReturnCode = (ULONG)STATUS_PENDING;
 
-    ImScsiAcquireLock(&pMPDrvInfoGlobal->RequestListLock, &lock_handle, *LowestAssumedIrql);
-
-    InsertTailList(&pMPDrvInfoGlobal->RequestList, &pWkRtnParms->RequestListEntry);
-
-    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
-
-    KeSetEvent(&pMPDrvInfoGlobal->RequestEvent, (KPRIORITY)0, FALSE);
+    ImScsiCoreQueueInsert(&pMPDrvInfoGlobal->RequestQueue,
+        &pWkRtnParms->RequestListEntry, LowestAssumedIrql);
 
     *pResult = ResultQueued;                          // Indicate queuing.
 
@@ -415,13 +452,19 @@ __inout __deref PKIRQL              LowestAssumedIrql
     if (*Length <
         sizeof(SRB_IMSCSI_CREATE_DATA) +
         device_extension->ObjectName.Length +
-        sizeof(*create_data->Fields.FileName))
+        sizeof(*create_data->Fields.FileName) +
+        device_extension->OverlayName.Length +
+        sizeof(*create_data->Fields.FileName) +
+        device_extension->SegmentNames.Length)
     {
         KdPrint(("PhDskMnt::ImScsiQueryDevice: Buffer too small. Got %u, need %u.\n",
             *Length,
             (ULONG)(sizeof(SRB_IMSCSI_CREATE_DATA) +
             device_extension->ObjectName.Length +
-            sizeof(*create_data->Fields.FileName))));
+            sizeof(*create_data->Fields.FileName) +
+            device_extension->OverlayName.Length +
+            sizeof(*create_data->Fields.FileName) +
+            device_extension->SegmentNames.Length)));
 
         *Length = sizeof(SRB_IO_CONTROL);
         return STATUS_BUFFER_TOO_SMALL;
@@ -458,6 +501,24 @@ __inout __deref PKIRQL              LowestAssumedIrql
     if (device_extension->Modified)
         create_data->Fields.Flags |= IMSCSI_IMAGE_MODIFIED;
 
+    if (device_extension->VMLazyLoad)
+        create_data->Fields.Flags |= IMSCSI_VM_LAZY_LOAD;
+
+    if (device_extension->VMCompress)
+        create_data->Fields.Flags |= IMSCSI_VM_COMPRESS;
+
+    if (device_extension->VMDedup)
+        create_data->Fields.Flags |= IMSCSI_VM_DEDUP;
+
+    if (device_extension->OverlayFile != NULL)
+        create_data->Fields.Flags |= IMSCSI_WRITE_OVERLAY;
+
+    if (device_extension->Segments != NULL)
+        create_data->Fields.Flags |= IMSCSI_MULTI_SEGMENT;
+
+    if (device_extension->Core.WriteBack)
+        create_data->Fields.Flags |= IMSCSI_WRITE_BACK;
+
     create_data->Fields.ImageOffset = device_extension->ImageOffset;
 
     create_data->Fields.FileNameLength = device_extension->ObjectName.Length;
@@ -467,6 +528,37 @@ __inout __deref PKIRQL              LowestAssumedIrql
         device_extension->ObjectName.Buffer,
         device_extension->ObjectName.Length);
 
+    // Differencing file name follows image file name, same way as when
+    // device was created.
+    if (device_extension->OverlayName.Length > 0)
+    {
+        create_data->Fields.FileName[create_data->Fields.FileNameLength /
+            sizeof(*create_data->Fields.FileName)] = 0;
+
+        RtlCopyMemory(create_data->Fields.FileName +
+            (create_data->Fields.FileNameLength / sizeof(*create_data->Fields.FileName)) + 1,
+            device_extension->OverlayName.Buffer,
+            device_extension->OverlayName.Length);
+
+        create_data->Fields.FileNameLength += sizeof(*create_data->Fields.FileName) +
+            device_extension->OverlayName.Length;
+    }
+
+    // Same for names of further segments of split images.
+    if (device_extension->SegmentNames.Length > 0)
+    {
+        create_data->Fields.FileName[create_data->Fields.FileNameLength /
+            sizeof(*create_data->Fields.FileName)] = 0;
+
+        RtlCopyMemory(create_data->Fields.FileName +
+            (create_data->Fields.FileNameLength / sizeof(*create_data->Fields.FileName)) + 1,
+            device_extension->SegmentNames.Buffer,
+            device_extension->SegmentNames.Length);
+
+        create_data->Fields.FileNameLength += sizeof(*create_data->Fields.FileName) +
+            device_extension->SegmentNames.Length;
+    }
+
     *Length = sizeof(SRB_IMSCSI_CREATE_DATA) +
         create_data->Fields.FileNameLength -
         sizeof(*create_data->Fields.FileName);
@@ -646,23 +738,14 @@ ImScsiExtendDevice(
         return;
     }
 
-    pMP_WorkRtnParms pWkRtnParms =                                     // Allocate parm area for work routine.
-        (pMP_WorkRtnParms)ExAllocatePoolWithTag(NonPagedPool, sizeof(MP_WorkRtnParms), MP_TAG_GENERAL);
+    pMP_WorkRtnParms pWkRtnParms =
+        ImScsiAllocateWorkItem(pHBAExt, device_extension, pSrb);
 
     if (pWkRtnParms == NULL)
     {
-        DbgPrint("ImScsi::ImScsiExtendDevice Failed to allocate work parm structure\n");
-
-        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
         return;
     }
 
-    RtlZeroMemory(pWkRtnParms, sizeof(MP_WorkRtnParms));
-
-    pWkRtnParms->pHBAExt = pHBAExt;
-    pWkRtnParms->pLUExt = device_extension;
-    pWkRtnParms->pSrb = pSrb;
-
     KEVENT wait_event;
     BOOLEAN wait_result = KeGetCurrentIrql() < DISPATCH_LEVEL;
 
@@ -673,26 +756,93 @@ ImScsiExtendDevice(
     }
 
     // Queue work item, which will run in the System process.
-    KLOCK_QUEUE_HANDLE           lock_handle;
+    ImScsiInsertWorkItem(pWkRtnParms, pResult, LowestAssumedIrql);
 
-    KdPrint2(("PhDskMnt::ImScsiExtendDevice: Queuing work=0x%p\n", pWkRtnParms));
+    if (wait_result)
+    {
+        KeWaitForSingleObject(&wait_event, KWAIT_REASON::Executive, MODE::KernelMode, FALSE, NULL);
+    }
 
-    ImScsiAcquireLock(&device_extension->RequestListLock, &lock_handle, *LowestAssumedIrql);
+    StoragePortNotification(BusChangeDetected, pHBAExt, extend_device_data->DeviceNumber.PathId);
 
-    InsertTailList(&device_extension->RequestList, &pWkRtnParms->RequestListEntry);
+    return;
+}
 
-    ImScsiReleaseLock(&lock_handle, LowestAssumedIrql);
+VOID
+ImScsiWriteOverlayDevice(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb,
+    __inout __deref PUCHAR         pResult,
+    __inout __deref PKIRQL         LowestAssumedIrql,
+    __inout __deref PSRB_IMSCSI_WRITE_OVERLAY       overlay_data
+    )
+{
+    UCHAR scsi_status;
+    pHW_LU_EXTENSION device_extension;
 
-    KeSetEvent(&device_extension->RequestEvent, (KPRIORITY)0, FALSE);
+    KdPrint(("ImScsi: Request to %s write overlay of device %i:%i:%i.\n",
+        overlay_data->SrbIoControl.ControlCode == SMP_IMSCSI_COMMIT_OVERLAY ?
+        "commit" : "discard",
+        (int)overlay_data->DeviceNumber.PathId,
+        (int)overlay_data->DeviceNumber.TargetId,
+        (int)overlay_data->DeviceNumber.Lun));
 
-    *pResult = ResultQueued;                          // Indicate queuing.
+    scsi_status = ScsiGetLUExtension(
+        pHBAExt,
+        &device_extension,
+        overlay_data->DeviceNumber.PathId,
+        overlay_data->DeviceNumber.TargetId,
+        overlay_data->DeviceNumber.Lun,
+        LowestAssumedIrql
+        );
+
+    if ((scsi_status != SRB_STATUS_SUCCESS) | (device_extension == NULL))
+    {
+        overlay_data->SrbIoControl.ReturnCode = (ULONG)STATUS_OBJECT_NAME_NOT_FOUND;
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        return;
+    }
+
+    if (device_extension->OverlayFile == NULL)
+    {
+        overlay_data->SrbIoControl.ReturnCode = (ULONG)STATUS_INVALID_DEVICE_REQUEST;
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        return;
+    }
+
+    if ((overlay_data->SrbIoControl.ControlCode == SMP_IMSCSI_COMMIT_OVERLAY) &&
+        device_extension->ReadOnly)
+    {
+        overlay_data->SrbIoControl.ReturnCode = (ULONG)STATUS_MEDIA_WRITE_PROTECTED;
+        ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        return;
+    }
+
+    pMP_WorkRtnParms pWkRtnParms =
+        ImScsiAllocateWorkItem(pHBAExt, device_extension, pSrb);
+
+    if (pWkRtnParms == NULL)
+    {
+        return;
+    }
+
+    KEVENT wait_event;
+    BOOLEAN wait_result = KeGetCurrentIrql() < DISPATCH_LEVEL;
 
     if (wait_result)
     {
-        KeWaitForSingleObject(&wait_event, KWAIT_REASON::Executive, MODE::KernelMode, FALSE, NULL);
+        KeInitializeEvent(&wait_event, EVENT_TYPE::NotificationEvent, FALSE);
+        pWkRtnParms->CallerWaitEvent = &wait_event;
     }
 
-    StoragePortNotification(BusChangeDetected, pHBAExt, extend_device_data->DeviceNumber.PathId);
+    // Queue in device worker thread, so that commit or discard is
+    // serialized with read and write requests.
+    ImScsiInsertWorkItem(pWkRtnParms, pResult, LowestAssumedIrql);
+
+    if (wait_result)
+    {
+        KeWaitForSingleObject(&wait_event, KWAIT_REASON::Executive, MODE::KernelMode, FALSE, NULL);
+    }
 
     return;
 }
@@ -731,7 +881,7 @@ __inout __deref PKIRQL          LowestAssumedIrql
         {
             count++;
             KeSetEvent(&object->StopThread, (KPRIORITY)0, FALSE);
-            KeSetEvent(&object->RequestEvent, (KPRIORITY)0, FALSE);
+            KeSetEvent(&object->Core.Queue.Event, (KPRIORITY)0, FALSE);
         }
     }
 
@@ -0,0 +1,224 @@
+/// srbtrace.cpp
+/// Binary trace of SCSI request stages, read with SMP_IMSCSI_READ_TRACE.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+//
+// Events are written to a ring of fixed size records. A writer reserves a
+// sequence number with one interlocked increment and owns the record at
+// that position in the ring until it stores the sequence number in the
+// record. Readers only accept a record that holds the sequence number they
+// expect both before and after copying it, anything else has either not
+// been written yet or has been overwritten by a later event.
+//
+
+#define IMSCSI_TRACE_RECORD_BUSY    MAXULONGLONG
+
+VOID
+ImScsiTraceSrbEvent(
+__in UCHAR               Stage,
+__in PSCSI_REQUEST_BLOCK pSrb)
+{
+    PIMSCSI_SRB_TRACE trace = &pMPDrvInfoGlobal->Trace;
+    PIMSCSI_TRACE_RECORD record;
+    ULONGLONG sequence;
+
+    if ((pSrb == NULL) ||
+        (pSrb->Function != SRB_FUNCTION_EXECUTE_SCSI) ||
+        (trace->Records == NULL))
+    {
+        return;
+    }
+
+    sequence = (ULONGLONG)InterlockedIncrement64(&trace->Next) - 1;
+
+    record = &trace->Records[sequence % trace->Capacity];
+
+    record->Sequence = IMSCSI_TRACE_RECORD_BUSY;
+
+    KeMemoryBarrier();
+
+    record->Timestamp = KeQueryPerformanceCounter(NULL).QuadPart;
+    record->Request = (ULONGLONG)(ULONG_PTR)pSrb;
+    record->LogicalBlock = ImScsiCdbGetLogicalBlock(pSrb->Cdb);
+    record->DataTransferLength = pSrb->DataTransferLength;
+    record->DeviceNumber.LongNumber = 0;
+    record->DeviceNumber.PathId = pSrb->PathId;
+    record->DeviceNumber.TargetId = pSrb->TargetId;
+    record->DeviceNumber.Lun = pSrb->Lun;
+    record->Stage = Stage;
+    record->Operation = pSrb->Cdb[0];
+    record->SrbStatus = pSrb->SrbStatus;
+    record->ScsiStatus = pSrb->ScsiStatus;
+    record->Processor = ImScsiGetProcessorIndex();
+
+    KeMemoryBarrier();
+
+    record->Sequence = sequence;
+}
+
+NTSTATUS
+ImScsiSetTrace(
+__inout __deref PSRB_IMSCSI_SET_TRACE  set_trace,
+__inout __deref PKIRQL                 LowestAssumedIrql)
+{
+    PIMSCSI_SRB_TRACE trace = &pMPDrvInfoGlobal->Trace;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    ULONG capacity = set_trace->Capacity;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    if (capacity == 0)
+    {
+        capacity = IMSCSI_TRACE_DEFAULT_CAPACITY;
+    }
+    else if (capacity > IMSCSI_TRACE_MAX_CAPACITY)
+    {
+        KdPrint(("PhDskMnt::ImScsiSetTrace: Too large trace buffer requested: %u records.\n",
+            capacity));
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    ImScsiAcquireLock(&trace->Lock, &LockHandle, *LowestAssumedIrql);
+
+    if (set_trace->Enable && (trace->Records == NULL))
+    {
+        PIMSCSI_TRACE_RECORD records = (PIMSCSI_TRACE_RECORD)
+            ExAllocatePoolWithTag(NonPagedPool,
+            capacity * sizeof(IMSCSI_TRACE_RECORD), MP_TAG_GENERAL);
+
+        if (records == NULL)
+        {
+            KdPrint(("PhDskMnt::ImScsiSetTrace: Memory allocation failed for %u records.\n",
+                capacity));
+
+            status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+        else
+        {
+            for (ULONG i = 0; i < capacity; i++)
+            {
+                records[i].Sequence = IMSCSI_TRACE_RECORD_BUSY;
+            }
+
+            trace->Capacity = capacity;
+            trace->Records = records;
+
+            KeMemoryBarrier();
+        }
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        trace->Enabled = set_trace->Enable;
+
+        KdPrint(("PhDskMnt::ImScsiSetTrace: Tracing %s, %u records.\n",
+            trace->Enabled ? "started" : "stopped", trace->Capacity));
+    }
+
+    set_trace->Capacity = trace->Capacity;
+    set_trace->Frequency = pMPDrvInfoGlobal->PerformanceFrequency.QuadPart;
+
+    ImScsiReleaseLock(&LockHandle, LowestAssumedIrql);
+
+    return status;
+}
+
+NTSTATUS
+ImScsiReadTrace(
+__inout __deref PSRB_IMSCSI_READ_TRACE  read_trace,
+__in            ULONG                   max_length)
+{
+    PIMSCSI_SRB_TRACE trace = &pMPDrvInfoGlobal->Trace;
+    ULONGLONG sequence = read_trace->Sequence;
+    ULONGLONG next;
+    ULONG max_records;
+    ULONG count = 0;
+
+    read_trace->Lost = 0;
+    read_trace->NumberOfRecords = 0;
+
+    if (trace->Records == NULL)
+    {
+        read_trace->Sequence = 0;
+        return STATUS_SUCCESS;
+    }
+
+    max_records = (max_length - FIELD_OFFSET(SRB_IMSCSI_READ_TRACE, Records)) /
+        sizeof(IMSCSI_TRACE_RECORD);
+
+    next = (ULONGLONG)InterlockedCompareExchange64(&trace->Next, 0, 0);
+
+    if (sequence > next)
+    {
+        sequence = next;
+    }
+
+    if (next - sequence > trace->Capacity)
+    {
+        read_trace->Lost = next - trace->Capacity - sequence;
+        sequence = next - trace->Capacity;
+    }
+
+    while ((sequence < next) && (count < max_records))
+    {
+        PIMSCSI_TRACE_RECORD record =
+            &trace->Records[sequence % trace->Capacity];
+        ULONGLONG record_sequence = record->Sequence;
+
+        // Still being written, try again next time.
+        if ((record_sequence == IMSCSI_TRACE_RECORD_BUSY) ||
+            (record_sequence < sequence))
+        {
+            break;
+        }
+
+        KeMemoryBarrier();
+
+        read_trace->Records[count] = *record;
+
+        KeMemoryBarrier();
+
+        if ((record_sequence != sequence) ||
+            (record->Sequence != sequence))
+        {
+            read_trace->Lost++;
+        }
+        else
+        {
+            count++;
+        }
+
+        sequence++;
+    }
+
+    read_trace->Sequence = sequence;
+    read_trace->NumberOfRecords = count;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+ImScsiFreeTrace()
+{
+    PIMSCSI_SRB_TRACE trace = &pMPDrvInfoGlobal->Trace;
+
+    trace->Enabled = FALSE;
+
+    if (trace->Records != NULL)
+    {
+        ExFreePoolWithTag(trace->Records, MP_TAG_GENERAL);
+        trace->Records = NULL;
+    }
+
+    trace->Capacity = 0;
+}
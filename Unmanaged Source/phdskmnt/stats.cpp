@@ -0,0 +1,320 @@
+/// stats.cpp
+/// Per-LU performance counters, returned by SMP_IMSCSI_QUERY_STATISTICS.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+//
+// Each LU has one block of counters for each processor, each in its own
+// cache line, so that requests completing on different processors do not
+// contend for the same counters. Counters are summed when queried. A thread
+// can be moved to another processor after it has selected a block, and
+// completion routines can interrupt a thread updating the same block, so
+// updates are still interlocked. They only rarely meet on the same line.
+//
+// Queue depth is incremented in the block of the processor that queues a
+// request and decremented in the block of the processor where it is done,
+// so only the sum over all blocks is meaningful.
+//
+
+C_ASSERT(IMSCSI_STAT_LATENCY_BUCKETS == IMSCSI_LATENCY_BUCKETS);
+
+static
+PIMSCSI_LU_STATISTICS
+ImScsiGetCpuStatistics(__in pHW_LU_EXTENSION pLUExt)
+{
+    ULONG index;
+
+    if (pLUExt->Statistics == NULL)
+    {
+        return NULL;
+    }
+
+    index = ImScsiGetProcessorIndex();
+
+    // Processors added after LU was created share blocks.
+    if (index >= pLUExt->StatisticsCount)
+    {
+        index %= pLUExt->StatisticsCount;
+    }
+
+    return &pLUExt->Statistics[index].Counters;
+}
+
+static
+ULONG
+ImScsiGetOperationClass(__in PSCSI_REQUEST_BLOCK pSrb)
+{
+    if (pSrb->Function != SRB_FUNCTION_EXECUTE_SCSI)
+    {
+        return IMSCSI_STAT_OTHER;
+    }
+
+    switch (pSrb->Cdb[0])
+    {
+    case SCSIOP_READ6:
+    case SCSIOP_READ:
+    case SCSIOP_READ12:
+    case SCSIOP_READ16:
+        return IMSCSI_STAT_READ;
+
+    case SCSIOP_WRITE6:
+    case SCSIOP_WRITE:
+    case SCSIOP_WRITE12:
+    case SCSIOP_WRITE16:
+    case SCSIOP_WRITE_SAME:
+    case SCSIOP_WRITE_SAME16:
+        return IMSCSI_STAT_WRITE;
+
+    case SCSIOP_UNMAP:
+        return IMSCSI_STAT_UNMAP;
+
+    default:
+        return IMSCSI_STAT_OTHER;
+    }
+}
+
+VOID
+ImScsiAllocateStatistics(__in pHW_LU_EXTENSION pLUExt)
+{
+    ULONG count = ImScsiGetProcessorCount();
+
+    if (count == 0)
+    {
+        count = 1;
+    }
+
+    pLUExt->Statistics = (PIMSCSI_CPU_STATISTICS)
+        ExAllocatePoolWithTag(NonPagedPool,
+        count * sizeof(IMSCSI_CPU_STATISTICS), MP_TAG_GENERAL);
+
+    if (pLUExt->Statistics == NULL)
+    {
+        KdPrint(("PhDskMnt::ImScsiAllocateStatistics: Memory allocation failed, statistics not collected.\n"));
+
+        pLUExt->StatisticsCount = 0;
+        return;
+    }
+
+    RtlZeroMemory(pLUExt->Statistics, count * sizeof(IMSCSI_CPU_STATISTICS));
+
+    pLUExt->StatisticsCount = count;
+}
+
+VOID
+ImScsiFreeStatistics(__in pHW_LU_EXTENSION pLUExt)
+{
+    if (pLUExt->Statistics != NULL)
+    {
+        ExFreePoolWithTag(pLUExt->Statistics, MP_TAG_GENERAL);
+        pLUExt->Statistics = NULL;
+    }
+
+    pLUExt->StatisticsCount = 0;
+}
+
+VOID
+ImScsiStatisticsStart(__in pMP_WorkRtnParms pWkRtnParms)
+{
+    PIMSCSI_LU_STATISTICS counters =
+        ImScsiGetCpuStatistics(pWkRtnParms->pLUExt);
+
+    // Called wherever a request is queued for a worker thread or for
+    // lower driver of a parallel I/O image file.
+    ImScsiTraceSrb(IMSCSI_TRACE_QUEUED, pWkRtnParms->pSrb);
+
+    if (counters == NULL)
+    {
+        return;
+    }
+
+    pWkRtnParms->Started = KeQueryPerformanceCounter(NULL);
+
+    InterlockedIncrement(&counters->QueueDepth);
+}
+
+VOID
+ImScsiStatisticsDone(__in pMP_WorkRtnParms pWkRtnParms)
+{
+    PIMSCSI_LU_STATISTICS counters;
+
+    if (pWkRtnParms->Started.QuadPart == 0)
+    {
+        return;
+    }
+
+    counters = ImScsiGetCpuStatistics(pWkRtnParms->pLUExt);
+
+    if (counters == NULL)
+    {
+        return;
+    }
+
+    InterlockedDecrement(&counters->QueueDepth);
+
+    ImScsiCountRequest(pWkRtnParms->pLUExt, pWkRtnParms->pSrb,
+        KeQueryPerformanceCounter(NULL).QuadPart -
+        pWkRtnParms->Started.QuadPart);
+
+    pWkRtnParms->Started.QuadPart = 0;
+}
+
+//
+// Counts a finished request that took Ticks performance counter ticks.
+// Also used directly for requests completed without being queued.
+//
+VOID
+ImScsiCountRequest(
+__in pHW_LU_EXTENSION    pLUExt,
+__in PSCSI_REQUEST_BLOCK pSrb,
+__in LONGLONG            Ticks)
+{
+    PIMSCSI_LU_STATISTICS counters = ImScsiGetCpuStatistics(pLUExt);
+    PIMSCSI_OPERATION_STATISTICS operation;
+    LONGLONG frequency = pMPDrvInfoGlobal->PerformanceFrequency.QuadPart;
+
+    if (counters == NULL)
+    {
+        return;
+    }
+
+    operation = &counters->Operations[ImScsiGetOperationClass(pSrb)];
+
+    InterlockedIncrement64(&operation->Requests);
+
+    if (SRB_STATUS(pSrb->SrbStatus) == SRB_STATUS_SUCCESS)
+    {
+        InterlockedExchangeAdd64(&operation->Bytes, pSrb->DataTransferLength);
+    }
+    else
+    {
+        InterlockedIncrement64(&operation->Errors);
+    }
+
+    InterlockedExchangeAdd64(&operation->LatencyTotal,
+        ImScsiTicksToMicroseconds(Ticks, frequency));
+
+    InterlockedIncrement64(&operation->Latency[
+        ImScsiGetLatencyBucket(Ticks, frequency)]);
+}
+
+VOID
+ImScsiCountCacheAccess(
+__in pHW_LU_EXTENSION pLUExt,
+__in ULONG            Hits,
+__in ULONG            Misses)
+{
+    PIMSCSI_LU_STATISTICS counters = ImScsiGetCpuStatistics(pLUExt);
+
+    if (counters == NULL)
+    {
+        return;
+    }
+
+    if (Hits != 0)
+    {
+        InterlockedExchangeAdd64(&counters->CacheHits, Hits);
+    }
+
+    if (Misses != 0)
+    {
+        InterlockedExchangeAdd64(&counters->CacheMisses, Misses);
+    }
+}
+
+//
+// Sums counters of all processors. Returns FALSE if LU has no counters.
+//
+BOOLEAN
+ImScsiSumStatistics(
+__in  pHW_LU_EXTENSION      pLUExt,
+__out PIMSCSI_LU_STATISTICS Statistics)
+{
+    RtlZeroMemory(Statistics, sizeof(*Statistics));
+
+    if (pLUExt->Statistics == NULL)
+    {
+        return FALSE;
+    }
+
+    // Counters are read without locks, a request finishing meanwhile
+    // could be partly included.
+    for (ULONG i = 0; i < pLUExt->StatisticsCount; i++)
+    {
+        PIMSCSI_LU_STATISTICS counters = &pLUExt->Statistics[i].Counters;
+
+        for (ULONG c = 0; c < IMSCSI_STAT_CLASSES; c++)
+        {
+            PIMSCSI_OPERATION_STATISTICS operation = &counters->Operations[c];
+
+            Statistics->Operations[c].Requests += operation->Requests;
+            Statistics->Operations[c].Bytes += operation->Bytes;
+            Statistics->Operations[c].Errors += operation->Errors;
+            Statistics->Operations[c].LatencyTotal += operation->LatencyTotal;
+
+            for (ULONG b = 0; b < IMSCSI_STAT_LATENCY_BUCKETS; b++)
+            {
+                Statistics->Operations[c].Latency[b] += operation->Latency[b];
+            }
+        }
+
+        Statistics->CacheHits += counters->CacheHits;
+        Statistics->CacheMisses += counters->CacheMisses;
+        Statistics->QueueDepth += counters->QueueDepth;
+    }
+
+    if (pLUExt->UseProxy)
+    {
+        Statistics->ProxyRoundTrips = pLUExt->Proxy.RoundTrips;
+    }
+
+    // Blocks are read one at a time, so a request done meanwhile on
+    // another processor can make the sum briefly negative.
+    if (Statistics->QueueDepth < 0)
+    {
+        Statistics->QueueDepth = 0;
+    }
+
+    return TRUE;
+}
+
+NTSTATUS
+ImScsiQueryStatisticsDevice(
+__in            pHW_HBA_EXT                   pHBAExt,
+__inout __deref PSRB_IMSCSI_QUERY_STATISTICS  query_statistics,
+__inout __deref PKIRQL                        LowestAssumedIrql
+)
+{
+    pHW_LU_EXTENSION device_extension;
+    UCHAR srb_status;
+
+    srb_status = ScsiGetLUExtension(
+        pHBAExt,
+        &device_extension,
+        query_statistics->DeviceNumber.PathId,
+        query_statistics->DeviceNumber.TargetId,
+        query_statistics->DeviceNumber.Lun,
+        LowestAssumedIrql
+        );
+
+    if (srb_status != SRB_STATUS_SUCCESS)
+    {
+        KdPrint(("PhDskMnt::ImScsiQueryStatisticsDevice: Device not found.\n"));
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    if (!ImScsiSumStatistics(device_extension, &query_statistics->Statistics))
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    return STATUS_SUCCESS;
+}
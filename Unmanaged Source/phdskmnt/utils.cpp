@@ -38,11 +38,19 @@ None
     // Set default values.
 
     defRegInfo.NumberOfBuses = DEFAULT_NUMBER_OF_BUSES;
+    defRegInfo.MaximumTargets = DEFAULT_MAXIMUM_TARGETS;
+    defRegInfo.MaximumLuns = DEFAULT_MAXIMUM_LUNS;
     defRegInfo.InitiatorID = DEFAULT_INITIATOR_ID;
+    defRegInfo.BlockCacheSize = DEFAULT_BLOCK_CACHE_SIZE;
+    defRegInfo.ProxyCacheSize = DEFAULT_PROXY_CACHE_SIZE;
+    defRegInfo.ProxyCachePolicy = DEFAULT_PROXY_CACHE_POLICY;
+    defRegInfo.WriteBackLimit = DEFAULT_WRITE_BACK_LIMIT;
+    defRegInfo.MaximumTransferLength = DEFAULT_MAX_TRANSFER_LENGTH;
 
     RtlInitUnicodeString(&defRegInfo.VendorId, VENDOR_ID);
     RtlInitUnicodeString(&defRegInfo.ProductId, PRODUCT_ID);
     RtlInitUnicodeString(&defRegInfo.ProductRevision, PRODUCT_REV);
+    RtlInitUnicodeString(&defRegInfo.ProxyCacheDirectory, L"");
 
     // The initialization of lclRtlQueryRegTbl is put into a subordinate block so that the initialized Buffer members of Unicode strings
     // in defRegInfo will be used.
@@ -59,10 +67,18 @@ None
             { NULL, RTL_QUERY_REGISTRY_SUBKEY | RTL_QUERY_REGISTRY_NOEXPAND, L"Parameters", NULL, (ULONG_PTR)NULL, NULL, (ULONG_PTR)NULL },
 
             { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"NumberOfBuses", &pRegInfo->NumberOfBuses, REG_DWORD, &defRegInfo.NumberOfBuses, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"MaximumTargets", &pRegInfo->MaximumTargets, REG_DWORD, &defRegInfo.MaximumTargets, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"MaximumLuns", &pRegInfo->MaximumLuns, REG_DWORD, &defRegInfo.MaximumLuns, sizeof(ULONG) },
             { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"InitiatorID", &pRegInfo->InitiatorID, REG_DWORD, &defRegInfo.InitiatorID, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"BlockCacheSize", &pRegInfo->BlockCacheSize, REG_DWORD, &defRegInfo.BlockCacheSize, sizeof(ULONG) },
             { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"VendorId", &pRegInfo->VendorId, REG_SZ, defRegInfo.VendorId.Buffer, 0 },
             { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"ProductId", &pRegInfo->ProductId, REG_SZ, defRegInfo.ProductId.Buffer, 0 },
             { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"ProductRevision", &pRegInfo->ProductRevision, REG_SZ, defRegInfo.ProductRevision.Buffer, 0 },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"ProxyCacheDirectory", &pRegInfo->ProxyCacheDirectory, REG_SZ, defRegInfo.ProxyCacheDirectory.Buffer, 0 },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"ProxyCacheSize", &pRegInfo->ProxyCacheSize, REG_DWORD, &defRegInfo.ProxyCacheSize, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"ProxyCachePolicy", &pRegInfo->ProxyCachePolicy, REG_DWORD, &defRegInfo.ProxyCachePolicy, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"WriteBackLimit", &pRegInfo->WriteBackLimit, REG_DWORD, &defRegInfo.WriteBackLimit, sizeof(ULONG) },
+            { NULL, RTL_QUERY_REGISTRY_DIRECT | RTL_QUERY_REGISTRY_NOEXPAND, L"MaximumTransferLength", &pRegInfo->MaximumTransferLength, REG_DWORD, &defRegInfo.MaximumTransferLength, sizeof(ULONG) },
 
             // The null entry denotes the end of the array.                                                                    
             { NULL, 0, NULL, NULL, (ULONG_PTR)NULL, NULL, (ULONG_PTR)NULL },
@@ -80,11 +96,40 @@ None
 
         if (!NT_SUCCESS(status)) {                    // A problem?
             pRegInfo->NumberOfBuses = defRegInfo.NumberOfBuses;
+            pRegInfo->MaximumTargets = defRegInfo.MaximumTargets;
+            pRegInfo->MaximumLuns = defRegInfo.MaximumLuns;
             pRegInfo->InitiatorID = defRegInfo.InitiatorID;
+            pRegInfo->BlockCacheSize = defRegInfo.BlockCacheSize;
+            pRegInfo->ProxyCacheSize = defRegInfo.ProxyCacheSize;
+            pRegInfo->ProxyCachePolicy = defRegInfo.ProxyCachePolicy;
+            pRegInfo->WriteBackLimit = defRegInfo.WriteBackLimit;
+            pRegInfo->MaximumTransferLength = defRegInfo.MaximumTransferLength;
             RtlCopyUnicodeString(&pRegInfo->VendorId, &defRegInfo.VendorId);
             RtlCopyUnicodeString(&pRegInfo->ProductId, &defRegInfo.ProductId);
             RtlCopyUnicodeString(&pRegInfo->ProductRevision, &defRegInfo.ProductRevision);
+            RtlCopyUnicodeString(&pRegInfo->ProxyCacheDirectory, &defRegInfo.ProxyCacheDirectory);
         }
     }
+
+    // Device addresses are direct indexes into LU table allocated with
+    // adapter extension, keep them within what port drivers accept.
+
+    if (pRegInfo->NumberOfBuses == 0)
+        pRegInfo->NumberOfBuses = 1;
+    else if (pRegInfo->NumberOfBuses > MAX_BUSES)
+        pRegInfo->NumberOfBuses = MAX_BUSES;
+
+    if (pRegInfo->MaximumTargets == 0)
+        pRegInfo->MaximumTargets = 1;
+    else if (pRegInfo->MaximumTargets > IMSCSI_MAXIMUM_TARGETS)
+        pRegInfo->MaximumTargets = IMSCSI_MAXIMUM_TARGETS;
+
+    if (pRegInfo->MaximumLuns == 0)
+        pRegInfo->MaximumLuns = 1;
+    else if (pRegInfo->MaximumLuns > IMSCSI_MAXIMUM_LUNS)
+        pRegInfo->MaximumLuns = IMSCSI_MAXIMUM_LUNS;
+
+    if (pRegInfo->MaximumTransferLength < MIN_MAX_TRANSFER_LENGTH)
+        pRegInfo->MaximumTransferLength = MIN_MAX_TRANSFER_LENGTH;
 }                                                     // End MpQueryRegParameters().
 
@@ -0,0 +1,527 @@
+/// wmi.cpp
+/// WMI performance data of adapter and each virtual disk. Classes are
+/// defined in phdskmnt.mof, data blocks in imscsiwmi.h generated from it.
+///
+/// Copyright (c) 2012-2015, Arsenal Consulting, Inc. (d/b/a Arsenal Recon) <http://www.ArsenalRecon.com>
+/// This source code and API are available under the terms of the Affero General Public
+/// License v3.
+///
+/// Please see LICENSE.txt for full license terms, including the availability of
+/// proprietary exceptions.
+/// Questions, comments, or requests for clarification: http://ArsenalRecon.com/contact/
+///
+
+#include "phdskmnt.h"
+
+#include <initguid.h>
+#include <wmistr.h>
+
+#include "imscsiwmi.h"
+
+//
+// Adapter requests are served from WmiLibContext and requests for a virtual
+// disk PDO from LUWmiLibContext. Port driver creates one instance of each LU
+// block for each LU PDO, so InstanceIndex is always 0 and the LU is found
+// from PathId, TargetId and Lun of the WMI request.
+//
+
+#define IdxAdapterPerformance               0
+#define IdxDiskPerformance                  0
+
+SCSIWMIGUIDREGINFO WmiGuidList[] =
+{
+    { &ArsenalImageMounter_AdapterPerformance_GUID, 1, 0 },
+};
+
+SCSIWMIGUIDREGINFO LUWmiGuidList[] =
+{
+    { &ArsenalImageMounter_DiskPerformance_GUID, 1, WMIREG_FLAG_INSTANCE_PDO },
+};
+
+#define WmiGuidCount (sizeof(WmiGuidList) / sizeof(SCSIWMIGUIDREGINFO))
+#define LUWmiGuidCount (sizeof(LUWmiGuidList) / sizeof(SCSIWMIGUIDREGINFO))
+
+UCHAR
+QueryWmiRegInfo(
+    __in  PVOID                      pContext,
+    __in  PSCSIWMI_REQUEST_CONTEXT   pRequestContext,
+    __out PWCHAR                   * pMofResourceName
+    );
+
+BOOLEAN
+QueryWmiDataBlock(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    InstanceCount,
+    __in __out PULONG                   pInstanceLenArr,
+    __in       ULONG                    BufferAvail,
+    __out      PUCHAR                   pBuffer
+    );
+
+BOOLEAN
+QueryLUWmiDataBlock(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    InstanceCount,
+    __in __out PULONG                   pInstanceLenArr,
+    __in       ULONG                    BufferAvail,
+    __out      PUCHAR                   pBuffer
+    );
+
+UCHAR
+SetWmiDataBlock(
+    __in PVOID                    pContext,
+    __in PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in ULONG                    GuidIndex,
+    __in ULONG                    InstanceIndex,
+    __in ULONG                    BufferSize,
+    __in PUCHAR                   pBuffer
+    );
+
+UCHAR
+ExecuteWmiMethod(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    MethodId,
+    __in       ULONG                    InBufferSize,
+    __in       ULONG                    OutBufferSize,
+    __in __out PUCHAR                   pBuffer
+    );
+
+VOID
+SpUpdateWmiRequest(
+    __in pHW_HBA_EXT              pHbaExtension,
+    __in PSCSI_WMI_REQUEST_BLOCK  pSrb,
+    __in PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in UCHAR                    Status,
+    __in ULONG                    SizeNeeded
+    );
+
+void
+InitializeWmiContext(__in pHW_HBA_EXT pHbaExtension)
+{
+    PSCSI_WMILIB_CONTEXT pWmiLibContext = &pHbaExtension->WmiLibContext;
+
+    RtlZeroMemory(pWmiLibContext, sizeof(SCSI_WMILIB_CONTEXT));
+
+    pWmiLibContext->GuidCount = WmiGuidCount;
+    pWmiLibContext->GuidList = WmiGuidList;
+    pWmiLibContext->QueryWmiRegInfo = QueryWmiRegInfo;
+    pWmiLibContext->QueryWmiDataBlock = QueryWmiDataBlock;
+    pWmiLibContext->SetWmiDataBlock = SetWmiDataBlock;
+    pWmiLibContext->ExecuteWmiMethod = ExecuteWmiMethod;
+    pWmiLibContext->WmiFunctionControl = NULL;
+
+    pWmiLibContext = &pHbaExtension->LUWmiLibContext;
+
+    RtlZeroMemory(pWmiLibContext, sizeof(SCSI_WMILIB_CONTEXT));
+
+    pWmiLibContext->GuidCount = LUWmiGuidCount;
+    pWmiLibContext->GuidList = LUWmiGuidList;
+    pWmiLibContext->QueryWmiRegInfo = QueryWmiRegInfo;
+    pWmiLibContext->QueryWmiDataBlock = QueryLUWmiDataBlock;
+    pWmiLibContext->SetWmiDataBlock = SetWmiDataBlock;
+    pWmiLibContext->ExecuteWmiMethod = ExecuteWmiMethod;
+    pWmiLibContext->WmiFunctionControl = NULL;
+}
+
+BOOLEAN
+HandleWmiSrb(
+    __in       pHW_HBA_EXT             pHbaExtension,
+    __in __out PSCSI_WMI_REQUEST_BLOCK pSrb
+    )
+{
+    PSCSIWMI_REQUEST_CONTEXT pRequestContext;
+    PSCSI_WMILIB_CONTEXT     pWmiLibContext;
+    BOOLEAN                  bPending;
+
+    ASSERT(pSrb->Function == SRB_FUNCTION_WMI);
+    ASSERT(pSrb->Length == sizeof(SCSI_WMI_REQUEST_BLOCK));
+
+    if (pSrb->WMIFlags & SRB_WMI_FLAGS_ADAPTER_REQUEST)
+    {
+        pWmiLibContext = &pHbaExtension->WmiLibContext;
+    }
+    else
+    {
+        pWmiLibContext = &pHbaExtension->LUWmiLibContext;
+    }
+
+    pRequestContext = &((PHW_SRB_EXTENSION)pSrb->SrbExtension)->WmiRequestContext;
+
+    // Callbacks find the SRB, and for LU requests the LU, from here.
+    pRequestContext->UserContext = pSrb;
+
+    bPending = ScsiPortWmiDispatchFunction(
+        pWmiLibContext,
+        pSrb->WMISubFunction,
+        pHbaExtension,
+        pRequestContext,
+        pSrb->DataPath,
+        pSrb->DataTransferLength,
+        pSrb->DataBuffer);
+
+    // If the request is complete, status and transfer length are not set by
+    // any callback.
+    if (!bPending)
+    {
+        pSrb->DataTransferLength = ScsiPortWmiGetReturnSize(pRequestContext);
+        pSrb->SrbStatus = ScsiPortWmiGetReturnStatus(pRequestContext);
+    }
+
+    return TRUE;
+}
+
+UCHAR
+QueryWmiRegInfo(
+    __in  PVOID                      pContext,
+    __in  PSCSIWMI_REQUEST_CONTEXT   pRequestContext,
+    __out PWCHAR                   * pMofResourceName
+    )
+{
+    UNREFERENCED_PARAMETER(pContext);
+    UNREFERENCED_PARAMETER(pRequestContext);
+
+    *pMofResourceName = L"MofResource";
+
+    return SRB_STATUS_SUCCESS;
+}
+
+//
+// Non-paged memory held by an LU beyond what port driver allocates. Image
+// file and proxy buffers are counted by their owners, block cache memory in
+// adapter block.
+//
+static
+ULONGLONG
+ImScsiGetLUPoolBytes(__in pHW_LU_EXTENSION pLUExt)
+{
+    ULONGLONG bytes = sizeof(HW_LU_EXTENSION) +
+        (ULONGLONG)pLUExt->StatisticsCount * sizeof(IMSCSI_CPU_STATISTICS);
+
+    if (pLUExt->Core.LastIo.Buffer != NULL)
+    {
+        bytes += pLUExt->Core.LastIo.Length;
+    }
+
+    return bytes;
+}
+
+static
+VOID
+ImScsiQueryAdapterPerformance(
+    __in  pHW_HBA_EXT                              pHBAExt,
+    __out PArsenalImageMounter_AdapterPerformance  Data
+    )
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+    LONGLONG busy_ticks;
+    LONGLONG queue_depth = 0;
+    PLIST_ENTRY list_ptr;
+
+    RtlZeroMemory(Data, ArsenalImageMounter_AdapterPerformance_SIZE);
+
+    Data->SRBsSeen = pHBAExt->SRBsSeen;
+    Data->WMISRBsSeen = pHBAExt->WMISRBsSeen;
+
+    // Global worker thread, creating and removing LUs.
+    Data->WorkerThreads = 1;
+    Data->BusyWorkers = pMPDrvInfoGlobal->WorkerBusy ? 1 : 0;
+    busy_ticks = pMPDrvInfoGlobal->WorkerBusyTicks;
+
+    ImScsiAcquireLock(&pHBAExt->LUListLock, &LockHandle, lowest_assumed_irql);
+
+    for (list_ptr = pHBAExt->LUList.Flink;
+        list_ptr != &pHBAExt->LUList;
+        list_ptr = list_ptr->Flink)
+    {
+        pHW_LU_EXTENSION object =
+            CONTAINING_RECORD(list_ptr, HW_LU_EXTENSION, List);
+        IMSCSI_LU_STATISTICS statistics;
+
+        Data->Devices++;
+
+        if (object->WorkerThread != NULL)
+        {
+            Data->WorkerThreads++;
+        }
+
+        if (object->WorkerBusy)
+        {
+            Data->BusyWorkers++;
+        }
+
+        busy_ticks += object->WorkerBusyTicks;
+
+        if (ImScsiSumStatistics(object, &statistics))
+        {
+            queue_depth += statistics.QueueDepth;
+        }
+
+        Data->DevicePoolBytes += ImScsiGetLUPoolBytes(object);
+    }
+
+    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+
+    Data->QueueDepth = (ULONG)queue_depth;
+
+    Data->WorkerBusyTime = ImScsiTicksToMicroseconds(busy_ticks,
+        pMPDrvInfoGlobal->PerformanceFrequency.QuadPart);
+
+    // Read without cache lock, may be one block off.
+    Data->BlockCacheBytes = (ULONGLONG)pMPDrvInfoGlobal->BlockCache.Blocks <<
+        IMSCSI_CACHE_BLOCK_SHIFT;
+    Data->BlockCacheMaxBytes = (ULONGLONG)pMPDrvInfoGlobal->BlockCache.MaxBlocks <<
+        IMSCSI_CACHE_BLOCK_SHIFT;
+
+#ifdef USE_SCSIPORT
+    // StorPort completes requests directly from LU worker threads.
+    C_ASSERT(sizeof(Data->CompletionLatency) ==
+        sizeof(pMPDrvInfoGlobal->CompletionLatency));
+
+    RtlCopyMemory(Data->CompletionLatency, (PVOID)pMPDrvInfoGlobal->CompletionLatency,
+        sizeof(Data->CompletionLatency));
+#endif
+}
+
+static
+VOID
+ImScsiQueryDiskPerformance(
+    __in  pHW_LU_EXTENSION                      pLUExt,
+    __out PArsenalImageMounter_DiskPerformance  Data
+    )
+{
+    IMSCSI_LU_STATISTICS statistics;
+
+    ImScsiSumStatistics(pLUExt, &statistics);
+
+    RtlZeroMemory(Data, ArsenalImageMounter_DiskPerformance_SIZE);
+
+    Data->DeviceNumber = pLUExt->DeviceNumber.LongNumber;
+    Data->QueueDepth = (ULONG)statistics.QueueDepth;
+
+    Data->ReadRequests = statistics.Operations[IMSCSI_STAT_READ].Requests;
+    Data->WriteRequests = statistics.Operations[IMSCSI_STAT_WRITE].Requests;
+    Data->UnmapRequests = statistics.Operations[IMSCSI_STAT_UNMAP].Requests;
+    Data->OtherRequests = statistics.Operations[IMSCSI_STAT_OTHER].Requests;
+    Data->BytesRead = statistics.Operations[IMSCSI_STAT_READ].Bytes;
+    Data->BytesWritten = statistics.Operations[IMSCSI_STAT_WRITE].Bytes;
+
+    for (ULONG c = 0; c < IMSCSI_STAT_CLASSES; c++)
+    {
+        Data->Errors += statistics.Operations[c].Errors;
+    }
+
+    Data->ReadLatencyTotal = statistics.Operations[IMSCSI_STAT_READ].LatencyTotal;
+    Data->WriteLatencyTotal = statistics.Operations[IMSCSI_STAT_WRITE].LatencyTotal;
+    Data->UnmapLatencyTotal = statistics.Operations[IMSCSI_STAT_UNMAP].LatencyTotal;
+    Data->OtherLatencyTotal = statistics.Operations[IMSCSI_STAT_OTHER].LatencyTotal;
+
+    Data->CacheHits = statistics.CacheHits;
+    Data->CacheMisses = statistics.CacheMisses;
+    Data->ProxyRoundTrips = statistics.ProxyRoundTrips;
+
+    Data->BusyTime = ImScsiTicksToMicroseconds(pLUExt->WorkerBusyTicks,
+        pMPDrvInfoGlobal->PerformanceFrequency.QuadPart);
+
+    C_ASSERT(sizeof(Data->ReadLatency) ==
+        sizeof(statistics.Operations[IMSCSI_STAT_READ].Latency));
+
+    RtlCopyMemory(Data->ReadLatency,
+        statistics.Operations[IMSCSI_STAT_READ].Latency,
+        sizeof(Data->ReadLatency));
+
+    RtlCopyMemory(Data->WriteLatency,
+        statistics.Operations[IMSCSI_STAT_WRITE].Latency,
+        sizeof(Data->WriteLatency));
+}
+
+BOOLEAN
+QueryWmiDataBlock(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    InstanceCount,
+    __in __out PULONG                   pInstanceLenArr,
+    __in       ULONG                    BufferAvail,
+    __out      PUCHAR                   pBuffer
+    )
+{
+    pHW_HBA_EXT             pHbaExtension = (pHW_HBA_EXT)pContext;
+    PSCSI_WMI_REQUEST_BLOCK pSrb = (PSCSI_WMI_REQUEST_BLOCK)pDispatchContext->UserContext;
+    ULONG                   sizeNeeded = 0;
+    UCHAR                   status = SRB_STATUS_SUCCESS;
+
+    UNREFERENCED_PARAMETER(InstanceIndex);
+    UNREFERENCED_PARAMETER(InstanceCount);
+
+    switch (GuidIndex)
+    {
+    case IdxAdapterPerformance:
+
+        sizeNeeded = ArsenalImageMounter_AdapterPerformance_SIZE;
+
+        if (BufferAvail < sizeNeeded)
+        {
+            status = SRB_STATUS_DATA_OVERRUN;
+            break;
+        }
+
+        ImScsiQueryAdapterPerformance(pHbaExtension,
+            (PArsenalImageMounter_AdapterPerformance)pBuffer);
+
+        *pInstanceLenArr = sizeNeeded;
+
+        break;
+
+    default:
+
+        status = SRB_STATUS_ERROR;
+        break;
+    }
+
+    SpUpdateWmiRequest(pHbaExtension, pSrb, pDispatchContext, status, sizeNeeded);
+
+    return SRB_STATUS_PENDING;
+}
+
+BOOLEAN
+QueryLUWmiDataBlock(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    InstanceCount,
+    __in __out PULONG                   pInstanceLenArr,
+    __in       ULONG                    BufferAvail,
+    __out      PUCHAR                   pBuffer
+    )
+{
+    pHW_HBA_EXT             pHbaExtension = (pHW_HBA_EXT)pContext;
+    PSCSI_WMI_REQUEST_BLOCK pSrb = (PSCSI_WMI_REQUEST_BLOCK)pDispatchContext->UserContext;
+    pHW_LU_EXTENSION        pLUExt;
+    KIRQL                   lowest_assumed_irql = PASSIVE_LEVEL;
+    ULONG                   sizeNeeded = 0;
+    UCHAR                   status;
+
+    UNREFERENCED_PARAMETER(InstanceIndex);
+    UNREFERENCED_PARAMETER(InstanceCount);
+
+    status = ScsiGetLUExtension(pHbaExtension, &pLUExt, pSrb->PathId,
+        pSrb->TargetId, pSrb->Lun, &lowest_assumed_irql);
+
+    if (status != SRB_STATUS_SUCCESS)
+    {
+        KdPrint(("PhDskMnt::QueryLUWmiDataBlock: No LU at %i:%i:%i.\n",
+            (int)pSrb->PathId, (int)pSrb->TargetId, (int)pSrb->Lun));
+    }
+    else switch (GuidIndex)
+    {
+    case IdxDiskPerformance:
+
+        sizeNeeded = ArsenalImageMounter_DiskPerformance_SIZE;
+
+        if (BufferAvail < sizeNeeded)
+        {
+            status = SRB_STATUS_DATA_OVERRUN;
+            break;
+        }
+
+        ImScsiQueryDiskPerformance(pLUExt,
+            (PArsenalImageMounter_DiskPerformance)pBuffer);
+
+        *pInstanceLenArr = sizeNeeded;
+
+        break;
+
+    default:
+
+        status = SRB_STATUS_ERROR;
+        break;
+    }
+
+    SpUpdateWmiRequest(pHbaExtension, pSrb, pDispatchContext, status, sizeNeeded);
+
+    return SRB_STATUS_PENDING;
+}
+
+//
+// All data blocks are read-only and there are no methods.
+//
+UCHAR
+SetWmiDataBlock(
+    __in PVOID                    pContext,
+    __in PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in ULONG                    GuidIndex,
+    __in ULONG                    InstanceIndex,
+    __in ULONG                    BufferSize,
+    __in PUCHAR                   pBuffer
+    )
+{
+    UNREFERENCED_PARAMETER(GuidIndex);
+    UNREFERENCED_PARAMETER(InstanceIndex);
+    UNREFERENCED_PARAMETER(BufferSize);
+    UNREFERENCED_PARAMETER(pBuffer);
+
+    SpUpdateWmiRequest((pHW_HBA_EXT)pContext,
+        (PSCSI_WMI_REQUEST_BLOCK)pDispatchContext->UserContext,
+        pDispatchContext, SRB_STATUS_INVALID_REQUEST, 0);
+
+    return SRB_STATUS_PENDING;
+}
+
+UCHAR
+ExecuteWmiMethod(
+    __in       PVOID                    pContext,
+    __in       PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in       ULONG                    GuidIndex,
+    __in       ULONG                    InstanceIndex,
+    __in       ULONG                    MethodId,
+    __in       ULONG                    InBufferSize,
+    __in       ULONG                    OutBufferSize,
+    __in __out PUCHAR                   pBuffer
+    )
+{
+    UNREFERENCED_PARAMETER(GuidIndex);
+    UNREFERENCED_PARAMETER(InstanceIndex);
+    UNREFERENCED_PARAMETER(MethodId);
+    UNREFERENCED_PARAMETER(InBufferSize);
+    UNREFERENCED_PARAMETER(OutBufferSize);
+    UNREFERENCED_PARAMETER(pBuffer);
+
+    SpUpdateWmiRequest((pHW_HBA_EXT)pContext,
+        (PSCSI_WMI_REQUEST_BLOCK)pDispatchContext->UserContext,
+        pDispatchContext, SRB_STATUS_INVALID_REQUEST, 0);
+
+    return SRB_STATUS_PENDING;
+}
+
+VOID
+SpUpdateWmiRequest(
+    __in pHW_HBA_EXT              pHbaExtension,
+    __in PSCSI_WMI_REQUEST_BLOCK  pSrb,
+    __in PSCSIWMI_REQUEST_CONTEXT pDispatchContext,
+    __in UCHAR                    Status,
+    __in ULONG                    SizeNeeded
+    )
+{
+    UNREFERENCED_PARAMETER(pHbaExtension);
+
+    // Update the request if the status is NOT pending or NOT already
+    // completed within the callback.
+    if (Status != SRB_STATUS_PENDING)
+    {
+        ScsiPortWmiPostProcess(pDispatchContext, Status, SizeNeeded);
+
+        pSrb->SrbStatus = ScsiPortWmiGetReturnStatus(pDispatchContext);
+        pSrb->DataTransferLength = ScsiPortWmiGetReturnSize(pDispatchContext);
+    }
+}
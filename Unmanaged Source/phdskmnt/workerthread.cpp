@@ -33,9 +33,10 @@ ImScsiWorkerThread(__in PVOID Context)
 {
     pHW_LU_EXTENSION            pLUExt = (pHW_LU_EXTENSION)Context;
     pMP_WorkRtnParms            pWkRtnParms = NULL;
-    PLIST_ENTRY                 request_list = NULL;
-    PKSPIN_LOCK                 request_list_lock = NULL;
+    PIMSCSI_CORE_QUEUE          request_queue = NULL;
     PKEVENT                     wait_objects[2] = { NULL };
+    volatile LONGLONG          *busy_ticks;
+    volatile BOOLEAN           *busy;
 
     KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY);
 
@@ -44,14 +45,14 @@ ImScsiWorkerThread(__in PVOID Context)
         KdPrint(("PhDskMnt::ImScsiWorkerThread: Device worker thread start. pLUExt = 0x%p\n",
             pLUExt));
 
-        request_list = &pLUExt->RequestList;
-        request_list_lock = &pLUExt->RequestListLock;
-        wait_objects[0] = &pLUExt->RequestEvent;
+        request_queue = &pLUExt->Core.Queue;
+        busy_ticks = &pLUExt->WorkerBusyTicks;
+        busy = &pLUExt->WorkerBusy;
 
         // If this is a VM backed disk that should be pre-loaded with an image file
         // we have to load the contents of that file now before entering the service
-        // loop.
-        if (pLUExt->VMDisk && (pLUExt->ImageFile != NULL))
+        // loop. Lazy loaded disks are instead filled in when idle, below.
+        if (pLUExt->VMDisk && (pLUExt->ImageFile != NULL) && !pLUExt->VMLazyLoad)
             if (!ImScsiFillMemoryDisk(pLUExt))
                 KeSetEvent(&pLUExt->StopThread, (KPRIORITY)0, FALSE);
     }
@@ -60,42 +61,23 @@ ImScsiWorkerThread(__in PVOID Context)
         KdPrint(("PhDskMnt::ImScsiWorkerThread: Global worker thread start. pLUExt=%p\n",
             pLUExt));
 
-        request_list = &pMPDrvInfoGlobal->RequestList;
-        request_list_lock = &pMPDrvInfoGlobal->RequestListLock;
-        wait_objects[0] = &pMPDrvInfoGlobal->RequestEvent;
+        request_queue = &pMPDrvInfoGlobal->RequestQueue;
+        busy_ticks = &pMPDrvInfoGlobal->WorkerBusyTicks;
+        busy = &pMPDrvInfoGlobal->WorkerBusy;
     }
+    wait_objects[0] = &request_queue->Event;
     wait_objects[1] = &pMPDrvInfoGlobal->StopWorker;
 
     for (;;)
     {
         PLIST_ENTRY                 request;
-        KLOCK_QUEUE_HANDLE          lock_handle;
         KIRQL                       lowest_assumed_irql = PASSIVE_LEVEL;
 
-#ifdef USE_SCSIPORT
-
-        NTSTATUS                    status = STATUS_SUCCESS;
-        PIRP                        irp = NULL;
-
-        ImScsiGetControllerObject();
-
-        if (pMPDrvInfoGlobal->ControllerObject != NULL)
-        {
-            KdPrint2(("PhDskMnt::ImScsiWorkerThread: Pre-building IRP for next SMB_IMSCSI_CHECK.\n"));
-
-            irp = ImScsiBuildCompletionIrp();
-        }
-#endif
-
         for (;;)
         {
-            ImScsiAcquireLock(request_list_lock, &lock_handle, lowest_assumed_irql);
-
-            request = RemoveHeadList(request_list);
+            request = ImScsiCoreQueueRemove(request_queue, &lowest_assumed_irql);
 
-            ImScsiReleaseLock(&lock_handle, &lowest_assumed_irql);
-
-            if (request != request_list)
+            if (request != NULL)
             {
                 break;
             }
@@ -111,18 +93,31 @@ ImScsiWorkerThread(__in PVOID Context)
                     ImScsiCleanupLU(pLUExt, &lowest_assumed_irql);
                 }
 
-#ifdef USE_SCSIPORT
-                // One last SMB_IMSCSI_CHECK call to flush response queue and free allocated IRP
-                if (irp != NULL)
-                {
-                    IoCallDriver(pMPDrvInfoGlobal->ControllerObject, irp);
-                }
-#endif
-
                 PsTerminateSystemThread(STATUS_SUCCESS);
                 return;
             }
 
+            // Load another chunk of a lazy loaded VM disk and check for new
+            // requests again, so that requests are never delayed by more
+            // than one chunk.
+            if ((pLUExt != NULL) && pLUExt->VMLazyLoad &&
+                ImScsiPrefetchMemoryDisk(pLUExt))
+            {
+                continue;
+            }
+
+            // Same for compressing chunks of VM disk not recently used.
+            if ((pLUExt != NULL) && ImScsiPackMemoryDisk(pLUExt))
+            {
+                continue;
+            }
+
+            // Same for reading parts of disk not yet hashed.
+            if ((pLUExt != NULL) && ImScsiHashIdle(pLUExt))
+            {
+                continue;
+            }
+
             KdPrint2(("PhDskMnt::ImScsiWorkerThread idle, waiting for request.\n"));
 
             KeWaitForMultipleObjects(2, (PVOID*)wait_objects, WaitAny, Executive, KernelMode, FALSE, NULL, NULL);
@@ -157,7 +152,15 @@ ImScsiWorkerThread(__in PVOID Context)
             {
                 KdPrint(("PhDskMnt::ImScsiWorkerThread: Worker not started. Ready to free LUExt.\n"));
             }
+
+            // Requests dispatched by port driver could have found LU in
+            // lookup table just before it was removed.
+            ImScsiWaitForLULookups();
             
+            ImScsiFreeImageHash(pWkRtnParms->pLUExt);
+
+            ImScsiFreeStatistics(pWkRtnParms->pLUExt);
+
             ExFreePoolWithTag(pWkRtnParms->pLUExt, MP_TAG_GENERAL);
 
             ExFreePoolWithTag(pWkRtnParms, MP_TAG_GENERAL);
@@ -165,8 +168,21 @@ ImScsiWorkerThread(__in PVOID Context)
             continue;
         }
 
+        // Time spent here is reported as worker utilization through WMI.
+        LARGE_INTEGER busy_since = KeQueryPerformanceCounter(NULL);
+
+        ImScsiTraceSrb(IMSCSI_TRACE_DEQUEUED, pWkRtnParms->pSrb);
+
+        *busy = TRUE;
+
         ImScsiDispatchWork(pWkRtnParms);
 
+        *busy = FALSE;
+
+        *busy_ticks += KeQueryPerformanceCounter(NULL).QuadPart - busy_since.QuadPart;
+
+        ImScsiStatisticsDone(pWkRtnParms);
+
         if (pWkRtnParms->pReqThread != NULL)
         {
             ObDereferenceObject(pWkRtnParms->pReqThread);
@@ -179,14 +195,9 @@ ImScsiWorkerThread(__in PVOID Context)
 
 #ifdef USE_SCSIPORT
 
-        KdPrint2(("PhDskMnt::ImScsiWorkerThread: Calling SMB_IMSCSI_CHECK for work: 0x%p.\n", pWkRtnParms));
-
-        status = ImScsiCallForCompletion(irp, pWkRtnParms, &lowest_assumed_irql);
+        KdPrint2(("PhDskMnt::ImScsiWorkerThread: Queuing for completion work: 0x%p.\n", pWkRtnParms));
 
-        if (!NT_SUCCESS(status))
-            DbgPrint("PhDskMnt::ImScsiWorkerThread: IoCallDriver failed: 0x%X for work 0x%p\n", status, pWkRtnParms);
-        else
-            KdPrint2(("PhDskMnt::ImScsiWorkerThread: Finished SMB_IMSCSI_CHECK for work: 0x%p.\n", pWkRtnParms));
+        ImScsiCallForCompletion(pWkRtnParms, &lowest_assumed_irql);
 
 #endif
 
@@ -194,6 +205,8 @@ ImScsiWorkerThread(__in PVOID Context)
 
         KdPrint2(("PhDskMnt::ImScsiWorkerThread: Sending 'RequestComplete' to StorPort for work: 0x%p.\n", pWkRtnParms));
 
+        ImScsiTraceSrb(IMSCSI_TRACE_COMPLETE, pWkRtnParms->pSrb);
+
         StorPortNotification(RequestComplete, pWkRtnParms->pHBAExt, pWkRtnParms->pSrb);
 
         ExFreePoolWithTag(pWkRtnParms, MP_TAG_GENERAL);
@@ -205,164 +218,399 @@ ImScsiWorkerThread(__in PVOID Context)
     }
 }
 
+#ifdef USE_SCSIPORT
+/**************************************************************************************************/
+/*                                                                                                */
+/* Completion thread for SCSIPORT. Sends an SMP_IMSCSI_CHECK request to the adapter each time     */
+/* work is queued on ResponseList. MpHwStartIo completes all queued work before handling the      */
+/* request, so work queued by several threads while one request is in progress is completed in   */
+/* one batch by the next. One IRP and SRB buffer are allocated once and reused.                   */
+/*                                                                                                */
+/**************************************************************************************************/
 VOID
-ImScsiDispatchReadWrite(
-    __in pHW_HBA_EXT pHBAExt,
-    __in pHW_LU_EXTENSION pLUExt,
-    __in PSCSI_REQUEST_BLOCK pSrb)
+ImScsiCompletionThread(__in PVOID Context)
 {
-    PCDB pCdb = (PCDB)pSrb->Cdb;
-    PVOID sysaddress;
-    PVOID buffer;
-    ULONG status;
-    LARGE_INTEGER startingSector;
-    LARGE_INTEGER startingOffset;
-    KLOCK_QUEUE_HANDLE LockHandle;
-    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+    PIRP                irp = NULL;
+    PSRB_IMSCSI_CHECK   completion_srb = NULL;
+    KEVENT              irp_done;
+    PKEVENT             wait_objects[2];
+
+    UNREFERENCED_PARAMETER(Context);
+
+    KeSetPriorityThread(KeGetCurrentThread(), LOW_REALTIME_PRIORITY);
+
+    KdPrint(("PhDskMnt::ImScsiCompletionThread start.\n"));
 
-    if ((pCdb->AsByte[0] == SCSIOP_READ16) |
-        (pCdb->AsByte[0] == SCSIOP_WRITE16))
+    KeInitializeEvent(&irp_done, NotificationEvent, FALSE);
+
+    wait_objects[0] = &pMPDrvInfoGlobal->ResponseEvent;
+    wait_objects[1] = &pMPDrvInfoGlobal->StopWorker;
+
+    for (;;)
     {
-        REVERSE_BYTES_QUAD(&startingSector, pCdb->CDB16.LogicalBlock);
+        PIO_STACK_LOCATION  ioctl_stack;
+        NTSTATUS            status;
+
+        status = KeWaitForMultipleObjects(2, (PVOID*)wait_objects, WaitAny,
+            Executive, KernelMode, FALSE, NULL, NULL);
+
+        if (status != STATUS_WAIT_0)
+        {
+            break;
+        }
+
+        if (!NT_SUCCESS(ImScsiGetControllerObject()))
+        {
+            // Left for MpHwTimer
+            continue;
+        }
+
+        if (irp == NULL)
+        {
+            completion_srb = (PSRB_IMSCSI_CHECK)ExAllocatePoolWithTag(
+                NonPagedPool, sizeof(*completion_srb), MP_TAG_GENERAL);
+
+            if (completion_srb == NULL)
+            {
+                DbgPrint("PhDskMnt::ImScsiCompletionThread: Memory allocation error.\n");
+                continue;
+            }
+
+            irp = IoAllocateIrp(pMPDrvInfoGlobal->ControllerObject->StackSize, FALSE);
+
+            if (irp == NULL)
+            {
+                DbgPrint("PhDskMnt::ImScsiCompletionThread: Memory allocation error.\n");
+                ExFreePoolWithTag(completion_srb, MP_TAG_GENERAL);
+                completion_srb = NULL;
+                continue;
+            }
+        }
+        else
+        {
+            IoReuseIrp(irp, STATUS_SUCCESS);
+        }
+
+        ImScsiInitializeSrbIoBlock(&completion_srb->SrbIoControl,
+            sizeof(*completion_srb), SMP_IMSCSI_CHECK, 0);
+
+        irp->AssociatedIrp.SystemBuffer = completion_srb;
+
+        ioctl_stack = IoGetNextIrpStackLocation(irp);
+        ioctl_stack->MajorFunction = IRP_MJ_DEVICE_CONTROL;
+        ioctl_stack->Parameters.DeviceIoControl.InputBufferLength =
+            sizeof(*completion_srb);
+        ioctl_stack->Parameters.DeviceIoControl.IoControlCode =
+            IOCTL_SCSI_MINIPORT;
+
+        IoSetCompletionRoutine(irp, ImScsiIoCtlCallCompletion,
+            &irp_done, TRUE, TRUE, TRUE);
+
+        KeClearEvent(&irp_done);
+
+        KdPrint2(("PhDskMnt::ImScsiCompletionThread: Calling SMB_IMSCSI_CHECK.\n"));
+
+        IoCallDriver(pMPDrvInfoGlobal->ControllerObject, irp);
+
+        KeWaitForSingleObject(&irp_done, Executive, KernelMode, FALSE, NULL);
     }
-    else
+
+    KdPrint(("PhDskMnt::ImScsiCompletionThread shutting down.\n"));
+
+    if (irp != NULL)
     {
-        startingSector.QuadPart = 0;
-        REVERSE_BYTES(&startingSector, &pCdb->CDB10.LogicalBlockByte0);
+        IoFreeIrp(irp);
+        ExFreePoolWithTag(completion_srb, MP_TAG_GENERAL);
     }
 
-    startingOffset.QuadPart = startingSector.QuadPart << pLUExt->BlockPower;
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
 
-    KdPrint2(("PhDskMnt::ImScsiDispatchWork starting sector: 0x%I64X\n", startingSector));
+NTSTATUS
+ImScsiStartCompletionThread()
+{
+    HANDLE              thread_handle;
+    OBJECT_ATTRIBUTES   object_attributes;
+    NTSTATUS            status;
+
+    InitializeObjectAttributes(&object_attributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL);
+
+    status = PsCreateSystemThread(
+        &thread_handle,
+        (ACCESS_MASK)0L,
+        &object_attributes,
+        NULL,
+        NULL,
+        ImScsiCompletionThread,
+        NULL);
+
+    if (!NT_SUCCESS(status))
+    {
+        DbgPrint("PhDskMnt::ImScsiStartCompletionThread: Cannot create completion thread. (%#x)\n", status);
+        return status;
+    }
 
-    status = StoragePortGetSystemAddress(pHBAExt, pSrb, &sysaddress);
+    status = ObReferenceObjectByHandle(
+        thread_handle,
+        FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+        *PsThreadType,
+        KernelMode,
+        (PVOID*)&pMPDrvInfoGlobal->CompletionThread,
+        NULL
+        );
 
-    if ((status != STORAGE_STATUS_SUCCESS) | (sysaddress == NULL))
+    if (!NT_SUCCESS(status))
     {
-        DbgPrint("PhDskMnt::ImScsiDispatchWork: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
-            status,
-            pSrb->DataBuffer,
-            sysaddress);
+        DbgPrint("PhDskMnt::ImScsiStartCompletionThread: Cannot reference completion thread. (%#x)\n", status);
+        pMPDrvInfoGlobal->CompletionThread = NULL;
+    }
 
-        pSrb->SrbStatus = SRB_STATUS_ERROR;
-        pSrb->ScsiStatus = SCSISTAT_GOOD;
+    ZwClose(thread_handle);
 
-        return;
-    }
+    return status;
+}
+#endif
 
-    buffer = ExAllocatePoolWithTag(NonPagedPool, pSrb->DataTransferLength, MP_TAG_GENERAL);
+//
+// Allocates work item for an SRB to be served by worker thread of LU. If
+// allocation fails, SRB is set to error and NULL is returned.
+//
+pMP_WorkRtnParms
+ImScsiAllocateWorkItem(
+    __in pHW_HBA_EXT          pHBAExt,
+    __in pHW_LU_EXTENSION     pLUExt,
+    __in PSCSI_REQUEST_BLOCK  pSrb)
+{
+    pMP_WorkRtnParms pWkRtnParms =                    // Allocate parm area for work routine.
+        (pMP_WorkRtnParms)ExAllocatePoolWithTag(NonPagedPool, sizeof(MP_WorkRtnParms), MP_TAG_GENERAL);
 
-    if (buffer == NULL)
+    if (pWkRtnParms == NULL)
     {
-        DbgPrint("PhDskMnt::ImScsiDispatchWork: Memory allocation failed.\n");
+        DbgPrint("PhDskMnt::ImScsiAllocateWorkItem: Failed to allocate work parm structure\n");
 
-        pSrb->SrbStatus = SRB_STATUS_ERROR;
-        pSrb->ScsiStatus = SCSISTAT_GOOD;
+        ScsiSetCheckCondition(pSrb, SRB_STATUS_ERROR, SCSI_SENSE_HARDWARE_ERROR, SCSI_ADSENSE_NO_SENSE, 0);
+        return NULL;
+    }
+
+    RtlZeroMemory(pWkRtnParms, sizeof(MP_WorkRtnParms));
+
+    pWkRtnParms->pHBAExt = pHBAExt;
+    pWkRtnParms->pLUExt = pLUExt;
+    pWkRtnParms->pSrb = pSrb;
+
+    return pWkRtnParms;
+}
+
+//
+// Adds work item last in request list of LU and wakes worker thread.
+// Requests are served in order of arrival.
+//
+VOID
+ImScsiInsertWorkItem(
+    __in pMP_WorkRtnParms         pWkRtnParms,
+    __inout __deref PUCHAR        pResult,
+    __inout __deref PKIRQL        LowestAssumedIrql)
+{
+    KdPrint2(("PhDskMnt::ImScsiInsertWorkItem: Queuing work=0x%p\n", pWkRtnParms));
 
+    ImScsiCoreQueueInsert(&pWkRtnParms->pLUExt->Core.Queue,
+        &pWkRtnParms->RequestListEntry, LowestAssumedIrql);
+
+    *pResult = ResultQueued;                          // Indicate queuing.
+}
+
+//
+// Queues a SCSI request for worker thread of LU, which runs in the System
+// process at PASSIVE_LEVEL.
+//
+VOID
+ImScsiQueueWorkItem(
+    __in pHW_HBA_EXT              pHBAExt,
+    __in pHW_LU_EXTENSION         pLUExt,
+    __in PSCSI_REQUEST_BLOCK      pSrb,
+    __inout __deref PUCHAR        pResult,
+    __inout __deref PKIRQL        LowestAssumedIrql)
+{
+    pMP_WorkRtnParms pWkRtnParms = ImScsiAllocateWorkItem(pHBAExt, pLUExt, pSrb);
+
+    if (pWkRtnParms == NULL)
+    {
         return;
     }
+
+    ImScsiStatisticsStart(pWkRtnParms);
+
+    ImScsiInsertWorkItem(pWkRtnParms, pResult, LowestAssumedIrql);
+}
+
+//
+// Frees last read or written data of LU, for requests that change data
+// in other ways than through write requests.
+//
+VOID
+ImScsiDropLastIoBuffer(
+    __in pHW_LU_EXTENSION         pLUExt,
+    __inout __deref PKIRQL        LowestAssumedIrql)
+{
+    ImScsiCoreDropLastIo(&pLUExt->Core.LastIo, LowestAssumedIrql);
+}
+
+//
+// Back end of LUs for the request path in iocore.cpp. Overlay, verification
+// and hashing are applied here, image format and transport are selected by
+// ImScsiReadDevice and ImScsiWriteDevice.
+//
+static
+NTSTATUS
+ImScsiLUBackendRead(
+    __in PVOID Context,
+    __in PVOID Buffer,
+    __in LONGLONG Offset,
+    __inout PULONG Length)
+{
+    pHW_LU_EXTENSION pLUExt = (pHW_LU_EXTENSION)Context;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+
+    offset.QuadPart = Offset;
+
+    if (pLUExt->OverlayFile != NULL)
+        status = ImScsiReadOverlay(pLUExt, Buffer, &offset, Length);
     else
+        status = ImScsiReadDevice(pLUExt, Buffer, &offset, Length);
+
+    if (NT_SUCCESS(status) && (pLUExt->MerkleIndex != NULL))
+        status = ImScsiVerifyReadData(pLUExt, Buffer, &offset, *Length);
+
+    if (!NT_SUCCESS(status))
     {
-        NTSTATUS status = STATUS_NOT_IMPLEMENTED;
+        return status;
+    }
 
-        /// For write operations, prepare temporary buffer
-        if ((pSrb->Cdb[0] == SCSIOP_WRITE) | (pSrb->Cdb[0] == SCSIOP_WRITE16))
-        {
-            RtlMoveMemory(buffer, sysaddress, pSrb->DataTransferLength);
-        }
+    /// Sequential reads are hashed as they are served.
+    if (pLUExt->ImageHash != NULL)
+    {
+        ImScsiHashReadData(pLUExt, Buffer, Offset, *Length);
+    }
 
-        if ((pSrb->Cdb[0] == SCSIOP_READ) | (pSrb->Cdb[0] == SCSIOP_READ16))
-        {
-            status = ImScsiReadDevice(pLUExt, buffer, &startingOffset, &pSrb->DataTransferLength);
-        }
-        else if ((pSrb->Cdb[0] == SCSIOP_WRITE) | (pSrb->Cdb[0] == SCSIOP_WRITE16))
+    /// Fake random disk signature in case mounted read-only, 0xAA55 at end of mbr and 0x00000000 in disk id field.
+    /// Compatibility fix for mounting Windows Backup vhd files in read-only.
+    if ((pLUExt->FakeDiskSignature != 0) &&
+        (Offset == 0) &&
+        (*Length >= 512) &&
+        (pLUExt->ReadOnly))
+    {
+        PUCHAR mbr = (PUCHAR)Buffer;
+
+        if ((*(PUSHORT)(mbr + 0x01FE) == 0xAA55) &
+            (*(PUSHORT)(mbr + 0x01BC) == 0x0000) &
+            ((*(mbr + 0x01BE) & 0x7F) == 0x00) &
+            ((*(mbr + 0x01CE) & 0x7F) == 0x00) &
+            ((*(mbr + 0x01DE) & 0x7F) == 0x00) &
+            ((*(mbr + 0x01EE) & 0x7F) == 0x00) &
+            ((*(PULONG)(mbr + 0x01B8) == 0x00000000UL)))
         {
-            status = ImScsiWriteDevice(pLUExt, buffer, &startingOffset, &pSrb->DataTransferLength);
+            DbgPrint("PhDskMnt::ImScsiLUBackendRead: Faking disk signature as %#X.\n", pLUExt->FakeDiskSignature);
+
+            *(PULONG)(mbr + 0x01B8) = pLUExt->FakeDiskSignature;
         }
+    }
 
-        if (!NT_SUCCESS(status))
-        {
-            ExFreePoolWithTag(buffer, MP_TAG_GENERAL);
+    return status;
+}
 
-            DbgPrint("PhDskMnt::ImScsiDispatchWork: I/O error status=0x%X\n", status);
-            switch (status)
-            {
-            case STATUS_INVALID_BUFFER_SIZE:
-            {
-                DbgPrint("PhDskMnt::ImScsiDispatchWork: STATUS_INVALID_BUFFER_SIZE from image I/O. Reporting SCSI_SENSE_ILLEGAL_REQUEST/SCSI_ADSENSE_INVALID_CDB/0x00.\n");
-                ScsiSetCheckCondition(
-                    pSrb,
-                    SRB_STATUS_ERROR,
-                    SCSI_SENSE_ILLEGAL_REQUEST,
-                    SCSI_ADSENSE_INVALID_CDB,
-                    0);
-                return;
-            }
-            case STATUS_DEVICE_BUSY:
-            {
-                DbgPrint("PhDskMnt::ImScsiDispatchWork: STATUS_DEVICE_BUSY from image I/O. Reporting SRB_STATUS_BUSY/SCSI_SENSE_NOT_READY/SCSI_ADSENSE_LUN_NOT_READY/SCSI_SENSEQ_BECOMING_READY.\n");
-                ScsiSetCheckCondition(
-                    pSrb,
-                    SRB_STATUS_BUSY,
-                    SCSI_SENSE_NOT_READY,
-                    SCSI_ADSENSE_LUN_NOT_READY,
-                    SCSI_SENSEQ_BECOMING_READY
-                    );
-                return;
-            }
-            default:
-            {
-                ScsiSetError(pSrb, SRB_STATUS_PARITY_ERROR);
-                return;
-            }
-            }
+static
+NTSTATUS
+ImScsiLUBackendWrite(
+    __in PVOID Context,
+    __in PVOID Buffer,
+    __in LONGLONG Offset,
+    __inout PULONG Length)
+{
+    pHW_LU_EXTENSION pLUExt = (pHW_LU_EXTENSION)Context;
+    LARGE_INTEGER offset;
 
-            return;
-        }
+    offset.QuadPart = Offset;
 
-        /// Fake random disk signature in case mounted read-only, 0xAA55 at end of mbr and 0x00000000 in disk id field.
-        /// Compatibility fix for mounting Windows Backup vhd files in read-only.
-        if ((pLUExt->FakeDiskSignature != 0) &&
-            ((pSrb->Cdb[0] == SCSIOP_READ) |
-                (pSrb->Cdb[0] == SCSIOP_READ16)) &&
-            (startingSector.QuadPart == 0) &&
-            (pSrb->DataTransferLength >= 512) &&
-            (pLUExt->ReadOnly))
-        {
-            PUCHAR mbr = (PUCHAR)buffer;
-
-            if ((*(PUSHORT)(mbr + 0x01FE) == 0xAA55) &
-                (*(PUSHORT)(mbr + 0x01BC) == 0x0000) &
-                ((*(mbr + 0x01BE) & 0x7F) == 0x00) &
-                ((*(mbr + 0x01CE) & 0x7F) == 0x00) &
-                ((*(mbr + 0x01DE) & 0x7F) == 0x00) &
-                ((*(mbr + 0x01EE) & 0x7F) == 0x00) &
-                ((*(PULONG)(mbr + 0x01B8) == 0x00000000UL)))
-            {
-                DbgPrint("PhDskMnt::ImScsiDispatchWork: Faking disk signature as %#X.\n", pLUExt->FakeDiskSignature);
+    if (pLUExt->OverlayFile != NULL)
+        return ImScsiWriteOverlay(pLUExt, Buffer, &offset, Length);
+    else
+        return ImScsiWriteDevice(pLUExt, Buffer, &offset, Length);
+}
 
-                *(PULONG)(mbr + 0x01B8) = pLUExt->FakeDiskSignature;
-            }
-        }
+static
+NTSTATUS
+ImScsiLUBackendFlush(
+    __in PVOID Context)
+{
+    return ImScsiFlushLU((pHW_LU_EXTENSION)Context);
+}
 
-        /// For write operations, temporary buffer holds read data.
-        /// Copy that to system buffer.
-        if ((pSrb->Cdb[0] == SCSIOP_READ) | (pSrb->Cdb[0] == SCSIOP_READ16))
-        {
-            RtlMoveMemory(sysaddress, buffer, pSrb->DataTransferLength);
-        }
+const IMSCSI_CORE_BACKEND ImScsiLUBackend = {
+    ImScsiLUBackendRead,
+    ImScsiLUBackendWrite,
+    ImScsiLUBackendFlush
+};
+
+VOID
+ImScsiDispatchReadWrite(
+    __in pHW_HBA_EXT pHBAExt,
+    __in pHW_LU_EXTENSION pLUExt,
+    __in PSCSI_REQUEST_BLOCK pSrb)
+{
+    PVOID sysaddress;
+    ULONG storage_status;
+    NTSTATUS status;
+    IMSCSI_RW_REQUEST request;
+    KIRQL lowest_assumed_irql = PASSIVE_LEVEL;
+
+    ImScsiDecodeReadWrite(pSrb->Cdb, pSrb->DataTransferLength,
+        pLUExt->BlockPower, &request);
+
+    KdPrint2(("PhDskMnt::ImScsiDispatchWork starting sector: 0x%I64X\n", request.StartingSector));
+
+    storage_status = StoragePortGetSystemAddress(pHBAExt, pSrb, &sysaddress);
+
+    if ((storage_status != STORAGE_STATUS_SUCCESS) | (sysaddress == NULL))
+    {
+        DbgPrint("PhDskMnt::ImScsiDispatchWork: StorPortGetSystemAddress failed: status=0x%X address=0x%p translated=0x%p\n",
+            storage_status,
+            pSrb->DataBuffer,
+            sysaddress);
+
+        pSrb->SrbStatus = SRB_STATUS_ERROR;
+        pSrb->ScsiStatus = SCSISTAT_GOOD;
+
+        return;
     }
 
-    ImScsiAcquireLock(&pLUExt->LastIoLock, &LockHandle, lowest_assumed_irql);
+    ImScsiTraceSrb(IMSCSI_TRACE_BACKEND_SUBMIT, pSrb);
+
+    status = ImScsiCoreDispatchReadWrite(&pLUExt->Core, &request, sysaddress,
+        &pSrb->DataTransferLength, IMSCSI_SRB_FUA(pSrb), &lowest_assumed_irql);
 
-    if (pLUExt->LastIoBuffer != NULL)
-        ExFreePoolWithTag(pLUExt->LastIoBuffer, MP_TAG_GENERAL);
+    ImScsiTraceSrb(IMSCSI_TRACE_BACKEND_DONE, pSrb);
 
-    pLUExt->LastIoStartSector = startingSector.QuadPart;
-    pLUExt->LastIoLength = pSrb->DataTransferLength;
-    pLUExt->LastIoBuffer = buffer;
+    if (!NT_SUCCESS(status))
+    {
+        IMSCSI_CORE_SENSE sense;
+
+        DbgPrint("PhDskMnt::ImScsiDispatchWork: I/O error status=0x%X\n", status);
+
+        ImScsiCoreGetSense(status, &sense);
+
+        if (sense.SenseKey == SCSI_SENSE_NO_SENSE)
+        {
+            ScsiSetError(pSrb, sense.SrbStatus);
+        }
+        else
+        {
+            ScsiSetCheckCondition(pSrb, sense.SrbStatus, sense.SenseKey,
+                sense.AdditionalSenseCode, sense.AdditionalSenseCodeQualifier);
+        }
 
-    ImScsiReleaseLock(&LockHandle, &lowest_assumed_irql);
+        return;
+    }
 
     ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
 }
@@ -410,12 +658,38 @@ __in pMP_WorkRtnParms        pWkRtnParms
         }
         break;
 
+        case SMP_IMSCSI_DISCARD_OVERLAY:
+        {
+            KdPrint(("PhDskMnt::ImScsiDispatchWork: Request SMP_IMSCSI_DISCARD_OVERLAY.\n"));
+
+            srb_io_control->ReturnCode = ImScsiDiscardOverlayLU(pLUExt);
+
+            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        }
+        break;
+
+        case SMP_IMSCSI_COMMIT_OVERLAY:
+        {
+            KdPrint(("PhDskMnt::ImScsiDispatchWork: Request SMP_IMSCSI_COMMIT_OVERLAY.\n"));
+
+            srb_io_control->ReturnCode = ImScsiCommitOverlayLU(pLUExt);
+
+            ScsiSetSuccess(pSrb, pSrb->DataTransferLength);
+        }
+        break;
+
         default:
             break;
         }
     }
     break;
 
+    case SRB_FUNCTION_SHUTDOWN:
+    case SRB_FUNCTION_FLUSH:
+        // Write-back LU only, see ScsiOpFlush
+        ImScsiFlushDevice(pHBAExt, pLUExt, pSrb);
+        break;
+
     case SRB_FUNCTION_EXECUTE_SCSI:
         switch (pSrb->Cdb[0])
         {
@@ -432,6 +706,27 @@ __in pMP_WorkRtnParms        pWkRtnParms
             ImScsiUnmapDevice(pHBAExt, pLUExt, pSrb);
             break;
 
+        case SCSIOP_WRITE_SAME:
+        case SCSIOP_WRITE_SAME16:
+            ImScsiWriteSameDevice(pHBAExt, pLUExt, pSrb);
+            break;
+
+        case SCSIOP_POPULATE_TOKEN:
+            // WRITE USING TOKEN, only service action queued
+            ImScsiWriteUsingToken(pHBAExt, pLUExt, pSrb);
+            break;
+
+        case SCSIOP_READ_CAPACITY16:
+            // GET LBA STATUS, only service action queued
+            ImScsiGetLbaStatusDevice(pHBAExt, pLUExt, pSrb);
+            break;
+
+        case SCSIOP_SYNCHRONIZE_CACHE:
+        case SCSIOP_SYNCHRONIZE_CACHE16:
+            // Write-back LU only, see ScsiOpSynchronizeCache
+            ImScsiFlushDevice(pHBAExt, pLUExt, pSrb);
+            break;
+
         default:
         {
             DbgPrint("PhDskMnt::ImScsiDispatchWork unknown function: 0x%X\n", (int)pSrb->Cdb[0]);